@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ARCdigitizer.h"
+#include "DigiBatchDriver.h"
+
+/** @class ARCdigiBatchDriver
+ *
+ *  Runs the batch mode of the ARCdigitizer (ARCdigitizer::digitizeBatch) on a podio file, batchSize events per call,
+ *  see DigiBatchDriver. The digitizer instance is configured in the job options as usual: with the same name, it draws
+ *  the same random numbers as in a job with IOSvc, whatever the batch size. The collection names are the ones of its
+ *  data handles.
+ *
+ */
+
+class ARCdigiBatchDriver final : public DigiBatchDriver<ARCdigitizer> {
+public:
+  using DigiBatchDriver<ARCdigitizer>::DigiBatchDriver;
+
+protected:
+  StatusCode digitize(const ARCdigitizer& digitizer, std::vector<podio::Frame>& frames) const override;
+
+private:
+  Gaudi::Property<std::string> m_simHitsName{this, "inputSimHits", "ARC_HITS", "Input sim tracker hit collection name"};
+  Gaudi::Property<std::string> m_headerName{this, "eventHeader", "EventHeader", "Input event header collection name"};
+  Gaudi::Property<std::string> m_digiHitsName{this, "outputDigiHits", "ARC_DIGI_HITS", "Output digitized tracker hit collection name"};
+};
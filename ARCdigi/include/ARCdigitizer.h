@@ -3,18 +3,30 @@
 // GAUDI
 #include "Gaudi/Property.h"
 #include "Gaudi/Algorithm.h"
-#include "GaudiKernel/IRndmGenSvc.h"
-#include "GaudiKernel/RndmGenerators.h"
 
 // K4FWCORE
 #include "k4FWCore/DataHandle.h"
+#include "k4Interface/IUniqueIDGenSvc.h"
 
 // EDM4HEP
+#include "edm4hep/EventHeaderCollection.h"
 #include "edm4hep/SimTrackerHitCollection.h"
 #include "edm4hep/TrackerHit3DCollection.h"
+#include "edm4hep/Vector3d.h"
 
 // DD4HEP
 #include "DD4hep/Detector.h"
+#include "DDRec/CellIDPositionConverter.h"
+#include "DDSegmentation/BitFieldCoder.h"
+
+#include "AlgorithmInstrumentation.h"
+#include "CellIDIndex.h"
+#include "IDigiGeometryCacheSvc.h"
+
+// STL
+#include <memory>
+#include <random>
+#include <vector>
 
 /** @class ARCdigitizer
  *
@@ -41,21 +53,107 @@ public:
    *   @return status code
    */
   virtual StatusCode finalize() final;
+  /**  Batch mode: digitize the sim hits of several events at once, for drivers running over many small events (e.g.
+   *   single particle calibration samples) where the per event overheads dominate. The PDE lookup and the time
+   *   quantization run over the concatenated hits of all the events, the outputs are split back per event into the
+   *   collections given by the caller. Each event draws its random numbers from its own seed, so its output does not
+   *   depend on the batch. execute() is a batch of one event.
+   *   @return status code
+   */
+  StatusCode digitizeBatch(const std::vector<const edm4hep::SimTrackerHitCollection*>& input_sim_hits,
+                           const std::vector<size_t>&                                  seeds,
+                           const std::vector<edm4hep::TrackerHit3DCollection*>&        output_digi_hits) const;
+  /**  Seed of the event described by the headers, the one used by execute(). Only available if usesRandomNumbers().
+   */
+  size_t eventSeed(const edm4hep::EventHeaderCollection& headers) const;
+  /**  Whether a random step (SiPM efficiency, time jitter or dark counts) is enabled: the UniqueIDGenSvc and the event
+   *   headers are only needed then, otherwise the seeds are not used.
+   */
+  bool usesRandomNumbers() const { return m_uses_random_numbers; }
 
 private:
   // Input sim tracker hit collection name
   mutable DataHandle<edm4hep::SimTrackerHitCollection> m_input_sim_hits{"inputSimHits", Gaudi::DataHandle::Reader, this};
+  // Input event header collection name, used to seed the random engine (only read if a random step is enabled)
+  mutable DataHandle<edm4hep::EventHeaderCollection> m_headers{"EventHeader", Gaudi::DataHandle::Reader, this};
   // Output digitized tracker hit collection name
   mutable DataHandle<edm4hep::TrackerHit3DCollection> m_output_digi_hits{"outputDigiHits", Gaudi::DataHandle::Writer, this};
   // Flat value for SiPM efficiency
   FloatProperty m_flat_SiPM_effi{this, "flatSiPMEfficiency", -1.0, "Flat value for SiPM quantum efficiency (<0 := disabled)"};
   // Apply the SiPM efficiency to digitized hits instead of simulated hits
   BooleanProperty m_apply_SiPM_effi_to_digi{this, "applySiPMEffiToDigiHits", false, "Apply the SiPM efficiency to digitized hits instead of simulated hits"};
+  // Tabulated SiPM photon detection efficiency as a function of the photon wavelength
+  Gaudi::Property<std::vector<float>> m_pde_wavelengths{this, "pdeWavelengths", {}, "Wavelengths of the tabulated SiPM photon detection efficiency curve [nm] (empty := disabled)"};
+  Gaudi::Property<std::vector<float>> m_pde_values{this, "pdeEfficiencies", {}, "SiPM photon detection efficiency at each of the pdeWavelengths"};
+  Gaudi::Property<int> m_pde_table_size{this, "pdeTableSize", 1024, "Number of points of the uniform photon energy grid the PDE curve is resampled on"};
+  // Timing digitization
+  FloatProperty m_time_window_start{this, "timeWindowStart", 0.0, "Start of the readout window [ns]"};
+  FloatProperty m_time_window_length{this, "timeWindowLength", -1.0, "Length of the readout window [ns] (<=0 := no readout window)"};
+  BooleanProperty m_drop_hits_outside_window{this, "dropHitsOutsideWindow", false, "Drop the digitized hits whose time is outside of the readout window"};
+  FloatProperty m_time_jitter{this, "timeJitter", -1.0, "Gaussian time jitter of the SiPM + TDC chain [ns] (<=0 := disabled)"};
+  FloatProperty m_tdc_bin_width{this, "tdcBinWidth", -1.0, "TDC bin width, the bins start at timeWindowStart [ns] (<=0 := no time quantization)"};
+  FloatProperty m_dark_count_rate{this, "darkCountRate", -1.0, "Dark count rate per SiPM pixel, injected within the readout window [Hz] (<=0 := disabled)"};
+  // Per stage timing and throughput counters (one probe per batch, i.e. per event in execute())
+  enum Stages { SiPMEfficiency, HitMerging, TimeDigitization, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"SiPM efficiency", "hit merging", "time digitization", "output fill"}};
+  // Unique ID service, used to seed the random engine for each event
+  Gaudi::Property<std::string> m_uidSvcName{this, "uidSvcName", "uidSvc", "The name of the UniqueIDGenSvc instance"};
+
+  // Detector readout name
+  Gaudi::Property<std::string> m_readoutName{this, "readoutName", "ARC_HITS", "Name of the ARC readout, used to build the SiPM pixel position table (if it does not exist, the positions are computed by the CellIDPositionConverter)"};
+  // Geometry cache service, providing the SiPM pixel position table
+  Gaudi::Property<std::string> m_geometryCacheSvcName{this, "geometryCacheSvcName", "DigiGeometryCacheSvc", "The name of the DigiGeometryCacheSvc (or DigiGeometrySnapshotSvc) instance"};
+
+  // Detector geometry, nullptr with a geometry snapshot
+  dd4hep::Detector* m_detector = nullptr;
+  // Decoder for the cellID, nullptr without the readout
+  dd4hep::DDSegmentation::BitFieldCoder* m_decoder = nullptr;
+  // cellID -> position converter, used for the cells missing from the SiPM pixel position table, or for all of them
+  // without the readout (not available with a geometry snapshot)
+  std::unique_ptr<dd4hep::rec::CellIDPositionConverter> m_converter;
+  // Geometry cache service, and its table of the global position of each SiPM pixel (shared, immutable; nullptr without
+  // the readout)
+  SmartIF<IDigiGeometryCacheSvc>  m_geometryCacheSvc;
+  const DigiGeometry::CellTable*  m_sipm_table = nullptr;
+  // Position of a SiPM pixel, read from the table (or computed if the pixel is missing from it, in which case
+  // n_missing is incremented)
+  edm4hep::Vector3d getSiPMPosition(uint64_t cellID, uint64_t& n_missing) const;
+  // PDE curve resampled on a uniform photon energy grid starting at m_pde_energy_min [GeV], zero outside of it
+  std::vector<float> m_pde_table;
+  float              m_pde_energy_min = 0;
+  float              m_pde_inv_step   = 0;
+  // Resample the PDE curve given as (wavelength, efficiency) points on the uniform photon energy grid
+  StatusCode buildPDETable();
+  // Unique ID service, only retrieved if a random step is enabled
+  SmartIF<IUniqueIDGenSvc> m_uidSvc;
+  bool                     m_uses_random_numbers = false;
+  // Per event random engine, seeded from the event header (thread local, as the algorithm is shared between threads)
+  inline static thread_local std::mt19937_64 m_engine;
+  void                                       prepareRandomEngine(size_t seed) const;
+  // Per thread buffers for the batched accept/reject pass: efficiency (or photon energy) in, decision out
+  inline static thread_local std::vector<float>   m_efficiencies;
+  inline static thread_local std::vector<float>   m_randoms;
+  inline static thread_local std::vector<uint8_t> m_accepted;
+  // Turn the photon energies stored in m_efficiencies into detection efficiencies
+  void convertEnergiesToPDE() const;
+  // Accept the entries [begin, end) of m_efficiencies with the corresponding probability, result in m_accepted
+  void sampleAcceptance(std::size_t begin, std::size_t end) const;
+
+  // Add dark counts in random SiPM pixels, uniformly distributed within the readout window, to the merged hits of the
+  // event starting at first_hit
+  void addDarkCounts(std::size_t first_hit) const;
 
-  // Detector geometry
-  dd4hep::Detector* m_detector;
-  // Random Number Service
-  SmartIF<IRndmGenSvc> m_randSvc;
-  // Uniform random number generator used for the SiPM quantum efficiency
-  Rndm::Numbers m_uniform;
+  // Summed deposited energy and earliest arrival time of the hits in one cell
+  struct MergedHit {
+    uint64_t cellID;
+    float    eDep;
+    float    time;
+  };
+  // Per thread merging buffers, reused across events to avoid re-allocating them; the merged hits of all the events of
+  // a batch are stored one event after the other
+  inline static thread_local CellIDIndex            m_merged_hit_index;
+  inline static thread_local std::vector<MergedHit> m_merged_hits;
+  // First sim hit and first merged hit of each event of a batch, plus the totals as last entries
+  inline static thread_local std::vector<std::size_t> m_sim_hit_offsets;
+  inline static thread_local std::vector<std::size_t> m_merged_hit_offsets;
 };
@@ -0,0 +1,29 @@
+#include "ARCdigiBatchDriver.h"
+
+DECLARE_COMPONENT(ARCdigiBatchDriver)
+
+StatusCode ARCdigiBatchDriver::digitize(const ARCdigitizer& digitizer, std::vector<podio::Frame>& frames) const {
+  const size_t nEvents = frames.size();
+  std::vector<const edm4hep::SimTrackerHitCollection*> input_sim_hits;
+  std::vector<size_t>                                  seeds;
+  input_sim_hits.reserve(nEvents);
+  seeds.reserve(nEvents);
+  for (const auto& frame : frames) {
+    input_sim_hits.push_back(&frame.get<edm4hep::SimTrackerHitCollection>(m_simHitsName));
+    seeds.push_back(digitizer.usesRandomNumbers()
+                        ? digitizer.eventSeed(frame.get<edm4hep::EventHeaderCollection>(m_headerName))
+                        : 0);
+  }
+
+  std::vector<edm4hep::TrackerHit3DCollection>  digi_hits(nEvents);
+  std::vector<edm4hep::TrackerHit3DCollection*> output_digi_hits;
+  for (auto& collection : digi_hits)
+    output_digi_hits.push_back(&collection);
+  StatusCode sc = digitizer.digitizeBatch(input_sim_hits, seeds, output_digi_hits);
+  if (sc.isFailure())
+    return sc;
+
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent)
+    frames[iEvent].put(std::move(digi_hits[iEvent]), m_digiHitsName);
+  return StatusCode::SUCCESS;
+}
@@ -3,88 +3,360 @@
 // EDM4HEP
 #include "edm4hep/Vector3d.h"
 
-// DD4HEP
-#include "DDRec/CellIDPositionConverter.h"
-
 // STL
-#include <unordered_map>
-#include <utility>
+#include <algorithm>
+#include <cmath>
 
 DECLARE_COMPONENT(ARCdigitizer)
 
 ARCdigitizer::ARCdigitizer(const std::string& aName, ISvcLocator* aSvcLoc) : Gaudi::Algorithm(aName, aSvcLoc) {
   declareProperty("inputSimHits", m_input_sim_hits, "Input sim tracker hit collection name");
+  declareProperty("eventHeader", m_headers, "Input event header collection name");
   declareProperty("outputDigiHits", m_output_digi_hits, "Output digitized tracker hit collection name");
 }
 
 ARCdigitizer::~ARCdigitizer() {}
 
 StatusCode ARCdigitizer::initialize() {
-  // Fetch our detector instance
-  m_detector = &(dd4hep::Detector::getInstance());
-  if (!m_detector) {
-    error() << "Couldn't fetch detector instance!" << endmsg;
+  // Sanity check on efficiency cut
+  if (m_flat_SiPM_effi > 1.0) {
+    error() << "Flat SiPM efficiency cannot exceed 1!" << endmsg;
     return StatusCode::FAILURE;
   }
-  // Initialize random number service
-  m_randSvc = service("RndmGenSvc", false);
-  if (!m_randSvc) {
-    error() << "Couldn't get RndmGenSvc!" << endmsg;
+  // Wavelength dependent SiPM efficiency
+  if (!m_pde_wavelengths.value().empty() || !m_pde_values.value().empty()) {
+    if (m_flat_SiPM_effi >= 0.0) {
+      error() << "flatSiPMEfficiency and the pdeWavelengths/pdeEfficiencies curve cannot be used together!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // A digitized hit may sum photons of different energies
+    if (m_apply_SiPM_effi_to_digi) {
+      error() << "The wavelength dependent SiPM efficiency can only be applied to simulated hits!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (buildPDETable().isFailure())
+      return StatusCode::FAILURE;
+  }
+  // Timing digitization
+  if ((m_dark_count_rate > 0 || m_drop_hits_outside_window) && m_time_window_length <= 0) {
+    error() << "Dark counts and dropping hits outside of the readout window need timeWindowLength > 0!" << endmsg;
     return StatusCode::FAILURE;
   }
-  if (m_uniform.initialize(m_randSvc, Rndm::Flat(0.0, 1.0)).isFailure()) {
-    error() << "Couldn't initialize RndmGenSvc!" << endmsg;
+  // Get the SiPM pixel position table of the geometry cache (the photodetector grid is static), which is built on the
+  // GeoSvc detector or read from a geometry snapshot, and our cell ID -> position converter if the detector is there
+  m_geometryCacheSvc = service(m_geometryCacheSvcName, true);
+  if (!m_geometryCacheSvc) {
+    error() << "Couldn't get DigiGeometryCacheSvc!" << endmsg;
     return StatusCode::FAILURE;
   }
-  // Sanity check on efficiency cut
-  if (m_flat_SiPM_effi > 1.0) {
-    error() << "Flat SiPM efficiency cannot exceed 1!" << endmsg;
+  m_detector = m_geometryCacheSvc->detector();
+  if (m_detector)
+    m_converter = std::make_unique<dd4hep::rec::CellIDPositionConverter>(*m_detector);
+  // Without the readoutName in the detector (e.g. an ARC readout with another name), the SiPM pixel positions are all
+  // computed by the converter, as without the table
+  if (m_detector && !m_detector->readouts().count(m_readoutName)) {
+    warning() << "Readout " << m_readoutName.value() << " does not exist, the SiPM pixel positions are computed by "
+              << "the CellIDPositionConverter" << endmsg;
+  } else {
+    m_decoder = m_geometryCacheSvc->decoder(m_readoutName);
+    if (!m_decoder)
+      return StatusCode::FAILURE;
+    m_sipm_table = m_geometryCacheSvc->cellPositions(m_readoutName);
+    if (!m_sipm_table)
+      return StatusCode::FAILURE;
+  }
+  if (m_dark_count_rate > 0 && (!m_sipm_table || m_sipm_table->size() == 0)) {
+    error() << "Dark counts need the SiPM pixel position table, which is empty!" << endmsg;
     return StatusCode::FAILURE;
   }
+  // Initialize the unique ID service, used to seed the random engine, if there is a random step
+  m_uses_random_numbers = m_flat_SiPM_effi >= 0.0 || !m_pde_wavelengths.value().empty() || m_time_jitter > 0 ||
+                          m_dark_count_rate > 0;
+  if (m_uses_random_numbers) {
+    m_uidSvc = service(m_uidSvcName, false);
+    if (!m_uidSvc) {
+      error() << "Couldn't get UniqueIDGenSvc!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+  }
+  m_instrumentation.initialize(this);
   return StatusCode::SUCCESS;
 }
 
+StatusCode ARCdigitizer::buildPDETable() {
+  const auto& wavelengths = m_pde_wavelengths.value();
+  const auto& values      = m_pde_values.value();
+  if (wavelengths.size() != values.size() || wavelengths.size() < 2) {
+    error() << "pdeWavelengths and pdeEfficiencies must have the same size, with at least two points!" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_pde_table_size < 2) {
+    error() << "pdeTableSize must be at least 2!" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  for (std::size_t i = 0; i < wavelengths.size(); ++i) {
+    if (wavelengths[i] <= 0 || (i > 0 && wavelengths[i] <= wavelengths[i - 1])) {
+      error() << "pdeWavelengths must be positive and strictly increasing!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (values[i] < 0 || values[i] > 1) {
+      error() << "pdeEfficiencies must be within [0, 1]!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+  }
+
+  // E [GeV] = hc / lambda, with hc in GeV nm (the sim hit eDep of an optical photon is its energy)
+  constexpr double hc         = 1.239841984e-6;
+  double           energy_min = hc / wavelengths.back();
+  double           energy_max = hc / wavelengths.front();
+  double           step       = (energy_max - energy_min) / (m_pde_table_size - 1);
+  m_pde_energy_min            = energy_min;
+  m_pde_inv_step              = 1.0 / step;
+  // Linear interpolation of the curve in wavelength at each point of the energy grid
+  m_pde_table.resize(m_pde_table_size);
+  for (int i = 0; i < m_pde_table_size; ++i) {
+    double wavelength = std::clamp(hc / (energy_min + i * step), double(wavelengths.front()), double(wavelengths.back()));
+    auto   upper      = std::upper_bound(wavelengths.begin(), wavelengths.end(), wavelength);
+    if (upper == wavelengths.end())
+      --upper;
+    std::size_t j = upper - wavelengths.begin();
+    double      f = (wavelength - wavelengths[j - 1]) / (wavelengths[j] - wavelengths[j - 1]);
+    m_pde_table[i] = values[j - 1] + f * (values[j] - values[j - 1]);
+  }
+  info() << "SiPM PDE curve with " << wavelengths.size() << " points resampled on " << m_pde_table_size
+         << " photon energies in [" << energy_min * 1e9 << ", " << energy_max * 1e9 << "] eV" << endmsg;
+  return StatusCode::SUCCESS;
+}
+
+edm4hep::Vector3d ARCdigitizer::getSiPMPosition(uint64_t cellID, uint64_t& n_missing) const {
+  if (m_sipm_table) {
+    uint32_t index = m_sipm_table->find(cellID);
+    if (index != DigiGeometry::CellTable::npos) {
+      const double* pos = m_sipm_table->position(index);
+      return edm4hep::Vector3d(pos[0], pos[1], pos[2]);
+    }
+    ++n_missing;
+    debug() << "Cell " << m_decoder->valueString(cellID) << " is missing from the SiPM pixel position table" << endmsg;
+  }
+  if (!m_converter)
+    return edm4hep::Vector3d(0, 0, 0);
+  auto pos = m_converter->position(cellID);
+  return edm4hep::Vector3d(pos.X(), pos.Y(), pos.Z());
+}
+
+size_t ARCdigitizer::eventSeed(const edm4hep::EventHeaderCollection& headers) const {
+  return m_uidSvc->getUniqueID(headers, this->name());
+}
+
+void ARCdigitizer::prepareRandomEngine(size_t seed) const {
+  m_engine.seed(seed);
+  // advance internal state to minimize possibility of creating correlations
+  m_engine.discard(10);
+}
+
+void ARCdigitizer::convertEnergiesToPDE() const {
+  // Branchless linear interpolation on the uniform energy grid, so that the loop can be vectorized
+  const float* table    = m_pde_table.data();
+  const float  last     = static_cast<float>(m_pde_table.size() - 1);
+  const float  e_min    = m_pde_energy_min;
+  const float  inv_step = m_pde_inv_step;
+  float*       values   = m_efficiencies.data();
+  for (std::size_t i = 0, n = m_efficiencies.size(); i < n; ++i) {
+    float x      = (values[i] - e_min) * inv_step;
+    bool  inside = x >= 0.f && x <= last;
+    x            = std::clamp(x, 0.f, last);
+    int   bin    = std::min(int(x), int(last) - 1);
+    float f      = x - bin;
+    float pde    = table[bin] + f * (table[bin + 1] - table[bin]);
+    values[i]    = inside ? pde : 0.f;
+  }
+}
+
+void ARCdigitizer::sampleAcceptance(std::size_t begin, std::size_t end) const {
+  // Draw all the random numbers first, the comparison loop below then has no dependency on the engine
+  std::uniform_real_distribution<float> flat(0.f, 1.f);
+  m_randoms.resize(m_efficiencies.size());
+  m_accepted.resize(m_efficiencies.size());
+  for (std::size_t i = begin; i < end; ++i)
+    m_randoms[i] = flat(m_engine);
+  const float* efficiencies = m_efficiencies.data();
+  const float* randoms      = m_randoms.data();
+  uint8_t*     accepted     = m_accepted.data();
+  for (std::size_t i = begin; i < end; ++i)
+    accepted[i] = randoms[i] < efficiencies[i];
+}
+
+void ARCdigitizer::addDarkCounts(std::size_t first_hit) const {
+  // Sparse sampling: draw the total number of dark counts over all the pixels, then the pixel and time of each of them
+  double      n_expected    = m_dark_count_rate.value() * 1e-9 * m_time_window_length.value() * m_sipm_table->size();
+  std::size_t n_dark_counts = std::poisson_distribution<std::size_t>(n_expected)(m_engine);
+  std::uniform_int_distribution<std::size_t> pixel(0, m_sipm_table->size() - 1);
+  std::uniform_real_distribution<float>      time(m_time_window_start.value(),
+                                                  m_time_window_start.value() + m_time_window_length.value());
+
+  // Rebuild the index of the merged hits of the event, they may have been filtered by the SiPM efficiency
+  m_merged_hit_index.reset(m_merged_hits.size() - first_hit + n_dark_counts);
+  for (std::size_t i = first_hit; i < m_merged_hits.size(); ++i)
+    m_merged_hit_index.insert(m_merged_hits[i].cellID);
+  // Dark counts carry no deposited energy, in a pixel with signal they only matter if they come first
+  for (std::size_t i = 0; i < n_dark_counts; ++i) {
+    uint64_t cellID        = m_sipm_table->key(pixel(m_engine));
+    float    dark_time     = time(m_engine);
+    auto [index, inserted] = m_merged_hit_index.insert(cellID);
+    if (inserted)
+      m_merged_hits.push_back(MergedHit{cellID, 0.0, dark_time});
+    else
+      m_merged_hits[first_hit + index].time = std::min(m_merged_hits[first_hit + index].time, dark_time);
+  }
+  verbose() << "Added " << n_dark_counts << " dark counts" << endmsg;
+}
+
 StatusCode ARCdigitizer::execute(const EventContext&) const {
-  // Get the input collection with Geant4 hits
-  const edm4hep::SimTrackerHitCollection* input_sim_hits = m_input_sim_hits.get();
-  verbose() << "Input Sim Hit collection size: " << input_sim_hits->size() << endmsg;
-
-  // Dictionary to keep track of cell IDs and (summed) deposited energies / (earliest) arrival times
-  std::unordered_map<uint64_t, std::pair<float, float>> merged_digi_hits;
-
-  // Digitize the sim hits
-  for (const auto& input_sim_hit : *input_sim_hits) {
-    // Throw away simulated hits based on flat SiPM efficiency
-    if (!m_apply_SiPM_effi_to_digi && m_flat_SiPM_effi >= 0.0 && m_uniform.shoot() > m_flat_SiPM_effi)
-      continue;
-    auto cell = input_sim_hit.getCellID();
-    if (merged_digi_hits.find(cell) == merged_digi_hits.end())
-      merged_digi_hits[cell] = std::pair<float, float>(0.0, -1.0);
-    merged_digi_hits[cell].first += input_sim_hit.getEDep();
-    if (merged_digi_hits[cell].second < 0.0 || input_sim_hit.getTime() < merged_digi_hits[cell].second)
-      merged_digi_hits[cell].second = input_sim_hit.getTime();
-  }
-
-  // Get our cell ID -> position converter
-  dd4hep::rec::CellIDPositionConverter converter(*m_detector);
-
-  // Write the digitized hits
-  edm4hep::TrackerHit3DCollection* output_digi_hits = m_output_digi_hits.createAndPut();
-  for (auto it = merged_digi_hits.begin(); it != merged_digi_hits.end(); it++) {
-    // Throw away digitized hits based on flat SiPM efficiency
-    if (m_apply_SiPM_effi_to_digi && m_flat_SiPM_effi >= 0.0 && m_uniform.shoot() > m_flat_SiPM_effi)
-      continue;
-    auto output_digi_hit = output_digi_hits->create();
-    auto pos             = converter.position(it->first);
-    output_digi_hit.setCellID(it->first);
-    output_digi_hit.setPosition(edm4hep::Vector3d(pos.X(), pos.Y(), pos.Z()));
-    output_digi_hit.setEDep(it->second.first);
-    output_digi_hit.setTime(it->second.second);
-  }
-
-  verbose() << "Output Digi Hit collection size: " << output_digi_hits->size() << endmsg;
+  // One event is a batch of one, the event headers are only read if there are random numbers to draw
+  const size_t seed = m_uses_random_numbers ? eventSeed(*m_headers.get()) : 0;
+  return digitizeBatch({m_input_sim_hits.get()}, {seed}, {m_output_digi_hits.createAndPut()});
+}
+
+StatusCode ARCdigitizer::digitizeBatch(const std::vector<const edm4hep::SimTrackerHitCollection*>& input_sim_hits,
+                                       const std::vector<size_t>&                                  seeds,
+                                       const std::vector<edm4hep::TrackerHit3DCollection*>&        output_digi_hits) const {
+  const std::size_t n_events = input_sim_hits.size();
+  if (seeds.size() != n_events || output_digi_hits.size() != n_events) {
+    error() << "The batch needs one seed and one output collection per event!" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  auto probe = m_instrumentation.event();
+  m_sim_hit_offsets.assign(1, 0);
+  for (const auto* event_sim_hits : input_sim_hits) {
+    verbose() << "Input Sim Hit collection size: " << event_sim_hits->size() << endmsg;
+    m_sim_hit_offsets.push_back(m_sim_hit_offsets.back() + event_sim_hits->size());
+  }
+  const std::size_t n_sim_hits = m_sim_hit_offsets.back();
+  probe.hitsIn(n_sim_hits);
+
+  // SiPM efficiency of the simulated hits (flat or wavelength dependent), for the concatenated hits of all the events
+  const bool use_pde            = !m_pde_table.empty();
+  const bool sim_hit_efficiency = use_pde || (!m_apply_SiPM_effi_to_digi && m_flat_SiPM_effi >= 0.0);
+  probe.enter(SiPMEfficiency);
+  if (use_pde) {
+    m_efficiencies.resize(n_sim_hits);
+    for (std::size_t i_event = 0; i_event < n_events; ++i_event) {
+      float* energies = m_efficiencies.data() + m_sim_hit_offsets[i_event];
+      for (std::size_t i = 0; i < input_sim_hits[i_event]->size(); ++i)
+        energies[i] = (*input_sim_hits[i_event])[i].getEDep();
+    }
+    convertEnergiesToPDE();
+  } else if (sim_hit_efficiency) {
+    m_efficiencies.assign(n_sim_hits, m_flat_SiPM_effi.value());
+  }
+  const bool digi_hit_efficiency = m_apply_SiPM_effi_to_digi && m_flat_SiPM_effi >= 0.0;
+
+  // The random steps, event by event from the seed of each event
+  m_merged_hits.clear();
+  m_merged_hit_offsets.assign(1, 0);
+  for (std::size_t i_event = 0; i_event < n_events; ++i_event) {
+    const auto&       event_sim_hits = *input_sim_hits[i_event];
+    const std::size_t first_sim_hit  = m_sim_hit_offsets[i_event];
+    const std::size_t first_hit      = m_merged_hits.size();
+    if (m_uses_random_numbers)
+      prepareRandomEngine(seeds[i_event]);
+
+    // Decide which simulated hits survive the SiPM efficiency, in one batch
+    probe.enter(SiPMEfficiency);
+    if (sim_hit_efficiency)
+      sampleAcceptance(first_sim_hit, first_sim_hit + event_sim_hits.size());
+
+    // Keep track of cell IDs and (summed) deposited energies / (earliest) arrival times, in order of first appearance
+    probe.enter(HitMerging);
+    m_merged_hit_index.reset(event_sim_hits.size());
+    for (std::size_t i = 0; i < event_sim_hits.size(); ++i) {
+      // Throw away simulated hits based on SiPM efficiency
+      if (sim_hit_efficiency && !m_accepted[first_sim_hit + i])
+        continue;
+      const auto& input_sim_hit = event_sim_hits[i];
+      auto [index, inserted] = m_merged_hit_index.insert(input_sim_hit.getCellID());
+      if (inserted)
+        m_merged_hits.push_back(MergedHit{input_sim_hit.getCellID(), 0.0, input_sim_hit.getTime()});
+      MergedHit& merged_hit = m_merged_hits[first_hit + index];
+      merged_hit.eDep += input_sim_hit.getEDep();
+      merged_hit.time = std::min(merged_hit.time, input_sim_hit.getTime());
+    }
+
+    // Decide which digitized hits survive the flat SiPM efficiency, in one batch (m_efficiencies is free: the SiPM
+    // efficiency is applied either to the simulated or to the digitized hits)
+    probe.enter(SiPMEfficiency);
+    if (digi_hit_efficiency) {
+      const std::size_t n_hits = m_merged_hits.size() - first_hit;
+      m_efficiencies.assign(n_hits, m_flat_SiPM_effi.value());
+      sampleAcceptance(0, n_hits);
+      std::size_t n_accepted = 0;
+      for (std::size_t i = 0; i < n_hits; ++i) {
+        if (m_accepted[i])
+          m_merged_hits[first_hit + n_accepted++] = m_merged_hits[first_hit + i];
+      }
+      m_merged_hits.resize(first_hit + n_accepted);
+    }
+
+    // Add the SiPM dark counts
+    probe.enter(TimeDigitization);
+    if (m_dark_count_rate > 0)
+      addDarkCounts(first_hit);
+
+    // Time jitter of the SiPM + TDC chain
+    if (m_time_jitter > 0) {
+      std::normal_distribution<float> jitter(0.f, m_time_jitter.value());
+      for (std::size_t i = first_hit; i < m_merged_hits.size(); ++i)
+        m_merged_hits[i].time += jitter(m_engine);
+    }
+    m_merged_hit_offsets.push_back(m_merged_hits.size());
+  }
+
+  // Time quantization in TDC bins (the time is set to the bin center), for the merged hits of all the events
+  probe.enter(TimeDigitization);
+  if (m_tdc_bin_width > 0) {
+    const float start = m_time_window_start, width = m_tdc_bin_width;
+    for (auto& merged_hit : m_merged_hits)
+      merged_hit.time = start + (std::floor((merged_hit.time - start) / width) + 0.5f) * width;
+  }
+  const float window_start = m_time_window_start;
+  const float window_end   = m_time_window_start.value() + m_time_window_length.value();
+
+  // Write the digitized hits, split back per event
+  probe.enter(OutputFill);
+  uint64_t n_written = 0, n_missing = 0;
+  for (std::size_t i_event = 0; i_event < n_events; ++i_event) {
+    edm4hep::TrackerHit3DCollection* event_digi_hits = output_digi_hits[i_event];
+    for (std::size_t i = m_merged_hit_offsets[i_event]; i < m_merged_hit_offsets[i_event + 1]; ++i) {
+      const MergedHit& merged_hit = m_merged_hits[i];
+      // Throw away digitized hits outside of the readout window
+      if (m_drop_hits_outside_window && (merged_hit.time < window_start || merged_hit.time >= window_end))
+        continue;
+      auto output_digi_hit = event_digi_hits->create();
+      output_digi_hit.setCellID(merged_hit.cellID);
+      output_digi_hit.setPosition(getSiPMPosition(merged_hit.cellID, n_missing));
+      output_digi_hit.setEDep(merged_hit.eDep);
+      output_digi_hit.setTime(merged_hit.time);
+    }
+    verbose() << "Output Digi Hit collection size: " << event_digi_hits->size() << endmsg;
+    n_written += event_digi_hits->size();
+  }
+  probe.leave();
+  probe.hitsOut(n_written);
+  if (probe.enabled())
+    probe.workingMemory(m_merged_hits.capacity() * sizeof(MergedHit) +
+                        m_efficiencies.capacity() * sizeof(float) + m_randoms.capacity() * sizeof(float) +
+                        m_accepted.capacity() * sizeof(uint8_t) + m_merged_hit_index.memory());
+  if (m_sipm_table)
+    m_sipm_table->countLookups(n_written - n_missing, n_missing);
+  if (n_missing > 0 && !m_converter) {
+    error() << n_missing << " SiPM pixels are not in the geometry snapshot!" << endmsg;
+    return StatusCode::FAILURE;
+  }
 
   return StatusCode::SUCCESS;
 }
 
-StatusCode ARCdigitizer::finalize() { return StatusCode::SUCCESS; }
+StatusCode ARCdigitizer::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
@@ -14,14 +14,27 @@ from Configurables import k4DataSvc
 dataservice = k4DataSvc("EventDataSvc", input = vars().get("input", "data/arcsim_kaon+_edm4hep.root"))
 
 from Configurables import PodioInput
-podioinput = PodioInput("PodioInput", collections = ["ARC_HITS"], OutputLevel = DEBUG)
+podioinput = PodioInput("PodioInput", collections = ["EventHeader", "ARC_HITS"], OutputLevel = DEBUG)
 
 from Configurables import ARCdigitizer
 arc_digitizer = ARCdigitizer("ARCdigitizer",
     inputSimHits = "ARC_HITS",
-    outputDigiHits = "ARC_DIGI_HITS"
+    outputDigiHits = "ARC_DIGI_HITS",
+    # Typical SiPM photon detection efficiency curve
+    pdeWavelengths = [300, 350, 400, 450, 500, 550, 600, 700, 800, 900],
+    pdeEfficiencies = [0.15, 0.35, 0.45, 0.50, 0.47, 0.40, 0.33, 0.22, 0.12, 0.05],
+    # Timing digitization: 25 ns readout window, 50 ps TDC bins, 100 ps jitter, 100 kHz dark count rate per pixel
+    timeWindowStart = 0.0,
+    timeWindowLength = 25.0,
+    dropHitsOutsideWindow = True,
+    tdcBinWidth = 0.05,
+    timeJitter = 0.1,
+    darkCountRate = 1e5,
 )
 
+from Configurables import UniqueIDGenSvc
+uidsvc = UniqueIDGenSvc("uidSvc")
+
 from Configurables import PodioOutput
 podiooutput = PodioOutput("PodioOutput", filename = vars().get("output", "digi.root"), OutputLevel = DEBUG)
 podiooutput.outputCommands = ["keep *"]
@@ -42,5 +55,5 @@ ApplicationMgr(
     ],
     EvtSel = 'NONE',
     EvtMax = 10,
-    ExtSvc = [geoservice, dataservice]
+    ExtSvc = [geoservice, dataservice, uidsvc]
 )
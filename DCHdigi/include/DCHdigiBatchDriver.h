@@ -0,0 +1,37 @@
+#ifndef DCHDIGIBATCHDRIVER_H
+#define DCHDIGIBATCHDRIVER_H
+
+#include "DCHdigi_v01.h"
+#include "DigiBatchDriver.h"
+
+/** ======= DCHdigiBatchDriver ==========
+ * Runs the batch mode of DCHdigi_v01 (DCHdigi_v01::DigitizeBatch) on a podio file, batchSize events per call, see
+ * DigiBatchDriver. The digitizer instance is configured in the job options as usual: with the same name, it draws the
+ * same random numbers as in a job with IOSvc, whatever the batch size. <br>
+ * The collection names below are the ones of the digitizer instance. <br>
+ * @param DCH_simhits The name of input collection, type edm4hep::SimTrackerHitCollection <br>
+ * @param HeaderName The name of the event header collection, used to seed the random engines <br>
+ * (default name EventHeader) <br>
+ * @param DCH_DigiCollection The name of out collection, type extension::SenseWireHitCollection <br>
+ * (default name DCH_DigiCollection) <br>
+ * @param DCH_DigiSimAssociationCollection The name of the link collection between the digitized and the sim hits <br>
+ * (default name DCH_DigiSimAssociationCollection) <br>
+ */
+class DCHdigiBatchDriver final : public DigiBatchDriver<DCHdigi_v01> {
+public:
+  using DigiBatchDriver<DCHdigi_v01>::DigiBatchDriver;
+
+protected:
+  StatusCode digitize(const DCHdigi_v01& digitizer, std::vector<podio::Frame>& frames) const override;
+
+private:
+  Gaudi::Property<std::string> m_simHitsName{this, "DCH_simhits", "DCHCollection", "Input sim hit collection name"};
+  Gaudi::Property<std::string> m_headerName{this, "HeaderName", "EventHeader", "Input event header collection name"};
+  Gaudi::Property<std::string> m_digiHitsName{this, "DCH_DigiCollection", "DCH_DigiCollection",
+                                              "Output digitized hit collection name"};
+  Gaudi::Property<std::string> m_digiSimAssociationName{this, "DCH_DigiSimAssociationCollection",
+                                                        "DCH_DigiSimAssociationCollection",
+                                                        "Output digitized hit to sim hit link collection name"};
+};
+
+#endif
@@ -28,6 +28,8 @@
  * (default value false) <br>
  * @param GeoSvcName Geometry service name <br>
  * (default value GeoSvc) <br>
+ * @param geometryCacheSvcName Geometry snapshot service name, used instead of the GeoSvc if set <br>
+ * (default value empty) <br>
  * @param uidSvcName The name of the UniqueIDGenSvc instance, used to create seed for each event/run, ensuring reproducibility. <br>
  * (default value uidSvc) <br>
  * <br>
@@ -58,12 +60,17 @@
 #include "DDSegmentation/BitFieldCoder.h"
 
 // STL
+#include <memory>
 #include <random>
 #include <string>
+#include <vector>
 
 // data extension for detector DCH_v2
 #include "DDRec/DCH_info.h"
 
+#include "AlgorithmInstrumentation.h"
+#include "IDigiGeometryCacheSvc.h"
+
 // ROOT headers
 #include "TFile.h"
 #include "TH1D.h"
@@ -87,6 +94,25 @@ struct DCHdigi_v01 final
   std::tuple<extension::SenseWireHitCollection, extension::SenseWireHitSimTrackerHitLinkCollection>
   operator()(const edm4hep::SimTrackerHitCollection&, const edm4hep::EventHeaderCollection&) const override;
 
+  /// seeds of the random engines for one event
+  struct EventSeeds {
+    size_t engine;
+    size_t random;
+  };
+  /// seeds of the event described by the headers, the ones used by operator()
+  EventSeeds CalculateEventSeeds(const edm4hep::EventHeaderCollection& headers) const;
+
+  /// Batch mode: digitize the sim hits of several events in one call, see DCHdigiBatchDriver. The hits of each event
+  /// go straight into the output collections of the event given by the caller. Each event draws its random numbers
+  /// from its own seeds, so its output does not depend on the batch. operator() is a batch of one event.
+  /// This is a loop over the events: the wire projection needs the geometry of each cell, and the cluster sampling the
+  /// ROOT random engine, hit by hit, so there is no kernel over the hits of the batch and no measured speed up over
+  /// operator(); the batch only saves the framework calls between the events.
+  void DigitizeBatch(const std::vector<const edm4hep::SimTrackerHitCollection*>&             input_sim_hits,
+                     const std::vector<EventSeeds>&                                           seeds,
+                     const std::vector<extension::SenseWireHitCollection*>&                  output_digi_hits,
+                     const std::vector<extension::SenseWireHitSimTrackerHitLinkCollection*>& output_digi_sim_associations) const;
+
 private:
   /// conversion factor mm to cm, static to the class to avoid clash with DD4hep
   static constexpr double MM_TO_CM = 0.1;
@@ -104,6 +130,18 @@ private:
   /// Pointer to the geometry service
   SmartIF<IGeoSvc> m_geoSvc;
 
+  /// Geometry snapshot service name, used instead of the GeoSvc if set
+  Gaudi::Property<std::string> m_geometryCacheSvcName{
+      this, "geometryCacheSvcName", "",
+      "The name of the DigiGeometrySnapshotSvc (or DigiGeometryCacheSvc) instance providing the geometry instead of "
+      "the GeoSvc (empty := GeoSvc)"};
+  /// Pointer to the geometry snapshot service
+  SmartIF<IDigiGeometryCacheSvc> m_geometryCacheSvc;
+  /// Drift chamber data extension rebuilt from the parameters of the geometry snapshot
+  std::unique_ptr<dd4hep::rec::DCH_info> m_dch_data_from_cache;
+  /// retrieve the data extension and the cellID decoder from the geometry snapshot service
+  void RetrieveGeometryFromCacheSvc(const std::string& DCH_name);
+
   /// Decoder for the cellID
   dd4hep::DDSegmentation::BitFieldCoder* m_decoder;
 
@@ -125,16 +163,17 @@ private:
   SmartIF<IUniqueIDGenSvc> m_uidSvc;
   /// use thread local engine from C++ standard
   inline static thread_local std::mt19937_64 m_engine;
-  void                                       PrepareRandomEngine(const edm4hep::EventHeaderCollection& headers) const;
-
-  // Operator std::normal_distribution<T>::operator()(Generator& g) is a non-const member function and thus cannot be called for a constant object. So we defined the distribution as mutable.
-  // Gaussian random number generator used for the smearing of the z position, in cm!
-  mutable std::normal_distribution<double> m_gauss_z_cm;
-  // Gaussian random number generator used for the smearing of the xy position, in cm!
-  mutable std::normal_distribution<double> m_gauss_xy_cm;
+  void                                       PrepareRandomEngine(const EventSeeds& seeds) const;
 
   /// members with internal state (such as random engines) must be defined thread local
   inline static thread_local TRandom3 myRandom;
+  //------------------------------------------------------------------
+  //        instrumentation
+
+  /// per stage timing and throughput counters (one probe per batch, i.e. per event in operator())
+  enum Stages { Digitization, ClusterSampling };
+  AlgorithmInstrumentation m_instrumentation{this, {"wire projection, smearing and output fill", "cluster sampling"}};
+
   //------------------------------------------------------------------
   //        ancillary functions
 
@@ -210,6 +249,4 @@ private:
   void Create_outputROOTfile_for_debugHistograms();
 };
 
-DECLARE_COMPONENT(DCHdigi_v01);
-
 #endif
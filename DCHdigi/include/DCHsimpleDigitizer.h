@@ -18,6 +18,9 @@
 #include "DD4hep/Detector.h"  // for dd4hep::VolumeManager
 #include "DDSegmentation/BitFieldCoder.h"
 
+#include "AlgorithmInstrumentation.h"
+#include "IDigiGeometryCacheSvc.h"
+
 /** @class DCHsimpleDigitizer
  *
  *  Algorithm for creating digitized drift chamber hits (still based on edm4hep::TrackerHit3D) from edm4hep::SimTrackerHit.
@@ -59,6 +62,10 @@ private:
   dd4hep::DDSegmentation::BitFieldCoder* m_decoder;
   // Volume manager to get the physical cell sensitive volume
   dd4hep::VolumeManager m_volman;
+  // Geometry cache service, and its table of the wire transformations (shared, immutable)
+  Gaudi::Property<std::string> m_geometryCacheSvcName{this, "geometryCacheSvcName", "DigiGeometryCacheSvc", "The name of the DigiGeometryCacheSvc (or DigiGeometrySnapshotSvc) instance (empty := DetElement look-up for each hit)"};
+  SmartIF<IDigiGeometryCacheSvc> m_geometryCacheSvc;
+  const DigiGeometry::CellTable* m_wire_table = nullptr;
 
   // z position resolution in mm
   FloatProperty m_z_resolution{this, "zResolution", 1.0,
@@ -66,6 +73,10 @@ private:
   // xy resolution in mm
   FloatProperty m_xy_resolution{this, "xyResolution", 0.1, "Spatial resolution in the xy direction [mm]"};
 
+  // Per stage timing and throughput counters
+  enum Stages { Geometry, Smearing, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"geometry", "smearing", "output fill"}};
+
   // Random Number Service
   SmartIF<IRndmGenSvc> m_randSvc;
   // Gaussian random number generator used for the smearing of the z position
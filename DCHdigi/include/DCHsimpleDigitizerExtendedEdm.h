@@ -23,6 +23,9 @@
 #include "DD4hep/Detector.h"  // for dd4hep::VolumeManager
 #include "DDSegmentation/BitFieldCoder.h"
 
+#include "AlgorithmInstrumentation.h"
+#include "IDigiGeometryCacheSvc.h"
+
 /** @class DCHsimpleDigitizerExtendedEdm
  *
  *  Algorithm for creating digitized drift chamber hits (extension::DriftChamberDigi) from edm4hep::SimTrackerHit.
@@ -68,6 +71,10 @@ private:
   dd4hep::DDSegmentation::BitFieldCoder* m_decoder;
   // Volume manager to get the physical cell sensitive volume
   dd4hep::VolumeManager m_volman;
+  // Geometry cache service, and its table of the wire transformations (shared, immutable)
+  Gaudi::Property<std::string> m_geometryCacheSvcName{this, "geometryCacheSvcName", "DigiGeometryCacheSvc", "The name of the DigiGeometryCacheSvc (or DigiGeometrySnapshotSvc) instance (empty := DetElement look-up for each hit)"};
+  SmartIF<IDigiGeometryCacheSvc> m_geometryCacheSvc;
+  const DigiGeometry::CellTable* m_wire_table = nullptr;
 
   // z position resolution in mm
   FloatProperty m_z_resolution{this, "zResolution", 1.0,
@@ -82,6 +89,10 @@ private:
   mutable DataHandle<podio::UserDataCollection<double>> m_rightHitSimHitDeltaDistToWire{"rightHitSimHitDeltaDistToWire", Gaudi::DataHandle::Writer, this}; // mm
   mutable DataHandle<podio::UserDataCollection<double>> m_rightHitSimHitDeltaLocalZ{"rightHitSimHitDeltaLocalZ", Gaudi::DataHandle::Writer, this}; // mm
 
+  // Per stage timing and throughput counters
+  enum Stages { Geometry, Smearing, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"geometry", "smearing", "output fill"}};
+
   // Random Number Service
   SmartIF<IRndmGenSvc> m_randSvc;
   // Gaussian random number generator used for the smearing of the z position
@@ -0,0 +1,31 @@
+#include "DCHdigiBatchDriver.h"
+
+DECLARE_COMPONENT(DCHdigiBatchDriver)
+
+StatusCode DCHdigiBatchDriver::digitize(const DCHdigi_v01& digitizer, std::vector<podio::Frame>& frames) const {
+  const size_t nEvents = frames.size();
+  std::vector<const edm4hep::SimTrackerHitCollection*> input_sim_hits;
+  std::vector<DCHdigi_v01::EventSeeds>                 seeds;
+  input_sim_hits.reserve(nEvents);
+  seeds.reserve(nEvents);
+  for (const auto& frame : frames) {
+    input_sim_hits.push_back(&frame.get<edm4hep::SimTrackerHitCollection>(m_simHitsName));
+    seeds.push_back(digitizer.CalculateEventSeeds(frame.get<edm4hep::EventHeaderCollection>(m_headerName)));
+  }
+
+  std::vector<extension::SenseWireHitCollection>                  digi_hits(nEvents);
+  std::vector<extension::SenseWireHitSimTrackerHitLinkCollection> digi_sim_associations(nEvents);
+  std::vector<extension::SenseWireHitCollection*>                  output_digi_hits;
+  std::vector<extension::SenseWireHitSimTrackerHitLinkCollection*> output_digi_sim_associations;
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    output_digi_hits.push_back(&digi_hits[iEvent]);
+    output_digi_sim_associations.push_back(&digi_sim_associations[iEvent]);
+  }
+  digitizer.DigitizeBatch(input_sim_hits, seeds, output_digi_hits, output_digi_sim_associations);
+
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    frames[iEvent].put(std::move(digi_hits[iEvent]), m_digiHitsName);
+    frames[iEvent].put(std::move(digi_sim_associations[iEvent]), m_digiSimAssociationName);
+  }
+  return StatusCode::SUCCESS;
+}
@@ -6,6 +6,8 @@
 
 #include "extension/MutableSenseWireHit.h"
 
+DECLARE_COMPONENT(DCHdigi_v01)
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //////////////////////       DCHdigi_v01 constructor       ////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -18,7 +20,6 @@ DCHdigi_v01::DCHdigi_v01(const std::string& name, ISvcLocator* svcLoc)
                        },
                        {KeyValues("DCH_DigiCollection", {"DCH_DigiCollection"}),
                         KeyValues("DCH_DigiSimAssociationCollection", {"DCH_DigiSimAssociationCollection"})}) {
-  m_geoSvc = serviceLocator()->service(m_geoSvcName);
   m_uidSvc = serviceLocator()->service(m_uidSvcName);
 }
 
@@ -31,39 +32,46 @@ StatusCode DCHdigi_v01::initialize() {
 
   if( 0 > m_z_resolution.value() )
     ThrowException("Z resolution input value can not be negative!");
-  m_gauss_z_cm  = std::normal_distribution<double>(0., m_z_resolution.value() * MM_TO_CM);
 
   if( 0 > m_xy_resolution.value() )
     ThrowException("Radial (XY) resolution input value can not be negative!");
-  m_gauss_xy_cm = std::normal_distribution<double>(0., m_xy_resolution.value() * MM_TO_CM);
 
   //-----------------
   // Retrieve the subdetector
   std::string DCH_name(m_DCH_name.value());
-  if (0 == m_geoSvc->getDetector()->detectors().count(DCH_name)) {
-    ThrowException("Detector <<" + DCH_name + ">> does not exist.");
-  }
+  if (not m_geometryCacheSvcName.value().empty()) {
+    // the geometry comes from a geometry snapshot (or cache) service, the GeoSvc is not needed
+    this->RetrieveGeometryFromCacheSvc(DCH_name);
+  } else {
+    m_geoSvc = serviceLocator()->service(m_geoSvcName);
+    if (!m_geoSvc)
+      ThrowException("Unable to get " + m_geoSvcName.value());
+
+    if (0 == m_geoSvc->getDetector()->detectors().count(DCH_name)) {
+      ThrowException("Detector <<" + DCH_name + ">> does not exist.");
+    }
 
-  dd4hep::DetElement DCH_DE = m_geoSvc->getDetector()->detectors().at(DCH_name);
+    dd4hep::DetElement DCH_DE = m_geoSvc->getDetector()->detectors().at(DCH_name);
 
-  ///////////////////////////////////////////////////////////////////////////////////
-  ///////////////////////////  retrieve data extension     //////////////////////////
-  ///////////////////////////////////////////////////////////////////////////////////
-  this->dch_data = DCH_DE.extension<dd4hep::rec::DCH_info>();
-  if (not dch_data->IsValid())
-    ThrowException("No valid data extension was found for detector <<" + DCH_name + ">>.");
+    ///////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////  retrieve data extension     //////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////
+    this->dch_data = DCH_DE.extension<dd4hep::rec::DCH_info>();
+    if (not dch_data->IsValid())
+      ThrowException("No valid data extension was found for detector <<" + DCH_name + ">>.");
 
-  ///////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////
 
-  //-----------------
-  // Retrieve the readout associated with the detector element (subdetector)
-  dd4hep::SensitiveDetector dch_sd = m_geoSvc->getDetector()->sensitiveDetector(DCH_name);
-  if (not dch_sd.isValid())
-    ThrowException("No valid Sensitive Detector was found for detector <<" + DCH_name + ">>.");
+    //-----------------
+    // Retrieve the readout associated with the detector element (subdetector)
+    dd4hep::SensitiveDetector dch_sd = m_geoSvc->getDetector()->sensitiveDetector(DCH_name);
+    if (not dch_sd.isValid())
+      ThrowException("No valid Sensitive Detector was found for detector <<" + DCH_name + ">>.");
 
-  dd4hep::Readout dch_readout = dch_sd.readout();
-  // set the cellID decoder
-  m_decoder = dch_readout.idSpec().decoder();
+    dd4hep::Readout dch_readout = dch_sd.readout();
+    // set the cellID decoder
+    m_decoder = dch_readout.idSpec().decoder();
+  }
 
   ///////////////////////////////////////////////////////////////////////////////////
   //////////////////  initialize Walaa's code for Cluster counting  /////////////////
@@ -90,128 +98,192 @@ StatusCode DCHdigi_v01::initialize() {
     hSxy = new TH1D("hSxy", "Smearing perpendicular the wire, in cm", 100, 0, 5 * m_xy_resolution.value());
     hSxy->SetDirectory(0);
   }
+  m_instrumentation.initialize(this);
   return StatusCode::SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+//////////////////       RetrieveGeometryFromCacheSvc       ///////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+void DCHdigi_v01::RetrieveGeometryFromCacheSvc(const std::string& DCH_name) {
+  m_geometryCacheSvc = service(m_geometryCacheSvcName.value(), true);
+  if (!m_geometryCacheSvc)
+    ThrowException("Unable to get " + m_geometryCacheSvcName.value());
+
+  const DigiGeometry::DCHParameters* parameters = m_geometryCacheSvc->driftChamber(DCH_name);
+  if (!parameters)
+    ThrowException("No data extension parameters were found for detector <<" + DCH_name + ">> in " +
+                   m_geometryCacheSvcName.value());
+
+  // rebuild the data extension from its input parameters, as done by the detector constructor
+  m_dch_data_from_cache = std::make_unique<dd4hep::rec::DCH_info>();
+  m_dch_data_from_cache->Set_lhalf(parameters->Lhalf);
+  m_dch_data_from_cache->Set_rin(parameters->rin);
+  m_dch_data_from_cache->Set_rout(parameters->rout);
+  m_dch_data_from_cache->Set_guard_rin_at_z0(parameters->guard_inner_r_at_z0);
+  m_dch_data_from_cache->Set_guard_rout_at_zL2(parameters->guard_outer_r_at_zL2);
+  m_dch_data_from_cache->Set_ncell0(parameters->ncell0);
+  m_dch_data_from_cache->Set_ncell_increment(parameters->ncell_increment);
+  m_dch_data_from_cache->Set_ncell_per_sector(parameters->ncell_per_sector);
+  m_dch_data_from_cache->Set_nsuperlayers(parameters->nsuperlayers);
+  m_dch_data_from_cache->Set_nlayersPerSuperlayer(parameters->nlayersPerSuperlayer);
+  m_dch_data_from_cache->Set_twist_angle(parameters->twist_angle);
+  m_dch_data_from_cache->Set_first_width(parameters->first_width);
+  m_dch_data_from_cache->Set_first_sense_r(parameters->first_sense_r);
+  m_dch_data_from_cache->BuildLayerDatabase();
+  this->dch_data = m_dch_data_from_cache.get();
+  if (not dch_data->IsValid())
+    ThrowException("The data extension of detector <<" + DCH_name + ">> could not be rebuilt from its parameters.");
+
+  // set the cellID decoder
+  m_decoder = m_geometryCacheSvc->decoder(parameters->readoutName);
+  if (!m_decoder)
+    ThrowException("No cellID decoder was found for readout <<" + parameters->readoutName + ">>.");
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////       operator()       ////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////
 std::tuple<extension::SenseWireHitCollection, extension::SenseWireHitSimTrackerHitLinkCollection>
 DCHdigi_v01::operator()(const edm4hep::SimTrackerHitCollection& input_sim_hits,
                     const edm4hep::EventHeaderCollection&   headers) const {
-  // initialize seed for random engine
-  this->PrepareRandomEngine(headers);
-
-  debug() << "Input Sim Hit collection size: " << input_sim_hits.size() << endmsg;
-
   // Create the collections we are going to return
   extension::SenseWireHitCollection                  output_digi_hits;
   extension::SenseWireHitSimTrackerHitLinkCollection output_digi_sim_association;
 
-  //loop over hit collection
-  for (const auto& input_sim_hit : input_sim_hits) {
-    dd4hep::DDSegmentation::CellID cellid = input_sim_hit.getCellID();
-    int                            ilayer = this->CalculateLayerFromCellID(cellid);
-    int                            nphi   = this->CalculateNphiFromCellID(cellid);
-    auto hit_position                     = Convert_EDM4hepVector_to_TVector3(input_sim_hit.getPosition(), MM_TO_CM);
-
-    // -------------------------------------------------------------------------
-    //      calculate hit position projection into the wire
-    TVector3 hit_to_wire_vector         = this->dch_data->Calculate_hitpos_to_wire_vector(ilayer, nphi, hit_position);
-    TVector3 hit_projection_on_the_wire = hit_position + hit_to_wire_vector;
-    if (m_create_debug_histos.value()) {
-      double distance_hit_wire = hit_to_wire_vector.Mag();
-      hDpw->Fill(distance_hit_wire);
-    }
-    TVector3 wire_direction_ez = this->dch_data->Calculate_wire_vector_ez(ilayer, nphi);
-
-    // -------------------------------------------------------------------------
-    //       smear the position
+  // one event is a batch of one
+  this->DigitizeBatch({&input_sim_hits}, {this->CalculateEventSeeds(headers)}, {&output_digi_hits},
+                      {&output_digi_sim_association});
 
-    //       smear position along the wire
-    double smearing_z = m_gauss_z_cm(m_engine);
-    if (m_create_debug_histos.value())
-      hSz->Fill(smearing_z);
-
-    hit_projection_on_the_wire += smearing_z * (wire_direction_ez.Unit());
-    if (m_create_debug_histos.value()) {
-      // the distance from the hit projection and the wire should be zero
-      TVector3 dummy_vector = this->dch_data->Calculate_hitpos_to_wire_vector(ilayer, nphi, hit_projection_on_the_wire);
-      hDww->Fill(dummy_vector.Mag());
-    }
+  /////////////////////////////////////////////////////////////////
+  return std::make_tuple<extension::SenseWireHitCollection,
+                         extension::SenseWireHitSimTrackerHitLinkCollection>(
+      std::move(output_digi_hits), std::move(output_digi_sim_association));
+}
 
-    //       smear position perpendicular to the wire
-    double smearing_xy = m_gauss_xy_cm(m_engine);
-    if (m_create_debug_histos.value())
-      hSxy->Fill(smearing_xy);
-    float distanceToWire_real = hit_to_wire_vector.Mag();
-
-    // protect against negative values
-    float distanceToWire_smeared = std::max(0.0, distanceToWire_real + smearing_xy);
-
-    std::int32_t type      = 0;
-    std::int32_t quality   = 0;
-    float        eDepError = 0;
-    // length units back to mm
-    auto  positionSW     = Convert_TVector3_to_EDM4hepVector(hit_projection_on_the_wire, 1. / MM_TO_CM);
-    //auto  directionSW    = Convert_TVector3_to_EDM4hepVector(wire_direction_ez, 1. / MM_TO_CM);
-    float distanceToWire = distanceToWire_smeared / MM_TO_CM;
-
-    // The direction of the sense wires can be calculated as:
-    //   RotationZ(WireAzimuthalAngle) * RotationX(stereoangle)
-    // One point of the wire is for example the following:
-    //   RotationZ(WireAzimuthalAngle) * Position(cell_rave_z0, 0 , 0)
-    // variables aredefined below
-    auto WireAzimuthalAngle = this->dch_data->Get_cell_phi_angle(ilayer, nphi);
-    float WireStereoAngle = 0;
-    {
-      auto l = this->dch_data->database.at(ilayer);
-      // radial middle point of the cell at Z=0
-      auto cell_rave_z0 = 0.5*(l.radius_fdw_z0 + l.radius_fuw_z0);
-      // when building the twisted tube, the twist angle is defined as:
-      //     cell_twistangle    = l.StereoSign() * DCH_i->twist_angle
-      // which forces the stereoangle of the wire to have the oposite sign
-      WireStereoAngle = (-1.)*l.StereoSign()*dch_data->stereoangle_z0(cell_rave_z0);      
-    }
-    
-    extension::MutableSenseWireHit oDCHdigihit;
-    oDCHdigihit.setCellID(input_sim_hit.getCellID());
-    oDCHdigihit.setType(type);
-    oDCHdigihit.setQuality(quality);
-    oDCHdigihit.setTime(input_sim_hit.getTime());
-    oDCHdigihit.setEDep(input_sim_hit.getEDep());
-    oDCHdigihit.setEDepError(eDepError);
-    oDCHdigihit.setPosition(positionSW);
-    oDCHdigihit.setPositionAlongWireError(smearing_z);
-    oDCHdigihit.setWireAzimuthalAngle(WireAzimuthalAngle);
-    oDCHdigihit.setWireStereoAngle(WireStereoAngle);
-    oDCHdigihit.setDistanceToWire(distanceToWire);
-    oDCHdigihit.setDistanceToWireError(smearing_xy);
-    // For the sake of speed, let the dNdx calculation be optional
-    if( m_calculate_dndx.value() )
-    {
-      auto [nCluster, nElectrons_v] = CalculateClusters(input_sim_hit);
-      // to return the total number of electrons within the step, do the following:
-      //   int nElectronsTotal = std::accumulate( nElectrons_v.begin(), nElectrons_v.end(), 0);
-      //   oDCHdigihit.setNElectronsTotal(nElectronsTotal);
-      // to copy the vector of each cluster size to the EDM4hep data extension, do the following:
-      for( auto ne : nElectrons_v )
-        oDCHdigihit.addToNElectrons(ne);
-    }
+///////////////////////////////////////////////////////////////////////////////////////
+///////////////////////       DigitizeBatch       /////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////
+void DCHdigi_v01::DigitizeBatch(
+    const std::vector<const edm4hep::SimTrackerHitCollection*>&             input_sim_hits,
+    const std::vector<EventSeeds>&                                           seeds,
+    const std::vector<extension::SenseWireHitCollection*>&                  output_digi_hits,
+    const std::vector<extension::SenseWireHitSimTrackerHitLinkCollection*>& output_digi_sim_associations) const {
+  const size_t nEvents = input_sim_hits.size();
+  if (seeds.size() != nEvents || output_digi_hits.size() != nEvents || output_digi_sim_associations.size() != nEvents)
+    ThrowException("DigitizeBatch needs one seed and one output collection of each type per event");
+
+  auto probe = m_instrumentation.event();
+  size_t nHits = 0;
+  for (const auto* event_sim_hits : input_sim_hits) {
+    debug() << "Input Sim Hit collection size: " << event_sim_hits->size() << endmsg;
+    nHits += event_sim_hits->size();
+  }
+  probe.hitsIn(nHits);
+
+  // the hits go straight from the input collections to the output collections of their event: the kernels call the
+  // data extension for each hit, a batch only saves the framework calls between the events
+  probe.enter(Digitization);
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    // random numbers, event by event from the seeds of each event. The Gaussian distributions of the smearing, in cm,
+    // are local to the event: they cache a normal deviate, which must neither leak to the next event nor be shared
+    // between threads
+    this->PrepareRandomEngine(seeds[iEvent]);
+    std::normal_distribution<double> gauss_z_cm(0., m_z_resolution.value() * MM_TO_CM);
+    std::normal_distribution<double> gauss_xy_cm(0., m_xy_resolution.value() * MM_TO_CM);
+    for (const auto& input_sim_hit : *input_sim_hits[iEvent]) {
+      dd4hep::DDSegmentation::CellID cellid = input_sim_hit.getCellID();
+      const int                      ilayer = this->CalculateLayerFromCellID(cellid);
+      const int                      nphi   = this->CalculateNphiFromCellID(cellid);
+      TVector3 hit_position = Convert_EDM4hepVector_to_TVector3(input_sim_hit.getPosition(), MM_TO_CM);
+
+      //      calculate hit position projection into the wire
+      TVector3 hit_to_wire_vector         = this->dch_data->Calculate_hitpos_to_wire_vector(ilayer, nphi, hit_position);
+      TVector3 hit_projection_on_the_wire = hit_position + hit_to_wire_vector;
+      if (m_create_debug_histos.value()) {
+        double distance_hit_wire = hit_to_wire_vector.Mag();
+        hDpw->Fill(distance_hit_wire);
+      }
+      TVector3 wire_direction_ez = this->dch_data->Calculate_wire_vector_ez(ilayer, nphi);
+
+      //       smear position along the wire
+      double smearing_z = gauss_z_cm(m_engine);
+      if (m_create_debug_histos.value())
+        hSz->Fill(smearing_z);
+
+      hit_projection_on_the_wire += smearing_z * (wire_direction_ez.Unit());
+      if (m_create_debug_histos.value()) {
+        // the distance from the hit projection and the wire should be zero
+        TVector3 dummy_vector = this->dch_data->Calculate_hitpos_to_wire_vector(ilayer, nphi, hit_projection_on_the_wire);
+        hDww->Fill(dummy_vector.Mag());
+      }
 
-    output_digi_hits.push_back(oDCHdigihit);
+      //       smear position perpendicular to the wire
+      double smearing_xy = gauss_xy_cm(m_engine);
+      if (m_create_debug_histos.value())
+        hSxy->Fill(smearing_xy);
+      float distanceToWire_real = hit_to_wire_vector.Mag();
+
+      // protect against negative values
+      float distanceToWire_smeared = std::max(0.0, distanceToWire_real + smearing_xy);
+
+      std::int32_t type      = 0;
+      std::int32_t quality   = 0;
+      float        eDepError = 0;
+      // length units back to mm
+      auto  positionSW     = Convert_TVector3_to_EDM4hepVector(hit_projection_on_the_wire, 1. / MM_TO_CM);
+      float distanceToWire = distanceToWire_smeared / MM_TO_CM;
+
+      // The direction of the sense wires can be calculated as:
+      //   RotationZ(WireAzimuthalAngle) * RotationX(stereoangle)
+      // One point of the wire is for example the following:
+      //   RotationZ(WireAzimuthalAngle) * Position(cell_rave_z0, 0 , 0)
+      // variables aredefined below
+      auto  WireAzimuthalAngle = this->dch_data->Get_cell_phi_angle(ilayer, nphi);
+      float WireStereoAngle    = 0;
+      {
+        auto l = this->dch_data->database.at(ilayer);
+        // radial middle point of the cell at Z=0
+        auto cell_rave_z0 = 0.5*(l.radius_fdw_z0 + l.radius_fuw_z0);
+        // when building the twisted tube, the twist angle is defined as:
+        //     cell_twistangle    = l.StereoSign() * DCH_i->twist_angle
+        // which forces the stereoangle of the wire to have the oposite sign
+        WireStereoAngle = (-1.)*l.StereoSign()*dch_data->stereoangle_z0(cell_rave_z0);
+      }
 
-    extension::MutableSenseWireHitSimTrackerHitLink oDCHsimdigi_association;
-    oDCHsimdigi_association.setFrom(oDCHdigihit);
-    oDCHsimdigi_association.setTo(input_sim_hit);
-    output_digi_sim_association.push_back(oDCHsimdigi_association);
+      extension::MutableSenseWireHit oDCHdigihit;
+      oDCHdigihit.setCellID(input_sim_hit.getCellID());
+      oDCHdigihit.setType(type);
+      oDCHdigihit.setQuality(quality);
+      oDCHdigihit.setTime(input_sim_hit.getTime());
+      oDCHdigihit.setEDep(input_sim_hit.getEDep());
+      oDCHdigihit.setEDepError(eDepError);
+      oDCHdigihit.setPosition(positionSW);
+      oDCHdigihit.setPositionAlongWireError(smearing_z);
+      oDCHdigihit.setWireAzimuthalAngle(WireAzimuthalAngle);
+      oDCHdigihit.setWireStereoAngle(WireStereoAngle);
+      oDCHdigihit.setDistanceToWire(distanceToWire);
+      oDCHdigihit.setDistanceToWireError(smearing_xy);
+      // For the sake of speed, let the dNdx calculation be optional
+      if (m_calculate_dndx.value()) {
+        probe.enter(ClusterSampling);
+        auto [nCluster, nElectrons_v] = CalculateClusters(input_sim_hit);
+        // to copy the vector of each cluster size to the EDM4hep data extension
+        for (auto ne : nElectrons_v)
+          oDCHdigihit.addToNElectrons(ne);
+        probe.enter(Digitization);
+      }
 
-  }  // end loop over hit collection
+      output_digi_hits[iEvent]->push_back(oDCHdigihit);
 
-  /////////////////////////////////////////////////////////////////
-  return std::make_tuple<extension::SenseWireHitCollection,
-                         extension::SenseWireHitSimTrackerHitLinkCollection>(
-      std::move(output_digi_hits), std::move(output_digi_sim_association));
+      extension::MutableSenseWireHitSimTrackerHitLink oDCHsimdigi_association;
+      oDCHsimdigi_association.setFrom(oDCHdigihit);
+      oDCHsimdigi_association.setTo(input_sim_hit);
+      output_digi_sim_associations[iEvent]->push_back(oDCHsimdigi_association);
+    }
+    probe.hitsOut(output_digi_hits[iEvent]->size());
+  }
+  probe.leave();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -251,6 +323,7 @@ StatusCode DCHdigi_v01::finalize() {
   {
      this->Create_outputROOTfile_for_debugHistograms();
   }
+  m_instrumentation.summary(info());
 
   return StatusCode::SUCCESS;
 }
@@ -284,11 +357,13 @@ void DCHdigi_v01::PrintConfiguration(std::ostream& io) {
   return;
 }
 
-void DCHdigi_v01::PrepareRandomEngine(const edm4hep::EventHeaderCollection& headers) const {
-  auto engine_seed = m_uidSvc->getUniqueID(headers, this->name());
-  m_engine.seed(engine_seed);
-  auto random_seed = m_uidSvc->getUniqueID(headers, this->name()+"_1");
-  myRandom.SetSeed(random_seed);
+DCHdigi_v01::EventSeeds DCHdigi_v01::CalculateEventSeeds(const edm4hep::EventHeaderCollection& headers) const {
+  return {m_uidSvc->getUniqueID(headers, this->name()), m_uidSvc->getUniqueID(headers, this->name() + "_1")};
+}
+
+void DCHdigi_v01::PrepareRandomEngine(const EventSeeds& seeds) const {
+  m_engine.seed(seeds.engine);
+  myRandom.SetSeed(seeds.random);
   // advance internal state to minimize possibility of creating correlations
   m_engine.discard(10);
   for (int i = 0; i < 10; ++i)
@@ -33,16 +33,38 @@ StatusCode DCHsimpleDigitizer::initialize() {
     return StatusCode::FAILURE;
   }
 
-  // check if readout exists
-  if (m_geoSvc->getDetector()->readouts().find(m_readoutName) == m_geoSvc->getDetector()->readouts().end()) {
-    error() << "Readout <<" << m_readoutName << ">> does not exist." << endmsg;
-    return StatusCode::FAILURE;
+  // retrieve the geometry: from the geometry cache, which is built on the GeoSvc detector or read from a geometry
+  // snapshot, or directly from the GeoSvc detector
+  dd4hep::Detector* detector = nullptr;
+  if (!m_geometryCacheSvcName.empty()) {
+    m_geometryCacheSvc = service(m_geometryCacheSvcName, true);
+    if (!m_geometryCacheSvc) {
+      error() << "Couldn't get DigiGeometryCacheSvc!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    detector  = m_geometryCacheSvc->detector();
+    m_decoder = m_geometryCacheSvc->decoder(m_readoutName);
+    if (!m_decoder)
+      return StatusCode::FAILURE;
+    // the wire transformations
+    m_wire_table = m_geometryCacheSvc->wireTransforms(m_readoutName);
+    if (!m_wire_table)
+      return StatusCode::FAILURE;
+  } else {
+    detector = m_geoSvc->getDetector();
+    // check if readout exists
+    if (detector->readouts().find(m_readoutName) == detector->readouts().end()) {
+      error() << "Readout <<" << m_readoutName << ">> does not exist." << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // set the cellID decoder
+    m_decoder = detector->readout(m_readoutName).idSpec().decoder();
   }
-  // set the cellID decoder
-  m_decoder = m_geoSvc->getDetector()->readout(m_readoutName).idSpec().decoder();
-  // retrieve the volume manager
-  m_volman = m_geoSvc->getDetector()->volumeManager();
+  // retrieve the volume manager, not available with a geometry snapshot
+  if (detector)
+    m_volman = detector->volumeManager();
 
+  m_instrumentation.initialize(this);
   return StatusCode::SUCCESS;
 }
 
@@ -50,29 +72,55 @@ StatusCode DCHsimpleDigitizer::execute(const EventContext&) const {
   // Get the input collection with Geant4 hits
   const edm4hep::SimTrackerHitCollection* input_sim_hits = m_input_sim_hits.get();
   debug() << "Input Sim Hit collection size: " << input_sim_hits->size() << endmsg;
+  auto probe = m_instrumentation.event();
+  probe.hitsIn(input_sim_hits->size());
 
   // Digitize the sim hits
+  uint64_t nMissingWires = 0;
   edm4hep::TrackerHit3DCollection* output_digi_hits = m_output_digi_hits.createAndPut();
   for (const auto& input_sim_hit : *input_sim_hits) {
+    probe.enter(OutputFill);
     auto output_digi_hit = output_digi_hits->create();
     // smear the hit position: need to go in the wire local frame to smear in the direction aligned/perpendicular with the wire for z/distanceToWire, taking e.g. stereo angle into account
-    // retrieve the cell detElement
-    dd4hep::DDSegmentation::CellID cellID         = input_sim_hit.getCellID();
-    auto                           cellDetElement = m_volman.lookupDetElement(cellID);
-    // retrieve the wire (in DD4hep 1.23 there is no easy way to access the volume daughters we have to pass by detElements, in later versions volumes can be used)
-    const std::string& wireDetElementName =
-        Form("superLayer_%ld_layer_%ld_phi_%ld_wire", m_decoder->get(cellID, "superLayer"),
-             m_decoder->get(cellID, "layer"), m_decoder->get(cellID, "phi"));
-    dd4hep::DetElement wireDetElement = cellDetElement.child(wireDetElementName);
-    // get the transformation matrix used to place the wire
-    const auto& wireTransformMatrix = wireDetElement.nominal().worldTransformation();
+    dd4hep::DDSegmentation::CellID cellID = input_sim_hit.getCellID();
+    probe.enter(Geometry);
+    // get the transformation used to place the wire, from the geometry cache if possible
+    const uint32_t    wire                = m_wire_table ? m_wire_table->find(cellID) : DigiGeometry::CellTable::npos;
+    const TGeoMatrix* wireTransformMatrix = nullptr;
+    if (wire == DigiGeometry::CellTable::npos) {
+      if (!m_volman.isValid()) {
+        error() << "Wire of cellID " << m_decoder->valueString(cellID) << " is not in the geometry snapshot!" << endmsg;
+        return StatusCode::FAILURE;
+      }
+      // retrieve the cell detElement
+      auto cellDetElement = m_volman.lookupDetElement(cellID);
+      // retrieve the wire (in DD4hep 1.23 there is no easy way to access the volume daughters we have to pass by detElements, in later versions volumes can be used)
+      const std::string& wireDetElementName =
+          Form("superLayer_%ld_layer_%ld_phi_%ld_wire", m_decoder->get(cellID, "superLayer"),
+               m_decoder->get(cellID, "layer"), m_decoder->get(cellID, "phi"));
+      dd4hep::DetElement wireDetElement = cellDetElement.child(wireDetElementName);
+      wireTransformMatrix = &wireDetElement.nominal().worldTransformation();
+      ++nMissingWires;
+    }
+    auto wireMasterToLocal = [&](const double* master, double* local) {
+      if (wireTransformMatrix)
+        wireTransformMatrix->MasterToLocal(master, local);
+      else
+        m_wire_table->toLocal(wire, master, local);
+    };
+    auto wireLocalToMaster = [&](const double* local, double* master) {
+      if (wireTransformMatrix)
+        wireTransformMatrix->LocalToMaster(local, master);
+      else
+        m_wire_table->toGlobal(wire, local, master);
+    };
     // Retrieve global position in mm and apply unit transformation (translation matrix is tored in cm)
     double simHitGlobalPosition[3] = {input_sim_hit.getPosition().x * dd4hep::mm,
                                       input_sim_hit.getPosition().y * dd4hep::mm,
                                       input_sim_hit.getPosition().z * dd4hep::mm};
     double simHitLocalPosition[3]  = {0, 0, 0};
     // get the simHit coordinate in cm in the wire reference frame to be able to apply smearing of radius perpendicular to the wire
-    wireTransformMatrix.MasterToLocal(simHitGlobalPosition, simHitLocalPosition);
+    wireMasterToLocal(simHitGlobalPosition, simHitLocalPosition);
     debug() << "Cell ID string: " << m_decoder->valueString(cellID) << endmsg;
     ;
     debug() << "Global simHit x " << simHitGlobalPosition[0] << " --> Local simHit x " << simHitLocalPosition[0]
@@ -84,6 +132,7 @@ StatusCode DCHsimpleDigitizer::execute(const EventContext&) const {
     // build a vector to easily apply smearing of distance to the wire
     dd4hep::rec::Vector3D simHitLocalPositionVector(simHitLocalPosition[0], simHitLocalPosition[1],
                                                     simHitLocalPosition[2]);
+    probe.enter(Smearing);
     // get the smeared distance to the wire (cylindrical coordinate as the smearing should be perpendicular to the wire)
     double smearedDistanceToWire = simHitLocalPositionVector.rho() + m_gauss_xy.shoot() * dd4hep::mm;
     // smear the z position (in local coordinate the z axis is aligned with the wire i.e. it take the stereo angle into account);
@@ -98,19 +147,28 @@ StatusCode DCHsimpleDigitizer::execute(const EventContext&) const {
     debug() << "Local simHit phi: " << simHitLocalPositionVector.phi()
             << " Local digiHit distance to the wire: " << digiHitLocalPositionVector.Phi() << endmsg;
     // go back to the global frame
+    probe.enter(Geometry);
     double digiHitLocalPosition[3]  = {digiHitLocalPositionVector.x(), digiHitLocalPositionVector.y(),
                                        digiHitLocalPositionVector.z()};
     double digiHitGlobalPosition[3] = {0, 0, 0};
-    wireTransformMatrix.LocalToMaster(digiHitLocalPosition, digiHitGlobalPosition);
+    wireLocalToMaster(digiHitLocalPosition, digiHitGlobalPosition);
     // go back to mm
     edm4hep::Vector3d digiHitGlobalPositionVector(digiHitGlobalPosition[0] / dd4hep::mm,
                                                   digiHitGlobalPosition[1] / dd4hep::mm,
                                                   digiHitGlobalPosition[2] / dd4hep::mm);
+    probe.enter(OutputFill);
     output_digi_hit.setPosition(digiHitGlobalPositionVector);
     output_digi_hit.setCellID(cellID);
   }
+  probe.leave();
+  probe.hitsOut(output_digi_hits->size());
+  if (m_wire_table)
+    m_wire_table->countLookups(input_sim_hits->size() - nMissingWires, nMissingWires);
   debug() << "Output Digi Hit collection size: " << output_digi_hits->size() << endmsg;
   return StatusCode::SUCCESS;
 }
 
-StatusCode DCHsimpleDigitizer::finalize() { return StatusCode::SUCCESS; }
+StatusCode DCHsimpleDigitizer::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
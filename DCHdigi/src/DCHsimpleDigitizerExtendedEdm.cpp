@@ -34,16 +34,38 @@ StatusCode DCHsimpleDigitizerExtendedEdm::initialize() {
     return StatusCode::FAILURE;
   }
 
-  // check if readout exists
-  if (m_geoSvc->getDetector()->readouts().find(m_readoutName) == m_geoSvc->getDetector()->readouts().end()) {
-    error() << "Readout <<" << m_readoutName << ">> does not exist." << endmsg;
-    return StatusCode::FAILURE;
+  // retrieve the geometry: from the geometry cache, which is built on the GeoSvc detector or read from a geometry
+  // snapshot, or directly from the GeoSvc detector
+  dd4hep::Detector* detector = nullptr;
+  if (!m_geometryCacheSvcName.empty()) {
+    m_geometryCacheSvc = service(m_geometryCacheSvcName, true);
+    if (!m_geometryCacheSvc) {
+      error() << "Couldn't get DigiGeometryCacheSvc!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    detector  = m_geometryCacheSvc->detector();
+    m_decoder = m_geometryCacheSvc->decoder(m_readoutName);
+    if (!m_decoder)
+      return StatusCode::FAILURE;
+    // the wire transformations
+    m_wire_table = m_geometryCacheSvc->wireTransforms(m_readoutName);
+    if (!m_wire_table)
+      return StatusCode::FAILURE;
+  } else {
+    detector = m_geoSvc->getDetector();
+    // check if readout exists
+    if (detector->readouts().find(m_readoutName) == detector->readouts().end()) {
+      error() << "Readout <<" << m_readoutName << ">> does not exist." << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // set the cellID decoder
+    m_decoder = detector->readout(m_readoutName).idSpec().decoder();
   }
-  // set the cellID decoder
-  m_decoder = m_geoSvc->getDetector()->readout(m_readoutName).idSpec().decoder();
-  // retrieve the volume manager
-  m_volman = m_geoSvc->getDetector()->volumeManager();
+  // retrieve the volume manager, not available with a geometry snapshot
+  if (detector)
+    m_volman = detector->volumeManager();
 
+  m_instrumentation.initialize(this);
   return StatusCode::SUCCESS;
 }
 
@@ -51,6 +73,8 @@ StatusCode DCHsimpleDigitizerExtendedEdm::execute(const EventContext&) const {
   // Get the input collection with Geant4 hits
   const edm4hep::SimTrackerHitCollection* input_sim_hits = m_input_sim_hits.get();
   debug() << "Input Sim Hit collection size: " << input_sim_hits->size() << endmsg;
+  auto probe = m_instrumentation.event();
+  probe.hitsIn(input_sim_hits->size());
 
   // Prepare a collection for digitized hits in local coordinate (only filled in debug mode)
   extension::DriftChamberDigiCollection* output_digi_hits = m_output_digi_hits.createAndPut();
@@ -66,26 +90,50 @@ StatusCode DCHsimpleDigitizerExtendedEdm::execute(const EventContext&) const {
   auto rightHitSimHitDeltaLocalZ = m_rightHitSimHitDeltaLocalZ.createAndPut();
 
   // Digitize the sim hits
+  uint64_t nMissingWires = 0;
   for (const auto& input_sim_hit : *input_sim_hits) {
+    probe.enter(OutputFill);
     auto output_digi_hit = output_digi_hits->create();
     // smear the hit position: need to go in the wire local frame to smear in the direction aligned/perpendicular with the wire for z/distanceToWire, taking e.g. stereo angle into account
-    // retrieve the cell detElement
-    dd4hep::DDSegmentation::CellID cellID         = input_sim_hit.getCellID();
-    auto                           cellDetElement = m_volman.lookupDetElement(cellID);
-    // retrieve the wire (in DD4hep 1.23 there is no easy way to access the volume daughters we have to pass by detElements, in later versions volumes can be used)
-    const std::string& wireDetElementName =
-        Form("superLayer_%ld_layer_%ld_phi_%ld_wire", m_decoder->get(cellID, "superLayer"),
-             m_decoder->get(cellID, "layer"), m_decoder->get(cellID, "phi"));
-    dd4hep::DetElement wireDetElement = cellDetElement.child(wireDetElementName);
-    // get the transformation matrix used to place the wire (DD4hep works with cm)
-    const auto& wireTransformMatrix = wireDetElement.nominal().worldTransformation();
+    dd4hep::DDSegmentation::CellID cellID = input_sim_hit.getCellID();
+    probe.enter(Geometry);
+    // get the transformation used to place the wire, from the geometry cache if possible (DD4hep works with cm)
+    const uint32_t    wire                = m_wire_table ? m_wire_table->find(cellID) : DigiGeometry::CellTable::npos;
+    const TGeoMatrix* wireTransformMatrix = nullptr;
+    if (wire == DigiGeometry::CellTable::npos) {
+      if (!m_volman.isValid()) {
+        error() << "Wire of cellID " << m_decoder->valueString(cellID) << " is not in the geometry snapshot!" << endmsg;
+        return StatusCode::FAILURE;
+      }
+      // retrieve the cell detElement
+      auto cellDetElement = m_volman.lookupDetElement(cellID);
+      // retrieve the wire (in DD4hep 1.23 there is no easy way to access the volume daughters we have to pass by detElements, in later versions volumes can be used)
+      const std::string& wireDetElementName =
+          Form("superLayer_%ld_layer_%ld_phi_%ld_wire", m_decoder->get(cellID, "superLayer"),
+               m_decoder->get(cellID, "layer"), m_decoder->get(cellID, "phi"));
+      dd4hep::DetElement wireDetElement = cellDetElement.child(wireDetElementName);
+      wireTransformMatrix = &wireDetElement.nominal().worldTransformation();
+      ++nMissingWires;
+    }
+    auto wireMasterToLocal = [&](const double* master, double* local) {
+      if (wireTransformMatrix)
+        wireTransformMatrix->MasterToLocal(master, local);
+      else
+        m_wire_table->toLocal(wire, master, local);
+    };
+    auto wireLocalToMaster = [&](const double* local, double* master) {
+      if (wireTransformMatrix)
+        wireTransformMatrix->LocalToMaster(local, master);
+      else
+        m_wire_table->toGlobal(wire, local, master);
+    };
     // Retrieve global position in mm and transform it to cm because the DD4hep translation matrix is stored in cm
     double simHitGlobalPosition[3] = {input_sim_hit.getPosition().x * dd4hep::mm,
                                       input_sim_hit.getPosition().y * dd4hep::mm,
                                       input_sim_hit.getPosition().z * dd4hep::mm};
     double simHitLocalPosition[3]  = {0, 0, 0};
     // get the simHit coordinate in cm in the wire reference frame to be able to apply smearing of radius perpendicular to the wire
-    wireTransformMatrix.MasterToLocal(simHitGlobalPosition, simHitLocalPosition);
+    wireMasterToLocal(simHitGlobalPosition, simHitLocalPosition);
     debug() << "Cell ID string: " << m_decoder->valueString(cellID) << endmsg;
     debug() << "Global simHit x " << simHitGlobalPosition[0] << " --> Local simHit x " << simHitLocalPosition[0]
             << " in cm" << endmsg;
@@ -96,6 +144,7 @@ StatusCode DCHsimpleDigitizerExtendedEdm::execute(const EventContext&) const {
     // build a vector to easily apply smearing of distance to the wire, going back to mm
     dd4hep::rec::Vector3D simHitLocalPositionVector(simHitLocalPosition[0] / dd4hep::mm, simHitLocalPosition[1] / dd4hep::mm,
                                                     simHitLocalPosition[2] / dd4hep::mm);
+    probe.enter(Smearing);
     // get the smeared distance to the wire (cylindrical coordinate as the smearing should be perpendicular to the wire)
     debug() << "Original distance to wire: " << simHitLocalPositionVector.rho() << " mm" << endmsg;
     double smearedDistanceToWire = simHitLocalPositionVector.rho() + m_gauss_xy.shoot();
@@ -111,10 +160,11 @@ StatusCode DCHsimpleDigitizerExtendedEdm::execute(const EventContext&) const {
     double leftHitLocalPosition[3]  = {-1 * smearedDistanceToWire  * dd4hep::mm, 0, smearedZ * dd4hep::mm};
     double rightHitLocalPosition[3]  = {smearedDistanceToWire * dd4hep::mm, 0, smearedZ * dd4hep::mm};
     // transform the left and right hit local position in global coordinate (still cm here)
+    probe.enter(Geometry);
     double leftHitGlobalPosition[3]  = {0, 0, 0};
     double rightHitGlobalPosition[3]  = {0, 0, 0};
-    wireTransformMatrix.LocalToMaster(leftHitLocalPosition, leftHitGlobalPosition);
-    wireTransformMatrix.LocalToMaster(rightHitLocalPosition, rightHitGlobalPosition);
+    wireLocalToMaster(leftHitLocalPosition, leftHitGlobalPosition);
+    wireLocalToMaster(rightHitLocalPosition, rightHitGlobalPosition);
     //std::cout << (leftHitGlobalPosition[2]==rightHitGlobalPosition[2]) <<  std::endl; // FIXME why are left and right global z coordinates the same?
     debug() << "Global leftHit x " << leftHitGlobalPosition[0] << " --> Local leftHit x " << leftHitLocalPosition[0]
             << " in cm" << endmsg;
@@ -129,6 +179,7 @@ StatusCode DCHsimpleDigitizerExtendedEdm::execute(const EventContext&) const {
     debug() << "Global rightHit z " << rightHitGlobalPosition[2] << " --> Local rightHit z " << rightHitLocalPosition[2]
             << " in cm" << endmsg;
     // fill the output DriftChamberDigi (making sure we are back in mm)
+    probe.enter(OutputFill);
     output_digi_hit.setCellID(cellID);
     edm4hep::Vector3d leftHitGlobalPositionVector = edm4hep::Vector3d(leftHitGlobalPosition[0] / dd4hep::mm, leftHitGlobalPosition[1] / dd4hep::mm, leftHitGlobalPosition[2] / dd4hep::mm);
     edm4hep::Vector3d rightHitGlobalPositionVector = edm4hep::Vector3d(rightHitGlobalPosition[0] / dd4hep::mm, rightHitGlobalPosition[1] / dd4hep::mm, rightHitGlobalPosition[2] / dd4hep::mm);
@@ -159,8 +210,15 @@ StatusCode DCHsimpleDigitizerExtendedEdm::execute(const EventContext&) const {
       rightHitSimHitDeltaLocalZ->push_back(rightHitLocalPositionVector.z() - simHitLocalPositionVector.z());
     }
   }
+  probe.leave();
+  probe.hitsOut(output_digi_hits->size());
+  if (m_wire_table)
+    m_wire_table->countLookups(input_sim_hits->size() - nMissingWires, nMissingWires);
   debug() << "Output Digi Hit collection size: " << output_digi_hits->size() << endmsg;
   return StatusCode::SUCCESS;
 }
 
-StatusCode DCHsimpleDigitizerExtendedEdm::finalize() { return StatusCode::SUCCESS; }
+StatusCode DCHsimpleDigitizerExtendedEdm::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
@@ -0,0 +1,45 @@
+# file: check_DCHdigi_batch_output.py
+# to run: python3 check_DCHdigi_batch_output.py
+# goal: check that the digitizer gives the same hits in batch mode (runDCHdigiBatch.py, 4 events per call) as event by
+# event (runDCHdigi.py), and that the frames of the other categories of the input file (runs, metadata) are copied,
+# and print out a number:
+#  0 : same hits
+#  1 : different number of events
+#  2 : different hits
+#  3 : missing frames of the input file
+
+import sys
+from podio.root_io import Reader
+
+def hit_values(hit):
+    position = hit.getPosition()
+    return (hit.getCellID(), hit.getTime(), hit.getEDep(), position.x, position.y, position.z,
+            hit.getPositionAlongWireError(), hit.getWireAzimuthalAngle(), hit.getWireStereoAngle(),
+            hit.getDistanceToWire(), hit.getDistanceToWireError(), tuple(hit.getNElectrons()))
+
+def main():
+    input_reader = Reader("dch_proton_10GeV.root")
+    batch_reader = Reader("dch_proton_10GeV_digi_batch.root")
+    for category in input_reader.categories:
+        if category != "events" and len(batch_reader.get(category)) != len(input_reader.get(category)):
+            print(f"The {category} frames of the input file are not all in the batch output")
+            return 3
+
+    single_events = Reader("dch_proton_10GeV_digi.root").get("events")
+    batch_events = batch_reader.get("events")
+    if len(single_events) != len(batch_events):
+        print(f"{len(single_events)} events digitized one by one, {len(batch_events)} in batches")
+        return 1
+
+    for i, (single_event, batch_event) in enumerate(zip(single_events, batch_events)):
+        single_hits = [hit_values(hit) for hit in single_event.get("DCH_DigiCollection")]
+        batch_hits = [hit_values(hit) for hit in batch_event.get("DCH_DigiCollection")]
+        if single_hits != batch_hits:
+            print(f"Event {i}: the hits digitized in batch differ from the ones digitized one by one")
+            return 2
+
+    return 0
+
+if __name__ == "__main__":
+    code = main()
+    sys.exit(code)
@@ -0,0 +1,44 @@
+#
+# gaudi steering file that runs DCHdigi in batch mode, 4 events per call
+#
+# to execute:
+# k4run runDCHdigiBatch.py
+#
+# the digitizer instance has the same name and configuration as in runDCHdigi.py, so that it draws the same
+# random numbers: the output must be the same as dch_proton_10GeV_digi.root, see check_DCHdigi_batch_output.py
+
+from Gaudi.Configuration import INFO,DEBUG
+from Configurables import EventDataSvc, UniqueIDGenSvc
+from k4FWCore import ApplicationMgr
+
+from Configurables import GeoSvc
+geoservice = GeoSvc("GeoSvc")
+geoservice.detectors = ['./compact/DCH_standalone_o1_v02.xml']
+
+from Configurables import DCHdigi_v01
+DCHdigi = DCHdigi_v01("DCHdigi")
+DCHdigi.DCH_simhits=["DCHCollection"]
+DCHdigi.DCH_name="DCH_v2"
+DCHdigi.fileDataAlg="DataAlgFORGEANT.root"
+DCHdigi.calculate_dndx=True
+DCHdigi.create_debug_histograms=False
+DCHdigi.zResolution_mm=1
+DCHdigi.xyResolution_mm=0.1
+
+DCHdigi.OutputLevel=INFO
+
+from Configurables import DCHdigiBatchDriver
+DCHdigiBatch = DCHdigiBatchDriver("DCHdigiBatch")
+DCHdigiBatch.digitizerName="DCHdigi"
+DCHdigiBatch.inputFile="dch_proton_10GeV.root"
+DCHdigiBatch.outputFile="dch_proton_10GeV_digi_batch.root"
+DCHdigiBatch.batchSize=4
+DCHdigiBatch.DCH_simhits="DCHCollection"
+
+mgr = ApplicationMgr(
+    TopAlg=[DCHdigiBatch],
+    EvtSel="NONE",
+    EvtMax=-1,
+    ExtSvc=[geoservice,EventDataSvc("EventDataSvc"),UniqueIDGenSvc("uidSvc")],
+    OutputLevel=INFO,
+)
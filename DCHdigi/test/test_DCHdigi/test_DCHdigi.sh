@@ -2,7 +2,8 @@
 # file: test_DCHdigi.sh
 # author: Alvaro Tolosa-Delgado, CERN 2024
 # to run: sh + test_DCHdigi.sh
-# goal: run sim-digitizer of the DCH v2, and return code printed by check_DCHdigi_output.py
+# goal: run sim-digitizer of the DCH v2, and return code printed by check_DCHdigi_output.py, plus 4 if the batch mode
+# of the digitizer does not give the same hits
 
 # run simulation with the drift chamber alone
 ddsim --steeringFile sim_steering.py --outputFile 'dch_proton_10GeV.root' -N 10 --runType batch --random.seed 42
@@ -23,3 +24,12 @@ k4run runDCHdigi.py
 
 # check distribution of distance from hit position to the wire
 python3 check_DCHdigi_output.py
+exit_code=$?
+
+# run the same digitizer in batch mode, and compare its hits with the ones digitized event by event
+k4run runDCHdigiBatch.py
+if ! python3 check_DCHdigi_batch_output.py; then
+    exit_code=$((exit_code + 4))
+fi
+
+exit $exit_code
@@ -0,0 +1,120 @@
+#pragma once
+
+// GAUDI
+#include "Gaudi/Property.h"
+#include "Gaudi/Sequence.h"
+#include "GaudiKernel/IEventProcessor.h"
+#include "GaudiKernel/System.h"
+
+// PODIO
+#include "podio/Frame.h"
+#include "podio/FrameCategories.h"
+#include "podio/ROOTReader.h"
+#include "podio/ROOTWriter.h"
+
+// STL
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+/** @class DigiBatchDriver
+ *
+ *  Driver of the batch mode of a digitizer: it reads the events of a podio file batchSize at a time, gives each batch
+ *  to the digitizer in one call and writes the events with their digitized collections to the output file. The frames
+ *  of the other categories of the input file (runs, metadata) are copied unchanged to the output file.
+ *  The digitizer is a sub-algorithm named digitizerName, configured in the job options like any other instance of its
+ *  type: it is initialized and finalized with the driver, but never executed. Each execute of the driver is one batch,
+ *  the driver stops the run after the last event of the input file, so the job runs with EvtSel = "NONE" and
+ *  EvtMax = -1, without IOSvc.
+ *  The derived drivers only implement digitize(), which reads the inputs of the batch from the frames, calls the batch
+ *  mode of the digitizer and puts its outputs in the frames.
+ *
+ */
+
+template <typename DIGITIZER> class DigiBatchDriver : public Gaudi::Sequence {
+public:
+  using Gaudi::Sequence::Sequence;
+
+  StatusCode initialize() override {
+    if (m_batchSize.value() < 1) {
+      error() << "batchSize must be at least 1!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    Gaudi::Algorithm* alg = nullptr;
+    if (createSubAlgorithm(System::typeinfoName(typeid(DIGITIZER)), m_digitizerName, alg).isFailure()) {
+      error() << "Unable to create the digitizer " << m_digitizerName.value() << "!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    m_digitizer = dynamic_cast<DIGITIZER*>(alg);
+    if (!m_digitizer) {
+      error() << m_digitizerName.value() << " is not a " << System::typeinfoName(typeid(DIGITIZER)) << "!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // initializes the digitizer
+    StatusCode sc = Gaudi::Sequence::initialize();
+    if (sc.isFailure())
+      return sc;
+
+    m_reader = std::make_unique<podio::ROOTReader>();
+    m_reader->openFile(m_inputFile);
+    m_nEntries = m_reader->getEntries(podio::Category::Event);
+    m_writer   = std::make_unique<podio::ROOTWriter>(m_outputFile);
+    // the frames of the other categories (runs, metadata with e.g. the CellIDEncoding parameters) are copied as they are
+    for (const auto category : m_reader->getAvailableCategories()) {
+      if (category == podio::Category::Event)
+        continue;
+      const std::string name(category);
+      for (size_t i = 0; i < m_reader->getEntries(name); ++i)
+        m_writer->writeFrame(podio::Frame(m_reader->readEntry(name, i)), name);
+    }
+    info() << "Digitizing the " << m_nEntries << " events of " << m_inputFile.value() << " in batches of "
+           << m_batchSize.value() << " events" << endmsg;
+    return StatusCode::SUCCESS;
+  }
+
+  StatusCode execute(const EventContext&) const override {
+    const size_t last = std::min<size_t>(m_nextEntry + m_batchSize, m_nEntries);
+    if (m_nextEntry < last) {
+      std::vector<podio::Frame> frames;
+      frames.reserve(last - m_nextEntry);
+      for (; m_nextEntry < last; ++m_nextEntry)
+        frames.emplace_back(m_reader->readEntry(podio::Category::Event, m_nextEntry));
+      StatusCode sc = digitize(*m_digitizer, frames);
+      if (sc.isFailure())
+        return sc;
+      for (const auto& frame : frames)
+        m_writer->writeFrame(frame, podio::Category::Event);
+    }
+    if (m_nextEntry >= m_nEntries)
+      return serviceLocator()->as<IEventProcessor>()->stopRun();
+    return StatusCode::SUCCESS;
+  }
+
+  StatusCode finalize() override {
+    if (m_writer)
+      m_writer->finish();
+    return Gaudi::Sequence::finalize();
+  }
+
+  /// The reader and the writer follow the order of the events
+  bool isReEntrant() const override { return false; }
+
+protected:
+  /// Digitize the events of one batch, from and into their frames
+  virtual StatusCode digitize(const DIGITIZER& digitizer, std::vector<podio::Frame>& frames) const = 0;
+
+private:
+  Gaudi::Property<std::string> m_inputFile{this, "inputFile", "", "Input podio file with the sim hits"};
+  Gaudi::Property<std::string> m_outputFile{this, "outputFile", "", "Output podio file, input events and digitized hits"};
+  Gaudi::Property<unsigned>    m_batchSize{this, "batchSize", 64, "Number of events digitized in one call"};
+  Gaudi::Property<std::string> m_digitizerName{this, "digitizerName", System::typeinfoName(typeid(DIGITIZER)),
+                                               "Name of the digitizer instance, configured in the job options"};
+
+  DIGITIZER*                                 m_digitizer = nullptr;
+  mutable std::unique_ptr<podio::ROOTReader> m_reader;
+  mutable std::unique_ptr<podio::ROOTWriter> m_writer;
+  size_t                                     m_nEntries  = 0;
+  mutable size_t                             m_nextEntry = 0;
+};
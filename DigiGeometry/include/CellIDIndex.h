@@ -0,0 +1,8 @@
+#pragma once
+
+#include "DenseKeyIndex.h"
+
+#include <cstdint>
+
+/// Dense index of the cellIDs, in order of first insertion (see DenseKeyIndex)
+using CellIDIndex = DenseKeyIndex<uint64_t>;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/// splitmix64 finalizer, for keys (cellIDs, object IDs) which are far from uniformly distributed in their low bits
+inline uint64_t splitmix64(uint64_t h) {
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+struct SplitMix64Hash {
+  uint64_t operator()(uint64_t key) const { return splitmix64(key); }
+};
+
+/** @class DenseKeyIndex
+ *
+ *  Open-addressing hash table (linear probing) mapping a key to a dense index.
+ *  Indices are given in order of first insertion, so that the order of the objects stored at these indices does not depend on the hash.
+ *  The table keeps its capacity across reset() calls and can therefore be reused from one event to the next without allocations.
+ *  KEY must be equality comparable, HASH a functor returning a 64 bit hash whose low bits are well mixed.
+ *
+ */
+
+template <typename KEY, typename HASH = SplitMix64Hash> class DenseKeyIndex {
+public:
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+  /// Forget all the keys and make sure the table can hold nKeys entries at a load factor <= 0.5
+  void reset(std::size_t nKeys) {
+    std::size_t capacity = 16;
+    while (capacity < 2 * nKeys)
+      capacity <<= 1;
+    if (capacity > m_slots.size())
+      m_slots.resize(capacity);
+    std::fill(m_slots.begin(), m_slots.end(), npos);
+    m_mask = m_slots.size() - 1;
+    m_keys.clear();
+    m_keys.reserve(nKeys);
+  }
+
+  /// Return the index of the key, and whether the key was inserted by this call
+  std::pair<uint32_t, bool> insert(const KEY& key) {
+    std::size_t slot = HASH{}(key) & m_mask;
+    while (m_slots[slot] != npos) {
+      if (m_keys[m_slots[slot]] == key)
+        return {m_slots[slot], false};
+      slot = (slot + 1) & m_mask;
+    }
+    m_slots[slot] = static_cast<uint32_t>(m_keys.size());
+    m_keys.push_back(key);
+    return {m_slots[slot], true};
+  }
+
+  /// Return the index of the key, or npos if it was never inserted
+  uint32_t find(const KEY& key) const {
+    if (m_slots.empty())
+      return npos;
+    std::size_t slot = HASH{}(key) & m_mask;
+    while (m_slots[slot] != npos) {
+      if (m_keys[m_slots[slot]] == key)
+        return m_slots[slot];
+      slot = (slot + 1) & m_mask;
+    }
+    return npos;
+  }
+
+  /// Number of distinct keys inserted since the last reset
+  std::size_t size() const { return m_keys.size(); }
+
+  /// Key stored at a given index
+  const KEY& key(uint32_t index) const { return m_keys[index]; }
+
+  /// Allocated memory in bytes
+  std::size_t memory() const { return m_slots.capacity() * sizeof(uint32_t) + m_keys.capacity() * sizeof(KEY); }
+
+private:
+  std::vector<uint32_t> m_slots;
+  std::vector<KEY>      m_keys;
+  std::size_t           m_mask = 0;
+};
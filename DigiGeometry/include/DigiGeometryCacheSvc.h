@@ -0,0 +1,87 @@
+#pragma once
+
+// GAUDI
+#include "Gaudi/Property.h"
+#include "GaudiKernel/Service.h"
+
+// K4FWCORE
+#include "k4Interface/IGeoSvc.h"
+
+// DD4HEP
+#include "DD4hep/Detector.h"
+#include "DDSegmentation/BitFieldCoder.h"
+
+#include "IDigiGeometryCacheSvc.h"
+
+// STL
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** @class DigiGeometryCacheSvc
+ *
+ *  Service building and sharing the geometry look-up tables of the digitizers (see IDigiGeometryCacheSvc), from the
+ *  detector of the GeoSvc. The memory of each table is printed when it is built, and its look-up statistics at
+ *  finalize.
+ *  If snapshotFile is set, the listed tables, drift chambers and sensor surfaces are exported at initialize, with the
+ *  decoders of all the readouts, to a geometry snapshot that DigiGeometrySnapshotSvc reads in place of this service.
+ *
+ */
+
+class DigiGeometryCacheSvc : public extends<Service, IDigiGeometryCacheSvc> {
+public:
+  explicit DigiGeometryCacheSvc(const std::string& name, ISvcLocator* svcLoc);
+  virtual ~DigiGeometryCacheSvc();
+  /**  Initialize.
+   *   @return status code
+   */
+  virtual StatusCode initialize() final;
+  /**  Finalize.
+   *   @return status code
+   */
+  virtual StatusCode finalize() final;
+
+  dd4hep::Detector*                      detector() final;
+  dd4hep::DDSegmentation::BitFieldCoder* decoder(const std::string& readoutName) final;
+  const DigiGeometry::CellTable*         sensorTransforms(const std::string& readoutName) final;
+  const DigiGeometry::CellTable*         wireTransforms(const std::string& readoutName) final;
+  const DigiGeometry::CellTable*         cellPositions(const std::string& readoutName) final;
+  const DigiGeometry::DCHParameters*     driftChamber(const std::string& detectorName) final;
+  const std::vector<DigiGeometry::SensorSurface>* sensorSurfaces(const std::string& detectorName) final;
+
+private:
+  // Geometry service name
+  Gaudi::Property<std::string> m_geoSvcName{this, "GeoSvcName", "GeoSvc", "The name of the GeoSvc instance"};
+  // Snapshot export
+  Gaudi::Property<std::string> m_snapshotFile{this, "snapshotFile", "", "Geometry snapshot file written at initialize (empty := no export)"};
+  Gaudi::Property<std::vector<std::string>> m_exportSensorTransforms{this, "exportSensorTransforms", {}, "Readouts whose sensor transformations are exported to the snapshot"};
+  Gaudi::Property<std::vector<std::string>> m_exportWireTransforms{this, "exportWireTransforms", {}, "Readouts whose wire transformations are exported to the snapshot"};
+  Gaudi::Property<std::vector<std::string>> m_exportCellPositions{this, "exportCellPositions", {}, "Readouts whose cell positions are exported to the snapshot"};
+  Gaudi::Property<std::vector<std::string>> m_exportDriftChambers{this, "exportDriftChambers", {}, "Detectors whose DCH_info parameters are exported to the snapshot"};
+  Gaudi::Property<std::vector<std::string>> m_exportSensorSurfaces{this, "exportSensorSurfaces", {}, "Detectors whose sensor surfaces are exported to the snapshot"};
+  // Pointer to the geometry service
+  SmartIF<IGeoSvc> m_geoSvc;
+
+  // Tables, drift chambers and sensor surfaces built so far (the pointers stay valid until finalize); the decoders of
+  // the snapshot are only filled for the export
+  DigiGeometry::Snapshot m_geometry;
+  std::mutex             m_mutex;
+  const DigiGeometry::CellTable* getTable(DigiGeometry::TableType type, const std::string& readoutName);
+  // Write the snapshot of the exported readouts and detectors
+  StatusCode exportSnapshot();
+  // Fill a table, false if the readout does not exist
+  bool buildSensorTransforms(const std::string& readoutName, DigiGeometry::CellTable& table) const;
+  bool buildWireTransforms(const std::string& readoutName, DigiGeometry::CellTable& table) const;
+  bool buildCellPositions(const std::string& readoutName, DigiGeometry::CellTable& table) const;
+
+  // Sensitive volumes of the detectors using the readout, with their volumeID; volumeMask gets the bits of the fields
+  // set by the placements
+  void findSensitiveVolumes(const std::string& readoutName,
+                            std::vector<std::pair<dd4hep::VolumeID, dd4hep::PlacedVolume>>& sensors,
+                            uint64_t& volumeMask) const;
+  void collectSensitiveVolumes(dd4hep::PlacedVolume placement, dd4hep::VolumeID volumeID,
+                               const dd4hep::DDSegmentation::BitFieldCoder& decoder,
+                               std::vector<std::pair<dd4hep::VolumeID, dd4hep::PlacedVolume>>& sensors,
+                               uint64_t& volumeMask) const;
+};
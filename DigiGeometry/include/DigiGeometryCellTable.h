@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CellIDIndex.h"
+
+// ROOT
+#include "TGeoMatrix.h"
+
+// STL
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace DigiGeometry {
+
+/** @class CellTable
+ *
+ *  Immutable table of per cell (or per sensor, or per wire) geometry: a position and optionally a local <-> global
+ *  transformation, stored contiguously and found from the cellID with an open-addressing hash table.
+ *  The key of a cellID is the cellID masked with the key mask of the table, e.g. with only the volume fields for a
+ *  table of sensors, so that the cellIDs of all the pixels of a sensor find the sensor. Lengths are in DD4hep units.
+ *  The transformations follow TGeoMatrix: toLocal is MasterToLocal and toGlobal is LocalToMaster.
+ *  A table is filled once by assign() and is then only read, it can be shared between threads. The look-up statistics
+ *  are counted by the users in bulk, e.g. once per event, so that the look-ups themselves do not touch any atomic.
+ *
+ */
+
+class CellTable {
+public:
+  static constexpr uint32_t npos = CellIDIndex::npos;
+
+  /// Fill the table; positions has 3 values per cellID, transforms either 12 per cellID (rotation row by row, then
+  /// translation) or none. The duplicated cellIDs are ignored.
+  void assign(uint64_t keyMask, const std::vector<uint64_t>& cellIDs, const std::vector<double>& positions,
+              const std::vector<double>& transforms) {
+    const bool withTransforms = !transforms.empty();
+    m_keyMask                 = keyMask;
+    m_index.reset(cellIDs.size());
+    m_positions.clear();
+    m_positions.reserve(3 * cellIDs.size());
+    m_transforms.clear();
+    m_transforms.reserve(withTransforms ? 12 * cellIDs.size() : 0);
+    for (std::size_t i = 0; i < cellIDs.size(); ++i) {
+      if (!m_index.insert(cellIDs[i] & m_keyMask).second)
+        continue;
+      m_positions.insert(m_positions.end(), positions.begin() + 3 * i, positions.begin() + 3 * i + 3);
+      if (withTransforms)
+        m_transforms.insert(m_transforms.end(), transforms.begin() + 12 * i, transforms.begin() + 12 * i + 12);
+    }
+  }
+
+  /// The 12 values of a transformation as stored by assign()
+  static void appendTransform(const TGeoMatrix& matrix, std::vector<double>& transforms) {
+    const double* rotation    = matrix.GetRotationMatrix();
+    const double* translation = matrix.GetTranslation();
+    transforms.insert(transforms.end(), rotation, rotation + 9);
+    transforms.insert(transforms.end(), translation, translation + 3);
+  }
+
+  /// Entry of a cellID, or npos if it is not in the table
+  uint32_t find(uint64_t cellID) const { return m_index.find(cellID & m_keyMask); }
+
+  /// Number of entries, and key of an entry
+  std::size_t size() const { return m_index.size(); }
+  uint64_t    key(uint32_t entry) const { return m_index.key(entry); }
+  uint64_t    keyMask() const { return m_keyMask; }
+  bool        hasTransforms() const { return !m_transforms.empty(); }
+
+  /// Position of an entry (for transformations, the global position of the local origin)
+  const double* position(uint32_t entry) const { return &m_positions[3 * entry]; }
+  /// The 12 values of the transformation of an entry, as given to assign()
+  const double* transform(uint32_t entry) const { return &m_transforms[12 * entry]; }
+
+  /// Global to local coordinates, as TGeoMatrix::MasterToLocal
+  void toLocal(uint32_t entry, const double global[3], double local[3]) const {
+    const double* rotation    = &m_transforms[12 * entry];
+    const double* translation = rotation + 9;
+    const double  d[3]        = {global[0] - translation[0], global[1] - translation[1], global[2] - translation[2]};
+    for (int i = 0; i < 3; ++i)
+      local[i] = d[0] * rotation[i] + d[1] * rotation[i + 3] + d[2] * rotation[i + 6];
+  }
+
+  /// Local to global coordinates, as TGeoMatrix::LocalToMaster
+  void toGlobal(uint32_t entry, const double local[3], double global[3]) const {
+    const double* rotation    = &m_transforms[12 * entry];
+    const double* translation = rotation + 9;
+    for (int i = 0; i < 3; ++i)
+      global[i] = translation[i] + local[0] * rotation[3 * i] + local[1] * rotation[3 * i + 1] +
+                  local[2] * rotation[3 * i + 2];
+  }
+
+  /// Add look-ups to the statistics, found in the table or missing from it
+  void countLookups(uint64_t found, uint64_t missing) const {
+    m_found.fetch_add(found, std::memory_order_relaxed);
+    m_missing.fetch_add(missing, std::memory_order_relaxed);
+  }
+  uint64_t found() const { return m_found.load(std::memory_order_relaxed); }
+  uint64_t missing() const { return m_missing.load(std::memory_order_relaxed); }
+
+  /// Allocated memory in bytes
+  std::size_t memory() const {
+    return m_index.memory() + (m_positions.capacity() + m_transforms.capacity()) * sizeof(double);
+  }
+
+private:
+  uint64_t            m_keyMask = ~uint64_t(0);
+  CellIDIndex         m_index;
+  std::vector<double> m_positions;
+  std::vector<double> m_transforms;
+
+  mutable std::atomic<uint64_t> m_found{0};
+  mutable std::atomic<uint64_t> m_missing{0};
+};
+
+} // namespace DigiGeometry
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "DigiGeometryCellTable.h"
+
+// STL
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace DigiGeometry {
+
+/// The look-up tables of a readout
+enum TableType : int32_t { SensorTransforms = 0, WireTransforms, CellPositions };
+
+inline const char* tableTypeName(TableType type) {
+  static const char* names[] = {"sensor transforms", "wire transforms", "cell positions"};
+  return names[type];
+}
+
+/** @struct DCHParameters
+ *
+ *  Input parameters of the DCH_info extension of a drift chamber (lengths in DD4hep units): the layer database is
+ *  rebuilt from them with DCH_info::BuildLayerDatabase, as done by the detector constructor.
+ *
+ */
+
+struct DCHParameters {
+  std::string readoutName;
+  double      Lhalf                = 0;
+  double      rin                  = 0;
+  double      rout                 = 0;
+  double      guard_inner_r_at_z0  = 0;
+  double      guard_outer_r_at_zL2 = 0;
+  double      twist_angle          = 0;
+  double      first_width          = 0;
+  double      first_sense_r        = 0;
+  int32_t     ncell0               = 0;
+  int32_t     ncell_increment      = 0;
+  int32_t     ncell_per_sector     = 0;
+  int32_t     nsuperlayers         = 0;
+  int32_t     nlayersPerSuperlayer = 0;
+};
+
+/** @struct SensorSurface
+ *
+ *  Planar measurement surface of a sensor, as needed by the digitizers (lengths in DD4hep units): the center and the
+ *  unit u-v directions of the surface, and its lengths along them.
+ *
+ */
+
+struct SensorSurface {
+  uint64_t cellID;
+  double   origin[3];
+  double   u[3];
+  double   v[3];
+  double   lengthU;
+  double   lengthV;
+};
+
+/** @class Snapshot
+ *
+ *  The subset of the detector geometry used by the digitizers (cellID decoders, look-up tables, drift chamber
+ *  parameters and sensor surfaces), written to and read from a versioned binary file, so that digitization-only jobs do
+ *  not need to build the full DD4hep detector from the compact XML.
+ *  The file starts with a magic string, the format version and a byte order mark, and is rejected if any of them does
+ *  not match: a snapshot has to be re-exported after a change of the format or of the geometry.
+ *
+ */
+
+class Snapshot {
+public:
+  static constexpr uint32_t version = 1;
+
+  /// cellID decoder field description of each readout
+  std::map<std::string, std::string> decoders;
+  /// Look-up tables by type and readout name
+  std::map<std::pair<TableType, std::string>, std::unique_ptr<CellTable>> tables;
+  /// Drift chamber parameters by detector name
+  std::map<std::string, DCHParameters> driftChambers;
+  /// Sensor surfaces by detector name
+  std::map<std::string, std::vector<SensorSurface>> sensorSurfaces;
+
+  /// Write the snapshot, false (with the reason in errorMessage) if the file could not be written
+  bool write(const std::string& fileName, std::string& errorMessage) const;
+  /// Read a snapshot, false (with the reason in errorMessage) if the file could not be read or is not compatible
+  bool read(const std::string& fileName, std::string& errorMessage);
+};
+
+} // namespace DigiGeometry
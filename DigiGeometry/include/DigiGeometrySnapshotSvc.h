@@ -0,0 +1,57 @@
+#pragma once
+
+// GAUDI
+#include "Gaudi/Property.h"
+#include "GaudiKernel/Service.h"
+
+// DD4HEP
+#include "DDSegmentation/BitFieldCoder.h"
+
+#include "IDigiGeometryCacheSvc.h"
+
+// STL
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** @class DigiGeometrySnapshotSvc
+ *
+ *  Lightweight geometry provider of the digitizers (see IDigiGeometryCacheSvc), reading the geometry snapshot written
+ *  by DigiGeometryCacheSvc at initialize instead of building the detector from the compact XML: digitization-only jobs
+ *  then need neither the GeoSvc nor the DD4hep detector. detector() is nullptr, and everything missing from the
+ *  snapshot is an error, as there is no DD4hep fall back.
+ *
+ */
+
+class DigiGeometrySnapshotSvc : public extends<Service, IDigiGeometryCacheSvc> {
+public:
+  explicit DigiGeometrySnapshotSvc(const std::string& name, ISvcLocator* svcLoc);
+  virtual ~DigiGeometrySnapshotSvc();
+  /**  Initialize.
+   *   @return status code
+   */
+  virtual StatusCode initialize() final;
+  /**  Finalize.
+   *   @return status code
+   */
+  virtual StatusCode finalize() final;
+
+  dd4hep::Detector*                      detector() final { return nullptr; }
+  dd4hep::DDSegmentation::BitFieldCoder* decoder(const std::string& readoutName) final;
+  const DigiGeometry::CellTable*         sensorTransforms(const std::string& readoutName) final;
+  const DigiGeometry::CellTable*         wireTransforms(const std::string& readoutName) final;
+  const DigiGeometry::CellTable*         cellPositions(const std::string& readoutName) final;
+  const DigiGeometry::DCHParameters*     driftChamber(const std::string& detectorName) final;
+  const std::vector<DigiGeometry::SensorSurface>* sensorSurfaces(const std::string& detectorName) final;
+
+private:
+  // Snapshot file
+  Gaudi::Property<std::string> m_snapshotFile{this, "snapshotFile", "", "Geometry snapshot file, written by DigiGeometryCacheSvc"};
+
+  // Content of the snapshot, immutable after initialize
+  DigiGeometry::Snapshot m_geometry;
+  // cellID decoders built from the field descriptions of the snapshot
+  std::map<std::string, std::unique_ptr<dd4hep::DDSegmentation::BitFieldCoder>> m_decoders;
+  const DigiGeometry::CellTable* getTable(DigiGeometry::TableType type, const std::string& readoutName);
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+// GAUDI
+#include "GaudiKernel/IInterface.h"
+
+// DD4HEP
+#include "DD4hep/Detector.h"
+#include "DDSegmentation/BitFieldCoder.h"
+
+#include "DigiGeometryCellTable.h"
+#include "DigiGeometrySnapshot.h"
+
+#include <string>
+#include <vector>
+
+/** @class IDigiGeometryCacheSvc
+ *
+ *  Interface of the service sharing the geometry look-up tables of the digitizers between all the algorithms of a job,
+ *  instead of querying the VolumeManager, the CellIDPositionConverter or the DetElement tree for each hit.
+ *  The tables are built once per readout at the first request and are immutable afterwards; they return nullptr if the
+ *  readout does not exist. A cellID missing from a table should fall back to the DD4hep look-up.
+ *  The service is either built on the full detector of the GeoSvc (DigiGeometryCacheSvc) or read from a geometry
+ *  snapshot (DigiGeometrySnapshotSvc), in which case detector() is nullptr and no DD4hep fall back is possible.
+ *
+ */
+
+class IDigiGeometryCacheSvc : virtual public IInterface {
+public:
+  DeclareInterfaceID(IDigiGeometryCacheSvc, 2, 0);
+
+  /// The full DD4hep detector, or nullptr if the geometry comes from a snapshot
+  virtual dd4hep::Detector* detector() = 0;
+
+  /// cellID decoder of the readout, or nullptr if the readout does not exist
+  virtual dd4hep::DDSegmentation::BitFieldCoder* decoder(const std::string& readoutName) = 0;
+
+  /// Placement transformation of each sensitive volume of the readout (the one of VolumeManager::lookupVolumePlacement),
+  /// keyed by the volume fields of the cellID
+  virtual const DigiGeometry::CellTable* sensorTransforms(const std::string& readoutName) = 0;
+
+  /// World transformation of each wire of the readout, for the drift chambers whose wires are DetElements named
+  /// "*_wire" below the DetElement of their cell, keyed by the cellID
+  virtual const DigiGeometry::CellTable* wireTransforms(const std::string& readoutName) = 0;
+
+  /// Position of each cell of the readout (from the CellIDPositionConverter), keyed by the cellID: one cell per
+  /// sensitive volume, or each pixel of the sensitive volumes for a CartesianGridXY segmentation
+  virtual const DigiGeometry::CellTable* cellPositions(const std::string& readoutName) = 0;
+
+  /// Parameters of the DCH_info extension of a drift chamber, or nullptr if the detector does not have it
+  virtual const DigiGeometry::DCHParameters* driftChamber(const std::string& detectorName) = 0;
+
+  /// Surfaces of the sensors of a detector (from its SurfaceManager map), or nullptr if the detector has none
+  virtual const std::vector<DigiGeometry::SensorSurface>* sensorSurfaces(const std::string& detectorName) = 0;
+};
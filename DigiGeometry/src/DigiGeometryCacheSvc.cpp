@@ -0,0 +1,341 @@
+#include "DigiGeometryCacheSvc.h"
+
+// DD4HEP
+#include "DDRec/CellIDPositionConverter.h"
+#include "DDRec/SurfaceManager.h"
+#ifdef DCH_INFO_H_EXIST
+#include "DDRec/DCH_info.h"
+#endif
+#include "DDSegmentation/CartesianGridXY.h"
+
+// ROOT
+#include "TGeoBBox.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+
+DECLARE_COMPONENT(DigiGeometryCacheSvc)
+
+DigiGeometryCacheSvc::DigiGeometryCacheSvc(const std::string& name, ISvcLocator* svcLoc) : base_class(name, svcLoc) {}
+
+DigiGeometryCacheSvc::~DigiGeometryCacheSvc() {}
+
+StatusCode DigiGeometryCacheSvc::initialize() {
+  StatusCode sc = Service::initialize();
+  if (sc.isFailure())
+    return sc;
+  m_geoSvc = service(m_geoSvcName, true);
+  if (!m_geoSvc) {
+    error() << "Unable to get the GeoSvc " << m_geoSvcName.value() << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (!m_snapshotFile.empty())
+    return exportSnapshot();
+  return StatusCode::SUCCESS;
+}
+
+StatusCode DigiGeometryCacheSvc::finalize() {
+  for (const auto& [key, table] : m_geometry.tables) {
+    const uint64_t lookups = table->found() + table->missing();
+    info() << "Geometry cache " << DigiGeometry::tableTypeName(key.first) << " of " << key.second << ": " << table->size()
+           << " entries, " << table->memory() / 1024. << " kB, " << lookups << " look-ups, hit rate "
+           << (lookups > 0 ? 100. * table->found() / lookups : 100.) << " %" << endmsg;
+  }
+  m_geometry = DigiGeometry::Snapshot();
+  m_geoSvc.reset();
+  return Service::finalize();
+}
+
+dd4hep::Detector* DigiGeometryCacheSvc::detector() { return m_geoSvc->getDetector(); }
+
+dd4hep::DDSegmentation::BitFieldCoder* DigiGeometryCacheSvc::decoder(const std::string& readoutName) {
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  if (detector->readouts().find(readoutName) == detector->readouts().end()) {
+    error() << "Readout <<" << readoutName << ">> does not exist." << endmsg;
+    return nullptr;
+  }
+  return detector->readout(readoutName).idSpec().decoder();
+}
+
+const DigiGeometry::CellTable* DigiGeometryCacheSvc::sensorTransforms(const std::string& readoutName) {
+  return getTable(DigiGeometry::SensorTransforms, readoutName);
+}
+
+const DigiGeometry::CellTable* DigiGeometryCacheSvc::wireTransforms(const std::string& readoutName) {
+  return getTable(DigiGeometry::WireTransforms, readoutName);
+}
+
+const DigiGeometry::CellTable* DigiGeometryCacheSvc::cellPositions(const std::string& readoutName) {
+  return getTable(DigiGeometry::CellPositions, readoutName);
+}
+
+const DigiGeometry::CellTable* DigiGeometryCacheSvc::getTable(DigiGeometry::TableType type,
+                                                              const std::string&      readoutName) {
+  // The tables are requested from the initialize of the algorithms, the lock is only there for safety
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_geometry.tables.find({type, readoutName});
+  if (it != m_geometry.tables.end())
+    return it->second.get();
+
+  auto table = std::make_unique<DigiGeometry::CellTable>();
+  bool built = false;
+  switch (type) {
+  case DigiGeometry::SensorTransforms:
+    built = buildSensorTransforms(readoutName, *table);
+    break;
+  case DigiGeometry::WireTransforms:
+    built = buildWireTransforms(readoutName, *table);
+    break;
+  case DigiGeometry::CellPositions:
+    built = buildCellPositions(readoutName, *table);
+    break;
+  }
+  if (!built) {
+    error() << "Readout <<" << readoutName << ">> does not exist." << endmsg;
+    return nullptr;
+  }
+  if (table->size() == 0)
+    warning() << "Geometry cache of readout " << readoutName << " is empty, all the look-ups will miss" << endmsg;
+  info() << "Geometry cache of readout " << readoutName << ": " << table->size() << " entries, "
+         << table->memory() / 1024. << " kB" << endmsg;
+  return (m_geometry.tables[{type, readoutName}] = std::move(table)).get();
+}
+
+const DigiGeometry::DCHParameters* DigiGeometryCacheSvc::driftChamber(const std::string& detectorName) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_geometry.driftChambers.find(detectorName);
+  if (it != m_geometry.driftChambers.end())
+    return &it->second;
+#ifdef DCH_INFO_H_EXIST
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  if (detector->detectors().count(detectorName) == 0)
+    return nullptr;
+  const auto* dch = dd4hep::DetElement(detector->detectors().at(detectorName)).extension<dd4hep::rec::DCH_info>(false);
+  if (!dch || !dch->IsValid())
+    return nullptr;
+  DigiGeometry::DCHParameters parameters;
+  dd4hep::SensitiveDetector   sensitive = detector->sensitiveDetector(detectorName);
+  if (sensitive.isValid())
+    parameters.readoutName = sensitive.readout().name();
+  parameters.Lhalf                = dch->Lhalf;
+  parameters.rin                  = dch->rin;
+  parameters.rout                 = dch->rout;
+  parameters.guard_inner_r_at_z0  = dch->guard_inner_r_at_z0;
+  parameters.guard_outer_r_at_zL2 = dch->guard_outer_r_at_zL2;
+  parameters.twist_angle          = dch->twist_angle;
+  parameters.first_width          = dch->first_width;
+  parameters.first_sense_r        = dch->first_sense_r;
+  parameters.ncell0               = dch->ncell0;
+  parameters.ncell_increment      = dch->ncell_increment;
+  parameters.ncell_per_sector     = dch->ncell_per_sector;
+  parameters.nsuperlayers         = dch->nsuperlayers;
+  parameters.nlayersPerSuperlayer = dch->nlayersPerSuperlayer;
+  return &(m_geometry.driftChambers[detectorName] = std::move(parameters));
+#else
+  return nullptr;
+#endif
+}
+
+const std::vector<DigiGeometry::SensorSurface>* DigiGeometryCacheSvc::sensorSurfaces(const std::string& detectorName) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_geometry.sensorSurfaces.find(detectorName);
+  if (it != m_geometry.sensorSurfaces.end())
+    return &it->second;
+  dd4hep::rec::SurfaceManager*   surfMan    = m_geoSvc->getDetector()->extension<dd4hep::rec::SurfaceManager>(false);
+  const dd4hep::rec::SurfaceMap* surfaceMap = surfMan ? surfMan->map(detectorName) : nullptr;
+  if (!surfaceMap)
+    return nullptr;
+  std::vector<DigiGeometry::SensorSurface> surfaces;
+  // A surface may be registered several times, once per volume level, keep one per cellID
+  for (auto sI = surfaceMap->begin(); sI != surfaceMap->end(); sI = surfaceMap->upper_bound(sI->first)) {
+    const dd4hep::rec::ISurface* surf   = sI->second;
+    const dd4hep::rec::Vector3D  origin = surf->origin();
+    const dd4hep::rec::Vector3D  u      = surf->u();
+    const dd4hep::rec::Vector3D  v      = surf->v();
+    surfaces.push_back({surf->id(),
+                        {origin.x(), origin.y(), origin.z()},
+                        {u.x(), u.y(), u.z()},
+                        {v.x(), v.y(), v.z()},
+                        surf->length_along_u(),
+                        surf->length_along_v()});
+  }
+  return &(m_geometry.sensorSurfaces[detectorName] = std::move(surfaces));
+}
+
+StatusCode DigiGeometryCacheSvc::exportSnapshot() {
+  for (const auto& readoutName : m_exportSensorTransforms.value())
+    if (!sensorTransforms(readoutName))
+      return StatusCode::FAILURE;
+  for (const auto& readoutName : m_exportWireTransforms.value())
+    if (!wireTransforms(readoutName))
+      return StatusCode::FAILURE;
+  for (const auto& readoutName : m_exportCellPositions.value())
+    if (!cellPositions(readoutName))
+      return StatusCode::FAILURE;
+  for (const auto& detectorName : m_exportDriftChambers.value()) {
+    if (!driftChamber(detectorName)) {
+      error() << "Detector <<" << detectorName << ">> has no valid DCH_info extension." << endmsg;
+      return StatusCode::FAILURE;
+    }
+  }
+  for (const auto& detectorName : m_exportSensorSurfaces.value()) {
+    if (!sensorSurfaces(detectorName)) {
+      error() << "Could not find surface map for detector " << detectorName << " in SurfaceManager" << endmsg;
+      return StatusCode::FAILURE;
+    }
+  }
+  // The decoders are small, export the ones of all the readouts
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  for (const auto& [readoutName, readout] : detector->readouts())
+    m_geometry.decoders[readoutName] = detector->readout(readoutName).idSpec().decoder()->fieldDescription();
+
+  std::string errorMessage;
+  if (!m_geometry.write(m_snapshotFile, errorMessage)) {
+    error() << "Could not write the geometry snapshot: " << errorMessage << endmsg;
+    return StatusCode::FAILURE;
+  }
+  info() << "Geometry snapshot written to " << m_snapshotFile.value() << ": " << m_geometry.decoders.size()
+         << " decoders, " << m_geometry.tables.size() << " tables, " << m_geometry.driftChambers.size()
+         << " drift chambers, " << m_geometry.sensorSurfaces.size() << " sensor surface maps" << endmsg;
+  return StatusCode::SUCCESS;
+}
+
+void DigiGeometryCacheSvc::collectSensitiveVolumes(dd4hep::PlacedVolume placement, dd4hep::VolumeID volumeID,
+                                                   const dd4hep::DDSegmentation::BitFieldCoder& decoder,
+                                                   std::vector<std::pair<dd4hep::VolumeID, dd4hep::PlacedVolume>>& sensors,
+                                                   uint64_t& volumeMask) const {
+  if (placement.data()) {
+    const auto& fields = decoder.fields();
+    for (const auto& [field, value] : placement.volIDs()) {
+      if (std::any_of(fields.begin(), fields.end(), [&field](const auto& f) { return f.name() == field; })) {
+        decoder.set(volumeID, field, value);
+        volumeMask |= decoder[field].mask();
+      }
+    }
+  }
+  if (placement.volume().isSensitive()) {
+    sensors.emplace_back(volumeID, placement);
+    return;
+  }
+  for (Int_t i = 0; i < placement->GetNdaughters(); ++i)
+    collectSensitiveVolumes(placement->GetDaughter(i), volumeID, decoder, sensors, volumeMask);
+}
+
+void DigiGeometryCacheSvc::findSensitiveVolumes(const std::string& readoutName,
+                                                std::vector<std::pair<dd4hep::VolumeID, dd4hep::PlacedVolume>>& sensors,
+                                                uint64_t& volumeMask) const {
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  const auto&       decoder  = *detector->readout(readoutName).idSpec().decoder();
+  for (const auto& [name, handle] : detector->detectors()) {
+    dd4hep::SensitiveDetector sensitive = detector->sensitiveDetector(name);
+    if (sensitive.isValid() && sensitive.readout().name() == readoutName)
+      collectSensitiveVolumes(dd4hep::DetElement(handle).placement(), 0, decoder, sensors, volumeMask);
+  }
+}
+
+bool DigiGeometryCacheSvc::buildSensorTransforms(const std::string& readoutName, DigiGeometry::CellTable& table) const {
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  if (detector->readouts().find(readoutName) == detector->readouts().end())
+    return false;
+  std::vector<std::pair<dd4hep::VolumeID, dd4hep::PlacedVolume>> sensors;
+  uint64_t                                                       volumeMask = 0;
+  findSensitiveVolumes(readoutName, sensors, volumeMask);
+
+  std::vector<uint64_t> volumeIDs;
+  std::vector<double>   positions, transforms;
+  for (const auto& [volumeID, placement] : sensors) {
+    const TGeoMatrix& matrix = placement.matrix();
+    volumeIDs.push_back(volumeID);
+    positions.insert(positions.end(), matrix.GetTranslation(), matrix.GetTranslation() + 3);
+    DigiGeometry::CellTable::appendTransform(matrix, transforms);
+  }
+  table.assign(volumeMask, volumeIDs, positions, transforms);
+  return true;
+}
+
+bool DigiGeometryCacheSvc::buildWireTransforms(const std::string& readoutName, DigiGeometry::CellTable& table) const {
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  if (detector->readouts().find(readoutName) == detector->readouts().end())
+    return false;
+
+  // Walk the DetElement trees of the detectors using the readout: a wire is a child "*_wire" of the DetElement of its
+  // cell, whose volumeID is the cellID of the hits
+  std::vector<uint64_t> cellIDs;
+  std::vector<double>   positions, transforms;
+  std::vector<dd4hep::DetElement> stack;
+  for (const auto& [name, handle] : detector->detectors()) {
+    dd4hep::SensitiveDetector sensitive = detector->sensitiveDetector(name);
+    if (sensitive.isValid() && sensitive.readout().name() == readoutName)
+      stack.push_back(dd4hep::DetElement(handle));
+  }
+  static const std::string wireSuffix = "_wire";
+  while (!stack.empty()) {
+    dd4hep::DetElement element = stack.back();
+    stack.pop_back();
+    for (const auto& [childName, child] : element.children()) {
+      bool isWire = childName.size() > wireSuffix.size() &&
+                    childName.compare(childName.size() - wireSuffix.size(), wireSuffix.size(), wireSuffix) == 0;
+      if (!isWire) {
+        stack.push_back(child);
+        continue;
+      }
+      const TGeoHMatrix& matrix = child.nominal().worldTransformation();
+      cellIDs.push_back(element.volumeID());
+      positions.insert(positions.end(), matrix.GetTranslation(), matrix.GetTranslation() + 3);
+      DigiGeometry::CellTable::appendTransform(matrix, transforms);
+    }
+  }
+  table.assign(~uint64_t(0), cellIDs, positions, transforms);
+  return true;
+}
+
+bool DigiGeometryCacheSvc::buildCellPositions(const std::string& readoutName, DigiGeometry::CellTable& table) const {
+  dd4hep::Detector* detector = m_geoSvc->getDetector();
+  if (detector->readouts().find(readoutName) == detector->readouts().end())
+    return false;
+  std::vector<std::pair<dd4hep::VolumeID, dd4hep::PlacedVolume>> sensors;
+  uint64_t                                                       volumeMask = 0;
+  findSensitiveVolumes(readoutName, sensors, volumeMask);
+
+  // Enumerate the cells of each sensor: the pixels of a CartesianGridXY segmentation, the volume otherwise
+  dd4hep::DDSegmentation::BitFieldCoder* decoder = detector->readout(readoutName).idSpec().decoder();
+  auto grid = dynamic_cast<const dd4hep::DDSegmentation::CartesianGridXY*>(
+      detector->readout(readoutName).segmentation().segmentation());
+  std::vector<uint64_t> cellIDs;
+  for (const auto& [volumeID, placement] : sensors) {
+    if (!grid) {
+      cellIDs.push_back(volumeID);
+      continue;
+    }
+    const auto*   box    = static_cast<const TGeoBBox*>(placement.volume().solid().ptr());
+    const double* origin = box->GetOrigin();
+    // same convention as dd4hep::DDSegmentation::positionToBin
+    auto toBin = [](double position, double cellSize, double offset) {
+      return int(std::floor((position + 0.5 * cellSize - offset) / cellSize));
+    };
+    double eps  = 1e-6 * std::min(grid->gridSizeX(), grid->gridSizeY());
+    int    xMin = toBin(origin[0] - box->GetDX() + eps, grid->gridSizeX(), grid->offsetX());
+    int    xMax = toBin(origin[0] + box->GetDX() - eps, grid->gridSizeX(), grid->offsetX());
+    int    yMin = toBin(origin[1] - box->GetDY() + eps, grid->gridSizeY(), grid->offsetY());
+    int    yMax = toBin(origin[1] + box->GetDY() - eps, grid->gridSizeY(), grid->offsetY());
+    for (int x = xMin; x <= xMax; ++x) {
+      for (int y = yMin; y <= yMax; ++y) {
+        dd4hep::DDSegmentation::CellID cellID = volumeID;
+        decoder->set(cellID, grid->fieldNameX(), x);
+        decoder->set(cellID, grid->fieldNameY(), y);
+        cellIDs.push_back(cellID);
+      }
+    }
+  }
+
+  dd4hep::rec::CellIDPositionConverter converter(*detector);
+  std::vector<double>                  positions;
+  positions.reserve(3 * cellIDs.size());
+  for (auto cellID : cellIDs) {
+    auto pos = converter.position(cellID);
+    positions.insert(positions.end(), {pos.X(), pos.Y(), pos.Z()});
+  }
+  table.assign(~uint64_t(0), cellIDs, positions, {});
+  return true;
+}
@@ -0,0 +1,240 @@
+#include "DigiGeometrySnapshot.h"
+
+// STL
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace DigiGeometry {
+
+namespace {
+
+constexpr char     s_magic[8]      = {'K', '4', 'D', 'I', 'G', 'E', 'O', '\0'};
+constexpr uint32_t s_byteOrderMark = 0x01020304;
+
+// Values are written in the native byte order, the byte order mark rejects the files written on another architecture
+class Writer {
+public:
+  explicit Writer(const std::string& fileName) : m_stream(fileName, std::ios::binary | std::ios::trunc) {}
+  bool good() const { return m_stream.good(); }
+
+  template <typename T> void value(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    m_stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  template <typename T> void values(const T* data, std::size_t size) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    m_stream.write(reinterpret_cast<const char*>(data), size * sizeof(T));
+  }
+  void string(const std::string& s) {
+    value<uint64_t>(s.size());
+    values(s.data(), s.size());
+  }
+
+private:
+  std::ofstream m_stream;
+};
+
+class Reader {
+public:
+  explicit Reader(const std::string& fileName) : m_stream(fileName, std::ios::binary | std::ios::ate) {
+    if (m_stream.good())
+      m_fileSize = m_stream.tellg();
+    m_stream.seekg(0);
+  }
+  bool good() const { return m_stream.good(); }
+
+  template <typename T> T value() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value{};
+    m_stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+  }
+  template <typename T> void values(std::vector<T>& data, uint64_t size) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (!checkSize(size, sizeof(T)))
+      return;
+    data.resize(size);
+    m_stream.read(reinterpret_cast<char*>(data.data()), size * sizeof(T));
+  }
+  std::string string() {
+    uint64_t size = value<uint64_t>();
+    if (!checkSize(size, sizeof(char)))
+      return {};
+    std::string s(size, '\0');
+    m_stream.read(s.data(), size);
+    return s;
+  }
+  // Number of elements of a container, 0 if the file is broken
+  uint64_t size() {
+    uint64_t size = value<uint64_t>();
+    return checkSize(size, 1) ? size : 0;
+  }
+
+private:
+  // The elements still to read must fit in the rest of the file, so that a corrupted size fails cleanly instead of
+  // allocating
+  bool checkSize(uint64_t size, std::size_t elementSize) {
+    if (m_stream.good()) {
+      const std::streamoff position = m_stream.tellg();
+      if (position < 0 || size > (m_fileSize - uint64_t(position)) / elementSize)
+        m_stream.setstate(std::ios::failbit);
+    }
+    return m_stream.good();
+  }
+
+  std::ifstream m_stream;
+  uint64_t      m_fileSize = 0;
+};
+
+} // namespace
+
+bool Snapshot::write(const std::string& fileName, std::string& errorMessage) const {
+  Writer out(fileName);
+  if (!out.good()) {
+    errorMessage = "cannot open " + fileName + " for writing";
+    return false;
+  }
+  out.values(s_magic, sizeof(s_magic));
+  out.value(version);
+  out.value(s_byteOrderMark);
+
+  out.value<uint64_t>(decoders.size());
+  for (const auto& [readoutName, description] : decoders) {
+    out.string(readoutName);
+    out.string(description);
+  }
+
+  out.value<uint64_t>(tables.size());
+  for (const auto& [key, table] : tables) {
+    const uint64_t size = table->size();
+    out.value<int32_t>(key.first);
+    out.string(key.second);
+    out.value(table->keyMask());
+    out.value(size);
+    out.value<uint8_t>(table->hasTransforms());
+    for (uint32_t entry = 0; entry < size; ++entry)
+      out.value(table->key(entry));
+    for (uint32_t entry = 0; entry < size; ++entry)
+      out.values(table->position(entry), 3);
+    if (table->hasTransforms()) {
+      for (uint32_t entry = 0; entry < size; ++entry)
+        out.values(table->transform(entry), 12);
+    }
+  }
+
+  out.value<uint64_t>(driftChambers.size());
+  for (const auto& [detectorName, dch] : driftChambers) {
+    out.string(detectorName);
+    out.string(dch.readoutName);
+    for (double length : {dch.Lhalf, dch.rin, dch.rout, dch.guard_inner_r_at_z0, dch.guard_outer_r_at_zL2,
+                          dch.twist_angle, dch.first_width, dch.first_sense_r})
+      out.value(length);
+    for (int32_t count : {dch.ncell0, dch.ncell_increment, dch.ncell_per_sector, dch.nsuperlayers,
+                          dch.nlayersPerSuperlayer})
+      out.value(count);
+  }
+
+  out.value<uint64_t>(sensorSurfaces.size());
+  for (const auto& [detectorName, surfaces] : sensorSurfaces) {
+    out.string(detectorName);
+    out.value<uint64_t>(surfaces.size());
+    out.values(surfaces.data(), surfaces.size());
+  }
+
+  if (!out.good()) {
+    errorMessage = "error while writing " + fileName;
+    return false;
+  }
+  return true;
+}
+
+bool Snapshot::read(const std::string& fileName, std::string& errorMessage) {
+  Reader in(fileName);
+  if (!in.good()) {
+    errorMessage = "cannot open " + fileName;
+    return false;
+  }
+  char magic[sizeof(s_magic)];
+  for (auto& c : magic)
+    c = in.value<char>();
+  if (!in.good() || std::memcmp(magic, s_magic, sizeof(s_magic)) != 0) {
+    errorMessage = fileName + " is not a digitization geometry snapshot";
+    return false;
+  }
+  // the version is only meaningful in the native byte order, check the byte order mark after it first
+  const uint32_t fileVersion   = in.value<uint32_t>();
+  const uint32_t byteOrderMark = in.value<uint32_t>();
+  if (!in.good()) {
+    errorMessage = fileName + " is truncated or corrupted";
+    return false;
+  }
+  if (byteOrderMark != s_byteOrderMark) {
+    errorMessage = fileName + " was written with another byte order: please re-export it";
+    return false;
+  }
+  if (fileVersion != version) {
+    errorMessage = fileName + " has format version " + std::to_string(fileVersion) + ", expected " +
+                   std::to_string(version) + ": please re-export it";
+    return false;
+  }
+
+  decoders.clear();
+  for (uint64_t i = 0, n = in.size(); i < n && in.good(); ++i) {
+    std::string readoutName = in.string();
+    decoders[readoutName]   = in.string();
+  }
+
+  tables.clear();
+  std::vector<uint64_t> keys;
+  std::vector<double>   positions, transforms;
+  for (uint64_t i = 0, n = in.size(); i < n && in.good(); ++i) {
+    const auto     type           = TableType(in.value<int32_t>());
+    std::string    readoutName    = in.string();
+    const uint64_t keyMask        = in.value<uint64_t>();
+    const uint64_t size           = in.size();
+    const bool     withTransforms = in.value<uint8_t>();
+    in.values(keys, size);
+    in.values(positions, 3 * size);
+    transforms.clear();
+    if (withTransforms)
+      in.values(transforms, 12 * size);
+    if (type < SensorTransforms || type > CellPositions) {
+      errorMessage = fileName + " contains an unknown table type " + std::to_string(type);
+      return false;
+    }
+    if (!in.good())
+      break;
+    auto table = std::make_unique<CellTable>();
+    table->assign(keyMask, keys, positions, transforms);
+    tables[{type, readoutName}] = std::move(table);
+  }
+
+  driftChambers.clear();
+  for (uint64_t i = 0, n = in.size(); i < n && in.good(); ++i) {
+    std::string   detectorName = in.string();
+    DCHParameters dch;
+    dch.readoutName = in.string();
+    for (double* length : {&dch.Lhalf, &dch.rin, &dch.rout, &dch.guard_inner_r_at_z0, &dch.guard_outer_r_at_zL2,
+                           &dch.twist_angle, &dch.first_width, &dch.first_sense_r})
+      *length = in.value<double>();
+    for (int32_t* count : {&dch.ncell0, &dch.ncell_increment, &dch.ncell_per_sector, &dch.nsuperlayers,
+                           &dch.nlayersPerSuperlayer})
+      *count = in.value<int32_t>();
+    driftChambers[detectorName] = std::move(dch);
+  }
+
+  sensorSurfaces.clear();
+  for (uint64_t i = 0, n = in.size(); i < n && in.good(); ++i) {
+    std::string detectorName = in.string();
+    in.values(sensorSurfaces[detectorName], in.size());
+  }
+
+  if (!in.good()) {
+    errorMessage = fileName + " is truncated or corrupted";
+    return false;
+  }
+  return true;
+}
+
+} // namespace DigiGeometry
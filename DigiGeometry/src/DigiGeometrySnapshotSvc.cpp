@@ -0,0 +1,86 @@
+#include "DigiGeometrySnapshotSvc.h"
+
+DECLARE_COMPONENT(DigiGeometrySnapshotSvc)
+
+DigiGeometrySnapshotSvc::DigiGeometrySnapshotSvc(const std::string& name, ISvcLocator* svcLoc)
+    : base_class(name, svcLoc) {}
+
+DigiGeometrySnapshotSvc::~DigiGeometrySnapshotSvc() {}
+
+StatusCode DigiGeometrySnapshotSvc::initialize() {
+  StatusCode sc = Service::initialize();
+  if (sc.isFailure())
+    return sc;
+  if (m_snapshotFile.empty()) {
+    error() << "snapshotFile must be set!" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  std::string errorMessage;
+  if (!m_geometry.read(m_snapshotFile, errorMessage)) {
+    error() << "Could not read the geometry snapshot: " << errorMessage << endmsg;
+    return StatusCode::FAILURE;
+  }
+  for (const auto& [readoutName, description] : m_geometry.decoders)
+    m_decoders[readoutName] = std::make_unique<dd4hep::DDSegmentation::BitFieldCoder>(description);
+  info() << "Geometry snapshot read from " << m_snapshotFile.value() << ": " << m_geometry.decoders.size()
+         << " decoders, " << m_geometry.tables.size() << " tables, " << m_geometry.driftChambers.size()
+         << " drift chambers, " << m_geometry.sensorSurfaces.size() << " sensor surface maps" << endmsg;
+  return StatusCode::SUCCESS;
+}
+
+StatusCode DigiGeometrySnapshotSvc::finalize() {
+  for (const auto& [key, table] : m_geometry.tables) {
+    const uint64_t lookups = table->found() + table->missing();
+    if (lookups == 0)
+      continue;
+    info() << "Geometry snapshot " << DigiGeometry::tableTypeName(key.first) << " of " << key.second << ": "
+           << table->size() << " entries, " << table->memory() / 1024. << " kB, " << lookups << " look-ups, hit rate "
+           << 100. * table->found() / lookups << " %" << endmsg;
+  }
+  m_decoders.clear();
+  m_geometry = DigiGeometry::Snapshot();
+  return Service::finalize();
+}
+
+dd4hep::DDSegmentation::BitFieldCoder* DigiGeometrySnapshotSvc::decoder(const std::string& readoutName) {
+  auto it = m_decoders.find(readoutName);
+  if (it == m_decoders.end()) {
+    error() << "Readout <<" << readoutName << ">> is not in the geometry snapshot." << endmsg;
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+const DigiGeometry::CellTable* DigiGeometrySnapshotSvc::sensorTransforms(const std::string& readoutName) {
+  return getTable(DigiGeometry::SensorTransforms, readoutName);
+}
+
+const DigiGeometry::CellTable* DigiGeometrySnapshotSvc::wireTransforms(const std::string& readoutName) {
+  return getTable(DigiGeometry::WireTransforms, readoutName);
+}
+
+const DigiGeometry::CellTable* DigiGeometrySnapshotSvc::cellPositions(const std::string& readoutName) {
+  return getTable(DigiGeometry::CellPositions, readoutName);
+}
+
+const DigiGeometry::CellTable* DigiGeometrySnapshotSvc::getTable(DigiGeometry::TableType type,
+                                                                 const std::string&      readoutName) {
+  auto it = m_geometry.tables.find({type, readoutName});
+  if (it == m_geometry.tables.end()) {
+    error() << "The " << DigiGeometry::tableTypeName(type) << " of readout <<" << readoutName
+            << ">> are not in the geometry snapshot." << endmsg;
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+const DigiGeometry::DCHParameters* DigiGeometrySnapshotSvc::driftChamber(const std::string& detectorName) {
+  auto it = m_geometry.driftChambers.find(detectorName);
+  return it != m_geometry.driftChambers.end() ? &it->second : nullptr;
+}
+
+const std::vector<DigiGeometry::SensorSurface>*
+DigiGeometrySnapshotSvc::sensorSurfaces(const std::string& detectorName) {
+  auto it = m_geometry.sensorSurfaces.find(detectorName);
+  return it != m_geometry.sensorSurfaces.end() ? &it->second : nullptr;
+}
@@ -0,0 +1,38 @@
+import os
+
+from Gaudi.Configuration import *
+
+################## Detector geometry
+from Configurables import GeoSvc
+geoservice = GeoSvc("GeoSvc")
+path_to_detector = os.environ.get("K4GEO", "")
+detectors_to_use=[
+                   'FCCee/IDEA/compact/IDEA_o1_v03/IDEA_o1_v03.xml',
+                  ]
+geoservice.detectors = [os.path.join(path_to_detector, _det) for _det in detectors_to_use]
+geoservice.OutputLevel = INFO
+
+################## Geometry snapshot export
+# Exports the subset of the geometry used by the digitizers at initialize, no event is processed. Digitization-only jobs
+# then replace the GeoSvc by:
+#   from Configurables import DigiGeometrySnapshotSvc
+#   snapshotservice = DigiGeometrySnapshotSvc("DigiGeometrySnapshotSvc", snapshotFile = "IDEA_o1_v03_digi_geometry.bin")
+# and set geometryCacheSvcName = "DigiGeometrySnapshotSvc" in the digitizers, see runDigitizersFromSnapshot.py
+from Configurables import DigiGeometryCacheSvc
+geometrycache = DigiGeometryCacheSvc("DigiGeometryCacheSvc",
+    snapshotFile = vars().get("output", "IDEA_o1_v03_digi_geometry.bin"),
+    # VTXdigitizer
+    exportSensorTransforms = ["VertexBarrelCollection", "VertexEndcapCollection", "SiWrBCollection", "SiWrDCollection"],
+    exportSensorSurfaces = ["Vertex", "SiWrB", "SiWrD"],
+    # DCHdigi_v01
+    exportDriftChambers = ["DCH_v2"],
+    OutputLevel = INFO
+)
+
+from Configurables import ApplicationMgr
+ApplicationMgr(
+    TopAlg = [],
+    EvtSel = 'NONE',
+    EvtMax = 0,
+    ExtSvc = [geoservice, geometrycache],
+)
@@ -0,0 +1,63 @@
+#
+# Digitization-only job: the vertex and drift chamber digitizers take their geometry from the snapshot written by
+# exportDigiGeometrySnapshot.py, without GeoSvc
+#
+# to execute (after exportDigiGeometrySnapshot.py, on the sim hits of IDEA_o1_v03, see test_digitizersFromSnapshot.sh):
+# k4run runDigitizersFromSnapshot.py
+
+import math
+
+from Gaudi.Configuration import INFO
+from Configurables import EventDataSvc, UniqueIDGenSvc, RndmGenSvc
+from k4FWCore import ApplicationMgr, IOSvc
+
+svc = IOSvc("IOSvc")
+svc.input = ["IDEA_o1_v03_sim_for_snapshot.root"]
+svc.output = "IDEA_o1_v03_digi_from_snapshot.root"
+
+################## Geometry snapshot
+from Configurables import DigiGeometrySnapshotSvc
+snapshotservice = DigiGeometrySnapshotSvc("DigiGeometrySnapshotSvc",
+    snapshotFile = "IDEA_o1_v03_digi_geometry.bin",
+    OutputLevel = INFO
+)
+
+################## Digitizers
+innerVertexResolution_x = 0.003 # [mm]
+innerVertexResolution_y = 0.003 # [mm]
+innerVertexResolution_t = 1000 # [ns]
+outerVertexResolution_x = 0.050/math.sqrt(12) # [mm]
+outerVertexResolution_y = 0.150/math.sqrt(12) # [mm]
+outerVertexResolution_t = 1000 # [ns]
+
+from Configurables import VTXdigitizer
+vtxb_digitizer = VTXdigitizer("VTXBdigitizer",
+    inputSimHits = "VertexBarrelCollection",
+    outputDigiHits = "VTXBDigis",
+    outputSimDigiAssociation = "VTXBSimDigiLinks",
+    detectorName = "Vertex",
+    readoutName = "VertexBarrelCollection",
+    xResolution = [innerVertexResolution_x, innerVertexResolution_x, innerVertexResolution_x, outerVertexResolution_x, outerVertexResolution_x], # mm, r-phi direction
+    yResolution = [innerVertexResolution_y, innerVertexResolution_y, innerVertexResolution_y, outerVertexResolution_y, outerVertexResolution_y], # mm, z direction
+    tResolution = [innerVertexResolution_t, innerVertexResolution_t, innerVertexResolution_t, outerVertexResolution_t, outerVertexResolution_t], # ns
+    geometryCacheSvcName = "DigiGeometrySnapshotSvc",
+    OutputLevel = INFO
+)
+
+from Configurables import DCHdigi_v01
+dch_digitizer = DCHdigi_v01("DCHdigi",
+    DCH_simhits = ["DCHCollection"],
+    DCH_name = "DCH_v2",
+    zResolution_mm = 1,
+    xyResolution_mm = 0.1,
+    geometryCacheSvcName = "DigiGeometrySnapshotSvc",
+    OutputLevel = INFO
+)
+
+ApplicationMgr(
+    TopAlg = [vtxb_digitizer, dch_digitizer],
+    EvtSel = 'NONE',
+    EvtMax = -1,
+    ExtSvc = [EventDataSvc("EventDataSvc"), RndmGenSvc(), UniqueIDGenSvc("uidSvc"), snapshotservice],
+    OutputLevel = INFO,
+)
@@ -0,0 +1,34 @@
+#!/bin/bash
+# file: test_digitizersFromSnapshot.sh
+# to run: bash test_digitizersFromSnapshot.sh <build directory>, from the directory of the snapshot written by
+# exportDigiGeometrySnapshot.py
+# goal: simulate a few muons in IDEA_o1_v03 and digitize their vertex and drift chamber hits with the geometry
+# snapshot only, then check that digitized hits were produced
+
+# the digitizers and their configurables
+if [[ -n "$1" ]]; then
+    export LD_LIBRARY_PATH="$1/VTXdigi:$1/DCHdigi:$LD_LIBRARY_PATH"
+    export PYTHONPATH="$1/VTXdigi/genConfDir:$1/DCHdigi/genConfDir:$PYTHONPATH"
+fi
+
+if [[ ! -f "IDEA_o1_v03_digi_geometry.bin" ]]; then
+    echo "Error: geometry snapshot 'IDEA_o1_v03_digi_geometry.bin' not found, run exportDigiGeometrySnapshot.py first."
+    exit 1
+fi
+
+ddsim --compactFile "$K4GEO/FCCee/IDEA/compact/IDEA_o1_v03/IDEA_o1_v03.xml" --outputFile 'IDEA_o1_v03_sim_for_snapshot.root' \
+      --enableGun --gun.particle mu- --gun.energy "10*GeV" --gun.distribution uniform \
+      -N 5 --runType batch --random.seed 42 || exit 1
+
+k4run test/runDigitizersFromSnapshot.py || exit 1
+
+python3 - <<'PYEOF'
+import sys
+from podio.root_io import Reader
+
+events = Reader("IDEA_o1_v03_digi_from_snapshot.root").get("events")
+n_vtx = sum(len(event.get("VTXBDigis")) for event in events)
+n_dch = sum(len(event.get("DCH_DigiCollection")) for event in events)
+print(f"{n_vtx} vertex barrel and {n_dch} drift chamber digitized hits")
+sys.exit(0 if n_vtx > 0 and n_dch > 0 else 2)
+PYEOF
@@ -0,0 +1,196 @@
+#pragma once
+
+// GAUDI
+#include "Gaudi/Accumulators.h"
+#include "Gaudi/Accumulators/Histogram.h"
+#include "Gaudi/Property.h"
+#include "GaudiKernel/MsgStream.h"
+
+#include "GAUDI_VERSION.h"
+
+#if GAUDI_MAJOR_VERSION < 39
+namespace Gaudi::Accumulators {
+  template <unsigned int ND, atomicity Atomicity = atomicity::full, typename Arithmetic = double>
+  using StaticHistogram =
+      Gaudi::Accumulators::HistogramingCounterBase<ND, Atomicity, Arithmetic, naming::histogramString,
+                                                   HistogramingAccumulator>;
+}
+#endif
+
+// STL
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** @class AlgorithmInstrumentation
+ *
+ *  Built-in per stage timing and throughput counters of an algorithm, switched on with its "instrumentation" property.
+ *  The algorithm splits its work into a few stages (e.g. geometry, smearing, cluster sampling, output fill), opens an
+ *  Event probe at the start of each event, times the stages with it (scoped Stage timers, or enter() for consecutive
+ *  stages) and reports its input and output hits and the size of its per event working buffers. The measurements of
+ *  an event are summed in the probe and go to the Gaudi::Accumulators counters once, when the probe goes out of scope:
+ *   - time per event, in total and per stage [ms],
+ *   - input and output hits per event,
+ *   - histogram of the time per input hit [log10(ns)],
+ *   - working memory of the per event buffers [kB], whose maximum is the peak per event allocation.
+ *  The counters are only created at initialize when enabled; disabled, a probe or a stage costs a branch and does not
+ *  read the clock. summary() prints the share of each stage and the hit throughput, from the finalize of the algorithm.
+ *
+ */
+
+class AlgorithmInstrumentation {
+  struct Counters;
+
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t maxStages = 8;
+
+  /// Declare the "instrumentation" property of the owner, with the names of its stages (at most maxStages)
+  template <typename OWNER>
+  AlgorithmInstrumentation(OWNER* owner, std::initializer_list<const char*> stages)
+      : m_enabled{owner, "instrumentation", false,
+                  "Per stage timing and throughput counters, summarized at finalize (false := no overhead)"},
+        m_stages(stages.begin(), stages.begin() + std::min(stages.size(), maxStages)) {}
+
+  /// Create the counters if enabled, to be called from the initialize of the owner
+  template <typename OWNER> void initialize(OWNER* owner) {
+    if (m_enabled)
+      m_counters = std::make_unique<Counters>(owner, m_stages);
+  }
+
+  bool enabled() const { return m_counters != nullptr; }
+
+  /// Timer of a stage, adding its duration to the stage time of its event probe when it goes out of scope
+  class Stage {
+  public:
+    explicit Stage(double* time) : m_time(time) {
+      if (m_time)
+        m_start = Clock::now();
+    }
+    Stage(const Stage&)            = delete;
+    Stage& operator=(const Stage&) = delete;
+    ~Stage() {
+      if (m_time)
+        *m_time += std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+    }
+
+  private:
+    double*           m_time;
+    Clock::time_point m_start;
+  };
+
+  /// Measurements of one event, flushed to the counters when the probe goes out of scope
+  class Event {
+  public:
+    explicit Event(const AlgorithmInstrumentation& parent) : m_counters(parent.m_counters.get()) {
+      if (m_counters)
+        m_start = Clock::now();
+    }
+    Event(const Event&)            = delete;
+    Event& operator=(const Event&) = delete;
+    ~Event() {
+      if (m_counters) {
+        leave();
+        m_counters->flush(*this);
+      }
+    }
+
+    bool enabled() const { return m_counters != nullptr; }
+    /// Time the stage (index in the list given to the constructor) until the returned timer goes out of scope
+    Stage stage(std::size_t index) { return Stage(m_counters ? &m_stageTimes[index] : nullptr); }
+    /// Close the current stage, if any, and time the stage (index) until the next enter(), leave() or end of event
+    void enter(std::size_t index) {
+      if (!m_counters)
+        return;
+      const auto now = Clock::now();
+      if (m_current < maxStages)
+        m_stageTimes[m_current] += std::chrono::duration<double, std::milli>(now - m_lapStart).count();
+      m_current  = index;
+      m_lapStart = now;
+    }
+    /// Close the current stage, the time until the next enter() is not attributed to any stage
+    void leave() { enter(maxStages); }
+    void hitsIn(std::size_t n) { m_hitsIn += n; }
+    void hitsOut(std::size_t n) { m_hitsOut += n; }
+    /// Size of the per event working buffers; only worth computing if enabled()
+    void workingMemory(std::size_t bytes) { m_bytes = std::max(m_bytes, bytes); }
+
+  private:
+    friend struct AlgorithmInstrumentation::Counters;
+    AlgorithmInstrumentation::Counters* m_counters;
+    Clock::time_point                   m_start;
+    Clock::time_point                   m_lapStart;
+    std::size_t                         m_current = maxStages;
+    std::array<double, maxStages>       m_stageTimes{};
+    std::size_t                         m_hitsIn  = 0;
+    std::size_t                         m_hitsOut = 0;
+    std::size_t                         m_bytes   = 0;
+  };
+
+  Event event() const { return Event(*this); }
+
+  /// Print the time share of each stage and the hit throughput (nothing if disabled)
+  void summary(MsgStream& log) const {
+    if (!m_counters)
+      return;
+    const double total  = m_counters->time.sum();
+    const auto   events = m_counters->time.nEntries();
+    log << "Instrumentation summary: " << events << " events, " << total << " ms";
+    if (total > 0) {
+      log << ", " << 1e3 * m_counters->hitsIn.sum() / total << " input hits/s, " << 1e3 * m_counters->hitsOut.sum() / total
+          << " output hits/s";
+      for (std::size_t i = 0; i < m_stages.size(); ++i)
+        log << "\n  " << m_stages[i] << ": " << m_counters->stageTimes[i]->sum() << " ms ("
+            << 100. * m_counters->stageTimes[i]->sum() / total << " %)";
+    }
+    if (m_counters->memory.nEntries() > 0)
+      log << "\n  peak working memory per event: " << m_counters->memory.max() << " kB";
+    log << endmsg;
+  }
+
+private:
+  Gaudi::Property<bool>    m_enabled;
+  std::vector<std::string> m_stages;
+
+  struct Counters {
+    template <typename OWNER>
+    Counters(OWNER* owner, const std::vector<std::string>& stages)
+        : time{owner, "Instrumentation: time per event [ms]"}
+        , hitsIn{owner, "Instrumentation: input hits per event"}
+        , hitsOut{owner, "Instrumentation: output hits per event"}
+        , memory{owner, "Instrumentation: working memory per event [kB]"}
+        , timePerHit{owner, "instrumentation_time_per_hit", "Time per input hit", {60, 0., 6., "log10(time per hit [ns]);Events"}} {
+      for (const auto& stage : stages)
+        stageTimes.push_back(
+            std::make_unique<Gaudi::Accumulators::AveragingCounter<double>>(owner, "Instrumentation: time per event, " + stage + " [ms]"));
+    }
+
+    void flush(const Event& event) {
+      const double eventTime = std::chrono::duration<double, std::milli>(Clock::now() - event.m_start).count();
+      time += eventTime;
+      for (std::size_t i = 0; i < stageTimes.size(); ++i)
+        *stageTimes[i] += event.m_stageTimes[i];
+      hitsIn += event.m_hitsIn;
+      hitsOut += event.m_hitsOut;
+      if (event.m_bytes > 0)
+        memory += event.m_bytes / 1024.;
+      if (event.m_hitsIn > 0)
+        ++timePerHit[std::log10(std::max(1e6 * eventTime / event.m_hitsIn, 1.))];
+    }
+
+    Gaudi::Accumulators::AveragingCounter<double>                              time;
+    Gaudi::Accumulators::AveragingCounter<unsigned long>                       hitsIn;
+    Gaudi::Accumulators::AveragingCounter<unsigned long>                       hitsOut;
+    Gaudi::Accumulators::StatCounter<double>                                   memory;
+    Gaudi::Accumulators::StaticHistogram<1>                                    timePerHit;
+    std::vector<std::unique_ptr<Gaudi::Accumulators::AveragingCounter<double>>> stageTimes;
+  };
+  std::unique_ptr<Counters> m_counters;
+};
@@ -0,0 +1,68 @@
+#include "Gaudi/Property.h"
+#include "GaudiKernel/Service.h"
+
+// DD4HEP
+#include "DD4hep/DD4hepUnits.h"
+#include "DD4hep/Detector.h"
+
+#include "IFieldCacheSvc.h"
+
+// C++
+#include <string>
+
+/** @class FieldCacheSvc
+ *
+ *  Service sampling the DD4hep magnetic field once, at initialize, onto a regular (r, z) grid (at phi = 0, the field
+ *  is assumed to be axially symmetric). Calling the DD4hep field at every helix or Runge-Kutta step is too slow, while
+ *  the bilinear interpolation of the cached grid costs a few multiplications.
+ *  The geometry service is initialized first, so that the field is available when sampling.
+ *
+ */
+
+class FieldCacheSvc : public extends<Service, IFieldCacheSvc> {
+public:
+  using extends::extends;
+
+  StatusCode initialize() override {
+    StatusCode sc = Service::initialize();
+    if (sc.isFailure())
+      return sc;
+
+    if (!serviceLocator()->service(m_geoSvcName.value(), true)) {
+      error() << "Unable to locate Geometry Service " << m_geoSvcName.value() << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (m_nR.value() < 2 || m_nZ.value() < 2 || m_rMax.value() <= 0. || m_zMax.value() <= 0.) {
+      error() << "The field grid needs at least two points and a positive extent in r and z" << endmsg;
+      return StatusCode::FAILURE;
+    }
+
+    const auto& field = dd4hep::Detector::getInstance().field();
+    m_fieldMap.resize(m_rMax.value(), m_zMax.value(), m_nR.value(), m_nZ.value());
+    for (int iz = 0; iz < m_fieldMap.nZ(); ++iz) {
+      for (int ir = 0; ir < m_fieldMap.nR(); ++ir) {
+        const double position[3] = {m_fieldMap.r(ir) * dd4hep::mm, 0., m_fieldMap.z(iz) * dd4hep::mm};
+        double       fieldVector[3] = {0., 0., 0.};
+        field.magneticField(position, fieldVector);
+        m_fieldMap.set(ir, iz, fieldVector[0] / dd4hep::tesla, fieldVector[2] / dd4hep::tesla);
+      }
+    }
+    const double origin[3] = {0., 0., 0.};
+    info() << "Cached the magnetic field on a " << m_nR.value() << " x " << m_nZ.value() << " (r, z) grid, Bz at origin: "
+           << m_fieldMap.bz(origin) << " T" << endmsg;
+    return StatusCode::SUCCESS;
+  }
+
+  const RZFieldMap& fieldMap() const override { return m_fieldMap; }
+
+private:
+  Gaudi::Property<std::string> m_geoSvcName{this, "GeoSvcName", "GeoSvc", "The name of the geometry service"};
+  Gaudi::Property<double>      m_rMax{this, "rMax", 3000., "Radial extent of the field grid [mm]"};
+  Gaudi::Property<double>      m_zMax{this, "zMax", 4000., "Longitudinal half extent of the field grid [mm]"};
+  Gaudi::Property<int>         m_nR{this, "nR", 301, "Number of grid points in r"};
+  Gaudi::Property<int>         m_nZ{this, "nZ", 801, "Number of grid points in z"};
+
+  RZFieldMap m_fieldMap;
+};
+
+DECLARE_COMPONENT(FieldCacheSvc)
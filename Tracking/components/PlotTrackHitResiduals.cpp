@@ -9,32 +9,28 @@
 #include "edm4hep/TrackMCParticleLinkCollection.h"
 #include "edm4hep/SimTrackerHitCollection.h"
 
-// marlin
-#include <marlinutil/HelixClass_double.h>
-
 // ROOT
 #include "TH1D.h"
 
 // k4FWCore
 #include "k4FWCore/Consumer.h"
 
-#include "GAUDI_VERSION.h"
-
-#if GAUDI_MAJOR_VERSION < 39
-namespace Gaudi::Accumulators {
-  template <unsigned int ND, atomicity Atomicity = atomicity::full, typename Arithmetic = double>
-  using StaticHistogram =
-      Gaudi::Accumulators::HistogramingCounterBase<ND, Atomicity, Arithmetic, naming::histogramString,
-                                                   HistogramingAccumulator>;
-}
-#endif
-
+#include <algorithm>
 #include <string>
+#include <vector>
+
+#include "AlgorithmInstrumentation.h"
+#include "HelixMath.h"
+#include "SimTrackerHitParticleIndex.h"
 
 /** @class PlotTrackHitDistances
  *
  *  Gaudi consumer that generates a residual distribution (mm) by comparing the helix from Track AtIP and simHit position.
  *  This is intended to be used on tracks produced from gen particles i.e. which do not have real hits attached to them.
+ *  The hits are grouped by gen particle once per event, and the distances of each group are computed in one batch.
+ *  By default the distance is the one to the closest turn of the helix (HelixClass_double::getDistanceToPoint), which
+ *  combines transverse and longitudinal distances; with ClosestApproach3D it is the 3D distance to the point of closest
+ *  approach, found from an arc length cache of the helix built once per track (see HelixMath::ArcLengthCache).
  *
  *  @author Brieuc Francois
  */
@@ -49,43 +45,97 @@ struct PlotTrackHitDistances final
             KeyValues("InputTracksFromGenParticlesAssociation", {"TracksFromGenParticlesAssociation"}),
             }) {}
 
+  StatusCode initialize() override {
+    StatusCode sc = Consumer::initialize();
+    if (sc.isFailure())
+      return sc;
+    if (m_closestApproach3D && (m_arcLengthStep <= 0. || m_maxArcLength <= 0.)) {
+      error() << "ArcLengthStep and MaxArcLength must be positive" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    m_instrumentation.initialize(this);
+    return StatusCode::SUCCESS;
+  }
+
+  StatusCode finalize() override {
+    m_instrumentation.summary(info());
+    return Consumer::finalize();
+  }
+
   void operator()(const edm4hep::SimTrackerHitCollection& simTrackerHits, const edm4hep::TrackMCParticleLinkCollection& trackParticleAssociations) const override {
 
+    auto probe = m_instrumentation.event();
+    probe.hitsIn(simTrackerHits.size());
+
+    // Group the hits by gen particle, once per event
+    probe.enter(HitIndexing);
+    SimTrackerHitParticleIndex hitIndex;
+    hitIndex.build({&simTrackerHits});
+
+    // Histogram buffer, flushed to the shared histogram when going out of scope
+    auto residualHist = m_residualHist.buffer();
+
     for (const auto& trackParticleAssociation : trackParticleAssociations) {
+      probe.enter(Distances);
       auto genParticle = trackParticleAssociation.getTo();
+      const auto particleHits = hitIndex.hits(genParticle.getObjectID());
+      if (particleHits.empty())
+        continue;
+
       auto track = trackParticleAssociation.getFrom();
-      edm4hep::TrackState trackStateAtIP;
-      bool found_trackStateAtIP = false;
-      for (const auto& trackState : track.getTrackStates()) {
-        if (trackState.location == edm4hep::TrackState::AtIP) {
-          trackStateAtIP = trackState;
-          found_trackStateAtIP = true;
-          break;
-        }
-      }
-      if (!found_trackStateAtIP)
+      // The track state AtIP is the first one for tracks from gen particles, the search stops there
+      auto trackStates = track.getTrackStates();
+      auto trackStateAtIP = std::find_if(trackStates.begin(), trackStates.end(), [](const auto& trackState) {
+        return trackState.location == edm4hep::TrackState::AtIP;
+      });
+      if (trackStateAtIP == trackStates.end())
         throw std::runtime_error("No track state defined AtIP, exiting!");
 
       // Build an helix out of the trackState
-      auto helixFromTrack = HelixClass_double();
-      helixFromTrack.Initialize_Canonical(trackStateAtIP.phi, trackStateAtIP.D0, trackStateAtIP.Z0, trackStateAtIP.omega, trackStateAtIP.tanLambda, m_Bz);
-
-      // Fill the histogram with residuals for hits attached to the same gen particle
-      for (const auto& simTrackerHit : simTrackerHits) {
-        auto simTrackerHitgenParticle = simTrackerHit.getParticle();
-        if (simTrackerHitgenParticle.getObjectID() == genParticle.getObjectID()) {
-          double simTrackerHitPosition[] = {simTrackerHit.x(), simTrackerHit.y(), simTrackerHit.z()};
-          double distances[3];
-          helixFromTrack.getDistanceToPoint(simTrackerHitPosition, distances);
-          // Distance[0] - distance in R-Phi plane, Distance[1] - distance along Z axis, Distance[2] - 3D distance
-          ++m_residualHist[distances[2]];
-        }
+      const auto helixFromTrack = HelixMath::Helix::fromCanonical(trackStateAtIP->phi, trackStateAtIP->D0, trackStateAtIP->Z0, trackStateAtIP->omega, trackStateAtIP->tanLambda, m_Bz);
+
+      // Gather the positions of the hits attached to the same gen particle
+      m_hitX.clear();
+      m_hitY.clear();
+      m_hitZ.clear();
+      for (const auto& hitRef : particleHits) {
+        const auto simTrackerHit = simTrackerHits[hitRef.index];
+        m_hitX.push_back(simTrackerHit.x());
+        m_hitY.push_back(simTrackerHit.y());
+        m_hitZ.push_back(simTrackerHit.z());
+      }
+      m_distances.resize(particleHits.size());
+      if (m_closestApproach3D) {
+        // the helix is sampled forward from the point of closest approach to the origin
+        m_arcLengthCache.build(helixFromTrack, 0., m_maxArcLength, m_arcLengthStep);
+        m_arcLengthCache.distancesToPoints(m_hitX.size(), m_hitX.data(), m_hitY.data(), m_hitZ.data(), m_distances.data());
       }
+      else
+        HelixMath::distancesToPoints(helixFromTrack, m_hitX.size(), m_hitX.data(), m_hitY.data(), m_hitZ.data(), m_distances.data());
+
+      // Fill the histogram with the 3D residuals
+      probe.enter(HistogramFill);
+      probe.hitsOut(m_distances.size());
+      for (double distance : m_distances)
+        ++residualHist[distance];
     }
+    probe.leave();
+    if (probe.enabled())
+      probe.workingMemory(hitIndex.memory() + (m_hitX.capacity() + m_hitY.capacity() + m_hitZ.capacity() + m_distances.capacity()) * sizeof(double));
     return;
   }
+
   Gaudi::Property<float> m_Bz{this, "Bz", 2., "Z component of the (assumed constant) magnetic field in Tesla."};
+  Gaudi::Property<bool> m_closestApproach3D{this, "ClosestApproach3D", false, "Use the 3D distance to the point of closest approach instead of the distance to the closest turn of the helix"};
+  Gaudi::Property<double> m_arcLengthStep{this, "ArcLengthStep", 20., "Transverse arc length between the samples of the helix, small compared to its radius [mm]"};
+  Gaudi::Property<double> m_maxArcLength{this, "MaxArcLength", 3000., "Transverse arc length up to which the helix is sampled [mm]"};
   mutable Gaudi::Accumulators::StaticHistogram<1> m_residualHist{this, "track_hits_distance_closest_approach", "Track-hit Distances", {100, 0, 1, "Distance [mm];Entries"}};
+  /// Per thread buffers for the hit positions and distances of one gen particle, reused across tracks and events
+  inline static thread_local std::vector<double> m_hitX, m_hitY, m_hitZ, m_distances;
+  inline static thread_local HelixMath::ArcLengthCache m_arcLengthCache;
+  /// Per stage timing and throughput counters, the output hits are the filled distances
+  enum Stages { HitIndexing, Distances, HistogramFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"hit indexing", "distances", "histogram fill"}};
 
 };
 
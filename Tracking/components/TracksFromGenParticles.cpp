@@ -1,69 +1,237 @@
+#include "Gaudi/Accumulators.h"
 #include "Gaudi/Property.h"
+#include "GaudiKernel/ThreadLocalContext.h"
 
 // edm4hep
+#include "edm4hep/EventHeaderCollection.h"
 #include "edm4hep/MCParticleCollection.h"
 #include "edm4hep/TrackCollection.h"
 #include "edm4hep/TrackMCParticleLinkCollection.h"
 
-// marlin
-#include <marlinutil/HelixClass_double.h>
+#include "AlgorithmInstrumentation.h"
+#include "GenParticleFilter.h"
+#include "HelixMath.h"
+#include "IFieldCacheSvc.h"
+#include "TrackSmearing.h"
 
 // k4FWCore
 #include "k4FWCore/Transformer.h"
+#include "k4Interface/IUniqueIDGenSvc.h"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
 #include <string>
+#include <vector>
 
 /** @class TracksFromGenParticles
  *
  *  Gaudi transformer that builds an edm4hep::TrackCollection out of an edm4hep::MCParticleCollection.
  *  It just builds an helix out of the genParticle position, momentum, charge and user defined z component of the (constant) magnetic field.
+ *  If a FieldCacheSvc is given, the z component of the field at the origin is taken from its cached field map instead.
  *  From this helix, different edm4hep::TrackStates (AtIP, AtFirstHit, AtLastHit and AtCalorimeter) are defined. #FIXME for now these trackstates are dummy (copies of the same helix parameters)
  *  This is meant to enable technical development needing edm4hep::Track and performance studies where having generator based trackis is a reasonable approximation.
+ *  With Smearing, the helix parameters are smeared and the covariance of the track states is filled from a resolution
+ *  table in bins of (pT, |eta|) per particle type (see TrackSmearing.h): read from ResolutionTableFile, or computed at
+ *  initialize from the resolution parametrization properties. The random engine is seeded for each event by the
+ *  UniqueIDGenSvc, as in the digitizers, from the event header given as InputEventHeader, so that the output does not
+ *  depend on the threads nor on the job the event runs in. Without InputEventHeader, the seed is taken from the event
+ *  and run numbers of the event context: they count the events of the job, so the smearing of an event then changes
+ *  when the input is skipped or split across jobs. The association to the gen particles is kept.
+ *  The gen particles can be pre-selected on generator status, pT, |cos(theta)|, vertex radius and decay in the tracker
+ *  (see GenParticleFilter.h) before any helix is built; by default all the charged particles are kept.
  *  Possible inprovement:
- *    - Retrieve magnetic field from geometry: const DD4hep::Field::MagneticField& magneticField = detector.field(); DD4hep::DDRec::Vector3D field = magneticField.magneticField(point);
  *    - Properly define different trackStates
  *
  *  @author Brieuc Francois
  */
 
+using EventHeaderColl = std::vector<const edm4hep::EventHeaderCollection*>;
+
 struct TracksFromGenParticles final
-  : k4FWCore::MultiTransformer<std::tuple<edm4hep::TrackCollection, edm4hep::TrackMCParticleLinkCollection>(const edm4hep::MCParticleCollection&)> {
+  : k4FWCore::MultiTransformer<std::tuple<edm4hep::TrackCollection, edm4hep::TrackMCParticleLinkCollection>(const edm4hep::MCParticleCollection&, const EventHeaderColl&)> {
   TracksFromGenParticles(const std::string& name, ISvcLocator* svcLoc)
       : MultiTransformer(
             name, svcLoc,
-            {KeyValues("InputGenParticles", {"MCParticles"})},
+            {KeyValues("InputGenParticles", {"MCParticles"}),
+             KeyValues("InputEventHeader", {})},
             {KeyValues("OutputTracks", {"TracksFromGenParticles"}),
             KeyValues("OutputMCRecoTrackParticleAssociation", {"TracksFromGenParticlesAssociation"})}) {
   }
 
-std::tuple<edm4hep::TrackCollection, edm4hep::TrackMCParticleLinkCollection> operator()(const edm4hep::MCParticleCollection& genParticleColl) const override {
+  StatusCode initialize() override {
+    StatusCode sc = MultiTransformer::initialize();
+    if (sc.isFailure())
+      return sc;
+    m_fieldBz = m_Bz;
+    if (!m_fieldCacheSvcName.value().empty()) {
+      auto fieldCache = service<IFieldCacheSvc>(m_fieldCacheSvcName.value(), true);
+      if (!fieldCache) {
+        error() << "Unable to locate the field cache service " << m_fieldCacheSvcName.value() << endmsg;
+        return StatusCode::FAILURE;
+      }
+      const double origin[3] = {0., 0., 0.};
+      m_fieldBz = fieldCache->fieldMap().bz(origin);
+    }
+    debug() << "B field (T) is : " << m_fieldBz << endmsg;
+
+    if (m_minPt < 0. || m_maxAbsCosTheta < 0. || m_maxAbsCosTheta > 1.) {
+      error() << "MinPt must not be negative and MaxAbsCosTheta must be between 0 and 1" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    m_cuts = GenParticleFilter::Cuts{m_generatorStatus, m_minPt, m_maxAbsCosTheta, m_maxVertexRadius, m_rejectDecayedInTracker};
+
+    if (m_smearing) {
+      m_uidSvc = service<IUniqueIDGenSvc>(m_uidSvcName.value(), true);
+      if (!m_uidSvc) {
+        error() << "Unable to locate the UniqueIDGenSvc " << m_uidSvcName.value() << endmsg;
+        return StatusCode::FAILURE;
+      }
+      if (!m_resolutionTableFile.value().empty()) {
+        std::ifstream input(m_resolutionTableFile.value());
+        std::string   message;
+        if (!input) {
+          error() << "Unable to open the resolution table " << m_resolutionTableFile.value() << endmsg;
+          return StatusCode::FAILURE;
+        }
+        if (!m_resolutionTable.read(input, message)) {
+          error() << "Invalid resolution table " << m_resolutionTableFile.value() << ": " << message << endmsg;
+          return StatusCode::FAILURE;
+        }
+      } else {
+        for (const auto* ab : {&m_d0Resolution, &m_z0Resolution, &m_phiResolution, &m_tanLambdaResolution, &m_ptResolution}) {
+          if (ab->value().size() != 2) {
+            error() << ab->name() << " needs two values, a and b" << endmsg;
+            return StatusCode::FAILURE;
+          }
+        }
+        if (!TrackSmearing::ResolutionTable::validEdges(m_ptBinEdges) ||
+            !TrackSmearing::ResolutionTable::validEdges(m_absEtaBinEdges)) {
+          error() << "PtBinEdges and AbsEtaBinEdges need at least two increasing values" << endmsg;
+          return StatusCode::FAILURE;
+        }
+        TrackSmearing::Parametrization parametrization;
+        std::copy_n(m_d0Resolution.value().begin(), 2, parametrization.d0);
+        std::copy_n(m_z0Resolution.value().begin(), 2, parametrization.z0);
+        std::copy_n(m_phiResolution.value().begin(), 2, parametrization.phi0);
+        std::copy_n(m_tanLambdaResolution.value().begin(), 2, parametrization.tanLambda);
+        std::copy_n(m_ptResolution.value().begin(), 2, parametrization.pt);
+        // electrons, muons, pions, kaons, protons, and the other particles as pions
+        m_resolutionTable.fromParametrization(parametrization, m_ptBinEdges, m_absEtaBinEdges, {11, 13, 211, 321, 2212, 0},
+                                              {0.000511, 0.10566, 0.13957, 0.49368, 0.93827, 0.13957});
+      }
+      info() << "Smearing the tracks with a resolution table of " << m_resolutionTable.types().size() << " particle types, "
+             << m_resolutionTable.nPtBins() << " pT bins and " << m_resolutionTable.nEtaBins() << " |eta| bins" << endmsg;
+    }
+    m_instrumentation.initialize(this);
+    return StatusCode::SUCCESS;
+  }
+
+  StatusCode finalize() override {
+    m_instrumentation.summary(info());
+    return MultiTransformer::finalize();
+  }
+
+std::tuple<edm4hep::TrackCollection, edm4hep::TrackMCParticleLinkCollection> operator()(const edm4hep::MCParticleCollection& genParticleColl, const EventHeaderColl& headers) const override {
 
     auto outputTrackCollection = edm4hep::TrackCollection();
     auto MCRecoTrackParticleAssociationCollection = edm4hep::TrackMCParticleLinkCollection();
 
-    for (const auto& genParticle : genParticleColl) {
+    auto probe = m_instrumentation.event();
+    probe.hitsIn(genParticleColl.size());
+
+    // Gather the vertex, momentum and charge of the selected charged gen particles
+    probe.enter(ParticleSelection);
+    m_particleIndices.clear();
+    for (auto* v : {&m_x, &m_y, &m_z, &m_px, &m_py, &m_pz, &m_charge})
+      v->clear();
+    m_pdg.clear();
+    GenParticleFilter::Tally tally;
+    for (std::size_t iParticle = 0; iParticle < genParticleColl.size(); ++iParticle) {
+      const auto genParticle = genParticleColl[iParticle];
       debug() << "Particle decayed in tracker: " << genParticle.isDecayedInTracker() << endmsg;
       debug() << genParticle << endmsg;
 
-      // consider only charged particles
-      if(genParticle.getCharge() == 0) continue;
+      // consider only charged particles passing the pre-selection
+      if (tally.add(GenParticleFilter::select(m_cuts, genParticle)) != GenParticleFilter::Accepted) continue;
 
-      // Building an helix out of MCParticle properties and B field
-      auto helixFromGenParticle = HelixClass_double();
-      double genParticleVertex[] = {genParticle.getVertex().x, genParticle.getVertex().y, genParticle.getVertex().z};
-      double genParticleMomentum[] = {genParticle.getMomentum().x, genParticle.getMomentum().y, genParticle.getMomentum().z};
-      helixFromGenParticle.Initialize_VP(genParticleVertex, genParticleMomentum, genParticle.getCharge(), m_Bz);
+      m_particleIndices.push_back(iParticle);
+      m_x.push_back(genParticle.getVertex().x);
+      m_y.push_back(genParticle.getVertex().y);
+      m_z.push_back(genParticle.getVertex().z);
+      m_px.push_back(genParticle.getMomentum().x);
+      m_py.push_back(genParticle.getMomentum().y);
+      m_pz.push_back(genParticle.getMomentum().z);
+      m_charge.push_back(genParticle.getCharge());
+      m_pdg.push_back(genParticle.getPDG());
+    }
+    m_acceptedParticles += tally.accepted();
+    m_rejectedParticles += tally.rejected();
+    if (msgLevel(MSG::DEBUG)) {
+      for (int reason = GenParticleFilter::GeneratorStatus; reason < GenParticleFilter::NReasons; ++reason)
+        debug() << "Gen particles rejected by the " << GenParticleFilter::reasonName(GenParticleFilter::Reason(reason)) << " cut: " << tally.counts[reason] << endmsg;
+    }
+
+    // Building the helices out of MCParticle properties and B field, all at once
+    probe.enter(HelixBuilding);
+    const std::size_t nTracks = m_particleIndices.size();
+    HelixMath::fromPositionMomentum(nTracks, m_x.data(), m_y.data(), m_z.data(), m_px.data(), m_py.data(), m_pz.data(), m_charge.data(), m_fieldBz, m_helices);
+    for (auto* v : {&m_d0, &m_phi0, &m_omega, &m_z0, &m_tanLambda})
+      v->resize(nTracks);
+    HelixMath::canonicalParameters(m_helices, m_d0.data(), m_phi0.data(), m_omega.data(), m_z0.data(), m_tanLambda.data());
+
+    // Smearing of the helix parameters, -1 in m_entries for the particles without resolution
+    probe.enter(Smearing);
+    m_entries.assign(nTracks, -1);
+    if (m_smearing) {
+      if (!headers.empty()) {
+        m_engine.seed(m_uidSvc->getUniqueID(*headers.front(), name()));
+      } else {
+        const auto& context = Gaudi::Hive::currentContext();
+        m_engine.seed(m_uidSvc->getUniqueID(context.evt(), context.eventID().run_number(), name()));
+      }
+      std::normal_distribution<double> gauss;
+      for (std::size_t i = 0; i < nTracks; ++i) {
+        const double pt     = std::hypot(m_px[i], m_py[i]);
+        const double absEta = pt > 0. ? std::fabs(std::asinh(m_pz[i] / pt)) : 1.e9;
+        m_entries[i]        = m_resolutionTable.entry(m_pdg[i], pt, absEta);
+        if (m_entries[i] < 0)
+          continue;
+        double normals[TrackSmearing::s_nParameters], offsets[TrackSmearing::s_nParameters];
+        for (auto& normal : normals)
+          normal = gauss(m_engine);
+        m_resolutionTable.sample(m_entries[i], normals, offsets);
+        m_d0[i] += offsets[0];
+        m_phi0[i] = HelixMath::kernel::wrapTwoPi(m_phi0[i] + offsets[1]);
+        m_omega[i] *= 1. + offsets[2];
+        m_z0[i] += offsets[3];
+        m_tanLambda[i] += offsets[4];
+      }
+    }
+
+    probe.enter(OutputFill);
+    for (std::size_t i = 0; i < nTracks; ++i) {
+      const auto genParticle = genParticleColl[m_particleIndices[i]];
 
       // Setting the track and trackStates properties
       // #FIXME for now, the different trackStates are dummy
       auto trackFromGen = edm4hep::MutableTrack();
       auto trackState_IP = edm4hep::TrackState {};
       trackState_IP.location = edm4hep::TrackState::AtIP;
-      trackState_IP.D0 = helixFromGenParticle.getD0();
-      trackState_IP.phi = helixFromGenParticle.getPhi0();
-      trackState_IP.omega = helixFromGenParticle.getOmega();
-      trackState_IP.Z0 = helixFromGenParticle.getZ0();
-      trackState_IP.tanLambda = helixFromGenParticle.getTanLambda();
+      trackState_IP.D0 = m_d0[i];
+      trackState_IP.phi = m_phi0[i];
+      trackState_IP.omega = m_omega[i];
+      trackState_IP.Z0 = m_z0[i];
+      trackState_IP.tanLambda = m_tanLambda[i];
+      if (m_entries[i] >= 0) {
+        // the curvature is smeared in relative terms: its rows of the covariance scale with |omega|
+        const double* covariance = m_resolutionTable.covariance(m_entries[i]);
+        const double scale[TrackSmearing::s_nParameters] = {1., 1., std::fabs(m_omega[i]), 1., 1.};
+        for (int a = 0, ab = 0; a < TrackSmearing::s_nParameters; ++a)
+          for (int b = 0; b <= a; ++b, ++ab)
+            trackState_IP.covMatrix.setValue(covariance[ab] * scale[a] * scale[b], edm4hep::TrackParams(a), edm4hep::TrackParams(b));
+      }
       trackFromGen.addToTrackStates(trackState_IP);
       auto trackState_AtFirstHit = edm4hep::TrackState(trackState_IP);
       trackState_AtFirstHit.location = edm4hep::TrackState::AtFirstHit;
@@ -84,10 +252,60 @@ std::tuple<edm4hep::TrackCollection, edm4hep::TrackMCParticleLinkCollection> ope
       MCRecoTrackParticleAssociation.setTo(genParticle);
       MCRecoTrackParticleAssociationCollection.push_back(MCRecoTrackParticleAssociation);
     }
+    probe.leave();
+    probe.hitsOut(outputTrackCollection.size());
+    if (probe.enabled())
+      probe.workingMemory(bufferMemory());
     return std::make_tuple(std::move(outputTrackCollection), std::move(MCRecoTrackParticleAssociationCollection));
   }
 
   Gaudi::Property<float> m_Bz{this, "Bz", 2., "Z component of the (assumed constant) magnetic field in Tesla."};
+  Gaudi::Property<std::string> m_fieldCacheSvcName{this, "FieldCacheSvcName", "", "Name of the FieldCacheSvc to take the field from; if empty, Bz is used"};
+  /// Field used for the helices, either Bz or the cached field at the origin
+  double m_fieldBz = 0.;
+
+  Gaudi::Property<std::vector<int>> m_generatorStatus{this, "GeneratorStatus", {}, "Generator status codes of the gen particles to build tracks from; all if empty"};
+  Gaudi::Property<double> m_minPt{this, "MinPt", 0., "Minimum transverse momentum of the gen particles [GeV]"};
+  Gaudi::Property<double> m_maxAbsCosTheta{this, "MaxAbsCosTheta", 1., "Maximum |cos(theta)| of the gen particles"};
+  Gaudi::Property<double> m_maxVertexRadius{this, "MaxVertexRadius", -1., "Maximum transverse radius of the gen particle vertex [mm]; no cut if negative"};
+  Gaudi::Property<bool> m_rejectDecayedInTracker{this, "RejectDecayedInTracker", false, "Do not build tracks from gen particles that decayed in the tracker"};
+  GenParticleFilter::Cuts m_cuts;
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_acceptedParticles{this, "Accepted gen particles per event"};
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_rejectedParticles{this, "Rejected charged gen particles per event"};
+
+  // Without InputEventHeader, the seeds follow the events of the job: the smearing is only reproducible for the same input and job
+  Gaudi::Property<bool> m_smearing{this, "Smearing", false, "Smear the helix parameters and fill the covariance of the track states"};
+  Gaudi::Property<std::string> m_resolutionTableFile{this, "ResolutionTableFile", "", "Resolution table, see TrackSmearing.h; if empty, it is computed from the parametrization below"};
+  Gaudi::Property<std::vector<double>> m_ptBinEdges{this, "PtBinEdges", {0.1, 0.2, 0.5, 1., 2., 5., 10., 20., 50., 100., 200.}, "pT bin edges of the computed resolution table [GeV]"};
+  Gaudi::Property<std::vector<double>> m_absEtaBinEdges{this, "AbsEtaBinEdges", {0., 0.25, 0.5, 0.75, 1., 1.25, 1.5, 1.75, 2., 2.25, 2.5, 3.}, "|eta| bin edges of the computed resolution table"};
+  Gaudi::Property<std::vector<double>> m_d0Resolution{this, "D0Resolution", {0.003, 0.015}, "sigma(d0) = a (+) b / (p beta sin(theta)^3/2), {a [mm], b [mm GeV]}"};
+  Gaudi::Property<std::vector<double>> m_z0Resolution{this, "Z0Resolution", {0.004, 0.02}, "sigma(z0) = a (+) b / (p beta sin(theta)^5/2), {a [mm], b [mm GeV]}"};
+  Gaudi::Property<std::vector<double>> m_phiResolution{this, "PhiResolution", {2.e-5, 1.e-3}, "sigma(phi0) = a (+) b / (p beta sin(theta)^1/2), {a [rad], b [rad GeV]}"};
+  Gaudi::Property<std::vector<double>> m_tanLambdaResolution{this, "TanLambdaResolution", {2.e-5, 1.e-3}, "sigma(theta) = a (+) b / (p beta sin(theta)^1/2), {a [rad], b [rad GeV]}, sigma(tanLambda) = sigma(theta) / sin(theta)^2"};
+  Gaudi::Property<std::vector<double>> m_ptResolution{this, "PtResolution", {2.e-5, 1.e-3}, "sigma(pT) / pT = a pT (+) b / (beta sin(theta)^1/2), {a [1/GeV], b}"};
+  Gaudi::Property<std::string> m_uidSvcName{this, "uidSvcName", "uidSvc", "The name of the UniqueIDGenSvc instance, to seed the smearing for each event"};
+  SmartIF<IUniqueIDGenSvc> m_uidSvc;
+  TrackSmearing::ResolutionTable m_resolutionTable;
+
+  /// Per thread SoA buffers for the charged gen particles and their helices, reused across events
+  inline static thread_local std::vector<std::size_t> m_particleIndices;
+  inline static thread_local std::vector<double> m_x, m_y, m_z, m_px, m_py, m_pz, m_charge;
+  inline static thread_local std::vector<double> m_d0, m_phi0, m_omega, m_z0, m_tanLambda;
+  inline static thread_local std::vector<int> m_pdg, m_entries;
+  inline static thread_local std::mt19937_64 m_engine;
+  inline static thread_local HelixMath::HelixSoA m_helices;
+
+  /// Per stage timing and throughput counters, the input and output hits are the gen particles and the tracks
+  enum Stages { ParticleSelection, HelixBuilding, Smearing, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"particle selection", "helix building", "smearing", "output fill"}};
+  /// Allocated memory of the per thread SoA buffers, in bytes
+  static std::size_t bufferMemory() {
+    std::size_t bytes = m_particleIndices.capacity() * sizeof(std::size_t) +
+                        (m_pdg.capacity() + m_entries.capacity()) * sizeof(int);
+    for (const auto* v : {&m_x, &m_y, &m_z, &m_px, &m_py, &m_pz, &m_charge, &m_d0, &m_phi0, &m_omega, &m_z0, &m_tanLambda})
+      bytes += v->capacity() * sizeof(double);
+    return bytes;
+  }
 };
 
 DECLARE_COMPONENT(TracksFromGenParticles)
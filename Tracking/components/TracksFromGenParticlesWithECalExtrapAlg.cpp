@@ -7,12 +7,6 @@
 #include "edm4hep/TrackMCParticleLinkCollection.h"
 #include "edm4hep/SimTrackerHitCollection.h"
 
-// marlin
-#include <marlinutil/HelixClass_double.h>
-
-// pandora
-#include <Objects/Helix.h>
-
 // k4FWCore
 #include "k4FWCore/DataHandle.h"
 
@@ -20,30 +14,16 @@
 #include "Gaudi/Algorithm.h"
 #include "GaudiKernel/ToolHandle.h"
 
-// DD4HEP
-#include <DDRec/DetectorData.h>
-#include "DD4hep/Detector.h"
-#include "DD4hep/DD4hepUnits.h"
-#include "DD4hep/DetType.h"
-#include "DD4hep/DetectorSelector.h"
-
 // C++
+#include <memory>
 #include <string>
+#include <vector>
 
-/** @class TracksFromGenParticlesWithECalExtrapAlg
- *
- *  GaudiAlg version of TracksFromGenParticles, that builds an edm4hep::TrackCollection out of an edm4hep::MCParticleCollection.
- *  It just builds an helix out of the genParticle position, momentum, charge and z component of the (constant) magnetic field, retrieved from the detector.
- *  From this helix, different edm4hep::TrackStates (AtIP, AtFirstHit, AtLastHit) are defined.
- *  The first and last hits are defined as those with smallest and largest time in the input SimTrackerHit collections
- *  The algorithm also performs extrapolation to the EM calorimeter inner face is done using the positions of the barrel and endcap retrieved from the detector data extensions.
- *  This is meant to enable technical development needing edm4hep::Track and performance studies where having generator based tracks is a reasonable approximation.
- *  @author Brieuc Francois
- *  @author Archil Durglishvili
- *  @author Giovanni Marchiori
- */
+#include "AlgorithmInstrumentation.h"
+#include "GenParticleTrackBuilder.h"
+#include "SimTrackerHitParticleIndex.h"
 
-class TracksFromGenParticlesWithECalExtrapAlg : public Gaudi::Algorithm {
+/** @class TracksFromGenParticlesWithECalExtrapAlg : public Gaudi::Algorithm {
 
   public:
     TracksFromGenParticlesWithECalExtrapAlg(const std::string& name, ISvcLocator* svcLoc);
@@ -57,68 +37,29 @@ class TracksFromGenParticlesWithECalExtrapAlg : public Gaudi::Algorithm {
     /// List of input sim tracker hit collections
     Gaudi::Property<std::vector<std::string>> m_inputSimTrackerHitCollections{this, "InputSimTrackerHits", {}, "Names of SimTrackerHit collections to read"};
     /// the vector of input DataHandles for the tracker hit collections
-    std::vector<DataObjectHandleBase*> m_inputSimTrackerHitCollectionHandles;
-    /// Solenoid magnetic field, to be retrieved from detector
-    float m_Bz;
-    /// ECAL barrel and endcap extent
-    float m_eCalBarrelInnerR;
-    float m_eCalBarrelMaxZ;
-    float m_eCalEndCapInnerR;
-    float m_eCalEndCapOuterR;
-    float m_eCalEndCapInnerZ;
-    float m_eCalEndCapOuterZ;
+    std::vector<std::unique_ptr<DataHandle<edm4hep::SimTrackerHitCollection>>> m_inputSimTrackerHitCollectionHandles;
+    /// Per thread buffer of the input tracker hit collections of the current event
+    inline static thread_local std::vector<const edm4hep::SimTrackerHitCollection*> m_simTrackerHitCollections;
+    /// Per thread buffers reused across events: the selected gen particles and the slots of their track states
+    inline static thread_local std::vector<std::size_t> m_particleIndices;
+    inline static thread_local std::vector<std::vector<edm4hep::TrackState>> m_trackStates;
+    /// Field, extrapolation and pre-selection properties, and the track states of each gen particle
+    GenParticleTrackBuilder m_trackBuilder{this};
     /// Handle for the output track collection
     mutable DataHandle<edm4hep::TrackCollection> m_tracks{"TracksFromGenParticlesAlg", Gaudi::DataHandle::Writer, this};
     /// Handle for the output links between reco and gen particles
     mutable DataHandle<edm4hep::TrackMCParticleLinkCollection> m_links{"TracksFromGenParticlesAlgAssociation", Gaudi::DataHandle::Writer, this};
 
-    // the next two functions have been copied from k4GaudiPandora and DDMarlinPandora / DDPandoraPFANewProcessor
-    // ideally they could be put in a separate file named e.g. DDUtils.cc
-    double getFieldFromCompact();
-    dd4hep::rec::LayeredCalorimeterData * getExtension(unsigned int includeFlag, unsigned int excludeFlag=0);
+    /// Per stage timing and throughput counters, the input hits are the SimTrackerHits and the output hits the tracks
+    enum Stages { ParticleSelection, HitIndexing, TrackStates, OutputFill };
+    AlgorithmInstrumentation m_instrumentation{this, {"particle selection", "hit indexing", "track states", "output fill"}};
 };
 
-double TracksFromGenParticlesWithECalExtrapAlg::getFieldFromCompact() {
-  dd4hep::Detector& mainDetector = dd4hep::Detector::getInstance();
-  const double position[3]={0,0,0}; // position to calculate magnetic field at (the origin in this case)
-  double magneticFieldVector[3]={0,0,0}; // initialise object to hold magnetic field
-  mainDetector.field().magneticField(position,magneticFieldVector); // get the magnetic field vector from DD4hep
-  return magneticFieldVector[2]/dd4hep::tesla; // z component at (0,0,0)
-}
-
-dd4hep::rec::LayeredCalorimeterData * TracksFromGenParticlesWithECalExtrapAlg::getExtension(unsigned int includeFlag, unsigned int excludeFlag) {
-
-  dd4hep::rec::LayeredCalorimeterData * theExtension = 0;
-
-  dd4hep::Detector & mainDetector = dd4hep::Detector::getInstance();
-  const std::vector< dd4hep::DetElement>& theDetectors = dd4hep::DetectorSelector(mainDetector).detectors(  includeFlag, excludeFlag );
-
-  debug() << " getExtension :  includeFlag: " << dd4hep::DetType( includeFlag ) << " excludeFlag: " << dd4hep::DetType( excludeFlag )
-          << "  found : " << theDetectors.size() << "  - first det: " << theDetectors.at(0).name()
-          << endmsg;
-
-  if( theDetectors.size()  != 1 ){
-
-    std::stringstream es ;
-    es << " getExtension: selection is not unique (or empty)  includeFlag: " << dd4hep::DetType( includeFlag ) << " excludeFlag: " << dd4hep::DetType( excludeFlag )
-       << " --- found detectors : " ;
-    for( unsigned i=0, N= theDetectors.size(); i<N ; ++i ){
-      es << theDetectors.at(i).name() << ", " ;
-    }
-    throw std::runtime_error( es.str() ) ;
-  }
-
-  theExtension = theDetectors.at(0).extension<dd4hep::rec::LayeredCalorimeterData>();
-
-  return theExtension;
-}
-
 TracksFromGenParticlesWithECalExtrapAlg::TracksFromGenParticlesWithECalExtrapAlg(const std::string& name, ISvcLocator* svcLoc) :
 Gaudi::Algorithm(name, svcLoc) {
   declareProperty("InputGenParticles", m_inputMCParticles, "input MCParticles");
   declareProperty("OutputTracks", m_tracks, "Output tracks");
   declareProperty("OutputMCRecoTrackParticleAssociation", m_links, "MCRecoTrackParticleAssociation");
-  m_Bz = 0.;
 }
 
 StatusCode TracksFromGenParticlesWithECalExtrapAlg::initialize() {
@@ -128,51 +69,13 @@ StatusCode TracksFromGenParticlesWithECalExtrapAlg::initialize() {
   // FIXME: handle exceptions if collections not found
   for ( const auto& col : m_inputSimTrackerHitCollections ) {
     debug() << "Creating handle for input SimTrackerHit collection : " << col << endmsg;
-    m_inputSimTrackerHitCollectionHandles.push_back(new DataHandle<edm4hep::SimTrackerHitCollection>(col, Gaudi::DataHandle::Reader, this));
-  }
-
-  // retrieve B field
-  m_Bz = getFieldFromCompact();
-  debug() << "B field (T) is : " << m_Bz << endmsg;
-
-  // retrieve tracker dimensions
-  //const dd4hep::rec::LayeredCalorimeterData * wrapperBarrelExtension = getExtension( ( dd4hep::DetType::TRACKER | dd4hep::DetType::BARREL ) , dd4hep::DetType::VERTEX );
-  //const dd4hep::rec::LayeredCalorimeterData * wrapperEndcapExtension = getExtension( ( dd4hep::DetType::TRACKER | dd4hep::DetType::ENDCAP ), dd4hep::DetType::VERTEX );
-  //const dd4hep::rec::LayeredCalorimeterData * vertexBarrelExtension = getExtension( ( dd4hep::DetType::TRACKER | dd4hep::DetType::BARREL | dd4hep::DetType::VERTEX ) );
-  //const dd4hep::rec::LayeredCalorimeterData * vertexEndcapExtension = getExtension( ( dd4hep::DetType::TRACKER | dd4hep::DetType::ENDCAP | dd4hep::DetType::VERTEX ) );
-
-  // retrieve ecal dimensions:
-  // - barrel: inner R, zmax
-  // - endcap: inner R, zmin, zmax
-  try {
-    const dd4hep::rec::LayeredCalorimeterData * eCalBarrelExtension = getExtension( ( dd4hep::DetType::CALORIMETER | dd4hep::DetType::ELECTROMAGNETIC | dd4hep::DetType::BARREL),
-                                                                                    ( dd4hep::DetType::AUXILIARY  |  dd4hep::DetType::FORWARD ) );
-    m_eCalBarrelInnerR = eCalBarrelExtension->extent[0] / dd4hep::mm;
-    m_eCalBarrelMaxZ = eCalBarrelExtension->extent[3] / dd4hep::mm;
-    debug() << "ECAL barrel extent: Rmin [mm] = " << m_eCalBarrelInnerR << endmsg;
-    debug() << "ECAL barrel extent: Zmax [mm] = " << m_eCalBarrelMaxZ << endmsg;
+    m_inputSimTrackerHitCollectionHandles.push_back(std::make_unique<DataHandle<edm4hep::SimTrackerHitCollection>>(col, Gaudi::DataHandle::Reader, this));
   }
-  catch(...) {
-    warning() << "ECAL barrel extension not found" << endmsg;
-    m_eCalBarrelInnerR = 0.; // set to 0, will use it later to avoid projecting to the barrel
-  };
 
-  try {
-    const dd4hep::rec::LayeredCalorimeterData * eCalEndCapExtension = getExtension( ( dd4hep::DetType::CALORIMETER | dd4hep::DetType::ELECTROMAGNETIC | dd4hep::DetType::ENDCAP),
-                                                                                    ( dd4hep::DetType::AUXILIARY  |  dd4hep::DetType::FORWARD ) );
-    m_eCalEndCapInnerR = eCalEndCapExtension->extent[0] / dd4hep::mm;
-    m_eCalEndCapOuterR = eCalEndCapExtension->extent[1] / dd4hep::mm;
-    m_eCalEndCapInnerZ = eCalEndCapExtension->extent[2] / dd4hep::mm;
-    m_eCalEndCapOuterZ = eCalEndCapExtension->extent[3] / dd4hep::mm;
-    debug() << "ECAL endcap extent: Rmin [mm] = " << m_eCalEndCapInnerR << endmsg;
-    debug() << "ECAL endcap extent: Rmax [mm] = " << m_eCalEndCapOuterR << endmsg;
-    debug() << "ECAL endcap extent: Zmin [mm] = " << m_eCalEndCapInnerZ << endmsg;
-    debug() << "ECAL endcap extent: Zmax [mm] = " << m_eCalEndCapOuterZ << endmsg;
-  }
-  catch(...) {
-    warning() << "ECAL endcap extension not found" << endmsg;
-    m_eCalEndCapInnerR = 0.; // set to 0, will use it later to avoid projecting to the endcap
-  };
+  // field, pre-selection and calorimeter surfaces
+  sc = m_trackBuilder.initialize(*this);
+  if (sc.isFailure()) return sc;
+  m_instrumentation.initialize(this);
   return StatusCode::SUCCESS;
 }
 
@@ -184,181 +87,50 @@ StatusCode TracksFromGenParticlesWithECalExtrapAlg::execute(const EventContext&)
   auto outputTrackCollection = new edm4hep::TrackCollection();
   auto MCRecoTrackParticleAssociationCollection = new edm4hep::TrackMCParticleLinkCollection();
 
-  // loop over the gen particles, find charged ones, and create the corresponding reco particles
-  int iparticle = 0;
-  for (const auto& genParticle : *genParticleColl) {
-    debug() << endmsg;
-    debug() << "Gen. particle: " << genParticle << endmsg;
-    debug() <<"  particle "<<iparticle++<<"  PDG: "<< genParticle.getPDG()  << " energy: "<<genParticle.getEnergy()
-            << " charge: "<< genParticle.getCharge() << endmsg;
-    debug() << "Particle decayed in tracker: " << genParticle.isDecayedInTracker() << endmsg;
-
-    // consider only charged particles
-    if (genParticle.getCharge() == 0) continue;
-
-    // Building an helix out of MCParticle properties and B field
-    auto helixFromGenParticle = HelixClass_double();
-    auto vertex = genParticle.getVertex();
-    auto endpoint = genParticle.getEndpoint();
-    debug() << "Vertex radius: " << sqrt(vertex.x*vertex.x+vertex.y*vertex.y) << endmsg;
-    debug() << "Endpoint radius: " << sqrt(endpoint.x*endpoint.x+endpoint.y*endpoint.y) << endmsg;
-    double genParticleVertex[] = {vertex.x, vertex.y, vertex.z};
-    double genParticleMomentum[] = {genParticle.getMomentum().x, genParticle.getMomentum().y, genParticle.getMomentum().z};
-    helixFromGenParticle.Initialize_VP(genParticleVertex, genParticleMomentum, genParticle.getCharge(), m_Bz);
-
-    // Setting the track and trackStates at IP properties
-    auto trackFromGen = edm4hep::MutableTrack();
-    auto trackState_IP = edm4hep::TrackState {};
-    trackState_IP.location = edm4hep::TrackState::AtIP;
-    trackState_IP.D0 = helixFromGenParticle.getD0();
-    trackState_IP.phi = helixFromGenParticle.getPhi0();
-    trackState_IP.omega = helixFromGenParticle.getOmega();
-    trackState_IP.Z0 = helixFromGenParticle.getZ0();
-    trackState_IP.tanLambda = helixFromGenParticle.getTanLambda();
-    trackState_IP.referencePoint = edm4hep::Vector3f((float)genParticleVertex[0],(float)genParticleVertex[1],(float)genParticleVertex[2]);
-    trackFromGen.addToTrackStates(trackState_IP);
-
-    // find SimTrackerHits associated to genParticle, store hit position, momentum and time
-    std::vector<std::array<double,7> > trackHits;
-    for ( size_t ih=0; ih<m_inputSimTrackerHitCollectionHandles.size(); ih++ ) {
-      auto handle = dynamic_cast<DataHandle<edm4hep::SimTrackerHitCollection>*> (m_inputSimTrackerHitCollectionHandles[ih]);
-      const edm4hep::SimTrackerHitCollection* coll = handle->get();
-      for (const auto& hit : *coll) {
-        const edm4hep::MCParticle particle = hit.getParticle();
-        std::array<double,7> ahit{hit.x(), hit.y(), hit.z(), hit.getMomentum()[0], hit.getMomentum()[1], hit.getMomentum()[2], hit.getTime()};
-        if(particle.getObjectID() == genParticle.getObjectID()) trackHits.push_back(ahit);
-      }
-    }
-  
-    if(!trackHits.empty())
-    {
-      // particles with at least one SimTrackerHit
-      debug() << "Number of SimTrackerHits: " << trackHits.size() << endmsg;
-
-      // sort the hits according to their time
-      std::sort(trackHits.begin(), trackHits.end(), [](const std::array<double,7> a, const std::array<double,7> b) {
-        return a[6]<b[6];
-      });
-
-      // TrackState at First Hit
-      auto trackState_AtFirstHit = edm4hep::TrackState {};
-      auto firstHit = trackHits.front();
-      double posAtFirstHit[] = {firstHit[0], firstHit[1], firstHit[2]};
-      double momAtFirstHit[] = {firstHit[3], firstHit[4], firstHit[5]};
-      debug() << "Radius of first hit: " << std::sqrt(firstHit[0]*firstHit[0] + firstHit[1]*firstHit[1]) << endmsg;
-      // get extrapolated momentum from the helix with ref point at IP
-      helixFromGenParticle.getExtrapolatedMomentum(posAtFirstHit,momAtFirstHit);
-      // produce new helix at first hit position
-      auto helixAtFirstHit = HelixClass_double();
-      helixAtFirstHit.Initialize_VP(posAtFirstHit, momAtFirstHit, genParticle.getCharge(), m_Bz);
-      // fill the TrackState parameters
-      trackState_AtFirstHit.location = edm4hep::TrackState::AtFirstHit;
-      trackState_AtFirstHit.D0 = helixAtFirstHit.getD0();
-      trackState_AtFirstHit.phi = helixAtFirstHit.getPhi0();
-      trackState_AtFirstHit.omega = helixAtFirstHit.getOmega();
-      trackState_AtFirstHit.Z0 = helixAtFirstHit.getZ0();
-      trackState_AtFirstHit.tanLambda = helixAtFirstHit.getTanLambda();
-      trackState_AtFirstHit.referencePoint = edm4hep::Vector3f((float)posAtFirstHit[0],(float)posAtFirstHit[1],(float)posAtFirstHit[2]);
-      trackFromGen.addToTrackStates(trackState_AtFirstHit);
-
-      // TrackState at Last Hit
-      auto trackState_AtLastHit = edm4hep::TrackState{};
-      auto lastHit = trackHits.back();
-      double posAtLastHit[] = {lastHit[0], lastHit[1], lastHit[2]};
-      double momAtLastHit[] = {lastHit[3], lastHit[4], lastHit[5]};
-      debug() << "Radius of last hit: " << std::sqrt(lastHit[0]*lastHit[0] + lastHit[1]*lastHit[1]) << endmsg;
-      // get extrapolated momentum from the helix with ref point at first hit
-      helixAtFirstHit.getExtrapolatedMomentum(posAtLastHit, momAtLastHit);
-      // produce new helix at last hit position
-      auto helixAtLastHit = HelixClass_double();
-      helixAtLastHit.Initialize_VP(posAtLastHit, momAtLastHit, genParticle.getCharge(), m_Bz);
-      // fill the TrackState parameters
-      trackState_AtLastHit.location = edm4hep::TrackState::AtLastHit;
-      trackState_AtLastHit.D0 = helixAtLastHit.getD0();
-      trackState_AtLastHit.phi = helixAtLastHit.getPhi0();
-      trackState_AtLastHit.omega = helixAtLastHit.getOmega();
-      trackState_AtLastHit.Z0 = helixAtLastHit.getZ0();
-      trackState_AtLastHit.tanLambda = helixAtLastHit.getTanLambda();
-      trackState_AtLastHit.referencePoint = edm4hep::Vector3f((float)posAtLastHit[0], 
-                                                              (float)posAtLastHit[1],
-                                                              (float)posAtLastHit[2]);
-      // attach the TrackState to the track
-      trackFromGen.addToTrackStates(trackState_AtLastHit);
-
-      // TrackState at Calorimeter
-      if (m_eCalBarrelInnerR>0. || m_eCalEndCapInnerR>0.) {
-        auto trackState_AtCalorimeter = edm4hep::TrackState{};
-        pandora::CartesianVector bestECalProjection(0.f, 0.f, 0.f);
-
-        // create helix to project
-        const pandora::Helix helix(trackState_IP.phi,
-                                   trackState_IP.D0,
-                                   trackState_IP.Z0,
-                                   trackState_IP.omega,
-                                   trackState_IP.tanLambda,
-                                   m_Bz);
-        const pandora::CartesianVector& referencePoint(helix.GetReferencePoint());
-        const int signPz((helix.GetMomentum().GetZ() > 0.f) ? 1 : -1);
-        
-        // First project to endcap
-        float minGenericTime(std::numeric_limits<float>::max());
-        if (m_eCalEndCapInnerR>0) {          
-          (void)helix.GetPointInZ(static_cast<float>(signPz) * m_eCalEndCapInnerZ, referencePoint,
-                                  bestECalProjection, minGenericTime);
-          // GM: if the radius of the point on the plane corresponding to the endcap inner face is
-          // lower than the inner radius of the calorimeter, we might want to ignore it
-          // for the moment let's keep it as it might be useful for debugging the reconstruction
-        }
-
-        // Then project to barrel surface(s), and keep projection with lower arrival time
-        if (m_eCalBarrelInnerR>0) {
-          pandora::CartesianVector barrelProjection(0.f, 0.f, 0.f);
-          float genericTime(std::numeric_limits<float>::max());
-          const pandora::StatusCode statusCode(helix.GetPointOnCircle(m_eCalBarrelInnerR, referencePoint, barrelProjection, genericTime));
-          if ((pandora::STATUS_CODE_SUCCESS == statusCode) && (genericTime < minGenericTime)) {
-            minGenericTime = genericTime;
-            bestECalProjection = barrelProjection;
-          }
-          // GM: again, if the Z of the point on the cylinder of the barrel is beyond the
-          // max/min z of the detector, we might want to ignore it - but let's keep it
-          // for the moment as it might be useful for debugging the reconstruction
-        }
-
-        // get extrapolated position
-        double posAtCalorimeter[] = {bestECalProjection.GetX(), bestECalProjection.GetY(), bestECalProjection.GetZ()};
-        debug() << "Radius at calorimeter: " << std::sqrt(posAtCalorimeter[0]*posAtCalorimeter[0] + posAtCalorimeter[1]*posAtCalorimeter[1]) << endmsg;
-        
-        // get extrapolated momentum from the helix with ref point at last hit
-        double momAtCalorimeter[] = {0.,0.,0.};
-        helixAtLastHit.getExtrapolatedMomentum(posAtCalorimeter, momAtCalorimeter);
-        
-        // produce new helix at calorimeter position
-        auto helixAtCalorimeter = HelixClass_double();
-        helixAtCalorimeter.Initialize_VP(posAtCalorimeter, momAtCalorimeter, genParticle.getCharge(), m_Bz);
-        
-        // fill the TrackState parameters
-        trackState_AtCalorimeter.location = edm4hep::TrackState::AtCalorimeter;
-        trackState_AtCalorimeter.D0 = helixAtCalorimeter.getD0();
-        trackState_AtCalorimeter.phi = helixAtCalorimeter.getPhi0();
-        trackState_AtCalorimeter.omega = helixAtCalorimeter.getOmega();
-        trackState_AtCalorimeter.Z0 = helixAtCalorimeter.getZ0();
-        trackState_AtCalorimeter.tanLambda = helixAtCalorimeter.getTanLambda();
-        trackState_AtCalorimeter.referencePoint = edm4hep::Vector3f((float)posAtCalorimeter[0],
-                                                                    (float)posAtCalorimeter[1],
-                                                                    (float)posAtCalorimeter[2]);
-        // attach the TrackState to the track
-        trackFromGen.addToTrackStates(trackState_AtCalorimeter);
-      }
-
-
-      outputTrackCollection->push_back(trackFromGen);
-
-      // Building the association between tracks and genParticles
-      auto MCRecoTrackParticleAssociation = edm4hep::MutableTrackMCParticleLink();
-      MCRecoTrackParticleAssociation.setFrom(trackFromGen);
-      MCRecoTrackParticleAssociation.setTo(genParticle);
-      MCRecoTrackParticleAssociationCollection->push_back(MCRecoTrackParticleAssociation);
-    }
+  // resolve the input collections
+  auto& simTrackerHitCollVec = m_simTrackerHitCollections;
+  simTrackerHitCollVec.clear();
+  for (const auto& handle : m_inputSimTrackerHitCollectionHandles)
+    simTrackerHitCollVec.push_back(handle->get());
+  auto probe = m_instrumentation.event();
+  if (probe.enabled())
+    for (const auto* simTrackerHits : simTrackerHitCollVec)
+      probe.hitsIn(simTrackerHits->size());
+
+  // loop over the gen particles, find charged ones passing the pre-selection
+  probe.enter(ParticleSelection);
+  m_trackBuilder.selectParticles(*this, *genParticleColl, m_particleIndices);
+
+  // group the SimTrackerHits by gen particle, once per event and only if a particle needs them
+  probe.enter(HitIndexing);
+  SimTrackerHitParticleIndex hitIndex;
+  if (!m_particleIndices.empty())
+    hitIndex.build(simTrackerHitCollVec);
+
+  // build the track states of each selected particle in its own slot
+  probe.enter(TrackStates);
+  const std::size_t nParticles = m_particleIndices.size();
+  if (m_trackStates.size() < nParticles)
+    m_trackStates.resize(nParticles);
+  std::vector<GenParticleTrackBuilder::TrackHit> trackHits;
+  std::vector<CalorimeterSurfaces::Intersection> intersections;
+  MsgStream* log = msgLevel(MSG::DEBUG) ? &debug() : nullptr;
+  for (std::size_t i = 0; i < nParticles; ++i)
+    m_trackBuilder.buildTrackStates((*genParticleColl)[m_particleIndices[i]], hitIndex, simTrackerHitCollVec, log, m_trackStates[i], trackHits, intersections);
+
+  // create the tracks, for the particles with at least one SimTrackerHit, and their links
+  probe.enter(OutputFill);
+  GenParticleTrackBuilder::fillTracks(*genParticleColl, m_particleIndices, m_trackStates, *outputTrackCollection, *MCRecoTrackParticleAssociationCollection);
+
+  probe.leave();
+  probe.hitsOut(outputTrackCollection->size());
+  if (probe.enabled()) {
+    std::size_t bytes = hitIndex.memory() + simTrackerHitCollVec.capacity() * sizeof(simTrackerHitCollVec[0]) +
+                        m_particleIndices.capacity() * sizeof(std::size_t) +
+                        m_trackStates.capacity() * sizeof(std::vector<edm4hep::TrackState>);
+    for (const auto& states : m_trackStates)
+      bytes += states.capacity() * sizeof(edm4hep::TrackState);
+    probe.workingMemory(bytes);
   }
 
   // push the outputTrackCollection to event store
@@ -370,7 +142,10 @@ StatusCode TracksFromGenParticlesWithECalExtrapAlg::execute(const EventContext&)
   return StatusCode::SUCCESS;
 }
 
-StatusCode TracksFromGenParticlesWithECalExtrapAlg::finalize() { return Gaudi::Algorithm::finalize(); }
+StatusCode TracksFromGenParticlesWithECalExtrapAlg::finalize() {
+  m_instrumentation.summary(info());
+  return Gaudi::Algorithm::finalize();
+}
 
 
 DECLARE_COMPONENT(TracksFromGenParticlesWithECalExtrapAlg)
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "HelixMath.h"
+
+// DD4HEP
+#include "DD4hep/DD4hepUnits.h"
+#include "DDRec/DetectorData.h"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/** @class CalorimeterSurfaces
+ *
+ *  Extrapolation targets built once from dd4hep::rec::LayeredCalorimeterData extensions: cylinders (barrel layouts)
+ *  and pairs of z planes (endcap layouts), either the inner face of each calorimeter or the inner face of each layer.
+ *  The surfaces of each calorimeter are kept sorted, so that for a given helix the crossed surfaces are found by
+ *  walking them in increasing path length and stopping at the first one out of the calorimeter acceptance. The cost
+ *  per track is then logarithmic in the number of surfaces, plus the number of crossed surfaces.
+ *
+ */
+
+class CalorimeterSurfaces {
+public:
+  /// Crossing of a surface by a helix
+  struct Intersection {
+    double   position[3];
+    /// transverse arc length from the helix reference point
+    double   pathLength;
+    /// calorimeter index (in order of addition) and surface index within the calorimeter
+    uint32_t calorimeter;
+    uint32_t surface;
+  };
+
+  /// Add the surfaces of a calorimeter, lengths are converted to mm. Conical layouts are not supported.
+  bool addCalorimeter(const std::string& name, const dd4hep::rec::LayeredCalorimeterData& data, bool allLayers) {
+    Calorimeter calo;
+    calo.name   = name;
+    calo.barrel = data.layoutType == dd4hep::rec::LayeredCalorimeterData::BarrelLayout;
+    if (!calo.barrel && data.layoutType != dd4hep::rec::LayeredCalorimeterData::EndcapLayout)
+      return false;
+    calo.rMin = data.extent[0] / dd4hep::mm;
+    calo.rMax = data.extent[1] / dd4hep::mm;
+    calo.zMin = data.extent[2] / dd4hep::mm;
+    calo.zMax = data.extent[3] / dd4hep::mm;
+    // layer distance: radius of the layer inner face (barrel) or z of the layer inner face (endcap)
+    if (allLayers) {
+      for (const auto& layer : data.layers)
+        calo.positions.push_back(layer.distance / dd4hep::mm);
+    }
+    if (calo.positions.empty())
+      calo.positions.push_back(calo.barrel ? calo.rMin : calo.zMin);
+    std::sort(calo.positions.begin(), calo.positions.end());
+    m_calorimeters.push_back(std::move(calo));
+    return true;
+  }
+
+  std::size_t nCalorimeters() const { return m_calorimeters.size(); }
+  const std::string& name(std::size_t calorimeter) const { return m_calorimeters[calorimeter].name; }
+  std::size_t nSurfaces(std::size_t calorimeter) const { return m_calorimeters[calorimeter].positions.size(); }
+
+  /// Append the forward crossings of the helix with all the surfaces, inside the calorimeter acceptances, sorted by path length
+  void intersect(const HelixMath::Helix& helix, std::vector<Intersection>& intersections) const {
+    const std::size_t first = intersections.size();
+    for (uint32_t iCalo = 0; iCalo < m_calorimeters.size(); ++iCalo) {
+      const auto& calo = m_calorimeters[iCalo];
+      if (calo.barrel)
+        intersectBarrel(helix, calo, iCalo, intersections);
+      else
+        intersectEndcap(helix, calo, iCalo, intersections);
+    }
+    std::sort(intersections.begin() + first, intersections.end(),
+              [](const Intersection& a, const Intersection& b) { return a.pathLength < b.pathLength; });
+  }
+
+private:
+  struct Calorimeter {
+    std::string         name;
+    bool                barrel;
+    double              rMin, rMax, zMin, zMax;
+    /// sorted radii (barrel) or |z| (endcap) of the surfaces
+    std::vector<double> positions;
+  };
+
+  /// Cylinders: the path length grows with the radius along the outgoing branch, stop when the helix no longer reaches
+  /// the cylinder or leaves the barrel in z
+  static void intersectBarrel(const HelixMath::Helix& helix, const Calorimeter& calo, uint32_t iCalo,
+                              std::vector<Intersection>& intersections) {
+    const double rReach = std::hypot(helix.xCentre, helix.yCentre) + helix.radius;
+    const double rStart = std::hypot(helix.refX, helix.refY);
+    auto         begin  = std::upper_bound(calo.positions.begin(), calo.positions.end(), rStart);
+    auto         end    = std::upper_bound(begin, calo.positions.end(), rReach);
+    for (auto it = begin; it != end; ++it) {
+      Intersection intersection{{0., 0., 0.}, 0., iCalo, static_cast<uint32_t>(it - calo.positions.begin())};
+      if (!helix.intersectCylinder(*it, intersection.position, intersection.pathLength) ||
+          std::fabs(intersection.position[2]) > calo.zMax)
+        break;
+      intersections.push_back(intersection);
+    }
+  }
+
+  /// Planes: the path length grows with |z| on the side the helix moves to, only the planes crossed between entering
+  /// the calorimeter radially (rMin) and leaving it (rMax) are considered
+  static void intersectEndcap(const HelixMath::Helix& helix, const Calorimeter& calo, uint32_t iCalo,
+                              std::vector<Intersection>& intersections) {
+    if (std::fabs(helix.tanLambda) < 1.0e-20)
+      return;
+    const double side = helix.tanLambda > 0. ? 1. : -1.;
+    double       point[3];
+    // path length range inside the radial acceptance, as seen from the reference point
+    double sEntry = 0.;
+    if (std::hypot(helix.refX, helix.refY) < calo.rMin && !helix.intersectCylinder(calo.rMin, point, sEntry))
+      return;
+    double sExit = std::numeric_limits<double>::max();
+    if (!helix.intersectCylinder(calo.rMax, point, sExit))
+      sExit = std::numeric_limits<double>::max();
+    // corresponding range of |z|
+    const double zEntry = side * (helix.refZ + sEntry * helix.tanLambda);
+    auto         begin  = std::lower_bound(calo.positions.begin(), calo.positions.end(), zEntry);
+    for (auto it = begin; it != calo.positions.end(); ++it) {
+      Intersection intersection{{0., 0., 0.}, 0., iCalo, static_cast<uint32_t>(it - calo.positions.begin())};
+      helix.intersectZPlane(side * *it, intersection.position, intersection.pathLength);
+      if (intersection.pathLength > sExit)
+        break;
+      // loopers can come back below rMin
+      const double r = std::hypot(intersection.position[0], intersection.position[1]);
+      if (r >= calo.rMin && r <= calo.rMax)
+        intersections.push_back(intersection);
+    }
+  }
+
+  std::vector<Calorimeter> m_calorimeters;
+};
@@ -0,0 +1,659 @@
+#pragma once
+
+#include "HoughSeeding.h"
+
+// TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+/** @namespace CellularAutomaton
+ *
+ *  Track candidates from drift chamber hits with a cellular automaton, for tracks that do not come from the origin.
+ *
+ *  Geometry: the chamber is described by its layers of cells (Layer), and the neighbours of each cell are computed
+ *  once per job (NeighbourTable): for each cell, each slice in z of the wires and each of the next maxLayerGap layers,
+ *  the range of the cells that a track crossing the cell outwards can cross next, given the maximum crossing angle,
+ *  the maximum curvature and the twist of the stereo wires between the two layers within the slice.
+ *
+ *  Doublets: a doublet is a line tangent to the drift circles of two hits in neighbour cells, on given sides of the
+ *  two wires (the 4 left-right combinations are separate doublets), leaving the inner hit outwards.
+ *  Triplets: two doublets sharing their middle hit, on the same side of its wire, are neighbours when the angle between
+ *  them is the one of a circle of |omega| < maxOmega and their slopes in (s, z) agree, within the tolerances.
+ *  Evolution: the state of a doublet is the length of the longest chain of neighbour doublets that starts from it. As
+ *  the doublets only point outwards, the states are computed in one pass per layer, from the outermost one: a pass
+ *  writes the states of the doublets of its layer and reads the final states of the outer layers, so the doublets of a
+ *  pass are independent and need no locks: with parallelEvolution, the passes over the layers with enough doublets are
+ *  split in TBB tasks. The cost per event is linear in the number of hits.
+ *  Candidates: the chains are followed from the doublets of highest state, through the neighbour of highest state
+ *  whose hit is free, preferring the one closest in curvature; the hits of an accepted candidate are not used again.
+ *  The candidate is a helix with respect to the first tangent point, fitted to the drift distances on the sides of the
+ *  chain, which the fit can flip, and to the positions along the wires.
+ *
+ *  The hits of the tracks curling back inwards after their turning point are not in the same candidate.
+ *
+ */
+
+namespace CellularAutomaton {
+
+struct Layer {
+  /// Radius of the sense wires at z = 0 [mm]
+  double radius;
+  /// Azimuth of the wire of cell 0 at z = 0, the wire of cell i is at phi0 + 2 pi i / nCells
+  double phi0;
+  /// Stereo angle, with the sign of SenseWireHit::wireStereoAngle: a wire at azimuth phi at z = 0 is at azimuth
+  /// phi - atan(z tan(stereo) / radius) at z
+  double   stereo;
+  uint32_t nCells;
+};
+
+struct Config {
+  /// Doublets join a layer to the next maxLayerGap layers, so that the chains go through missing hits
+  uint32_t maxLayerGap = 2;
+  /// Slices in z of the neighbour table, over the length of the wires
+  uint32_t zSlices    = 16;
+  double   halfLength = 2000.;
+  /// Maximum angle between the tracks and the radial direction [rad]
+  double maxCrossingAngle = 1.2;
+  /// Maximum |omega| [1/mm], from the minimum transverse momentum
+  double maxOmega = 2.e-3;
+  /// Tolerances of the triplets on the tangent points [mm], transverse and along the wires
+  double maxResidual  = 0.5;
+  double maxZResidual = 3.;
+  /// Minimum number of hits of a candidate
+  uint32_t minHits = 10;
+  /// Resolutions of the drift distance and of the position along the wire [mm], for the covariances
+  double driftResolution = 0.1;
+  double zResolution     = 1.;
+  /// Evolve the doublets of a layer in parallel TBB tasks of parallelGrainSize doublets, for the layers with more
+  bool     parallelEvolution = false;
+  uint32_t parallelGrainSize = 256;
+};
+
+struct Hit {
+  /// Cell of the hit: layer and index in the layer
+  uint32_t layer, cell;
+  /// Point of the wire at the hit
+  double x, y, z;
+  double driftDistance;
+};
+
+struct Candidate {
+  /// Helix with respect to the reference point, in the conventions of HelixMath
+  double referencePoint[2];
+  double d0, phi0, omega, z0, tanLambda;
+  /// Covariances of (d0, phi0, omega): (00, 10, 11, 20, 21, 22), and of (z0, tanLambda): (00, 10, 11)
+  double transverseCov[6], longitudinalCov[3];
+  double chi2;
+  int    ndf;
+  /// Range of the candidate in hits(), which holds the hit indices of all candidates from the inside out
+  uint32_t firstHit, nHits;
+};
+
+/// Neighbour cells of each cell, computed once from the geometry
+class NeighbourTable {
+public:
+  /// Range of neighbour cells in a layer, from first and wrapping around
+  struct Range {
+    uint16_t first, count;
+  };
+
+  NeighbourTable() = default;
+  NeighbourTable(const std::vector<Layer>& layers, const Config& config) { build(layers, config); }
+
+  void build(const std::vector<Layer>& layers, const Config& config) {
+    m_layers = layers;
+    m_config = config;
+    m_firstCell.assign(1, 0);
+    for (const auto& layer : layers)
+      m_firstCell.push_back(m_firstCell.back() + layer.nCells);
+    const uint32_t nSlices = m_config.zSlices;
+    const uint32_t nGaps   = m_config.maxLayerGap;
+    m_ranges.assign(std::size_t(nCells()) * nSlices * nGaps, Range{0, 0});
+    const double tanCrossing = std::tan(m_config.maxCrossingAngle);
+    for (uint32_t layer = 0; layer < m_layers.size(); ++layer) {
+      const Layer& inner = m_layers[layer];
+      for (uint32_t gap = 1; gap <= nGaps && layer + gap < m_layers.size(); ++gap) {
+        const Layer& outer = m_layers[layer + gap];
+        const double width = 2. * M_PI / outer.nCells;
+        // azimuth between the crossings of the two radii: straight line at the maximum crossing angle, sagitta of the
+        // maximum curvature over that length, and both hits anywhere in their cells
+        const double crossing = std::fabs(m_config.maxCrossingAngle -
+                                          std::asin(std::min(inner.radius * std::sin(m_config.maxCrossingAngle) /
+                                                             outer.radius, 1.)));
+        const double length   = std::fabs(outer.radius - inner.radius) * std::sqrt(1. + tanCrossing * tanCrossing);
+        const double window   = crossing + 0.5 * m_config.maxOmega * length * length / inner.radius +
+                              M_PI / inner.nCells + width / 2.;
+        for (uint32_t slice = 0; slice < nSlices; ++slice) {
+          // twist of the outer wires with respect to the inner ones, monotonic in z: extremes at the slice edges
+          const auto twist = [&](double z) {
+            return std::atan(z * std::tan(outer.stereo) / outer.radius) -
+                   std::atan(z * std::tan(inner.stereo) / inner.radius);
+          };
+          const double twistLow  = twist(sliceEdge(slice));
+          const double twistHigh = twist(sliceEdge(slice + 1));
+          for (uint32_t cell = 0; cell < inner.nCells; ++cell) {
+            // outer cells j whose azimuth phi0 + j width, relative to the inner cell at the same z, is in the window
+            const double azimuth = inner.phi0 + 2. * M_PI * cell / inner.nCells - outer.phi0;
+            const double low     = azimuth + std::min(twistLow, twistHigh) - window;
+            const double high    = azimuth + std::max(twistLow, twistHigh) + window;
+            const auto   first   = int64_t(std::ceil(low / width));
+            const auto   last    = int64_t(std::floor(high / width));
+            const auto   wrapped = (first % int64_t(outer.nCells) + outer.nCells) % outer.nCells;
+            Range&       range   = m_ranges[index(m_firstCell[layer] + cell, slice, gap)];
+            range.first          = uint16_t(wrapped);
+            range.count          = uint16_t(std::clamp<int64_t>(last - first + 1, 0, outer.nCells));
+          }
+        }
+      }
+    }
+  }
+
+  const std::vector<Layer>& layers() const { return m_layers; }
+  const Config&             config() const { return m_config; }
+  uint32_t                  nCells() const { return m_firstCell.back(); }
+  /// Index of a cell in the whole chamber
+  uint32_t cell(uint32_t layer, uint32_t cell) const { return m_firstCell[layer] + cell; }
+  uint32_t slice(double z) const {
+    const double position = (z + m_config.halfLength) / (2. * m_config.halfLength) * m_config.zSlices;
+    return uint32_t(std::clamp(position, 0., m_config.zSlices - 1.));
+  }
+  /// Neighbours in layer + gap of a cell of layer, for a hit in slice
+  Range neighbours(uint32_t layer, uint32_t cell, uint32_t slice, uint32_t gap) const {
+    return m_ranges[index(m_firstCell[layer] + cell, slice, gap)];
+  }
+
+private:
+  double sliceEdge(uint32_t slice) const {
+    return -m_config.halfLength + 2. * m_config.halfLength * slice / m_config.zSlices;
+  }
+  std::size_t index(uint32_t cell, uint32_t slice, uint32_t gap) const {
+    return (std::size_t(cell) * m_config.zSlices + slice) * m_config.maxLayerGap + gap - 1;
+  }
+
+  std::vector<Layer>    m_layers;
+  Config                m_config;
+  std::vector<uint32_t> m_firstCell;
+  std::vector<Range>    m_ranges;
+};
+
+/// Per event finder, whose buffers are reused across events
+class Finder {
+public:
+  /// Find the candidates in the hits; the candidates and their hits stay valid until the next call
+  const std::vector<Candidate>& find(const NeighbourTable& table, const Hit* hits, std::size_t nHits) {
+    m_table = &table;
+    m_hits  = hits;
+    m_candidates.clear();
+    m_candidateHits.clear();
+    buildDoublets(nHits);
+    buildTriplets();
+    evolve();
+    collect(nHits);
+    return m_candidates;
+  }
+
+  /// Hit indices of the candidates, see Candidate::firstHit
+  const std::vector<uint32_t>& hits() const { return m_candidateHits; }
+  /// Numbers of doublets and triplets of the last event
+  std::size_t nDoublets() const { return m_doublets.size(); }
+  std::size_t nTriplets() const { return m_triplets.size(); }
+  /// Allocated memory of the per event buffers, in bytes
+  std::size_t memory() const {
+    auto bytes = [](const auto& v) { return v.capacity() * sizeof(v[0]); };
+    return bytes(m_order) + bytes(m_cellHead) + bytes(m_nextInCell) + bytes(m_doublets) + bytes(m_hitDoublets) +
+           bytes(m_doubletEnd) + bytes(m_layerDoublets) + bytes(m_triplets) + bytes(m_doubletTriplets) +
+           bytes(m_state) + bytes(m_seeds) + bytes(m_used) + bytes(m_chain) + bytes(m_fitHits) + bytes(m_candidates) +
+           bytes(m_candidateHits);
+  }
+
+private:
+  struct Doublet {
+    uint32_t inner, outer;
+    /// Sides of the wires: +1 if the wire is on the left of the track, -1 on the right
+    int8_t innerSide, outerSide;
+    /// Direction, length between the tangent points and difference in z
+    double tx, ty, length, dz;
+  };
+  struct Triplet {
+    /// Outer doublet, and curvature of the pair
+    uint32_t outer;
+    double   omega;
+  };
+
+  void buildDoublets(std::size_t nHits) {
+    const NeighbourTable& table  = *m_table;
+    const Config&         config = table.config();
+    const uint32_t        nLayer = table.layers().size();
+    // hits ordered by cell, and chained per cell: the cell heads are reset at the end, in a time linear in the hits
+    m_order.resize(nHits);
+    for (uint32_t i = 0; i < nHits; ++i)
+      m_order[i] = i;
+    std::sort(m_order.begin(), m_order.end(), [this](uint32_t a, uint32_t b) {
+      return std::tie(m_hits[a].layer, m_hits[a].cell, a) < std::tie(m_hits[b].layer, m_hits[b].cell, b);
+    });
+    m_cellHead.resize(table.nCells(), -1);
+    m_nextInCell.assign(nHits, -1);
+    for (uint32_t k = nHits; k-- > 0;) {
+      const uint32_t i    = m_order[k];
+      const uint32_t cell = table.cell(m_hits[i].layer, m_hits[i].cell);
+      m_nextInCell[i]     = m_cellHead[cell];
+      m_cellHead[cell]    = i;
+    }
+
+    const double cosCrossing = std::cos(config.maxCrossingAngle);
+    m_doublets.clear();
+    m_hitDoublets.resize(nHits);
+    m_doubletEnd.resize(nHits);
+    m_layerDoublets.resize(nLayer + 1);
+    uint32_t layer = 0;
+    for (const uint32_t a : m_order) {
+      const Hit& A = m_hits[a];
+      for (; layer <= A.layer; ++layer)
+        m_layerDoublets[layer] = m_doublets.size();
+      m_hitDoublets[a]     = m_doublets.size();
+      const uint32_t slice = table.slice(A.z);
+      for (uint32_t gap = 1; gap <= config.maxLayerGap && A.layer + gap < nLayer; ++gap) {
+        const auto     range  = table.neighbours(A.layer, A.cell, slice, gap);
+        const uint32_t nCells = table.layers()[A.layer + gap].nCells;
+        for (uint32_t c = 0; c < range.count; ++c) {
+          const uint32_t cell = range.first + c < nCells ? range.first + c : range.first + c - nCells;
+          for (int32_t b = m_cellHead[table.cell(A.layer + gap, cell)]; b >= 0; b = m_nextInCell[b])
+            addDoublets(a, b, cosCrossing);
+        }
+      }
+      m_doubletEnd[a] = m_doublets.size();
+    }
+    for (; layer <= nLayer; ++layer)
+      m_layerDoublets[layer] = m_doublets.size();
+
+    for (uint32_t i = 0; i < nHits; ++i)
+      m_cellHead[table.cell(m_hits[i].layer, m_hits[i].cell)] = -1;
+  }
+
+  /// Lines tangent to the drift circles of a and b, on each side of the two wires, that leave a outwards within the
+  /// crossing angle
+  void addDoublets(uint32_t a, uint32_t b, double cosCrossing) {
+    const Hit&   A        = m_hits[a];
+    const Hit&   B        = m_hits[b];
+    const double dx       = B.x - A.x;
+    const double dy       = B.y - A.y;
+    const double distance = std::sqrt(dx * dx + dy * dy);
+    for (const int8_t innerSide : {-1, 1})
+      for (const int8_t outerSide : {-1, 1}) {
+        // the normal n (on the left of the track) satisfies n.(B - A) = outerSide rB - innerSide rA
+        const double c = (outerSide * B.driftDistance - innerSide * A.driftDistance) / distance;
+        if (!(std::fabs(c) < 1.))
+          continue;
+        const double h  = std::sqrt(1. - c * c);
+        const double nx = (c * dx - h * dy) / distance;
+        const double ny = (c * dy + h * dx) / distance;
+        // tangent point on the inner circle, and direction of the track
+        const double px = A.x - innerSide * A.driftDistance * nx;
+        const double py = A.y - innerSide * A.driftDistance * ny;
+        const double tx = ny;
+        const double ty = -nx;
+        if (tx * px + ty * py < cosCrossing * std::sqrt(px * px + py * py))
+          continue;
+        m_doublets.push_back(Doublet{a, b, innerSide, outerSide, tx, ty, distance * h, B.z - A.z});
+      }
+  }
+
+  void buildTriplets() {
+    const Config& config = m_table->config();
+    m_triplets.clear();
+    m_doubletTriplets.resize(m_doublets.size() + 1);
+    for (uint32_t j = 0; j < m_doublets.size(); ++j) {
+      m_doubletTriplets[j] = m_triplets.size();
+      const Doublet& inner = m_doublets[j];
+      for (uint32_t k = m_hitDoublets[inner.outer]; k < m_doubletEnd[inner.outer]; ++k) {
+        const Doublet& outer = m_doublets[k];
+        if (outer.innerSide != inner.outerSide)
+          continue;
+        const double sum    = inner.length + outer.length;
+        const double errors = 2. / inner.length + 2. / outer.length;
+        if (std::fabs(inner.dz / inner.length - outer.dz / outer.length) > config.maxZResidual * errors)
+          continue;
+        // a circle turns by omega times the arc length between the middles of two chords, clockwise for omega > 0; the
+        // turn is below the maximum (less than pi / 2) when |sin| < tan(maximum) cos
+        const double maxTurn = 0.5 * config.maxOmega * sum + config.maxResidual * errors;
+        const double sin     = inner.tx * outer.ty - inner.ty * outer.tx;
+        const double cos     = inner.tx * outer.tx + inner.ty * outer.ty;
+        if (!(maxTurn < 0.5 * M_PI && cos > 0. && std::fabs(sin) <= std::tan(maxTurn) * cos))
+          continue;
+        const double turn = std::atan2(sin, cos);
+        m_triplets.push_back(Triplet{k, -2. * turn / sum});
+      }
+    }
+    m_doubletTriplets[m_doublets.size()] = m_triplets.size();
+  }
+
+  /// Length of the longest chain of doublets from each doublet, one pass per layer from the outside in
+  void evolve() {
+    const Config&  config = m_table->config();
+    const uint32_t grain  = std::max(config.parallelGrainSize, 1u);
+    m_state.assign(m_doublets.size(), 0);
+    for (uint32_t layer = m_layerDoublets.size() - 1; layer-- > 0;) {
+      const uint32_t begin = m_layerDoublets[layer];
+      const uint32_t end   = m_layerDoublets[layer + 1];
+      if (!config.parallelEvolution || end - begin <= grain) {
+        evolveLayer(begin, end);
+        continue;
+      }
+      // the finder is a per thread buffer of the algorithm: isolated, a thread waiting for the tasks of the pass cannot
+      // pick up the execution of another event, which would reuse this finder
+      tbb::this_task_arena::isolate([&] {
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(begin, end, grain),
+                          [this](const tbb::blocked_range<uint32_t>& range) { evolveLayer(range.begin(), range.end()); });
+      });
+    }
+  }
+
+  /// The doublets of the range only read the states of outer doublets: they can be evolved in any order, in parallel
+  void evolveLayer(uint32_t begin, uint32_t end) {
+    for (uint32_t j = begin; j < end; ++j) {
+      uint16_t longest = 0;
+      for (uint32_t t = m_doubletTriplets[j]; t < m_doubletTriplets[j + 1]; ++t)
+        longest = std::max(longest, m_state[m_triplets[t].outer]);
+      m_state[j] = longest + 1;
+    }
+  }
+
+  void collect(std::size_t nHits) {
+    const Config& config = m_table->config();
+    // a chain of n doublets has n + 1 hits
+    m_seeds.clear();
+    for (uint32_t j = 0; j < m_doublets.size(); ++j)
+      if (m_state[j] + 1u >= config.minHits)
+        m_seeds.push_back(j);
+    std::sort(m_seeds.begin(), m_seeds.end(),
+              [this](uint32_t a, uint32_t b) { return std::tie(m_state[b], a) < std::tie(m_state[a], b); });
+    m_used.assign(nHits, 0);
+    for (const uint32_t seed : m_seeds) {
+      if (m_used[m_doublets[seed].inner] || m_used[m_doublets[seed].outer])
+        continue;
+      m_chain.assign(1, seed);
+      double omega = 0.;
+      for (uint32_t j = seed; true;) {
+        uint32_t best = 0;
+        double   bestOmega = 0.;
+        bool     found = false;
+        for (uint32_t t = m_doubletTriplets[j]; t < m_doubletTriplets[j + 1]; ++t) {
+          const Triplet& triplet = m_triplets[t];
+          if (m_used[m_doublets[triplet.outer].outer])
+            continue;
+          const bool better = !found || m_state[triplet.outer] > m_state[best] ||
+                              (m_state[triplet.outer] == m_state[best] &&
+                               std::fabs(triplet.omega - omega) < std::fabs(bestOmega - omega));
+          if (better) {
+            best      = triplet.outer;
+            bestOmega = triplet.omega;
+            found     = true;
+          }
+        }
+        if (!found)
+          break;
+        // running mean of the curvature along the chain
+        omega += (bestOmega - omega) / m_chain.size();
+        m_chain.push_back(best);
+        j = best;
+      }
+      if (m_chain.size() + 1 < config.minHits || !fitChain(omega))
+        continue;
+      for (uint32_t k = m_candidates.back().firstHit; k < m_candidateHits.size(); ++k)
+        m_used[m_candidateHits[k]] = 1;
+    }
+  }
+
+  /// Helix fit of the hits of m_chain, with respect to the first tangent point; appends the candidate if it converges
+  bool fitChain(double omega) {
+    const Config&  config = m_table->config();
+    const Doublet& first  = m_doublets[m_chain.front()];
+    const Hit&     start  = m_hits[first.inner];
+    // reference point: tangent point on the first drift circle, n = (-ty, tx)
+    const double x0 = start.x + first.innerSide * start.driftDistance * first.ty;
+    const double y0 = start.y - first.innerSide * start.driftDistance * first.tx;
+    double       sumDz = 0., sumLength = 0.;
+    for (const uint32_t j : m_chain) {
+      sumDz += m_doublets[j].dz;
+      sumLength += m_doublets[j].length;
+    }
+    const double tanLambda = sumDz / sumLength;
+
+    // The drift distance is the distance of closest approach in space between the track and the stereo wire, and the
+    // hit is the point of the wire at the measured z: in the transverse plane, the wire is at a shorter distance from
+    // the track, the track is at another z, and the error on z moves the wire across the track. With the direction of
+    // the track at the hit from its doublet, the closest approach q = a n + b t + c ez (n on the left of the track, t
+    // along it) is perpendicular to the track (b = -c tanLambda) and to the wire (c = kappa a).
+    m_fitHits.clear();
+    for (uint32_t k = 0; k <= m_chain.size(); ++k) {
+      // hit k is the inner hit of doublet k and the outer hit of doublet k - 1
+      const Doublet& doublet = m_doublets[m_chain[std::min<std::size_t>(k, m_chain.size() - 1)]];
+      const uint32_t i       = k < m_chain.size() ? doublet.inner : doublet.outer;
+      const Hit&     hit     = m_hits[i];
+      const Layer&   layer   = m_table->layers()[hit.layer];
+      // transverse direction of the wire, from the azimuth of the cell at z = 0
+      const double cellPhi  = layer.phi0 + 2. * M_PI * hit.cell / layer.nCells;
+      const double wx       = std::sin(cellPhi);
+      const double wy       = -std::cos(cellPhi);
+      const double sinS     = std::sin(layer.stereo);
+      const double normal   = -doublet.ty * wx + doublet.tx * wy;
+      const double along    = doublet.tx * wx + doublet.ty * wy;
+      const double kappa    = -sinS * normal / (std::cos(layer.stereo) - tanLambda * sinS * along);
+      const double distance = hit.driftDistance / std::sqrt(1. + kappa * kappa * (1. + tanLambda * tanLambda));
+      const double zError   = config.zResolution * sinS * normal;
+      FitHit&      fitHit   = m_fitHits.emplace_back();
+      fitHit.hit            = i;
+      fitHit.side           = k < m_chain.size() ? doublet.innerSide : doublet.outerSide;
+      fitHit.distance       = fitHit.side * distance;
+      fitHit.z              = hit.z - kappa * fitHit.distance;
+      fitHit.weight         = 1. / (config.driftResolution * config.driftResolution + zError * zError);
+    }
+
+    // Gauss-Newton on the signed distances to the wires, positive on the left of the track, for (d0, phi0, omega) with
+    // the point of closest approach at (x0, y0) + d0 n; the steps that increase the chi2 are halved. The sides of the
+    // first hits of a chain can be mirrored: the hits whose other side fits better are flipped and the fit is redone,
+    // twice at most.
+    double parameters[3] = {0., std::atan2(first.ty, first.tx), omega};
+    double normal[6], gradient[3], cov[6];
+    double chi2 = 0.;
+    for (int pass = 0; pass < 3; ++pass) {
+      chi2 = accumulate(x0, y0, parameters, normal, gradient);
+      for (int iteration = 0; iteration < 20; ++iteration) {
+        if (!invertSymmetric3(normal, cov))
+          return false;
+        double step[3] = {cov[0] * gradient[0] + cov[1] * gradient[1] + cov[3] * gradient[2],
+                          cov[1] * gradient[0] + cov[2] * gradient[1] + cov[4] * gradient[2],
+                          cov[3] * gradient[0] + cov[4] * gradient[1] + cov[5] * gradient[2]};
+        double trial[3], trialNormal[6], trialGradient[3], trialChi2 = chi2;
+        for (int halving = 0; halving < 8; ++halving) {
+          for (int a = 0; a < 3; ++a)
+            trial[a] = parameters[a] - step[a];
+          trialChi2 = accumulate(x0, y0, trial, trialNormal, trialGradient);
+          if (trialChi2 <= chi2)
+            break;
+          for (int a = 0; a < 3; ++a)
+            step[a] *= 0.5;
+        }
+        if (!(trialChi2 <= chi2))
+          break;
+        std::copy(trial, trial + 3, parameters);
+        std::copy(trialNormal, trialNormal + 6, normal);
+        std::copy(trialGradient, trialGradient + 3, gradient);
+        const bool converged = chi2 - trialChi2 < 1.e-3 * (1. + trialChi2);
+        chi2                 = trialChi2;
+        if (converged)
+          break;
+      }
+      if (pass < 2 && !resolveSides(x0, y0, parameters))
+        break;
+    }
+    if (!invertSymmetric3(normal, cov))
+      return false;
+    const double d0   = parameters[0];
+    const double phi0 = parameters[1];
+    omega             = parameters[2];
+    if (!std::isfinite(phi0) || !std::isfinite(omega) || std::fabs(omega) > 2. * config.maxOmega)
+      return false;
+
+    // z = z0 + tanLambda s, with s the arc length from the point of closest approach
+    const double pcaX   = x0 - d0 * std::sin(phi0);
+    const double pcaY   = y0 + d0 * std::cos(phi0);
+    double       sum[5] = {0., 0., 0., 0., 0.}; // sums of 1, s, s^2, z, s z
+    for (auto& fitHit : m_fitHits) {
+      const Hit& hit = m_hits[fitHit.hit];
+      fitHit.s       = HoughSeeding::arcLength(hit.x - pcaX, hit.y - pcaY, omega);
+      sum[0] += 1.;
+      sum[1] += fitHit.s;
+      sum[2] += fitHit.s * fitHit.s;
+      sum[3] += fitHit.z;
+      sum[4] += fitHit.s * fitHit.z;
+    }
+    const double determinant = sum[0] * sum[2] - sum[1] * sum[1];
+    if (!(determinant > 0.))
+      return false;
+    Candidate& candidate = m_candidates.emplace_back();
+    candidate.tanLambda  = (sum[0] * sum[4] - sum[1] * sum[3]) / determinant;
+    candidate.z0         = (sum[3] - candidate.tanLambda * sum[1]) / sum[0];
+    double zChi2         = 0.;
+    for (const auto& fitHit : m_fitHits) {
+      const double residual = fitHit.z - candidate.z0 - candidate.tanLambda * fitHit.s;
+      zChi2 += residual * residual;
+    }
+    const double zVariance       = config.zResolution * config.zResolution;
+    candidate.referencePoint[0]  = x0;
+    candidate.referencePoint[1]  = y0;
+    candidate.d0                 = d0;
+    candidate.phi0               = std::remainder(phi0, 2. * M_PI);
+    candidate.omega              = omega;
+    std::copy(cov, cov + 6, candidate.transverseCov);
+    candidate.longitudinalCov[0] = zVariance * sum[2] / determinant;
+    candidate.longitudinalCov[1] = -zVariance * sum[1] / determinant;
+    candidate.longitudinalCov[2] = zVariance * sum[0] / determinant;
+    candidate.chi2               = chi2 + zChi2 / zVariance;
+    candidate.ndf                = 2 * int(m_fitHits.size()) - 5;
+    candidate.firstHit           = m_candidateHits.size();
+    candidate.nHits              = m_fitHits.size();
+    for (const auto& fitHit : m_fitHits)
+      m_candidateHits.push_back(fitHit.hit);
+    return true;
+  }
+
+  /// Signed distance from the helix (d0, phi0, omega) with respect to (x0, y0) to a hit, and its derivatives
+  double distance(double x0, double y0, const double parameters[3], const Hit& hit, double jacobian[3]) const {
+    const double d0     = parameters[0];
+    const double omega  = parameters[2];
+    const double sinPhi = std::sin(parameters[1]);
+    const double cosPhi = std::cos(parameters[1]);
+    const double x      = hit.x - x0 + d0 * sinPhi;
+    const double y      = hit.y - y0 - d0 * cosPhi;
+    const double r2     = x * x + y * y;
+    const double q      = x * sinPhi - y * cosPhi;
+    const double t      = x * cosPhi + y * sinPhi;
+    const double ux     = omega * x - sinPhi;
+    const double uy     = omega * y + cosPhi;
+    const double n      = std::max(std::sqrt(ux * ux + uy * uy), 1.e-12);
+    const double num    = omega * r2 - 2. * q;
+    const double den    = 1. + n;
+    // derivatives with respect to x, y, and to phi0 and omega at fixed x, y
+    const double dX = (2. * ux * den - num * omega * ux / n) / (den * den);
+    const double dY = (2. * uy * den - num * omega * uy / n) / (den * den);
+    jacobian[0]     = dX * sinPhi - dY * cosPhi;
+    jacobian[1]     = (-2. * t * den + num * omega * t / n) / (den * den) + d0 * (dX * cosPhi + dY * sinPhi);
+    jacobian[2]     = (r2 * den - num * (omega * r2 - q) / n) / (den * den);
+    return num / den;
+  }
+
+  /// Normal matrix, gradient and chi2 of the transverse fit at the given parameters
+  double accumulate(double x0, double y0, const double parameters[3], double normal[6], double gradient[3]) const {
+    std::fill(normal, normal + 6, 0.);
+    std::fill(gradient, gradient + 3, 0.);
+    double chi2 = 0.;
+    for (const auto& fitHit : m_fitHits) {
+      double       jacobian[3];
+      const double residual = distance(x0, y0, parameters, m_hits[fitHit.hit], jacobian) - fitHit.distance;
+      for (int a = 0, ab = 0; a < 3; ++a) {
+        gradient[a] += fitHit.weight * jacobian[a] * residual;
+        for (int b = 0; b <= a; ++b, ++ab)
+          normal[ab] += fitHit.weight * jacobian[a] * jacobian[b];
+      }
+      chi2 += fitHit.weight * residual * residual;
+    }
+    return chi2;
+  }
+
+  /// Flip the sides of the hits closer to their mirror distance than to their distance; true if any was flipped
+  bool resolveSides(double x0, double y0, const double parameters[3]) {
+    bool flipped = false;
+    for (auto& fitHit : m_fitHits) {
+      const Hit&   hit = m_hits[fitHit.hit];
+      double       jacobian[3];
+      const double fitted = distance(x0, y0, parameters, hit, jacobian);
+      if (std::fabs(fitted + fitHit.distance) < std::fabs(fitted - fitHit.distance)) {
+        fitHit.side     = -fitHit.side;
+        fitHit.distance = -fitHit.distance;
+        fitHit.z        = 2. * hit.z - fitHit.z;
+        flipped         = true;
+      }
+    }
+    return flipped;
+  }
+
+  /// Inverse of a positive definite symmetric 3x3 matrix stored as (00, 10, 11, 20, 21, 22); false if it is singular
+  static bool invertSymmetric3(const double m[6], double inverse[6]) {
+    const double c00         = m[2] * m[5] - m[4] * m[4];
+    const double c10         = m[4] * m[3] - m[1] * m[5];
+    const double c20         = m[1] * m[4] - m[2] * m[3];
+    const double determinant = m[0] * c00 + m[1] * c10 + m[3] * c20;
+    if (!(determinant > 0.))
+      return false;
+    inverse[0] = c00 / determinant;
+    inverse[1] = c10 / determinant;
+    inverse[2] = (m[0] * m[5] - m[3] * m[3]) / determinant;
+    inverse[3] = c20 / determinant;
+    inverse[4] = (m[1] * m[3] - m[0] * m[4]) / determinant;
+    inverse[5] = (m[0] * m[2] - m[1] * m[1]) / determinant;
+    return true;
+  }
+
+  /// Hit of the fit: side of the wire, signed transverse distance, z of the track and weight of the transverse residual
+  struct FitHit {
+    uint32_t hit;
+    int8_t   side;
+    double   distance, z, weight;
+    double   s;
+  };
+
+  const NeighbourTable* m_table = nullptr;
+  const Hit*            m_hits  = nullptr;
+  /// Hits in the order of the cells, and the hits of each cell (-1 terminated lists)
+  std::vector<uint32_t> m_order;
+  std::vector<int32_t>  m_cellHead;
+  std::vector<int32_t>  m_nextInCell;
+  /// Doublets, ordered by layer and by inner hit: those of hit i are [m_hitDoublets[i], m_doubletEnd[i]), those of a
+  /// layer are [m_layerDoublets[layer], m_layerDoublets[layer + 1])
+  std::vector<Doublet>  m_doublets;
+  std::vector<uint32_t> m_hitDoublets;
+  std::vector<uint32_t> m_doubletEnd;
+  std::vector<uint32_t> m_layerDoublets;
+  /// Outer neighbours of the doublets: those of doublet j are [m_doubletTriplets[j], m_doubletTriplets[j + 1])
+  std::vector<Triplet>  m_triplets;
+  std::vector<uint32_t> m_doubletTriplets;
+  std::vector<uint16_t> m_state;
+  /// Candidates
+  std::vector<uint32_t>  m_seeds;
+  std::vector<uint8_t>   m_used;
+  std::vector<uint32_t>  m_chain;
+  std::vector<FitHit>    m_fitHits;
+  std::vector<Candidate> m_candidates;
+  std::vector<uint32_t>  m_candidateHits;
+};
+
+} // namespace CellularAutomaton
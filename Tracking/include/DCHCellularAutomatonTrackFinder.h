@@ -0,0 +1,131 @@
+#pragma once
+
+// GAUDI
+#include "Gaudi/Accumulators.h"
+#include "Gaudi/Algorithm.h"
+#include "Gaudi/Property.h"
+
+// K4FWCORE
+#include "k4FWCore/DataHandle.h"
+
+// EDM4HEP extension
+#include "extension/SenseWireHitCollection.h"
+#include "extension/TrackCollection.h"
+
+// DD4hep
+#include "DDSegmentation/BitFieldCoder.h"
+
+#include "AlgorithmInstrumentation.h"
+#include "CellularAutomaton.h"
+#include "SenseWireHitIndex.h"
+
+// C++
+#include <string>
+#include <vector>
+
+/** @class DCHCellularAutomatonTrackFinder
+ *
+ *  Pattern recognition in the drift chamber with a cellular automaton on the sense wire hits, see
+ *  CellularAutomaton.h: unlike DCHHoughTrackFinder, it does not assume that the tracks come from the origin.
+ *  The cells and their neighbours are taken from the DCH_info extension of the detector once, in initialize, so that
+ *  the time per event only depends on the hits.
+ *  The output tracks have an AtFirstHit state, with respect to the tangent point on the drift circle of their first
+ *  hit, the covariance of the transverse and longitudinal fits, and their sense wire hits, from the inside out.
+ *  The side of the wire of each hit is not stored: the tracks are meant as seeds for the track fit.
+ *  With recoverHits, the free hits close to the helix of a candidate, in the layers it crosses outwards from its first
+ *  hit, are added to its track: they are looked for in an azimuth window around the crossing point of each layer with
+ *  a SenseWireHitIndex of the event. The recovered hits are not in the fit, its chi2 and ndf are the ones of the
+ *  candidate.
+ *
+ */
+
+class DCHCellularAutomatonTrackFinder : public Gaudi::Algorithm {
+public:
+  explicit DCHCellularAutomatonTrackFinder(const std::string&, ISvcLocator*);
+  virtual ~DCHCellularAutomatonTrackFinder();
+  /**  Initialize.
+   *   @return status code
+   */
+  virtual StatusCode initialize() final;
+  /**  Execute.
+   *   @return status code
+   */
+  virtual StatusCode execute(const EventContext&) const final;
+  /**  Finalize.
+   *   @return status code
+   */
+  virtual StatusCode finalize() final;
+
+private:
+  // Input drift chamber hits
+  mutable DataHandle<extension::SenseWireHitCollection> m_input_wire_hits{"inputWireHits", Gaudi::DataHandle::Reader,
+                                                                          this};
+  // Output track candidates
+  mutable DataHandle<extension::TrackCollection> m_output_tracks{"outputTracks", Gaudi::DataHandle::Writer, this};
+
+  // Geometry
+  Gaudi::Property<std::string> m_geoSvcName{this, "GeoSvcName", "GeoSvc", "The name of the geometry service"};
+  Gaudi::Property<std::string> m_DCH_name{this, "DCH_name", "DCH_v2", "Name of the Drift Chamber detector"};
+  // Track selection
+  Gaudi::Property<double>   m_bz{this, "Bz", 2., "Magnetic field along z [T]"};
+  Gaudi::Property<double>   m_min_pt{this, "minPt", 0.3, "Minimum transverse momentum of the tracks [GeV]"};
+  Gaudi::Property<unsigned> m_min_hits{this, "minHits", 10, "Minimum number of hits of a track"};
+  Gaudi::Property<double>   m_max_crossing_angle{this, "maxCrossingAngle", 1.2,
+                                                 "Maximum angle between the tracks and the radial direction [rad]"};
+  // Cellular automaton
+  Gaudi::Property<unsigned> m_max_layer_gap{this, "maxLayerGap", 2,
+                                            "Doublets join a layer to the next maxLayerGap layers"};
+  Gaudi::Property<unsigned> m_z_slices{this, "zSlices", 16, "Number of slices in z of the cell neighbour table"};
+  Gaudi::Property<double>   m_max_residual{this, "maxResidual", 0.5,
+                                           "Transverse tolerance of the triplets on the tangent points [mm]"};
+  Gaudi::Property<double>   m_max_z_residual{this, "maxZResidual", 3.,
+                                             "Tolerance of the triplets along the wires [mm]"};
+  Gaudi::Property<bool>     m_parallel_evolution{this, "parallelEvolution", false,
+                                                 "Evolve the doublets of each layer in parallel TBB tasks"};
+  Gaudi::Property<unsigned> m_parallel_grain_size{this, "parallelGrainSize", 256,
+                                                  "Doublets per TBB task of the parallel evolution, smaller layers are "
+                                                  "evolved serially"};
+  // Hit recovery
+  Gaudi::Property<bool>   m_recover_hits{this, "recoverHits", false,
+                                       "Add to the tracks the free hits close to them in the layers they cross"};
+  Gaudi::Property<double> m_recovery_window{this, "recoveryWindow", 1.5,
+                                            "Half width of the azimuth window searched in each layer [cells]"};
+  Gaudi::Property<double> m_max_recovery_residual{this, "maxRecoveryResidual", 1.,
+                                                  "Maximum distance between a recovered hit and the track circle [mm]"};
+  Gaudi::Property<double> m_max_recovery_z_residual{
+      this, "maxRecoveryZResidual", 10., "Maximum distance between a recovered hit and the track along the wire [mm]"};
+  // Fit
+  Gaudi::Property<double> m_wire_drift_resolution{this, "wireDriftResolution", 0.1,
+                                                  "Resolution on the distance to the wire [mm]"};
+  Gaudi::Property<double> m_wire_along_resolution{this, "wireAlongResolution", 1.0,
+                                                  "Resolution on the position along the wire [mm]"};
+
+  /// Cells and their neighbours, shared by all threads
+  CellularAutomaton::NeighbourTable m_table;
+  /// cellID decoder: the layer of a hit in the table is superlayer * m_layers_per_superlayer + layer
+  dd4hep::DDSegmentation::BitFieldCoder* m_decoder                = nullptr;
+  unsigned                               m_layers_per_superlayer = 0;
+
+  // Monitoring
+  mutable Gaudi::Accumulators::AveragingCounter<double>   m_find_time{this, "Time per event [ms]"};
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_doublets_per_event{this, "Doublets per event"};
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_triplets_per_event{this, "Triplets per event"};
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_tracks_per_event{this, "Tracks per event"};
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_recovered_per_event{this, "Recovered hits per event"};
+  enum Stages { HitPreparation, TrackFinding, HitRecovery, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{
+      this, {"hit preparation", "cellular automaton and fits", "hit recovery", "output fill"}};
+
+  /// Hits of the candidates and the free hits close to them, into m_track_hits; returns the number of recovered hits
+  unsigned recoverHits(const extension::SenseWireHitCollection&          wire_hits,
+                       const std::vector<CellularAutomaton::Candidate>& candidates) const;
+
+  /// Per thread buffers reused across events
+  inline static thread_local std::vector<CellularAutomaton::Hit> m_hits;
+  inline static thread_local CellularAutomaton::Finder           m_finder;
+  /// Hit recovery: track t has the hits [m_track_offsets[t], m_track_offsets[t + 1]) of m_track_hits
+  inline static thread_local SenseWireHitIndex     m_hit_index;
+  inline static thread_local std::vector<uint32_t> m_track_hits;
+  inline static thread_local std::vector<uint32_t> m_track_offsets;
+  inline static thread_local std::vector<uint8_t>  m_used;
+};
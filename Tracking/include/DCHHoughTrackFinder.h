@@ -0,0 +1,94 @@
+#pragma once
+
+// GAUDI
+#include "Gaudi/Accumulators.h"
+#include "Gaudi/Algorithm.h"
+#include "Gaudi/Property.h"
+
+// K4FWCORE
+#include "k4FWCore/DataHandle.h"
+
+// EDM4HEP
+#include "edm4hep/TrackCollection.h"
+
+// EDM4HEP extension
+#include "extension/SenseWireHitCollection.h"
+
+#include "AlgorithmInstrumentation.h"
+#include "HoughSeeding.h"
+
+// C++
+#include <string>
+#include <vector>
+
+/** @class DCHHoughTrackFinder
+ *
+ *  Pattern recognition in the drift chamber: track candidates from the sense wire hits, with a Hough transform in
+ *  (phi0, omega) followed by a fit of the circle and of the line in (s, z), see HoughSeeding.h.
+ *  The tracks are assumed to come from the origin. The transverse position of a hit is the point of its wire at the
+ *  measured position along the wire: all the IDEA wires are stereo, and the error this position makes on the
+ *  transverse projection (wireAlongResolution times the sine of the stereo angle) is small compared with the cells.
+ *  Only the wires with a stereo angle below maxVotingStereoAngle vote; the others are attached to the seeds found.
+ *  The output tracks have an AtIP state at the origin (d0 = 0, which is not fitted), the covariance of the transverse
+ *  and longitudinal fits, and no hits (sense wire hits are not edm4hep::TrackerHits): they are meant as seeds for the
+ *  track fit.
+ *
+ */
+
+class DCHHoughTrackFinder : public Gaudi::Algorithm {
+public:
+  explicit DCHHoughTrackFinder(const std::string&, ISvcLocator*);
+  virtual ~DCHHoughTrackFinder();
+  /**  Initialize.
+   *   @return status code
+   */
+  virtual StatusCode initialize() final;
+  /**  Execute.
+   *   @return status code
+   */
+  virtual StatusCode execute(const EventContext&) const final;
+  /**  Finalize.
+   *   @return status code
+   */
+  virtual StatusCode finalize() final;
+
+private:
+  // Input drift chamber hits
+  mutable DataHandle<extension::SenseWireHitCollection> m_input_wire_hits{"inputWireHits", Gaudi::DataHandle::Reader,
+                                                                          this};
+  // Output track candidates
+  mutable DataHandle<edm4hep::TrackCollection> m_output_tracks{"outputTracks", Gaudi::DataHandle::Writer, this};
+
+  // Track selection
+  Gaudi::Property<double> m_bz{this, "Bz", 2., "Magnetic field along z [T]"};
+  Gaudi::Property<double> m_min_pt{this, "minPt", 0.3, "Minimum transverse momentum of the tracks [GeV]"};
+  Gaudi::Property<unsigned> m_min_hits{this, "minHits", 15, "Minimum number of hits of a track"};
+  Gaudi::Property<double> m_max_voting_stereo_angle{
+      this, "maxVotingStereoAngle", 0.3, "Only the wires with a smaller stereo angle vote in the Hough transform [rad]"};
+  // Hough transform
+  Gaudi::Property<unsigned> m_phi_bins{this, "phiBins", 512, "Number of phi0 bins of the accumulator"};
+  Gaudi::Property<unsigned> m_omega_bins{this, "omegaBins", 256, "Number of omega bins of the accumulator"};
+  Gaudi::Property<unsigned> m_coarse_factor{this, "coarseFactor", 4,
+                                            "Fine bins per bin of the coarse accumulator, in phi0 and in omega"};
+  // Fits
+  Gaudi::Property<double> m_max_residual{this, "maxResidual", 1.,
+                                         "Maximum distance between a hit and the track circle [mm]"};
+  Gaudi::Property<double> m_max_z_residual{this, "maxZResidual", 10.,
+                                           "Maximum distance between a hit and the track along the wire [mm]"};
+  Gaudi::Property<double> m_max_chi2_per_ndf{this, "maxChi2PerNdf", 4., "Maximum chi2 / ndf of the circle fit"};
+  Gaudi::Property<double> m_wire_drift_resolution{this, "wireDriftResolution", 0.1,
+                                                  "Resolution on the distance to the wire [mm]"};
+  Gaudi::Property<double> m_wire_along_resolution{this, "wireAlongResolution", 1.0,
+                                                  "Resolution on the position along the wire [mm]"};
+  HoughSeeding::Config m_config;
+
+  // Monitoring
+  mutable Gaudi::Accumulators::AveragingCounter<double>   m_find_time{this, "Time per event [ms]"};
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_tracks_per_event{this, "Tracks per event"};
+  enum Stages { HitPreparation, TrackFinding, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"hit preparation", "Hough transform and fits", "output fill"}};
+
+  /// Per thread buffers reused across events
+  inline static thread_local std::vector<HoughSeeding::Hit> m_hits;
+  inline static thread_local HoughSeeding::Finder           m_finder;
+};
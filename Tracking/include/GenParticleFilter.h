@@ -0,0 +1,90 @@
+#pragma once
+
+// edm4hep
+#include "edm4hep/MCParticle.h"
+
+// C++
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/** @namespace GenParticleFilter
+ *
+ *  Kinematic and acceptance selection of the gen particles to build tracks from, applied before any helix building or
+ *  hit matching: generator status, minimum pT, maximum |cos(theta)| of the momentum, maximum transverse radius of the
+ *  production vertex, and whether the particle decayed in the tracker.
+ *  The cuts only use the MCParticle members, without square roots or trigonometric functions, so that the selection is
+ *  cheap compared to the track building. The default Cuts accept all the charged particles.
+ *
+ */
+
+namespace GenParticleFilter {
+
+/// Outcome of the selection: accepted, or the first cut the particle failed
+enum Reason { Accepted = 0, Neutral, GeneratorStatus, Pt, CosTheta, VertexRadius, DecayedInTracker, NReasons };
+
+inline const char* reasonName(Reason reason) {
+  static const char* names[NReasons] = {"accepted",         "neutral",       "generator status",       "pT",
+                                        "|cos(theta)|",     "vertex radius", "decayed in the tracker"};
+  return names[reason];
+}
+
+struct Cuts {
+  /// Accepted generator status codes, all if empty
+  std::vector<int> generatorStatus;
+  /// Minimum transverse momentum [GeV]
+  double minPt = 0.;
+  /// Maximum |cos(theta)| of the momentum
+  double maxAbsCosTheta = 1.;
+  /// Maximum transverse radius of the production vertex [mm], no cut if negative
+  double maxVertexRadius = -1.;
+  /// Reject the particles that decayed in the tracker
+  bool rejectDecayedInTracker = false;
+};
+
+inline Reason select(const Cuts& cuts, const edm4hep::MCParticle& particle) {
+  if (particle.getCharge() == 0)
+    return Neutral;
+  if (!cuts.generatorStatus.empty() && std::find(cuts.generatorStatus.begin(), cuts.generatorStatus.end(),
+                                                 particle.getGeneratorStatus()) == cuts.generatorStatus.end())
+    return GeneratorStatus;
+  const auto&  momentum = particle.getMomentum();
+  const double pt2      = double(momentum.x) * momentum.x + double(momentum.y) * momentum.y;
+  if (pt2 < cuts.minPt * cuts.minPt)
+    return Pt;
+  if (cuts.maxAbsCosTheta < 1.) {
+    // pz^2 > cos^2 p^2, i.e. pz^2 sin^2 > cos^2 pT^2
+    const double pz2  = double(momentum.z) * momentum.z;
+    const double cos2 = cuts.maxAbsCosTheta * cuts.maxAbsCosTheta;
+    if (pz2 * (1. - cos2) > cos2 * pt2)
+      return CosTheta;
+  }
+  if (cuts.maxVertexRadius >= 0.) {
+    const auto& vertex = particle.getVertex();
+    if (vertex.x * vertex.x + vertex.y * vertex.y > cuts.maxVertexRadius * cuts.maxVertexRadius)
+      return VertexRadius;
+  }
+  if (cuts.rejectDecayedInTracker && particle.isDecayedInTracker())
+    return DecayedInTracker;
+  return Accepted;
+}
+
+/// Number of particles per outcome, e.g. for one event
+struct Tally {
+  std::array<unsigned, NReasons> counts{};
+
+  Reason add(Reason reason) {
+    ++counts[reason];
+    return reason;
+  }
+  unsigned accepted() const { return counts[Accepted]; }
+  /// Charged particles rejected by the cuts
+  unsigned rejected() const {
+    unsigned n = 0;
+    for (int reason = GeneratorStatus; reason < NReasons; ++reason)
+      n += counts[reason];
+    return n;
+  }
+};
+
+} // namespace GenParticleFilter
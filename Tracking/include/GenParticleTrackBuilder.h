@@ -0,0 +1,148 @@
+#pragma once
+
+// Gaudi
+#include "Gaudi/Accumulators.h"
+#include "Gaudi/Algorithm.h"
+#include "Gaudi/Property.h"
+#include "GaudiKernel/MsgStream.h"
+
+// edm4hep
+#include "edm4hep/MCParticleCollection.h"
+#include "edm4hep/SimTrackerHitCollection.h"
+#include "edm4hep/TrackCollection.h"
+#include "edm4hep/TrackMCParticleLinkCollection.h"
+
+// DD4HEP
+#include "DDRec/DetectorData.h"
+
+// C++
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "CalorimeterSurfaces.h"
+#include "GenParticleFilter.h"
+#include "IFieldCacheSvc.h"
+#include "SimTrackerHitParticleIndex.h"
+
+/** @class GenParticleTrackBuilder
+ *
+ *  Track states of the gen particles, shared by TracksFromGenParticlesWithECalExtrap and
+ *  TracksFromGenParticlesWithECalExtrapAlg: it declares their field, extrapolation and pre-selection properties and
+ *  their selection counters, reads the field and the calorimeter surfaces at initialize, and builds the track states
+ *  of one gen particle at a time.
+ *  Each gen particle gives an helix from its position, momentum and charge, and the AtIP, AtFirstHit and AtLastHit
+ *  states, the first and last hits being those with smallest and largest time among its SimTrackerHits. The AtCalorimeter
+ *  state is the first crossing of the ECAL barrel cylinder and endcap planes, taken from the detector data extensions,
+ *  and optional AtOther states are defined at the crossings of a list of calorimeters, in order of path length.
+ *  Optionally, the field is taken from a FieldCacheSvc, and the AtCalorimeter state can be obtained by Runge-Kutta
+ *  propagation from the last hit through the cached field map. Each state then takes the local Bz at its reference
+ *  point, unless it is out of the solenoid: where the local Bz drops below MinLocalBzFraction of the field at the origin
+ *  or is reversed by the return flux, the helix parameters would be infinite or of the wrong sign, and the state takes
+ *  the field at the origin.
+ *  buildTrackStates() is const and only writes to its arguments, so that the gen particles can be processed in
+ *  parallel.
+ *
+ */
+
+class GenParticleTrackBuilder {
+public:
+  using SimTrackerHitColl = std::vector<const edm4hep::SimTrackerHitCollection*>;
+  using TrackHit          = std::array<double, 7>;
+
+  /// Declare the properties and the counters of the owner algorithm
+  template <typename OWNER>
+  explicit GenParticleTrackBuilder(OWNER* owner)
+      : m_fieldCacheSvcName{owner, "FieldCacheSvcName", "",
+                            "Name of the FieldCacheSvc; if empty, the field at the origin is used everywhere"},
+        m_useRungeKutta{owner, "UseRungeKutta", false,
+                        "Obtain the AtCalorimeter TrackState by Runge-Kutta propagation from the last hit through the "
+                        "cached field map"},
+        m_rungeKuttaTolerance{owner, "RungeKuttaTolerance", 1.e-3, "Position error tolerance per Runge-Kutta step [mm]"},
+        m_rungeKuttaMaxPath{owner, "RungeKuttaMaxPath", 20000., "Maximum path length of the Runge-Kutta propagation [mm]"},
+        m_minLocalBzFraction{owner, "MinLocalBzFraction", 0.5,
+                             "A local Bz below this fraction of the field at the origin, or of opposite sign, is "
+                             "replaced by the field at the origin in the track state parameters"},
+        m_extrapolationCalorimeters{owner, "ExtrapolationCalorimeters", {},
+                                    "Names of the calorimeters (with LayeredCalorimeterData) to define additional track "
+                                    "states at"},
+        m_extrapolateToAllLayers{owner, "ExtrapolateToAllLayers", false,
+                                 "Define a track state at every layer of the ExtrapolationCalorimeters instead of at "
+                                 "their inner face only"},
+        m_generatorStatus{owner, "GeneratorStatus", {},
+                          "Generator status codes of the gen particles to build tracks from; all if empty"},
+        m_minPt{owner, "MinPt", 0., "Minimum transverse momentum of the gen particles [GeV]"},
+        m_maxAbsCosTheta{owner, "MaxAbsCosTheta", 1., "Maximum |cos(theta)| of the gen particles"},
+        m_maxVertexRadius{owner, "MaxVertexRadius", -1.,
+                          "Maximum transverse radius of the gen particle vertex [mm]; no cut if negative"},
+        m_rejectDecayedInTracker{owner, "RejectDecayedInTracker", false,
+                                 "Do not build tracks from gen particles that decayed in the tracker"},
+        m_acceptedParticles{owner, "Accepted gen particles per event"},
+        m_rejectedParticles{owner, "Rejected charged gen particles per event"} {}
+
+  /// Field, pre-selection and calorimeter surfaces, to be called from the initialize of the owner
+  StatusCode initialize(const Gaudi::Algorithm& owner);
+
+  /// Indices of the charged gen particles passing the pre-selection, in their original order
+  void selectParticles(const Gaudi::Algorithm& owner, const edm4hep::MCParticleCollection& genParticles,
+                       std::vector<std::size_t>& particleIndices) const;
+
+  /// Track states of a gen particle, false (and no state) if it has no SimTrackerHits. The messages go to log if not
+  /// null: the MsgStream is not thread safe. trackHits and intersections are working buffers.
+  bool buildTrackStates(const edm4hep::MCParticle& genParticle, const SimTrackerHitParticleIndex& hitIndex,
+                        const SimTrackerHitColl& simTrackerHitCollVec, MsgStream* log,
+                        std::vector<edm4hep::TrackState>& trackStates, std::vector<TrackHit>& trackHits,
+                        std::vector<CalorimeterSurfaces::Intersection>& intersections) const;
+
+  /// Tracks of the selected gen particles with track states, and their links, in the order of the gen particles
+  static void fillTracks(const edm4hep::MCParticleCollection&                 genParticles,
+                         const std::vector<std::size_t>&                      particleIndices,
+                         const std::vector<std::vector<edm4hep::TrackState>>& trackStates,
+                         edm4hep::TrackCollection& tracks, edm4hep::TrackMCParticleLinkCollection& links);
+
+  /// Field at the origin [T]
+  double bz() const { return m_Bz; }
+
+private:
+  double getFieldFromCompact() const;
+  // copied from k4GaudiPandora and DDMarlinPandora / DDPandoraPFANewProcessor
+  const dd4hep::rec::LayeredCalorimeterData* getExtension(const Gaudi::Algorithm& owner, unsigned int includeFlag,
+                                                          unsigned int excludeFlag) const;
+  /// Bz of the track state parameters at position: the local Bz from the cached field map if available and of the
+  /// same sign as, and at least MinLocalBzFraction of, the field at the origin, else the field at the origin
+  double bzAt(const double position[3]) const;
+  /// Runge-Kutta propagation to the first crossed of the ECAL endcap plane and barrel cylinder, false if not reached
+  bool propagateToCalorimeter(const double position[3], const double momentum[3], double charge,
+                              double positionAtCalorimeter[3], double momentumAtCalorimeter[3]) const;
+
+  /// Solenoid magnetic field, to be retrieved from detector
+  double m_Bz = 0.;
+  /// Optional cached field map, for the local Bz of the helices and the Runge-Kutta propagation to the calorimeter
+  Gaudi::Property<std::string> m_fieldCacheSvcName;
+  Gaudi::Property<bool>        m_useRungeKutta;
+  Gaudi::Property<double>      m_rungeKuttaTolerance;
+  Gaudi::Property<double>      m_rungeKuttaMaxPath;
+  Gaudi::Property<double>      m_minLocalBzFraction;
+  SmartIF<IFieldCacheSvc>      m_fieldCache;
+  /// ECAL barrel and endcap extent
+  double m_eCalBarrelInnerR = 0.;
+  double m_eCalBarrelMaxZ   = 0.;
+  double m_eCalEndCapInnerR = 0.;
+  double m_eCalEndCapOuterR = 0.;
+  double m_eCalEndCapInnerZ = 0.;
+  double m_eCalEndCapOuterZ = 0.;
+  /// Additional calorimeter surfaces to extrapolate to
+  Gaudi::Property<std::vector<std::string>> m_extrapolationCalorimeters;
+  Gaudi::Property<bool>                     m_extrapolateToAllLayers;
+  CalorimeterSurfaces                       m_calorimeterSurfaces;
+  /// Pre-selection of the gen particles
+  Gaudi::Property<std::vector<int>> m_generatorStatus;
+  Gaudi::Property<double>           m_minPt;
+  Gaudi::Property<double>           m_maxAbsCosTheta;
+  Gaudi::Property<double>           m_maxVertexRadius;
+  Gaudi::Property<bool>             m_rejectDecayedInTracker;
+  GenParticleFilter::Cuts           m_cuts;
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_acceptedParticles;
+  mutable Gaudi::Accumulators::AveragingCounter<unsigned> m_rejectedParticles;
+};
@@ -0,0 +1,435 @@
+#pragma once
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/** @namespace HelixMath
+ *
+ *  Header-only helix math for a charged particle in a constant solenoidal field along z, in mm, GeV and Tesla.
+ *  It replaces HelixClass_double (MarlinUtil) and pandora::Helix (PandoraSDK) for the generator level tracks and keeps
+ *  their conventions: canonical parameters (d0, phi0, omega, z0, tanLambda) are expressed with respect to the origin,
+ *  with z0 taken on the turn closest to z = 0, and extrapolations are parametrised by the transverse arc length s
+ *  travelled from the helix anchor point (the reference point of HelixClass_double and pandora::Helix).
+ *
+ *  Everything is available for one helix (Helix) and for many helices at once (HelixSoA + the batch functions).
+ *  The batch functions are plain loops without branches over structure-of-arrays data, that the compiler vectorizes
+ *  when a vector math library is available for the trigonometric functions (e.g. glibc libmvec with -ffast-math).
+ *  They call the same inline kernels as the scalar methods, so both give identical results.
+ *
+ */
+
+namespace HelixMath {
+
+/// Conversion factor between the curvature radius and the transverse momentum: pT [GeV] = FCT * B [T] * R [mm]
+constexpr double FCT    = 2.99792458e-4;
+constexpr double TWO_PI = 2. * M_PI;
+constexpr double PI_2   = 0.5 * M_PI;
+
+/// Canonical (perigee) track parameters with respect to the origin
+struct Parameters {
+  double d0;
+  double phi0;
+  double omega;
+  double z0;
+  double tanLambda;
+};
+
+/// Transverse, longitudinal and 3D distances between a point and the closest turn of the helix
+struct Distance {
+  double xy;
+  double z;
+  double xyz;
+};
+
+namespace kernel {
+
+  /// Nearest integer, with the tie breaking of HelixClass_double
+  inline double nearestTurn(double x) { return std::floor(x + 0.5); }
+
+  /// Angle in [0, 2pi)
+  inline double wrapTwoPi(double phi) {
+    phi -= TWO_PI * std::floor(phi / TWO_PI);
+    return phi >= TWO_PI ? phi - TWO_PI : phi;
+  }
+
+  /// Helix geometry from a point and the momentum at that point
+  inline void fromPositionMomentum(double x, double y, double px, double py, double pz, double charge, double bz,
+                                   double& xCentre, double& yCentre, double& radius, double& pxy, double& tanLambda,
+                                   double& phiRef) {
+    pxy                 = std::sqrt(px * px + py * py);
+    radius              = pxy / (FCT * bz);
+    tanLambda           = pz / pxy;
+    const double phiMom = std::atan2(py, px);
+    xCentre             = x + radius * std::cos(phiMom - PI_2 * charge);
+    yCentre             = y + radius * std::sin(phiMom - PI_2 * charge);
+    phiRef              = std::atan2(y - yCentre, x - xCentre);
+  }
+
+  /// Helix geometry from the canonical parameters, the anchor point is the point of closest approach to the origin
+  inline void fromCanonical(double phi0, double d0, double z0, double omega, double bz, double& xCentre,
+                            double& yCentre, double& radius, double& charge, double& pxy, double& refX, double& refY,
+                            double& refZ, double& phiRef) {
+    charge  = omega > 0 ? 1. : -1.;
+    radius  = 1. / std::fabs(omega);
+    pxy     = FCT * bz * radius;
+    refX    = -d0 * std::sin(phi0);
+    refY    = d0 * std::cos(phi0);
+    refZ    = z0;
+    xCentre = refX + radius * std::cos(phi0 - PI_2 * charge);
+    yCentre = refY + radius * std::sin(phi0 - PI_2 * charge);
+    phiRef  = std::atan2(refY - yCentre, refX - xCentre);
+  }
+
+  /// Canonical parameters of the helix
+  inline void canonical(double xCentre, double yCentre, double radius, double charge, double tanLambda, double refZ,
+                        double phiRef, double& d0, double& phi0, double& omega, double& z0) {
+    const double phiAtPCA = std::atan2(-yCentre, -xCentre);
+    phi0                  = wrapTwoPi(-PI_2 * charge + phiAtPCA);
+    d0 = charge * radius - (charge > 0 ? 1. : -1.) * std::sqrt(xCentre * xCentre + yCentre * yCentre);
+    omega                 = charge / radius;
+    // z0 is taken on the turn closest to z = 0
+    const double deltaPhi = phiRef - phiAtPCA;
+    const bool   helical  = std::fabs(tanLambda * radius) > 1.0e-20;
+    const double xCircles = (-refZ * charge / (helical ? radius * tanLambda : 1.) - deltaPhi) / TWO_PI;
+    const double nCircles = helical ? nearestTurn(xCircles) : 0.;
+    z0                    = refZ + radius * tanLambda * charge * (deltaPhi + TWO_PI * nCircles);
+  }
+
+  /// Momentum at a point on (or close to) the helix
+  inline void momentumAt(double xCentre, double yCentre, double charge, double pxy, double tanLambda, double x, double y,
+                         double& px, double& py, double& pz) {
+    const double phi = wrapTwoPi(std::atan2(y - yCentre, x - xCentre)) - PI_2 * charge;
+    px               = pxy * std::cos(phi);
+    py               = pxy * std::sin(phi);
+    pz               = pxy * tanLambda;
+  }
+
+  /// Distance of a point to the closest turn of the helix
+  inline void distanceToPoint(double xCentre, double yCentre, double radius, double charge, double tanLambda,
+                              double refZ, double phiRef, double x, double y, double z, double& distXY, double& distZ,
+                              double& dist) {
+    const double dx       = x - xCentre;
+    const double dy       = y - yCentre;
+    const double phi      = std::atan2(dy, dx);
+    distXY                = std::fabs(std::sqrt(dx * dx + dy * dy) - radius);
+    const bool   helical  = std::fabs(tanLambda * radius) > 1.0e-20;
+    const double zScale   = helical ? charge / (tanLambda * radius) : 0.;
+    const double xCircles = (phiRef - phi - zScale * (z - refZ)) / TWO_PI;
+    const double nCircles = helical ? nearestTurn(xCircles) : 0.;
+    const double dPhi     = TWO_PI * nCircles + phi - phiRef;
+    distZ                 = std::fabs(refZ - charge * radius * tanLambda * dPhi - z);
+    dist                  = std::sqrt(distXY * distXY + distZ * distZ);
+  }
+
+  /// Point of the helix at the transverse arc length s from the reference point
+  inline void positionAt(double xCentre, double yCentre, double radius, double charge, double tanLambda, double refZ,
+                         double phiRef, double s, double& x, double& y, double& z) {
+    const double phi = phiRef - charge * s / radius;
+    x                = xCentre + radius * std::cos(phi);
+    y                = yCentre + radius * std::sin(phi);
+    z                = refZ + s * tanLambda;
+  }
+
+  /// Intersection with the plane z = zPlane, found is false for a helix parallel to the plane
+  inline void intersectZPlane(double xCentre, double yCentre, double radius, double charge, double tanLambda,
+                              double refZ, double phiRef, double zPlane, double& x, double& y, double& z, double& s,
+                              bool& found) {
+    found            = std::fabs(tanLambda) > 1.0e-20;
+    s                = found ? (zPlane - refZ) / tanLambda : 0.;
+    const double phi = phiRef - charge * s / radius;
+    x                = xCentre + radius * std::cos(phi);
+    y                = yCentre + radius * std::sin(phi);
+    z                = zPlane;
+  }
+
+  /// First intersection, moving forward, with the cylinder of radius rCylinder around the z axis
+  inline void intersectCylinder(double xCentre, double yCentre, double radius, double charge, double tanLambda,
+                                double refZ, double phiRef, double rCylinder, double& x, double& y, double& z,
+                                double& s, bool& found) {
+    const double distCentre = std::sqrt(xCentre * xCentre + yCentre * yCentre);
+    found                   = (distCentre + radius >= rCylinder) && (radius + rCylinder >= distCentre);
+    const double phiCentre  = std::atan2(yCentre, xCentre);
+    double       cosStar    = 0.5 * (rCylinder * rCylinder + distCentre * distCentre - radius * radius) /
+                     std::max(1.e-20, rCylinder * distCentre);
+    cosStar                 = std::clamp(cosStar, -0.9999999, 0.9999999);
+    const double phiStar    = std::acos(cosStar);
+    // the two crossing points, and the turning angle needed to reach each of them moving forward
+    const double x1    = rCylinder * std::cos(phiCentre + phiStar);
+    const double y1    = rCylinder * std::sin(phiCentre + phiStar);
+    const double x2    = rCylinder * std::cos(phiCentre - phiStar);
+    const double y2    = rCylinder * std::sin(phiCentre - phiStar);
+    double       dPhi1 = std::atan2(y1 - yCentre, x1 - xCentre) - phiRef;
+    double       dPhi2 = std::atan2(y2 - yCentre, x2 - xCentre) - phiRef;
+    dPhi1 += (dPhi1 < 0. && charge < 0.) ? TWO_PI : ((dPhi1 > 0. && charge > 0.) ? -TWO_PI : 0.);
+    dPhi2 += (dPhi2 < 0. && charge < 0.) ? TWO_PI : ((dPhi2 > 0. && charge > 0.) ? -TWO_PI : 0.);
+    const double s1    = -charge * dPhi1 * radius;
+    const double s2    = -charge * dPhi2 * radius;
+    const bool   first = s1 < s2;
+    s                  = first ? s1 : s2;
+    x                  = first ? x1 : x2;
+    y                  = first ? y1 : y2;
+    z                  = refZ + s * tanLambda;
+  }
+
+} // namespace kernel
+
+/// One helix, anchored at a reference point
+struct Helix {
+  double xCentre   = 0;
+  double yCentre   = 0;
+  double radius    = 0;
+  double charge    = 0;
+  double pxy       = 0;
+  double tanLambda = 0;
+  double refX      = 0;
+  double refY      = 0;
+  double refZ      = 0;
+  /// Phase of the reference point seen from the helix centre
+  double phiRef = 0;
+
+  /// Helix through pos with momentum mom at that point (HelixClass_double::Initialize_VP)
+  static Helix fromPositionMomentum(const double pos[3], const double mom[3], double charge, double bz) {
+    Helix h;
+    h.charge = charge;
+    h.refX   = pos[0];
+    h.refY   = pos[1];
+    h.refZ   = pos[2];
+    kernel::fromPositionMomentum(pos[0], pos[1], mom[0], mom[1], mom[2], charge, bz, h.xCentre, h.yCentre, h.radius,
+                                 h.pxy, h.tanLambda, h.phiRef);
+    return h;
+  }
+
+  /// Helix from canonical parameters (HelixClass_double::Initialize_Canonical and the pandora::Helix constructor)
+  static Helix fromCanonical(double phi0, double d0, double z0, double omega, double tanLambda, double bz) {
+    Helix h;
+    h.tanLambda = tanLambda;
+    kernel::fromCanonical(phi0, d0, z0, omega, bz, h.xCentre, h.yCentre, h.radius, h.charge, h.pxy, h.refX,
+                          h.refY, h.refZ, h.phiRef);
+    return h;
+  }
+
+  Parameters parameters() const {
+    Parameters p;
+    p.tanLambda = tanLambda;
+    kernel::canonical(xCentre, yCentre, radius, charge, tanLambda, refZ, phiRef, p.d0, p.phi0, p.omega, p.z0);
+    return p;
+  }
+
+  /// Momentum at the point of the helix at the azimuth of pos (HelixClass_double::getExtrapolatedMomentum)
+  void momentumAt(const double pos[3], double mom[3]) const {
+    kernel::momentumAt(xCentre, yCentre, charge, pxy, tanLambda, pos[0], pos[1], mom[0], mom[1], mom[2]);
+  }
+
+  /// Distance to the closest turn of the helix (HelixClass_double::getDistanceToPoint)
+  Distance distanceToPoint(const double pos[3]) const {
+    Distance d;
+    kernel::distanceToPoint(xCentre, yCentre, radius, charge, tanLambda, refZ, phiRef, pos[0], pos[1], pos[2], d.xy,
+                            d.z, d.xyz);
+    return d;
+  }
+
+  /// Point at the transverse arc length s from the reference point
+  void positionAt(double s, double pos[3]) const {
+    kernel::positionAt(xCentre, yCentre, radius, charge, tanLambda, refZ, phiRef, s, pos[0], pos[1], pos[2]);
+  }
+
+  /// Intersection with a z plane (pandora::Helix::GetPointInZ), s is the transverse arc length from the reference point
+  bool intersectZPlane(double zPlane, double pos[3], double& s) const {
+    bool found;
+    kernel::intersectZPlane(xCentre, yCentre, radius, charge, tanLambda, refZ, phiRef, zPlane, pos[0], pos[1], pos[2],
+                            s, found);
+    return found;
+  }
+
+  /// First forward intersection with a cylinder around the z axis (pandora::Helix::GetPointOnCircle)
+  bool intersectCylinder(double rCylinder, double pos[3], double& s) const {
+    bool found;
+    kernel::intersectCylinder(xCentre, yCentre, radius, charge, tanLambda, refZ, phiRef, rCylinder, pos[0], pos[1],
+                              pos[2], s, found);
+    return found;
+  }
+};
+
+/// Many helices in structure-of-arrays form
+struct HelixSoA {
+  std::vector<double> xCentre, yCentre, radius, charge, pxy, tanLambda, refX, refY, refZ, phiRef;
+
+  std::size_t size() const { return xCentre.size(); }
+
+  void resize(std::size_t n) {
+    for (auto* v : {&xCentre, &yCentre, &radius, &charge, &pxy, &tanLambda, &refX, &refY, &refZ, &phiRef})
+      v->resize(n);
+  }
+
+  Helix get(std::size_t i) const {
+    return Helix{xCentre[i], yCentre[i], radius[i], charge[i], pxy[i], tanLambda[i], refX[i], refY[i], refZ[i], phiRef[i]};
+  }
+};
+
+/// Helices through the points (x, y, z) with momenta (px, py, pz)
+inline void fromPositionMomentum(std::size_t n, const double* x, const double* y, const double* z, const double* px,
+                                 const double* py, const double* pz, const double* charge, double bz, HelixSoA& out) {
+  out.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    out.charge[i] = charge[i];
+    out.refX[i]   = x[i];
+    out.refY[i]   = y[i];
+    out.refZ[i]   = z[i];
+    kernel::fromPositionMomentum(x[i], y[i], px[i], py[i], pz[i], charge[i], bz, out.xCentre[i], out.yCentre[i],
+                                 out.radius[i], out.pxy[i], out.tanLambda[i], out.phiRef[i]);
+  }
+}
+
+/// Canonical parameters of all the helices
+inline void canonicalParameters(const HelixSoA& helices, double* d0, double* phi0, double* omega, double* z0,
+                                double* tanLambda) {
+  for (std::size_t i = 0, n = helices.size(); i < n; ++i) {
+    tanLambda[i] = helices.tanLambda[i];
+    kernel::canonical(helices.xCentre[i], helices.yCentre[i], helices.radius[i], helices.charge[i],
+                      helices.tanLambda[i], helices.refZ[i], helices.phiRef[i], d0[i], phi0[i], omega[i], z0[i]);
+  }
+}
+
+/// Intersections of all the helices with the plane z = +zPlane or -zPlane, on the side they are moving to
+inline void intersectZPlanes(const HelixSoA& helices, double zPlane, double* x, double* y, double* z, double* s,
+                             uint8_t* found) {
+  for (std::size_t i = 0, n = helices.size(); i < n; ++i) {
+    bool         f;
+    const double side = helices.tanLambda[i] > 0. ? zPlane : -zPlane;
+    kernel::intersectZPlane(helices.xCentre[i], helices.yCentre[i], helices.radius[i], helices.charge[i],
+                            helices.tanLambda[i], helices.refZ[i], helices.phiRef[i], side, x[i], y[i], z[i], s[i], f);
+    found[i] = f;
+  }
+}
+
+/// First forward intersections of all the helices with a cylinder around the z axis
+inline void intersectCylinders(const HelixSoA& helices, double rCylinder, double* x, double* y, double* z, double* s,
+                               uint8_t* found) {
+  for (std::size_t i = 0, n = helices.size(); i < n; ++i) {
+    bool f;
+    kernel::intersectCylinder(helices.xCentre[i], helices.yCentre[i], helices.radius[i], helices.charge[i],
+                              helices.tanLambda[i], helices.refZ[i], helices.phiRef[i], rCylinder, x[i], y[i], z[i],
+                              s[i], f);
+    found[i] = f;
+  }
+}
+
+/// 3D distances of many points to one helix
+inline void distancesToPoints(const Helix& helix, std::size_t n, const double* x, const double* y, const double* z,
+                              double* distances) {
+  for (std::size_t i = 0; i < n; ++i) {
+    double distXY, distZ;
+    kernel::distanceToPoint(helix.xCentre, helix.yCentre, helix.radius, helix.charge, helix.tanLambda, helix.refZ,
+                            helix.phiRef, x[i], y[i], z[i], distXY, distZ, distances[i]);
+  }
+}
+
+/// Point of closest approach in 3D of a helix to a point
+struct ClosestApproach {
+  /// Transverse arc length from the reference point of the helix
+  double s;
+  double position[3];
+  double distance;
+};
+
+/** Positions of one helix sampled at fixed steps of transverse arc length, for repeated closest approach queries on
+ *  the same track (hit residuals, hit to track association).
+ *  A query starts from the nearest sample, within half a step of the closest approach, and converges with one or two
+ *  Newton steps on the derivative of the squared distance. Unlike distanceToPoint, which combines the transverse and
+ *  longitudinal distances to the closest turn, it gives the true 3D distance, also for loopers and low tanLambda.
+ *  The step must be small compared to the radius of the helix for the nearest sample to be on the right turn.
+ */
+class ArcLengthCache {
+public:
+  /// Sample the helix from sBegin to at least sEnd, every step [mm]
+  void build(const Helix& helix, double sBegin, double sEnd, double step) {
+    m_helix             = helix;
+    m_sBegin            = sBegin;
+    m_step              = step;
+    const std::size_t n = std::size_t(std::max(0., std::ceil((sEnd - sBegin) / step))) + 1;
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+      kernel::positionAt(helix.xCentre, helix.yCentre, helix.radius, helix.charge, helix.tanLambda, helix.refZ,
+                         helix.phiRef, sBegin + i * step, m_x[i], m_y[i], m_z[i]);
+  }
+
+  const Helix& helix() const { return m_helix; }
+  std::size_t  size() const { return m_x.size(); }
+
+  /// Closest approach to pos, from the nearest sample and at most newtonSteps Newton steps
+  ClosestApproach closestApproach(const double pos[3], int newtonSteps = 2) const {
+    // the closest approach is within |z - pos[2]| <= distance of pos, i.e. within distance / |tanLambda| in s of the
+    // point at the height of pos: only the samples of that window are searched for the nearest one
+    const Helix& h     = m_helix;
+    std::size_t  first = 0;
+    std::size_t  last  = m_x.size();
+    if (std::fabs(h.tanLambda) > 1.e-6) {
+      const double sAtZ     = (pos[2] - h.refZ) / h.tanLambda;
+      const double atZ      = std::clamp(std::round((sAtZ - m_sBegin) / m_step), 0., double(last - 1));
+      const auto   i        = std::size_t(atZ);
+      const double dx       = m_x[i] - pos[0], dy = m_y[i] - pos[1], dz = m_z[i] - pos[2];
+      const double halfSize = std::sqrt(dx * dx + dy * dy + dz * dz) / (std::fabs(h.tanLambda) * m_step) + 1.;
+      first                 = std::size_t(std::clamp(std::floor((sAtZ - m_sBegin) / m_step - halfSize), 0., atZ));
+      last = std::size_t(std::clamp(std::ceil((sAtZ - m_sBegin) / m_step + halfSize), atZ, double(last - 1))) + 1;
+    }
+    std::size_t nearest  = first;
+    double      nearest2 = std::numeric_limits<double>::max();
+    for (std::size_t i = first; i < last; ++i) {
+      const double dx = m_x[i] - pos[0], dy = m_y[i] - pos[1], dz = m_z[i] - pos[2];
+      const double d2 = dx * dx + dy * dy + dz * dz;
+      nearest         = d2 < nearest2 ? i : nearest;
+      nearest2        = std::min(d2, nearest2);
+    }
+    // Newton steps on g(s) = (P(s) - pos) . P'(s), with |P'|^2 = q^2 + tanLambda^2 and P'' = -q^2 (cos(phi), sin(phi)) / R
+    const double charge2  = h.charge * h.charge;
+    const double tangent2 = charge2 + h.tanLambda * h.tanLambda;
+    double       s        = m_sBegin + nearest * m_step;
+    for (int step = 0; step < newtonSteps; ++step) {
+      const double phi        = h.phiRef - h.charge * s / h.radius;
+      const double cosPhi     = std::cos(phi);
+      const double sinPhi     = std::sin(phi);
+      const double dx         = h.xCentre + h.radius * cosPhi - pos[0];
+      const double dy         = h.yCentre + h.radius * sinPhi - pos[1];
+      const double dz         = h.refZ + s * h.tanLambda - pos[2];
+      const double g          = h.charge * (dx * sinPhi - dy * cosPhi) + dz * h.tanLambda;
+      const double derivative = tangent2 - charge2 * (dx * cosPhi + dy * sinPhi) / h.radius;
+      // away from a minimum (points beyond the centre of curvature), keep the sample
+      if (derivative <= 0.)
+        break;
+      const double ds = g / derivative;
+      s -= ds;
+      if (std::fabs(ds) < 1.e-9 * (1. + std::fabs(s)))
+        break;
+    }
+    ClosestApproach result;
+    result.s = s;
+    h.positionAt(s, result.position);
+    result.distance = std::sqrt((result.position[0] - pos[0]) * (result.position[0] - pos[0]) +
+                                (result.position[1] - pos[1]) * (result.position[1] - pos[1]) +
+                                (result.position[2] - pos[2]) * (result.position[2] - pos[2]));
+    return result;
+  }
+
+  /// 3D distances of many points to the helix
+  void distancesToPoints(std::size_t n, const double* x, const double* y, const double* z, double* distances,
+                         int newtonSteps = 2) const {
+    for (std::size_t i = 0; i < n; ++i) {
+      const double pos[3] = {x[i], y[i], z[i]};
+      distances[i]        = closestApproach(pos, newtonSteps).distance;
+    }
+  }
+
+private:
+  Helix               m_helix;
+  double              m_sBegin = 0.;
+  double              m_step   = 1.;
+  std::vector<double> m_x, m_y, m_z;
+};
+
+} // namespace HelixMath
@@ -0,0 +1,712 @@
+#pragma once
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/** @namespace HoughSeeding
+ *
+ *  Track seeds from drift chamber hits with a Hough transform, for tracks coming from the origin.
+ *
+ *  Transverse stage: a circle through the origin leaving it with direction phi0 and curvature omega (conventions of
+ *  HelixMath: d0 = 0, the direction is phi0 - omega s after a transverse arc length s) passes at a distance d of the
+ *  wire at (x, y) when
+ *    omega (r^2 - d^2) / 2 = x sin phi0 - y cos phi0 +- d,
+ *  so each hit draws two curves omega(phi0) in a flat (phi0, omega) accumulator, one per side of the wire. A hit votes
+ *  in each phi0 column for the omega bins that its curves cross in that column, only in the columns where it is ahead
+ *  of the origin (first half turn) and where |omega| is in range. The omega bin ranges are computed for one hit at a
+ *  time in plain loops over its columns, that the compiler vectorizes. The accumulator holds the differences between
+ *  consecutive omega bins, so that a vote is two increments per column whatever the length of the range. The counts
+ *  are summed along omega for blocks of phi0 columns, in the vector lanes, and the highest cell of each column is kept:
+ *  after the first peak, only the blocks of the columns whose votes changed (the votes of the hits of a seed, or a
+ *  vetoed cell) are summed again, and the highest cell is found from the column maxima.
+ *  The transform runs coarse to fine: all the hits vote in a coarse accumulator, with coarseFactor times fewer bins
+ *  along each axis, where a hit crosses coarseFactor times fewer columns. Only the hits that voted in the highest coarse
+ *  cell and in its neighbours vote again, in the fine cells of these coarse cells, and the highest fine cell makes the
+ *  seed. A coarse cell whose fine cells all fall below minHits is vetoed, as is a fine cell that gives no seed.
+ *  The highest fine cell gives the hits that voted in it; their circle is fitted (Gauss-Newton on the distances to the
+ *  wires), all the free hits close to the fitted circle are collected and the circle is fitted again. The votes of the
+ *  hits of an accepted seed are removed from the coarse accumulator before the next peak is looked for, so each hit
+ *  belongs to at most one seed.
+ *
+ *  Longitudinal stage: the hits of the seed, together with the hits close to the circle among those that do not vote
+ *  (e.g. wires with a large stereo angle), give z = z0 + tanLambda s, with s the arc length of the hit along the
+ *  circle and z its measured position along the wire. The line is fitted with iterative rejection of the outliers,
+ *  before each circle fit: the hits of another track with a close transverse projection are given back to the other
+ *  seeds.
+ *
+ */
+
+namespace HoughSeeding {
+
+struct Config {
+  /// Maximum |omega| [1/mm], from the minimum transverse momentum
+  double maxOmega = 2.e-3;
+  /// Accumulator bins, rounded up to multiples of 8 coarse bins
+  uint32_t phiBins   = 512;
+  uint32_t omegaBins = 256;
+  /// Fine bins per coarse bin, in phi0 and in omega (1: the coarse accumulator is the fine one)
+  uint32_t coarseFactor = 4;
+  /// Minimum number of hits of a seed, in the peak and after the fits
+  uint32_t minHits = 15;
+  /// Maximum difference between the distance of the circle to the wire and the drift distance [mm]
+  double maxResidual = 1.;
+  /// Maximum residual of the hits to the fitted line in z [mm]
+  double maxZResidual = 10.;
+  /// Maximum chi2 / ndf of the circle fit, above which the hits are on the wrong side of their wires
+  double maxChi2PerNdf = 4.;
+  /// Resolutions of the drift distance and of the position along the wire [mm], for the covariances
+  double driftResolution = 0.1;
+  double zResolution     = 1.;
+};
+
+struct Hit {
+  /// Point of the wire at the hit
+  double x, y, z;
+  double driftDistance;
+  /// Whether the hit votes in the transverse stage, otherwise it is only attached to the seeds
+  bool vote;
+};
+
+struct Seed {
+  double phi0, omega, z0, tanLambda;
+  /// Covariances of (phi0, omega) and of (z0, tanLambda): (00, 10, 11)
+  double   transverseCov[3], longitudinalCov[3];
+  double   chi2;
+  int      ndf;
+  /// Range of the seed in hits(), which holds the hit indices of all seeds ordered by arc length
+  uint32_t firstHit, nHits;
+};
+
+/// Distance between the point (x, y) and the circle through the origin with direction phi0 and curvature omega,
+/// positive outside the circle (in a form that is stable when omega goes to 0)
+inline double distance(double x, double y, double sinPhi, double cosPhi, double omega) {
+  const double q  = x * sinPhi - y * cosPhi;
+  const double ux = omega * x - sinPhi;
+  const double uy = omega * y + cosPhi;
+  return (omega * (x * x + y * y) - 2. * q) / (1. + std::sqrt(ux * ux + uy * uy));
+}
+
+/// Transverse arc length from the origin to the point of the circle closest to (x, y), on the first half turn
+inline double arcLength(double x, double y, double omega) {
+  const double chord = std::sqrt(x * x + y * y);
+  const double v     = std::min(std::fabs(0.5 * omega * chord), 1.);
+  return v > 1.e-8 ? chord * std::asin(v) / v : chord;
+}
+
+class Finder {
+public:
+  Finder() = default;
+  explicit Finder(const Config& config) { setConfig(config); }
+
+  void setConfig(const Config& config) {
+    m_config              = config;
+    m_config.coarseFactor = std::max(config.coarseFactor, 1u);
+    const uint32_t factor = m_config.coarseFactor;
+    // the coarse bins are multiples of s_block, and each of them is coarseFactor fine bins
+    const uint32_t coarsePhi   = padded((std::max(config.phiBins, 1u) + factor - 1) / factor);
+    const uint32_t coarseOmega = padded((std::max(config.omegaBins, 1u) + factor - 1) / factor);
+    m_config.phiBins           = coarsePhi * factor;
+    m_config.omegaBins         = coarseOmega * factor;
+    m_coarse.setBins(coarsePhi, coarseOmega, m_config.maxOmega);
+    m_fine.setBins(m_config.phiBins, m_config.omegaBins, m_config.maxOmega);
+    m_edgeBins.resize(m_config.phiBins + s_block);
+    m_ranges.resize(m_config.phiBins);
+  }
+
+  const Config& config() const { return m_config; }
+
+  /// Find the seeds in the hits; the seeds and their hits stay valid until the next call
+  const std::vector<Seed>& find(const Hit* hits, std::size_t nHits) {
+    m_seeds.clear();
+    m_hits.clear();
+    m_vetoedCells.clear();
+    loadHits(hits, nHits);
+    m_coarse.clear();
+    m_fine.clear();
+    for (uint32_t i = 0; i < m_nHits; ++i)
+      if (m_flags[i].voter)
+        vote(m_coarse, i, 1, 0, m_coarse.nPhi);
+
+    const uint32_t factor = m_config.coarseFactor;
+    while (true) {
+      uint32_t coarsePhi, coarseOmega;
+      if (findPeak(m_coarse, 0, m_coarse.nPhi, 0, m_coarse.nOmega - 1, coarsePhi, coarseOmega) <
+          int32_t(m_config.minHits))
+        break;
+      // fine transform of the hits voting around the coarse cell, in the fine cells of the coarse cell and of its
+      // neighbours, as a track peaking near a coarse edge shares its votes with the next coarse cell
+      const uint32_t firstColumn = (coarsePhi + m_coarse.nPhi - 1) % m_coarse.nPhi * factor;
+      const uint32_t nColumns    = std::min(3 * factor, m_fine.nPhi);
+      const uint32_t lowRow      = coarseOmega > 0 ? (coarseOmega - 1) * factor : 0;
+      const uint32_t highRow     = std::min(coarseOmega + 2, m_coarse.nOmega) * factor - 1;
+      selectVoters(m_coarse, (coarsePhi + m_coarse.nPhi - 1) % m_coarse.nPhi, std::min(3u, m_coarse.nPhi),
+                   coarseOmega > 0 ? coarseOmega - 1 : 0, std::min(coarseOmega + 1, m_coarse.nOmega - 1));
+      for (uint32_t i = 0; i < m_nHits; ++i)
+        if (m_flags[i].selected)
+          vote(m_fine, i, 1, firstColumn, nColumns);
+      for (const auto& [phiBin, omegaBin] : m_vetoedCells)
+        if ((phiBin + m_fine.nPhi - firstColumn) % m_fine.nPhi < nColumns)
+          m_fine.veto(phiBin, omegaBin, s_vetoed);
+      // highest fine cell, until one gives a seed or they are all below the threshold
+      while (true) {
+        uint32_t phiBin, omegaBin;
+        if (findPeak(m_fine, firstColumn, nColumns, lowRow, highRow, phiBin, omegaBin) < int32_t(m_config.minHits)) {
+          // keep the coarse cell below the threshold whatever happens to the other votes
+          m_coarse.veto(coarsePhi, coarseOmega, s_vetoed);
+          break;
+        }
+        if (makeSeed(phiBin, omegaBin)) {
+          const Seed& seed = m_seeds.back();
+          for (uint32_t k = seed.firstHit; k < seed.firstHit + seed.nHits; ++k) {
+            Flags& flags = m_flags[m_hits[k]];
+            if (flags.voter)
+              vote(m_coarse, m_hits[k], -1, 0, m_coarse.nPhi);
+            flags.voter = flags.free = 0;
+          }
+          break;
+        }
+        // no seed from this fine cell, also when the transform around the coarse cell is made again
+        m_fine.veto(phiBin, omegaBin, s_vetoed);
+        m_vetoedCells.emplace_back(phiBin, omegaBin);
+      }
+      m_fine.clearColumns(firstColumn, nColumns);
+    }
+    return m_seeds;
+  }
+
+  /// Hit indices of the seeds, see Seed::firstHit
+  const std::vector<uint32_t>& hits() const { return m_hits; }
+  /// Allocated memory of the accumulators and of the per event buffers, in bytes
+  std::size_t memory() const {
+    auto bytes = [](const auto& v) { return v.capacity() * sizeof(v[0]); };
+    return m_coarse.memory() + m_fine.memory() + bytes(m_x) + bytes(m_y) + bytes(m_z) + bytes(m_drift) +
+           bytes(m_scale) + bytes(m_radius) + bytes(m_azimuth) + bytes(m_halfWidth) + bytes(m_distance) +
+           bytes(m_flags) + bytes(m_edgeBins) + bytes(m_ranges) + bytes(m_seeds) + bytes(m_hits) + bytes(m_track) +
+           bytes(m_vetoedCells);
+  }
+
+private:
+  /// Cells of the accumulator that gave no seed, far enough below 0 to never come back above the threshold
+  static constexpr int16_t s_vetoed = -16384;
+  /// The loops over the phi bins, the omega bins and the hits run by blocks of s_block iterations: with a constant trip
+  /// count, the compiler vectorizes them at -O2 without scalar epilogue
+  static constexpr uint32_t s_block = 8;
+
+  static uint32_t padded(std::size_t n) { return (n + s_block - 1) / s_block * s_block; }
+
+  /// Binning of the (phi0, omega) plane, and its accumulator
+  struct Grid {
+    uint32_t nPhi = 0, nOmega = 0;
+    double   phiWidth = 0., omegaWidth = 0.;
+    /// trigonometric tables of the phi0 bins, over two turns so that the columns of a hit are contiguous in the tables,
+    /// plus the padding of the loop over the edges
+    std::vector<double> sinEdge, cosEdge, sinCentre, cosCentre;
+    /// (phi0, omega) votes, as differences between consecutive omega bins: the count of a cell is the sum of its column
+    /// up to its row. The phi0 bins are contiguous in each row, so that the sums run in vector lanes along phi0. The
+    /// extra row takes the end of the ranges up to the last bin.
+    std::vector<int16_t> accumulator;
+    /// highest count of each phi0 column in the rows of the last scan and its first omega bin, valid for the blocks of
+    /// columns that are not dirty
+    std::vector<int32_t> columnMaximum, columnPeak;
+    /// blocks of s_block phi0 columns whose votes changed since they were last summed
+    std::vector<uint8_t> dirtyBlocks;
+
+    double phiEdge(uint32_t j) const { return -M_PI + j * phiWidth; }
+
+    void setBins(uint32_t phiBins, uint32_t omegaBins, double maxOmega) {
+      phiWidth   = 2. * M_PI / phiBins;
+      omegaWidth = 2. * maxOmega / omegaBins;
+      // the tables only depend on the numbers of bins: setting the same configuration again costs nothing
+      if (phiBins == nPhi && omegaBins == nOmega)
+        return;
+      nPhi                  = phiBins;
+      nOmega                = omegaBins;
+      const uint32_t nTable = 2 * nPhi + s_block;
+      sinEdge.resize(nTable);
+      cosEdge.resize(nTable);
+      sinCentre.resize(nTable);
+      cosCentre.resize(nTable);
+      for (uint32_t j = 0; j < nTable; ++j) {
+        sinEdge[j]   = std::sin(phiEdge(j));
+        cosEdge[j]   = std::cos(phiEdge(j));
+        sinCentre[j] = std::sin(phiEdge(j) + 0.5 * phiWidth);
+        cosCentre[j] = std::cos(phiEdge(j) + 0.5 * phiWidth);
+      }
+      accumulator.assign(std::size_t(nPhi) * (nOmega + 1), 0);
+      columnMaximum.resize(nPhi);
+      columnPeak.resize(nPhi);
+      dirtyBlocks.resize(nPhi / s_block);
+    }
+
+    void clear() {
+      std::fill(accumulator.begin(), accumulator.end(), 0);
+      std::fill(dirtyBlocks.begin(), dirtyBlocks.end(), 1);
+    }
+
+    /// Set the columns [first, first + n) (modulo a turn) back to no vote
+    void clearColumns(uint32_t first, uint32_t n) {
+      for (uint32_t k = 0; k < n; ++k) {
+        const uint32_t j = (first + k) % nPhi;
+        for (std::size_t row = 0; row <= nOmega; ++row)
+          accumulator[row * nPhi + j] = 0;
+        dirtyBlocks[j / s_block] = 1;
+      }
+    }
+
+    /// Add weight to the count of a cell only, s_vetoed to keep it below the threshold whatever happens to the other
+    /// votes
+    void veto(uint32_t phiBin, uint32_t omegaBin, int16_t weight) {
+      accumulator[std::size_t(omegaBin) * nPhi + phiBin] += weight;
+      accumulator[std::size_t(omegaBin + 1) * nPhi + phiBin] -= weight;
+      dirtyBlocks[phiBin / s_block] = 1;
+    }
+
+    std::size_t memory() const {
+      auto bytes = [](const auto& v) { return v.capacity() * sizeof(v[0]); };
+      return bytes(sinEdge) + bytes(cosEdge) + bytes(sinCentre) + bytes(cosCentre) + bytes(accumulator) +
+             bytes(columnMaximum) + bytes(columnPeak) + bytes(dirtyBlocks);
+    }
+  };
+
+  void loadHits(const Hit* hits, std::size_t nHits) {
+    // the padding hits are at the origin and never selected
+    m_nHits               = nHits;
+    const uint32_t nSlots = padded(nHits);
+    for (auto* buffer : {&m_x, &m_y, &m_z, &m_drift, &m_scale, &m_radius, &m_azimuth, &m_halfWidth, &m_distance})
+      buffer->assign(nSlots, 0.);
+    m_flags.assign(nSlots, Flags{0, 0, 0});
+    for (std::size_t i = 0; i < nHits; ++i) {
+      m_x[i]     = hits[i].x;
+      m_y[i]     = hits[i].y;
+      m_z[i]     = hits[i].z;
+      m_drift[i] = hits[i].driftDistance;
+      // a wire closer to the origin than its drift distance cannot be reached by a circle through the origin
+      const double r2 = hits[i].x * hits[i].x + hits[i].y * hits[i].y - hits[i].driftDistance * hits[i].driftDistance;
+      m_flags[i].voter = hits[i].vote && r2 > 0.;
+      m_flags[i].free  = 1;
+      // omega = (q +- d) scale, the bin coordinate is omega / omegaWidth + offset
+      m_scale[i] = r2 > 0. ? 2. / r2 : 0.;
+      // |omega| < maxOmega gives |sin(phi0 - azimuth)| < (maxOmega (r^2 - d^2) / 2 + d) / r, and the hit is ahead within
+      // a quarter turn of its azimuth
+      const double r       = std::sqrt(hits[i].x * hits[i].x + hits[i].y * hits[i].y);
+      const double sinWidth = r > 0. ? (m_config.maxOmega * r2 / 2. + hits[i].driftDistance) / r : 1.;
+      m_radius[i]    = r;
+      m_azimuth[i]   = std::atan2(hits[i].y, hits[i].x) + M_PI;
+      m_halfWidth[i] = sinWidth < 1. ? std::asin(sinWidth) : 0.5 * M_PI;
+    }
+  }
+
+  /// Range of omega bins crossed by the curves of a hit in the phi columns it can vote in, among the columns
+  /// [windowFirst, windowFirst + windowColumns) (modulo a turn), from the bins at the edges of the columns:
+  /// m_ranges[k] is the range of column m_firstColumn + k (modulo a turn), k < m_nColumns
+  void computeRanges(const Grid& grid, uint32_t i, uint32_t windowFirst, uint32_t windowColumns) {
+    const uint32_t nPhi   = grid.nPhi;
+    const int32_t  nOmega = grid.nOmega;
+    const double   x      = m_x[i];
+    const double   y      = m_y[i];
+    const double   d      = m_drift[i];
+    const double   scale  = m_scale[i] / grid.omegaWidth;
+    const double   offset = 0.5 * nOmega;
+    const int      first  = int(std::floor((m_azimuth[i] - m_halfWidth[i]) / grid.phiWidth));
+    const int      last   = int(std::floor((m_azimuth[i] + m_halfWidth[i]) / grid.phiWidth));
+    const uint32_t hitFirst = first < 0 ? first + nPhi : first;
+    const uint32_t hitCount = std::min(uint32_t(last - first + 1), nPhi);
+    // the centres of the inner columns are within the half width of the azimuth, only the first and the last columns
+    // can be behind the origin
+    const auto ahead = [&grid, x, y](uint32_t j) { return x * grid.cosCentre[j] + y * grid.sinCentre[j] > 0.; };
+    // columns of the hit in the window; the window and the columns of the hit are less than a turn together, so the
+    // columns in the window are contiguous
+    uint32_t skip = 0, count = hitCount;
+    if (windowColumns < nPhi) {
+      const uint32_t windowOffset = (windowFirst + nPhi - hitFirst) % nPhi;
+      const uint32_t hitOffset    = (hitFirst + nPhi - windowFirst) % nPhi;
+      if (windowOffset < hitCount) {
+        skip  = windowOffset;
+        count = std::min(hitCount - windowOffset, windowColumns);
+      } else {
+        count = hitOffset < windowColumns ? std::min(hitCount, windowColumns - hitOffset) : 0;
+      }
+    }
+    m_firstColumn          = hitFirst + skip;
+    m_nColumns             = count;
+    const double* sinEdge  = grid.sinEdge.data() + m_firstColumn;
+    const double* cosEdge  = grid.cosEdge.data() + m_firstColumn;
+    EdgeBins*     edges    = m_edgeBins.data();
+    Range*        ranges   = m_ranges.data();
+    const int32_t nColumns = count;
+    const int32_t begin    = skip == 0 && !ahead(hitFirst) ? 1 : 0;
+    const int32_t end      = skip + count == hitCount && !ahead(hitFirst + hitCount - 1) ? nColumns - 1 : nColumns;
+    // bins of the curves at the edges, clamped to [-1, nOmega], where the truncation (after + 1, before - 1) is the
+    // floor. The bins are increasing with q, so the range of a column is between the bins at its two edges.
+    const auto bin = [nOmega, scale, offset](double value) {
+      return int16_t(std::clamp(value * scale + offset + 1., 0., double(nOmega + 1))) - 1;
+    };
+    for (int32_t block = 0; block <= nColumns; block += s_block)
+      for (int32_t k = 0; k < int32_t(s_block); ++k) {
+        const int32_t j = block + k;
+        const double  q = x * sinEdge[j] - y * cosEdge[j];
+        edges[j].minus  = bin(q - d);
+        edges[j].plus   = bin(q + d);
+      }
+    for (int32_t block = 0; block < nColumns; block += s_block)
+      for (int32_t k = 0; k < int32_t(s_block); ++k) {
+        const int32_t j     = block + k;
+        const int32_t m0    = edges[j].minus;
+        const int32_t m1    = edges[j + 1].minus;
+        const int32_t p0    = edges[j].plus;
+        const int32_t p1    = edges[j + 1].plus;
+        const int32_t mLow  = std::max(std::min(m0, m1), 0);
+        const int32_t mHigh = std::min(std::max(m0, m1), nOmega - 1);
+        // the curve of the other side is always at larger omega, do not vote twice in the same cell
+        const int32_t pHigh = std::min(std::max(p0, p1), nOmega - 1);
+        const int32_t pLow  = std::min(std::max(std::max(std::min(p0, p1), 0), mHigh + 1), pHigh + 1);
+        // empty ranges behind the origin and in the padding, with a mask: a select would move the loads to a branch
+        const int32_t outside = -int32_t((j < begin) | (j >= end));
+        ranges[j].low[0]      = mLow & ~outside;
+        ranges[j].high[0]     = mHigh | outside;
+        ranges[j].low[1]      = pLow & ~outside;
+        ranges[j].high[1]     = pHigh | outside;
+      }
+  }
+
+  /// Add (weight 1) or remove (weight -1) the votes of a hit in the columns [windowFirst, windowFirst + windowColumns)
+  void vote(Grid& grid, uint32_t i, int16_t weight, uint32_t windowFirst, uint32_t windowColumns) {
+    computeRanges(grid, i, windowFirst, windowColumns);
+    const uint32_t nPhi = grid.nPhi;
+    int16_t*       rows = grid.accumulator.data();
+    // a range adds the weight from its low bin on and removes it after its high bin; the empty ranges (high = low - 1)
+    // add and remove it in the same cell
+    for (uint32_t k = 0; k < m_nColumns; ++k) {
+      const uint32_t j = m_firstColumn + k < nPhi ? m_firstColumn + k : m_firstColumn + k - nPhi;
+      for (const int side : {0, 1}) {
+        rows[std::size_t(m_ranges[k].low[side]) * nPhi + j] += weight;
+        rows[std::size_t(m_ranges[k].high[side] + 1) * nPhi + j] -= weight;
+      }
+      grid.dirtyBlocks[j / s_block] = 1;
+    }
+  }
+
+  /// Sum the columns of a block of the accumulator along omega, and keep the highest count of each column in the rows
+  /// [lowRow, highRow] and its first row
+  static void scanBlock(Grid& grid, uint32_t block, uint32_t lowRow, uint32_t highRow) {
+    const uint32_t    nPhi  = grid.nPhi;
+    const std::size_t first = std::size_t(block) * s_block;
+    int32_t           counts[s_block], maximum[s_block], peak[s_block];
+    std::fill(counts, counts + s_block, 0);
+    std::fill(maximum, maximum + s_block, std::numeric_limits<int32_t>::min());
+    std::fill(peak, peak + s_block, 0);
+    for (std::size_t row = 0; row < lowRow; ++row) {
+      const int16_t* votes = grid.accumulator.data() + row * nPhi + first;
+      for (std::size_t k = 0; k < s_block; ++k)
+        counts[k] += votes[k];
+    }
+    // selects rather than std::max, which returns a reference into maximum
+    for (std::size_t row = lowRow; row <= highRow; ++row) {
+      const int16_t* votes = grid.accumulator.data() + row * nPhi + first;
+      for (std::size_t k = 0; k < s_block; ++k) {
+        const int32_t count  = counts[k] + votes[k];
+        const bool    higher = count > maximum[k];
+        counts[k]            = count;
+        maximum[k]           = higher ? count : maximum[k];
+        peak[k]              = higher ? int32_t(row) : peak[k];
+      }
+    }
+    std::copy(maximum, maximum + s_block, grid.columnMaximum.begin() + first);
+    std::copy(peak, peak + s_block, grid.columnPeak.begin() + first);
+  }
+
+  /// Highest count in the columns [firstColumn, firstColumn + nColumns) (modulo a turn) and the rows [lowRow, highRow]
+  /// of the accumulator, and its cell: the first one in (omega, phi0) order in case of ties. The column maxima are
+  /// those of the last scan of the blocks that did not change, so the rows must be the same until the votes change.
+  static int32_t findPeak(Grid& grid, uint32_t firstColumn, uint32_t nColumns, uint32_t lowRow, uint32_t highRow,
+                          uint32_t& phiBin, uint32_t& omegaBin) {
+    for (uint32_t k = 0; k < nColumns; ++k) {
+      const uint32_t block = (firstColumn + k) % grid.nPhi / s_block;
+      if (grid.dirtyBlocks[block]) {
+        scanBlock(grid, block, lowRow, highRow);
+        grid.dirtyBlocks[block] = 0;
+      }
+    }
+    int32_t maximum = std::numeric_limits<int32_t>::min();
+    phiBin = omegaBin = 0;
+    for (uint32_t k = 0; k < nColumns; ++k) {
+      const uint32_t j     = (firstColumn + k) % grid.nPhi;
+      const int32_t  count = grid.columnMaximum[j];
+      const uint32_t row   = grid.columnPeak[j];
+      if (count > maximum || (count == maximum && (row < omegaBin || (row == omegaBin && j < phiBin)))) {
+        maximum  = count;
+        phiBin   = j;
+        omegaBin = row;
+      }
+    }
+    return maximum;
+  }
+
+  /// Select the free hits that voted in the cells of the columns [firstColumn, firstColumn + nColumns) (modulo a turn)
+  /// and of the rows [lowRow, highRow]. As in computeRanges, the curves of a hit are taken between their values at the
+  /// first and the last edges: over a few coarse columns, the error at the turning point of a curve is a fraction of a
+  /// coarse bin
+  void selectVoters(const Grid& grid, uint32_t firstColumn, uint32_t nColumns, int32_t lowRow, int32_t highRow) {
+    const uint32_t lastEdge  = firstColumn + nColumns;
+    const double   sinLow    = grid.sinEdge[firstColumn];
+    const double   cosLow    = grid.cosEdge[firstColumn];
+    const double   sinHigh   = grid.sinEdge[lastEdge];
+    const double   cosHigh   = grid.cosEdge[lastEdge];
+    const double   sinCentre = std::sin(0.5 * (grid.phiEdge(firstColumn) + grid.phiEdge(lastEdge)));
+    const double   cosCentre = std::cos(0.5 * (grid.phiEdge(firstColumn) + grid.phiEdge(lastEdge)));
+    // a hit ahead of the origin in one of the columns only: its half turn ends within the window
+    const double   maxBehind = std::sin(0.5 * nColumns * grid.phiWidth);
+    const double   offset    = 0.5 * grid.nOmega;
+    const double   maxBin    = grid.nOmega + 1;
+    const double   invWidth  = 1. / grid.omegaWidth;
+    const double*  x         = m_x.data();
+    const double*  y         = m_y.data();
+    const double*  drift     = m_drift.data();
+    const double*  scale     = m_scale.data();
+    const double*  radius    = m_radius.data();
+    Flags*         flags     = m_flags.data();
+    for (std::size_t block = 0; block < m_flags.size(); block += s_block)
+      for (std::size_t k = 0; k < s_block; ++k) {
+        const std::size_t i     = block + k;
+        const double      qLow  = x[i] * sinLow - y[i] * cosLow;
+        const double      qHigh = x[i] * sinHigh - y[i] * cosHigh;
+        const double      low   = std::min(qLow, qHigh);
+        const double      high  = std::max(qLow, qHigh);
+        // same bins as computeRanges
+        const double hitScale = scale[i] * invWidth;
+        const auto   bin      = [&](double value) {
+          return int32_t(std::clamp(value * hitScale + offset + 1., 0., maxBin)) - 1;
+        };
+        const bool minus = (bin(low - drift[i]) <= highRow) & (lowRow <= bin(high - drift[i]));
+        const bool plus  = (bin(low + drift[i]) <= highRow) & (lowRow <= bin(high + drift[i]));
+        const bool ahead = x[i] * cosCentre + y[i] * sinCentre > -maxBehind * radius[i];
+        flags[i].selected  = (flags[i].voter != 0) & ahead & (minus | plus);
+      }
+  }
+
+  /// Select the free hits whose wire is at the drift distance of the circle, on its first half turn
+  void selectClose(double phi0, double omega) {
+    const double  sinPhi = std::sin(phi0);
+    const double  cosPhi = std::cos(phi0);
+    const double  maxRes = m_config.maxResidual;
+    const double* x      = m_x.data();
+    const double* y      = m_y.data();
+    const double* drift  = m_drift.data();
+    Flags*        flags  = m_flags.data();
+    for (std::size_t block = 0; block < m_flags.size(); block += s_block)
+      for (std::size_t k = 0; k < s_block; ++k) {
+        const std::size_t i        = block + k;
+        const double      residual = std::fabs(distance(x[i], y[i], sinPhi, cosPhi, omega)) - drift[i];
+        const bool        ahead    = x[i] * cosPhi + y[i] * sinPhi > 0.;
+        flags[i].selected          = (flags[i].free != 0) & ahead & (std::fabs(residual) < maxRes);
+      }
+  }
+
+  void collectSelected() {
+    m_track.clear();
+    for (uint32_t i = 0; i < m_nHits; ++i)
+      if (m_flags[i].selected)
+        m_track.push_back(i);
+  }
+
+  /// Gauss-Newton fit of (phi0, omega) to the drift distances of the hits of m_track; false if it does not converge.
+  /// With a window, the hits are weighted with Tukey's biweight, so hits further than the window are ignored.
+  bool fitCircle(double& phi0, double& omega, double cov[3], double& chi2, double window = 0.) const {
+    double normal[3] = {0., 0., 0.};
+    for (int iteration = 0; iteration < 5; ++iteration) {
+      const double sinPhi      = std::sin(phi0);
+      const double cosPhi      = std::cos(phi0);
+      double       gradient[2] = {0., 0.};
+      normal[0] = normal[1] = normal[2] = 0.;
+      chi2                              = 0.;
+      for (const uint32_t i : m_track) {
+        const double x   = m_x[i];
+        const double y   = m_y[i];
+        const double r2  = x * x + y * y;
+        const double q   = x * sinPhi - y * cosPhi;
+        const double t   = x * cosPhi + y * sinPhi;
+        const double ux  = omega * x - sinPhi;
+        const double uy  = omega * y + cosPhi;
+        const double n   = std::max(std::sqrt(ux * ux + uy * uy), 1.e-12);
+        const double num = omega * r2 - 2. * q;
+        const double den = 1. + n;
+        const double e   = num / den;
+        // derivatives of the numerator and of n with respect to phi0 and omega
+        const double dNum[2]  = {-2. * t, r2};
+        const double dN[2]    = {-omega * t / n, (omega * r2 - q) / n};
+        const double side     = e < 0. ? -1. : 1.;
+        const double jac[2]   = {side * (dNum[0] * den - num * dN[0]) / (den * den),
+                                 side * (dNum[1] * den - num * dN[1]) / (den * den)};
+        const double residual = side * e - m_drift[i];
+        const double u        = window > 0. ? std::min(residual * residual / (window * window), 1.) : 0.;
+        const double weight   = (1. - u) * (1. - u);
+        gradient[0] += weight * jac[0] * residual;
+        gradient[1] += weight * jac[1] * residual;
+        normal[0] += weight * jac[0] * jac[0];
+        normal[1] += weight * jac[1] * jac[0];
+        normal[2] += weight * jac[1] * jac[1];
+        chi2 += weight * residual * residual;
+      }
+      const double determinant = normal[0] * normal[2] - normal[1] * normal[1];
+      if (!(determinant > 0.))
+        return false;
+      const double dPhi   = -(normal[2] * gradient[0] - normal[1] * gradient[1]) / determinant;
+      const double dOmega = -(normal[0] * gradient[1] - normal[1] * gradient[0]) / determinant;
+      phi0 += dPhi;
+      omega += dOmega;
+      if (std::fabs(dPhi) < 1.e-9 && std::fabs(dOmega) < 1.e-12)
+        break;
+    }
+    const double variance    = m_config.driftResolution * m_config.driftResolution;
+    const double determinant = normal[0] * normal[2] - normal[1] * normal[1];
+    cov[0]                   = variance * normal[2] / determinant;
+    cov[1]                   = -variance * normal[1] / determinant;
+    cov[2]                   = variance * normal[0] / determinant;
+    chi2 /= variance;
+    return std::isfinite(phi0) && std::isfinite(omega) && std::fabs(omega) < 2. * m_config.maxOmega;
+  }
+
+  /// Least squares fit of z = z0 + tanLambda s on the hits of m_track, whose arc lengths are in m_distance; false if
+  /// it is degenerate. With a window, the hits are weighted with Tukey's biweight as in fitCircle.
+  bool fitLine(double& z0, double& tanLambda, double cov[3], double& chi2, double window = 0.) const {
+    const bool weighted = window > 0.;
+    double     sum[5]   = {0., 0., 0., 0., 0.}; // weighted sums of 1, s, s^2, z, s z
+    for (const uint32_t i : m_track) {
+      const double s        = m_distance[i];
+      const double residual = m_z[i] - z0 - tanLambda * s;
+      const double u        = weighted ? std::min(residual * residual / (window * window), 1.) : 0.;
+      const double weight   = (1. - u) * (1. - u);
+      sum[0] += weight;
+      sum[1] += weight * s;
+      sum[2] += weight * s * s;
+      sum[3] += weight * m_z[i];
+      sum[4] += weight * s * m_z[i];
+    }
+    const double determinant = sum[0] * sum[2] - sum[1] * sum[1];
+    if (!(determinant > 0.))
+      return false;
+    tanLambda             = (sum[0] * sum[4] - sum[1] * sum[3]) / determinant;
+    z0                    = (sum[3] - tanLambda * sum[1]) / sum[0];
+    const double variance = m_config.zResolution * m_config.zResolution;
+    cov[0]                = variance * sum[2] / determinant;
+    cov[1]                = -variance * sum[1] / determinant;
+    cov[2]                = variance * sum[0] / determinant;
+    chi2                  = 0.;
+    for (const uint32_t i : m_track) {
+      const double residual = m_z[i] - z0 - tanLambda * m_distance[i];
+      chi2 += residual * residual;
+    }
+    chi2 /= variance;
+    return true;
+  }
+
+  /// Robust fit of the line in z to the hits of m_track at their arc lengths along the circle of curvature omega, then
+  /// removal of the outliers from m_track; false if the fits fail or less than minHits are left
+  bool fitLineWithoutOutliers(double omega, double& z0, double& tanLambda, double cov[3], double& chi2) {
+    for (const uint32_t i : m_track)
+      m_distance[i] = arcLength(m_x[i], m_y[i], omega);
+    z0 = tanLambda = 0.;
+    if (!fitLine(z0, tanLambda, cov, chi2))
+      return false;
+    for (const double window : {16., 4., 1.})
+      if (!fitLine(z0, tanLambda, cov, chi2, window * m_config.maxZResidual))
+        return false;
+    m_track.erase(std::remove_if(m_track.begin(), m_track.end(),
+                                 [this, z0, tanLambda](uint32_t i) {
+                                   return !(std::fabs(m_z[i] - z0 - tanLambda * m_distance[i]) < m_config.maxZResidual);
+                                 }),
+                  m_track.end());
+    return m_track.size() >= m_config.minHits && fitLine(z0, tanLambda, cov, chi2);
+  }
+
+  /// Seed from the hits that voted in the cell; false if the fits fail or do not keep enough hits
+  bool makeSeed(uint32_t phiBin, uint32_t omegaBin) {
+    selectVoters(m_fine, phiBin, 1, omegaBin, omegaBin);
+    collectSelected();
+    if (m_track.size() < m_config.minHits)
+      return false;
+    Seed   seed;
+    double phi0  = m_fine.phiEdge(phiBin) + 0.5 * m_fine.phiWidth;
+    double omega = -m_config.maxOmega + (omegaBin + 0.5) * m_fine.omegaWidth;
+    double transverseChi2, longitudinalChi2;
+    // the cell also holds hits of the tracks crossing it near the origin, or with a close transverse projection: first
+    // the hits along the main line in z, then a robust circle fit with a shrinking window, starting from the distance
+    // between the cell centre and the track in the outer layers
+    if (!fitLineWithoutOutliers(omega, seed.z0, seed.tanLambda, seed.longitudinalCov, longitudinalChi2))
+      return false;
+    for (const double window : {32., 8., 2.})
+      if (!fitCircle(phi0, omega, seed.transverseCov, transverseChi2, window * m_config.maxResidual))
+        return false;
+    // all the free hits close to the circle and to the line, and least squares fits, until the hits do not change
+    for (int iteration = 0; iteration < 4; ++iteration) {
+      selectClose(phi0, omega);
+      const std::size_t before = m_track.size();
+      collectSelected();
+      if (!fitLineWithoutOutliers(omega, seed.z0, seed.tanLambda, seed.longitudinalCov, longitudinalChi2) ||
+          !fitCircle(phi0, omega, seed.transverseCov, transverseChi2))
+        return false;
+      if (m_track.size() == before)
+        break;
+    }
+    // a circle started between two tracks can converge with the hits of one of them on the wrong side of their wires
+    if (transverseChi2 > m_config.maxChi2PerNdf * (m_track.size() - 2.))
+      return false;
+    for (const uint32_t i : m_track)
+      m_distance[i] = arcLength(m_x[i], m_y[i], omega);
+    if (!fitLine(seed.z0, seed.tanLambda, seed.longitudinalCov, longitudinalChi2))
+      return false;
+    std::sort(m_track.begin(), m_track.end(), [this](uint32_t a, uint32_t b) {
+      return std::tie(m_distance[a], a) < std::tie(m_distance[b], b);
+    });
+    seed.phi0     = std::remainder(phi0, 2. * M_PI);
+    seed.omega    = omega;
+    seed.chi2     = transverseChi2 + longitudinalChi2;
+    seed.ndf      = 2 * int(m_track.size()) - 4;
+    seed.firstHit = m_hits.size();
+    seed.nHits    = m_track.size();
+    m_hits.insert(m_hits.end(), m_track.begin(), m_track.end());
+    m_seeds.push_back(seed);
+    return true;
+  }
+
+  Config m_config;
+
+  /// coarse accumulator of all the hits, and fine accumulator of the hits around a coarse peak
+  Grid m_coarse, m_fine;
+  /// fine cells that gave no seed, in the current event
+  std::vector<std::pair<uint32_t, uint32_t>> m_vetoedCells;
+  // per hit buffers, reused between events
+  uint32_t             m_nHits = 0;
+  std::vector<double>  m_x, m_y, m_z, m_drift, m_scale, m_distance;
+  /// transverse radius and azimuth (in [0, 2 pi]) of the hits, and half width of their phi0 range around the azimuth
+  std::vector<double> m_radius, m_azimuth, m_halfWidth;
+  /// voter: the votes of the hit are in the accumulator, free: the hit belongs to no seed, selected: output of the select
+  /// functions. The select loops read a single field each, they are not vectorized otherwise
+  struct Flags {
+    int32_t voter, free, selected;
+  };
+  std::vector<Flags> m_flags;
+  /// omega bins crossed by the curves of the two sides of a hit in a phi column (empty if high = low - 1)
+  struct Range {
+    int32_t low[2], high[2];
+  };
+  /// bins of the two curves of the current hit at the edges of its phi columns (int16, not to alias the ranges)
+  struct EdgeBins {
+    int16_t minus, plus;
+  };
+  std::vector<EdgeBins> m_edgeBins;
+  /// ranges of the current hit in its phi columns, from computeRanges
+  std::vector<Range> m_ranges;
+  uint32_t           m_firstColumn = 0, m_nColumns = 0;
+  // output and current seed
+  std::vector<Seed>     m_seeds;
+  std::vector<uint32_t> m_hits, m_track;
+};
+
+} // namespace HoughSeeding
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "GaudiKernel/IInterface.h"
+
+#include "RZFieldMap.h"
+
+/** @class IFieldCacheSvc
+ *
+ *  Interface of the service caching the DD4hep magnetic field on an (r, z) grid.
+ *  The map is filled at initialize and is immutable afterwards, so it can be shared between threads.
+ *
+ */
+
+class IFieldCacheSvc : virtual public IInterface {
+public:
+  DeclareInterfaceID(IFieldCacheSvc, 1, 0);
+
+  /// Cached field map (mm, Tesla)
+  virtual const RZFieldMap& fieldMap() const = 0;
+};
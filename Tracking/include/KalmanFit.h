@@ -0,0 +1,361 @@
+#pragma once
+
+#include "HelixMath.h"
+#include "KalmanMath.h"
+
+// C++
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/** @namespace KalmanFit
+ *
+ *  Kalman filter and smoother for helical tracks in a constant solenoidal field, without material effects. The state
+ *  is the perigee parameters (d0, phi0, omega, z0, tanLambda) with respect to a pivot point, with the conventions of
+ *  HelixMath and of edm4hep::TrackState (pivot = referencePoint): the point of closest approach is
+ *  pivot + d0 (-sin phi0, cos phi0) in xy, at z = pivot z + z0, and the direction is phi0 - omega s after a transverse
+ *  arc length s. The state is transported exactly from one pivot to the next, with the analytic jacobian.
+ *
+ *  Each measurement is linear in (d0, z0) once the pivot is moved next to it:
+ *    - Point (silicon 3D hit): the pivot is the hit position, and the measurement is (d0, z0) = (0, 0).
+ *    - Wire (drift chamber hit): the pivot is the point of the wire at the predicted z, and the measurements are the
+ *      signed distance between the track and the wire and the position of the closest point along the wire, compared
+ *      to the hit position. The sign of the distance (the left/right ambiguity) is taken from the prediction, or the
+ *      hit only measures the wire position when the prediction is not precise enough. When the smoothed track is
+ *      significantly on the other side of some wires, or next to ambiguous ones, the track is filtered a second time
+ *      with the sides of the smoothed track.
+ *
+ *  Without process noise, the Rauch-Tung-Striebel smoothed state at a hit is the last filtered state transported back
+ *  to the pivot of that hit, so the smoother transports the states backwards instead of inverting 5x5 covariances.
+ *
+ */
+
+namespace KalmanFit {
+
+enum Parameter { D0 = 0, PHI0, OMEGA, Z0, TANLAMBDA };
+
+struct State {
+  double              pivot[3];
+  KalmanMath::Vector5 params;
+  KalmanMath::Matrix5 cov;
+};
+
+struct Measurement {
+  enum Type : uint8_t { Point, Wire };
+  Type type;
+  /// Point: hit position. Wire: point of the wire closest to the hit
+  double position[3];
+  /// Wire: unit vector along the wire
+  double direction[3];
+  /// Wire: measured (unsigned) distance between the track and the wire
+  double driftDistance;
+  /// Point: position covariance (xx, yx, yy, zx, zy, zz). Wire: variances of the drift distance and of the position
+  /// along the wire, in [0] and [1]
+  double covariance[6];
+  /// Position of the hit in the caller's input, to refer back to it
+  uint32_t index;
+};
+
+struct Config {
+  double   maxChi2PerHit = 30.;
+  uint32_t minHits       = 3;
+  /// Seed uncertainties on (d0, phi0, omega, z0, tanLambda), the one on omega is relative
+  double seedSigma[5] = {1., 1.e-2, 1.e-1, 1., 1.e-2};
+  /// A wire hit is ambiguous when its drift distance is below this many sigmas of the predicted distance to the wire,
+  /// it is then used as a measurement of the wire position, with the drift distance as additional error
+  double ambiguousSigmas = 2.;
+  /// Refit with the left/right sides of the smoothed track if it is further than this many sigmas of the drift
+  /// distance on the other side of a wire than the one used by the filter, or from an ambiguous wire; no refit if not
+  /// positive
+  double refitSideSigmas = 3.;
+};
+
+struct Step {
+  State    filtered, smoothed;
+  double   chi2;
+  uint32_t measurement;
+  /// Wire: side of the wire used in the update (-1 or 1), 0 for points and ambiguous wires
+  int8_t side;
+};
+
+/// Buffers reused between fits
+struct Workspace {
+  std::vector<Step>   steps;
+  std::vector<int8_t> sides;
+};
+
+struct Result {
+  /// Smoothed states at the seed pivot, at the first and at the last used hits
+  State    atReference, atFirstHit, atLastHit;
+  double   chi2;
+  int      ndf;
+  uint32_t nHits;
+};
+
+/// Angle in [-pi, pi)
+inline double wrapPi(double phi) { return phi - HelixMath::TWO_PI * std::floor((phi + M_PI) / HelixMath::TWO_PI); }
+
+/// Move the pivot of the parameters a to newPivot, giving b and optionally the jacobian db/da.
+/// Returns the transverse arc length between the two points of closest approach (nearest branch of the circle).
+inline double transport(const KalmanMath::Vector5& a, const double pivot[3], const double newPivot[3],
+                        KalmanMath::Vector5& b, KalmanMath::Matrix5* jacobian) {
+  const double omega = std::fabs(a[OMEGA]) > 1.e-12 ? a[OMEGA] : std::copysign(1.e-12, a[OMEGA]);
+  const double rho   = 1. / omega;
+  const double sign  = omega > 0. ? 1. : -1.;
+  const double s0    = std::sin(a[PHI0]);
+  const double c0    = std::cos(a[PHI0]);
+  // vector from the circle centre to the new pivot
+  const double u     = rho - a[D0];
+  const double dx    = newPivot[0] - pivot[0] - u * s0;
+  const double dy    = newPivot[1] - pivot[1] + u * c0;
+  const double dist2 = dx * dx + dy * dy;
+  const double dist  = std::sqrt(dist2);
+  const double dPhi  = wrapPi(std::atan2(-sign * dx, sign * dy) - a[PHI0]);
+  const double s     = -dPhi / omega;
+  b[D0]              = rho - sign * dist;
+  b[PHI0]            = a[PHI0] + dPhi;
+  b[OMEGA]           = a[OMEGA];
+  b[Z0]              = pivot[2] + a[Z0] + s * a[TANLAMBDA] - newPivot[2];
+  b[TANLAMBDA]       = a[TANLAMBDA];
+  if (jacobian) {
+    auto& j = *jacobian;
+    j       = KalmanMath::Matrix5{};
+    // derivatives of (dx, dy) with respect to d0, phi0 and omega
+    const double dxda[3] = {s0, -u * c0, rho * rho * s0};
+    const double dyda[3] = {-c0, -u * s0, -rho * rho * c0};
+    for (int k = 0; k < 3; ++k) {
+      const double dPhi1 = (dx * dyda[k] - dy * dxda[k]) / dist2;
+      const double dDist = (dx * dxda[k] + dy * dyda[k]) / dist;
+      const double ds    = -(dPhi1 - (k == PHI0 ? 1. : 0.)) / omega + (k == OMEGA ? dPhi / (omega * omega) : 0.);
+      j[D0][k]           = -sign * dDist - (k == OMEGA ? rho * rho : 0.);
+      j[PHI0][k]         = dPhi1;
+      j[Z0][k]           = a[TANLAMBDA] * ds;
+    }
+    j[OMEGA][OMEGA]         = 1.;
+    j[Z0][Z0]               = 1.;
+    j[Z0][TANLAMBDA]        = s;
+    j[TANLAMBDA][TANLAMBDA] = 1.;
+  }
+  return s;
+}
+
+/// Transport of a state, parameters and covariance
+inline void transport(const State& state, const double newPivot[3], State& transported,
+                      KalmanMath::Matrix5& jacobian) {
+  transport(state.params, state.pivot, newPivot, transported.params, &jacobian);
+  for (int i = 0; i < 3; ++i)
+    transported.pivot[i] = newPivot[i];
+  // non zero columns of each row of the jacobian
+  static constexpr int first[KalmanMath::N] = {D0, D0, OMEGA, D0, TANLAMBDA};
+  static constexpr int last[KalmanMath::N]  = {OMEGA + 1, OMEGA + 1, OMEGA + 1, TANLAMBDA + 1, TANLAMBDA + 1};
+  transported.cov = KalmanMath::similarity(jacobian, state.cov, first, last);
+}
+
+/// Update with a 2D measurement m = h0 + g (d0, z0) + noise(v); false if the chi2 is above the cut
+inline bool update(const State& predicted, const double g[2][2], const double h0[2], const double m[2],
+                   const double v[2][2], double maxChi2, State& filtered, double& chi2) {
+  constexpr int columns[2] = {D0, Z0};
+  const auto&   c          = predicted.cov;
+  // c h^T
+  double cht[KalmanMath::N][2];
+  for (int i = 0; i < KalmanMath::N; ++i)
+    for (int j = 0; j < 2; ++j)
+      cht[i][j] = c[i][columns[0]] * g[j][0] + c[i][columns[1]] * g[j][1];
+  // residual covariance and its inverse
+  double s[2][2];
+  for (int j = 0; j < 2; ++j)
+    for (int l = 0; l < 2; ++l)
+      s[j][l] = g[j][0] * cht[columns[0]][l] + g[j][1] * cht[columns[1]][l] + v[j][l];
+  const double determinant = s[0][0] * s[1][1] - s[0][1] * s[1][0];
+  if (!(determinant > 0.))
+    return false;
+  const double si[2][2] = {{s[1][1] / determinant, -s[0][1] / determinant},
+                           {-s[1][0] / determinant, s[0][0] / determinant}};
+  const auto&  x        = predicted.params;
+  const double r[2]     = {m[0] - h0[0] - g[0][0] * x[D0] - g[0][1] * x[Z0],
+                           m[1] - h0[1] - g[1][0] * x[D0] - g[1][1] * x[Z0]};
+  chi2 = r[0] * (si[0][0] * r[0] + si[0][1] * r[1]) + r[1] * (si[1][0] * r[0] + si[1][1] * r[1]);
+  if (chi2 > maxChi2)
+    return false;
+  // gain, state and covariance
+  double k[KalmanMath::N][2];
+  for (int i = 0; i < KalmanMath::N; ++i)
+    for (int j = 0; j < 2; ++j)
+      k[i][j] = cht[i][0] * si[0][j] + cht[i][1] * si[1][j];
+  filtered = predicted;
+  for (int i = 0; i < KalmanMath::N; ++i) {
+    filtered.params[i] += k[i][0] * r[0] + k[i][1] * r[1];
+    for (int j = 0; j <= i; ++j) {
+      // c - k s k^T = c - k h c
+      const double value = c[i][j] - (k[i][0] * cht[j][0] + k[i][1] * cht[j][1]);
+      filtered.cov[i][j] = filtered.cov[j][i] = value;
+    }
+  }
+  return true;
+}
+
+/// Derivatives g of the (signed distance to the wire, position along the wire) with respect to (d0, z0), for a track
+/// whose pivot lies on the wire with direction u; false if the track is parallel to the wire
+inline bool wireProjection(const KalmanMath::Vector5& x, const double u[3], double g[2][2]) {
+  // the track is locally the line pivot + d0 n + z0 ez, with direction t
+  const double sinPhi    = std::sin(x[PHI0]);
+  const double cosPhi    = std::cos(x[PHI0]);
+  const double cosLambda = 1. / std::sqrt(1. + x[TANLAMBDA] * x[TANLAMBDA]);
+  const double t[3]      = {cosPhi * cosLambda, sinPhi * cosLambda, x[TANLAMBDA] * cosLambda};
+  const double n[3]      = {-sinPhi, cosPhi, 0.};
+  const double tu        = t[0] * u[0] + t[1] * u[1] + t[2] * u[2];
+  const double sin2      = 1. - tu * tu;
+  if (sin2 < 1.e-6)
+    return false;
+  // unit normal to both lines, and direction giving the closest point on the wire
+  const double norm   = 1. / std::sqrt(sin2);
+  const double nrm[3] = {(t[1] * u[2] - t[2] * u[1]) * norm, (t[2] * u[0] - t[0] * u[2]) * norm,
+                         (t[0] * u[1] - t[1] * u[0]) * norm};
+  const double along[3] = {(u[0] - tu * t[0]) / sin2, (u[1] - tu * t[1]) / sin2, (u[2] - tu * t[2]) / sin2};
+  g[0][0]               = n[0] * nrm[0] + n[1] * nrm[1];
+  g[0][1]               = nrm[2];
+  g[1][0]               = n[0] * along[0] + n[1] * along[1];
+  g[1][1]               = along[2];
+  return true;
+}
+
+/// Predict the state next to the measurement and update it; false if the measurement is rejected.
+/// For wires, side is the side of the wire to use (-1 or 1), or 0 to take it from the prediction.
+inline bool filterStep(const State& previous, const Measurement& measurement, const Config& config, int8_t side,
+                       Step& step) {
+  State               predicted;
+  KalmanMath::Matrix5 jacobian;
+  if (measurement.type == Measurement::Point) {
+    transport(previous, measurement.position, predicted, jacobian);
+    const double  sinPhi = std::sin(predicted.params[PHI0]);
+    const double  cosPhi = std::cos(predicted.params[PHI0]);
+    const double  tanL   = predicted.params[TANLAMBDA];
+    const double* cov    = measurement.covariance;
+    // a hit error e moves the measured (d0, z0) by (-e.n, tanLambda e.t - e.z), with n = (-sin phi0, cos phi0) and
+    // t = (cos phi0, sin phi0): the error along the track moves the point of closest approach, hence its z
+    const double nn      = sinPhi * sinPhi * cov[0] - 2. * sinPhi * cosPhi * cov[1] + cosPhi * cosPhi * cov[2];
+    const double nt =
+        -sinPhi * cosPhi * cov[0] + (cosPhi * cosPhi - sinPhi * sinPhi) * cov[1] + sinPhi * cosPhi * cov[2];
+    const double tt      = cosPhi * cosPhi * cov[0] + 2. * sinPhi * cosPhi * cov[1] + sinPhi * sinPhi * cov[2];
+    const double nz      = -sinPhi * cov[3] + cosPhi * cov[4];
+    const double tz      = cosPhi * cov[3] + sinPhi * cov[4];
+    const double vdd     = nn;
+    const double vdz     = -tanL * nt + nz;
+    const double vzz     = tanL * tanL * tt - 2. * tanL * tz + cov[5];
+    const double g[2][2] = {{1., 0.}, {0., 1.}};
+    const double h0[2]   = {0., 0.};
+    const double m[2]    = {0., 0.};
+    const double v[2][2] = {{vdd, vdz}, {vdz, vzz}};
+    step.side            = 0;
+    return update(predicted, g, h0, m, v, config.maxChi2PerHit, step.filtered, step.chi2);
+  }
+
+  // wire: first find the point of the wire at the z of the track
+  const double* w = measurement.position;
+  const double* u = measurement.direction;
+  if (std::fabs(u[2]) < 1.e-3)
+    return false;
+  KalmanMath::Vector5 atWire;
+  transport(previous.params, previous.pivot, w, atWire, nullptr);
+  const double tau      = atWire[Z0] / u[2];
+  const double pivot[3] = {w[0] + tau * u[0], w[1] + tau * u[1], w[2] + tau * u[2]};
+  transport(previous, pivot, predicted, jacobian);
+
+  double g[2][2];
+  if (!wireProjection(predicted.params, u, g))
+    return false;
+  const double h0[2]    = {0., tau};
+  double       m[2]     = {side * measurement.driftDistance, 0.};
+  double       v[2][2]  = {{measurement.covariance[0], 0.}, {0., measurement.covariance[1]}};
+  step.side             = side;
+  if (side == 0) {
+    const auto&  x        = predicted.params;
+    const auto&  c        = predicted.cov;
+    const double distance = g[0][0] * x[D0] + g[0][1] * x[Z0];
+    const double variance = g[0][0] * g[0][0] * c[D0][D0] + 2. * g[0][0] * g[0][1] * c[D0][Z0] +
+                            g[0][1] * g[0][1] * c[Z0][Z0];
+    if (measurement.driftDistance * measurement.driftDistance < config.ambiguousSigmas * config.ambiguousSigmas *
+                                                                    variance) {
+      // the prediction cannot tell the side: measure the wire position, with the drift distance as error
+      v[0][0] += measurement.driftDistance * measurement.driftDistance;
+    } else {
+      step.side = distance < 0. ? -1 : 1;
+      m[0]      = step.side * measurement.driftDistance;
+    }
+  }
+  return update(predicted, g, h0, m, v, config.maxChi2PerHit, step.filtered, step.chi2);
+}
+
+/// Filter and smooth, with the given wire sides (0: from the prediction); false if too few hits are accepted
+inline bool filterAndSmooth(const State& seed, const Measurement* measurements, std::size_t nMeasurements,
+                            const Config& config, const int8_t* sides, std::vector<Step>& steps, Result& result) {
+  steps.clear();
+  result.chi2 = 0.;
+  for (std::size_t i = 0; i < nMeasurements; ++i) {
+    Step& step = steps.emplace_back();
+    if (!filterStep(steps.size() > 1 ? steps[steps.size() - 2].filtered : seed, measurements[i], config, sides[i],
+                    step)) {
+      steps.pop_back();
+      continue;
+    }
+    step.measurement = i;
+    result.chi2 += step.chi2;
+  }
+  result.nHits = steps.size();
+  result.ndf   = 2 * int(result.nHits) - KalmanMath::N;
+  if (result.nHits < config.minHits || result.ndf <= 0)
+    return false;
+
+  // smoother, hit by hit to stay on the nearest branch of the helix
+  KalmanMath::Matrix5 jacobian;
+  steps.back().smoothed = steps.back().filtered;
+  for (std::size_t k = steps.size() - 1; k-- > 0;)
+    transport(steps[k + 1].smoothed, steps[k].filtered.pivot, steps[k].smoothed, jacobian);
+  return true;
+}
+
+/// Fit the seed (parameters and pivot, the covariance is set from the config) to the measurements, ordered along the
+/// track. False if fewer than config.minHits measurements are accepted.
+inline bool fit(const State& seed, const Measurement* measurements, std::size_t nMeasurements, const Config& config,
+                Workspace& workspace, Result& result) {
+  State start = seed;
+  start.cov   = KalmanMath::Matrix5{};
+  for (int i = 0; i < KalmanMath::N; ++i) {
+    const double sigma = i == OMEGA ? config.seedSigma[i] * std::fabs(seed.params[OMEGA]) : config.seedSigma[i];
+    start.cov[i][i]    = sigma * sigma;
+  }
+
+  auto& steps = workspace.steps;
+  auto& sides = workspace.sides;
+  sides.assign(nMeasurements, 0);
+  if (!filterAndSmooth(start, measurements, nMeasurements, config, sides.data(), steps, result))
+    return false;
+
+  // left/right ambiguities: sides of the smoothed track, and refit if one of them is significantly different
+  if (config.refitSideSigmas > 0.) {
+    bool   refit = false;
+    double g[2][2];
+    for (const Step& step : steps) {
+      const Measurement& measurement = measurements[step.measurement];
+      if (measurement.type != Measurement::Wire)
+        continue;
+      const auto&        x           = step.smoothed.params;
+      if (!wireProjection(x, measurement.direction, g))
+        continue;
+      const double distance = g[0][0] * x[D0] + g[0][1] * x[Z0];
+      sides[step.measurement] = distance < 0. ? -1 : 1;
+      refit |= sides[step.measurement] != step.side &&
+               std::fabs(distance) > config.refitSideSigmas * std::sqrt(measurement.covariance[0]);
+    }
+    if (refit && !filterAndSmooth(start, measurements, nMeasurements, config, sides.data(), steps, result))
+      return false;
+  }
+
+  KalmanMath::Matrix5 jacobian;
+  result.atFirstHit = steps.front().smoothed;
+  result.atLastHit  = steps.back().smoothed;
+  transport(result.atFirstHit, seed.pivot, result.atReference, jacobian);
+  return true;
+}
+
+} // namespace KalmanFit
@@ -0,0 +1,47 @@
+#pragma once
+
+/** @namespace KalmanMath
+ *
+ *  Fixed size (5 track parameters) vector and matrix types for the Kalman filter, living on the stack, and the
+ *  operations the filter needs. Loops have compile time bounds so that the compiler can fully unroll them.
+ *
+ */
+
+namespace KalmanMath {
+
+constexpr int N = 5;
+
+struct Vector5 {
+  double v[N];
+  double&       operator[](int i) { return v[i]; }
+  const double& operator[](int i) const { return v[i]; }
+};
+
+struct Matrix5 {
+  double m[N][N];
+  double*       operator[](int i) { return m[i]; }
+  const double* operator[](int i) const { return m[i]; }
+};
+
+/// f c f^T for a symmetric c and a jacobian f whose rows are non zero only in the column ranges [first[i], last[i])
+inline Matrix5 similarity(const Matrix5& f, const Matrix5& c, const int first[N], const int last[N]) {
+  double fc[N][N];
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j < N; ++j) {
+      double sum = 0.;
+      for (int k = first[i]; k < last[i]; ++k)
+        sum += f[i][k] * c[k][j];
+      fc[i][j] = sum;
+    }
+  Matrix5 s;
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j <= i; ++j) {
+      double sum = 0.;
+      for (int k = first[j]; k < last[j]; ++k)
+        sum += fc[i][k] * f[j][k];
+      s[i][j] = s[j][i] = sum;
+    }
+  return s;
+}
+
+} // namespace KalmanMath
@@ -0,0 +1,562 @@
+#pragma once
+
+#include "KalmanFit.h"
+#include "SimdMath.h"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+/** @namespace KalmanMatriplex
+ *
+ *  Track parallel version of the KalmanFit filter and smoother. W tracks are fitted in lockstep, one per lane, with
+ *  their states in "matriplex" layout: element major and track minor, element i of the W tracks being a contiguous
+ *  array. Every operation is then a loop over the lanes with the same arithmetic for each lane, that the compiler turns
+ *  into vector instructions (W = 8 fills AVX-512 registers, and two AVX2 or four SSE2 registers).
+ *  The measurement models and the ambiguity treatment are the ones of KalmanFit, but most divisions are replaced by
+ *  products with inverses and the trigonometric functions are the ones of SimdMath: the results agree with KalmanFit
+ *  to rounding. They do not depend on W nor on the position of a track in its bundle, so W = 1 is a scalar fallback
+ *  giving the same bits. The loops are only vectorized with -fno-math-errno and -fno-trapping-math, and the bits only
+ *  match without floating point contraction (-ffp-contract=off): see the compile options of the Tracking package.
+ *  The tracks are bundled by decreasing number of measurements, and the lanes of a bundle with fewer measurements than
+ *  the others are masked once they have used all of theirs.
+ *
+ */
+
+namespace KalmanMatriplex {
+
+using KalmanFit::D0;
+using KalmanFit::OMEGA;
+using KalmanFit::PHI0;
+using KalmanFit::TANLAMBDA;
+using KalmanFit::Z0;
+constexpr int N = KalmanMath::N;
+
+/// Index of the element (i, j) of a symmetric 5x5 matrix in packed storage
+constexpr int sym(int i, int j) { return i >= j ? i * (i + 1) / 2 + j : j * (j + 1) / 2 + i; }
+constexpr int NSYM = N * (N + 1) / 2;
+
+/// Track to fit: seed (parameters and pivot, the covariance is set from the config) and measurements, ordered along
+/// the track. If accepted is set, it receives one flag per measurement, set for the measurements used in the fit.
+struct Track {
+  KalmanFit::State              seed;
+  const KalmanFit::Measurement* measurements;
+  uint32_t                      nMeasurements;
+  uint8_t*                      accepted = nullptr;
+};
+
+/// States of the W tracks of a bundle
+template <int W> struct States {
+  alignas(64) double pivot[3][W];
+  alignas(64) double params[N][W];
+  alignas(64) double cov[NSYM][W];
+};
+
+/// KalmanFit::transport of the parameters, and of the covariance if withCovariance, to newPivot
+template <int W, bool withCovariance>
+inline void transport(const States<W>& in, const double (&newPivot)[3][W], States<W>& out) {
+  // the lane loop only writes local arrays, that cannot alias the arguments
+  alignas(64) double b[N][W];
+  // jacobian, only the elements that are not constant
+  alignas(64) double j[N][N][W];
+  for (int n = 0; n < W; ++n) {
+    const double a0     = in.params[D0][n];
+    const double a1     = in.params[PHI0][n];
+    const double a2     = in.params[OMEGA][n];
+    const double a3     = in.params[Z0][n];
+    const double a4     = in.params[TANLAMBDA][n];
+    const double omega  = std::fabs(a2) > 1.e-12 ? a2 : std::copysign(1.e-12, a2);
+    const double rho    = 1. / omega;
+    const double sign   = omega > 0. ? 1. : -1.;
+    double       s0, c0;
+    SimdMath::sinCos(a1, s0, c0);
+    const double u     = rho - a0;
+    const double dx    = newPivot[0][n] - in.pivot[0][n] - u * s0;
+    const double dy    = newPivot[1][n] - in.pivot[1][n] + u * c0;
+    const double dist2 = dx * dx + dy * dy;
+    const double dist  = std::sqrt(dist2);
+    const double dPhi  = SimdMath::wrapPi(SimdMath::atan2(-sign * dx, sign * dy) - a1);
+    const double s     = -dPhi * rho;
+    b[D0][n]           = rho - sign * dist;
+    b[PHI0][n]         = a1 + dPhi;
+    b[OMEGA][n]        = a2;
+    b[Z0][n]           = in.pivot[2][n] + a3 + s * a4 - newPivot[2][n];
+    b[TANLAMBDA][n]    = a4;
+    if constexpr (withCovariance) {
+      // derivatives of (dx, dy) with respect to d0, phi0 and omega; divisions are replaced by products with inverses,
+      // they are the most expensive vector instructions
+      const double dxd0 = s0, dxPhi = -u * c0, dxOmega = rho * rho * s0;
+      const double dyd0 = -c0, dyPhi = -u * s0, dyOmega = -rho * rho * c0;
+      const double invDist    = 1. / dist;
+      const double invDist2   = invDist * invDist;
+      const double dPhid0     = (dx * dyd0 - dy * dxd0) * invDist2;
+      const double dPhiPhi    = (dx * dyPhi - dy * dxPhi) * invDist2;
+      const double dPhiOmega  = (dx * dyOmega - dy * dxOmega) * invDist2;
+      const double dDistd0    = (dx * dxd0 + dy * dyd0) * invDist;
+      const double dDistPhi   = (dx * dxPhi + dy * dyPhi) * invDist;
+      const double dDistOmega = (dx * dxOmega + dy * dyOmega) * invDist;
+      j[D0][D0][n]            = -sign * dDistd0;
+      j[D0][PHI0][n]          = -sign * dDistPhi;
+      j[D0][OMEGA][n]         = -sign * dDistOmega - rho * rho;
+      j[PHI0][D0][n]          = dPhid0;
+      j[PHI0][PHI0][n]        = dPhiPhi;
+      j[PHI0][OMEGA][n]       = dPhiOmega;
+      j[Z0][D0][n]            = a4 * (-dPhid0 * rho);
+      j[Z0][PHI0][n]          = a4 * (-(dPhiPhi - 1.) * rho);
+      j[Z0][OMEGA][n]         = a4 * (-dPhiOmega * rho + dPhi * rho * rho);
+      j[Z0][TANLAMBDA][n]     = s;
+    }
+  }
+  if constexpr (withCovariance) {
+    for (int n = 0; n < W; ++n) {
+      j[OMEGA][OMEGA][n]         = 1.;
+      j[Z0][Z0][n]               = 1.;
+      j[TANLAMBDA][TANLAMBDA][n] = 1.;
+    }
+    // j c j^T, with the non zero columns [first[i], last[i]) of each row of j, as KalmanMath::similarity. The loops
+    // over the matrix elements are unrolled so that the indices are constants, only the loops over the lanes remain
+    constexpr int      first[N] = {D0, D0, OMEGA, D0, TANLAMBDA};
+    constexpr int      last[N]  = {OMEGA + 1, OMEGA + 1, OMEGA + 1, TANLAMBDA + 1, TANLAMBDA + 1};
+    alignas(64) double jc[N][N][W];
+#pragma GCC unroll 5
+    for (int r = 0; r < N; ++r)
+#pragma GCC unroll 5
+      for (int c = 0; c < N; ++c) {
+        for (int n = 0; n < W; ++n)
+          jc[r][c][n] = j[r][first[r]][n] * in.cov[sym(first[r], c)][n];
+#pragma GCC unroll 5
+        for (int k = first[r] + 1; k < last[r]; ++k)
+          for (int n = 0; n < W; ++n)
+            jc[r][c][n] += j[r][k][n] * in.cov[sym(k, c)][n];
+      }
+#pragma GCC unroll 5
+    for (int r = 0; r < N; ++r)
+#pragma GCC unroll 5
+      for (int c = 0; c <= r; ++c) {
+        double* result = out.cov[sym(r, c)];
+        for (int n = 0; n < W; ++n)
+          result[n] = jc[r][first[c]][n] * j[c][first[c]][n];
+#pragma GCC unroll 5
+        for (int k = first[c] + 1; k < last[c]; ++k)
+          for (int n = 0; n < W; ++n)
+            result[n] += jc[r][k][n] * j[c][k][n];
+      }
+  }
+  for (int i = 0; i < N; ++i)
+    for (int n = 0; n < W; ++n)
+      out.params[i][n] = b[i][n];
+  for (int i = 0; i < 3; ++i)
+    for (int n = 0; n < W; ++n)
+      out.pivot[i][n] = newPivot[i][n];
+}
+
+/// Fitter of bundles of W tracks, with buffers reused between calls
+template <int W> class Fitter {
+public:
+  Fitter() = default;
+  explicit Fitter(const KalmanFit::Config& config) : m_config(config) {}
+
+  void setConfig(const KalmanFit::Config& config) { m_config = config; }
+
+  /// Fit the tracks; fitted[i] is 0 if fewer than config.minHits measurements are accepted for track i, results[i] is
+  /// only set otherwise
+  void fit(const Track* tracks, std::size_t nTracks, KalmanFit::Result* results, uint8_t* fitted) {
+    // bundle tracks with similar numbers of measurements
+    m_order.resize(nTracks);
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::stable_sort(m_order.begin(), m_order.end(), [tracks](uint32_t a, uint32_t b) {
+      return tracks[a].nMeasurements > tracks[b].nMeasurements;
+    });
+    for (std::size_t begin = 0; begin < nTracks; begin += W) {
+      const int nLanes = std::min<std::size_t>(W, nTracks - begin);
+      for (int n = 0; n < W; ++n)
+        m_lanes[n] = m_order[begin + std::min(n, nLanes - 1)];
+      fitBundle(tracks, nLanes, results, fitted);
+    }
+  }
+
+private:
+  /// Data of the lanes at one step of the filter, for the smoother and the refit
+  struct Step {
+    alignas(64) double pivot[3][W];
+    alignas(64) double direction[3][W];
+    alignas(64) double driftVariance[W];
+    alignas(64) double isWire[W];
+    alignas(64) double accepted[W];
+    alignas(64) double side[W];
+    /// sides of the smoothed track, used by the refit
+    alignas(64) double smoothedSide[W];
+  };
+
+  void fitBundle(const Track* tracks, int nLanes, KalmanFit::Result* results, uint8_t* fitted) {
+    double active[W], refit[W];
+    for (int n = 0; n < W; ++n)
+      active[n] = n < nLanes ? 1. : 0.;
+    filterAndSmooth(tracks, active, false);
+    // left/right ambiguities: refit the lanes whose smoothed track is significantly on the other side of a wire
+    bool anyRefit = false;
+    for (int n = 0; n < W; ++n) {
+      refit[n] = active[n] != 0. && m_fitted[n] != 0. && m_refit[n] != 0. ? 1. : 0.;
+      anyRefit |= refit[n] != 0.;
+    }
+    // lanes that are not refitted keep their results
+    store(tracks, active, refit, results, fitted, false);
+    if (anyRefit) {
+      filterAndSmooth(tracks, refit, true);
+      store(tracks, refit, refit, results, fitted, true);
+    }
+  }
+
+  /// Copy the results of the lanes with mask set, excluding those with skip set unless useSkipped
+  void store(const Track* tracks, const double* mask, const double* skip, KalmanFit::Result* results,
+             uint8_t* fitted, bool useSkipped) {
+    for (int n = 0; n < W; ++n) {
+      if (mask[n] == 0. || (!useSkipped && skip[n] != 0.))
+        continue;
+      const uint32_t track = m_lanes[n];
+      fitted[track]        = m_fitted[n] != 0.;
+      if (tracks[track].accepted)
+        for (uint32_t k = 0; k < tracks[track].nMeasurements; ++k)
+          tracks[track].accepted[k] = m_steps[k].accepted[n] != 0.;
+      if (!fitted[track])
+        continue;
+      auto& result = results[track];
+      result.chi2  = m_chi2[n];
+      result.nHits = uint32_t(m_nHits[n]);
+      result.ndf   = 2 * int(result.nHits) - N;
+      unpack(m_reference, n, result.atReference);
+      unpack(m_firstHit, n, result.atFirstHit);
+      unpack(m_lastHit, n, result.atLastHit);
+    }
+  }
+
+  template <typename T> static void copy(const T& from, T& to) { std::memcpy(&to, &from, sizeof(T)); }
+
+  /// to = from for the lanes with mask set
+  static void select(const double (&mask)[W], const States<W>& from, States<W>& to) {
+    for (int i = 0; i < 3; ++i)
+      for (int n = 0; n < W; ++n)
+        to.pivot[i][n] = mask[n] != 0. ? from.pivot[i][n] : to.pivot[i][n];
+    for (int i = 0; i < N; ++i)
+      for (int n = 0; n < W; ++n)
+        to.params[i][n] = mask[n] != 0. ? from.params[i][n] : to.params[i][n];
+    for (int i = 0; i < NSYM; ++i)
+      for (int n = 0; n < W; ++n)
+        to.cov[i][n] = mask[n] != 0. ? from.cov[i][n] : to.cov[i][n];
+  }
+
+  static void unpack(const States<W>& states, int n, KalmanFit::State& state) {
+    for (int i = 0; i < 3; ++i)
+      state.pivot[i] = states.pivot[i][n];
+    for (int i = 0; i < N; ++i) {
+      state.params[i] = states.params[i][n];
+      for (int j = 0; j < N; ++j)
+        state.cov[i][j] = states.cov[sym(i, j)][n];
+    }
+  }
+
+  /// Filter and smooth the lanes with active set; with forcedSides, the wire sides are the smoothed sides of the
+  /// previous call. False if no lane has accepted enough measurements.
+  bool filterAndSmooth(const Track* tracks, const double* active, bool forcedSides) {
+    const KalmanFit::Measurement dummy{};
+    uint32_t                     nSteps = 0;
+    double                       nMeasurements[W];
+    for (int n = 0; n < W; ++n) {
+      nMeasurements[n] = active[n] != 0. ? tracks[m_lanes[n]].nMeasurements : 0.;
+      nSteps           = std::max(nSteps, uint32_t(nMeasurements[n]));
+    }
+    if (m_steps.size() < nSteps)
+      m_steps.resize(nSteps);
+
+    // seed
+    for (int n = 0; n < W; ++n) {
+      const auto& seed = tracks[m_lanes[n]].seed;
+      for (int i = 0; i < 3; ++i)
+        m_state.pivot[i][n] = m_seedPivot[i][n] = seed.pivot[i];
+      for (int i = 0; i < N; ++i) {
+        m_state.params[i][n] = seed.params[i];
+        for (int j = 0; j <= i; ++j)
+          m_state.cov[sym(i, j)][n] = 0.;
+      }
+      for (int i = 0; i < N; ++i) {
+        const double sigma = i == OMEGA ? m_config.seedSigma[i] * std::fabs(seed.params[OMEGA]) : m_config.seedSigma[i];
+        m_state.cov[sym(i, i)][n] = sigma * sigma;
+      }
+      m_chi2[n]     = 0.;
+      m_nHits[n]    = 0.;
+      m_lastStep[n] = -1.;
+    }
+
+    // filter
+    for (uint32_t k = 0; k < nSteps; ++k) {
+      Step& step = m_steps[k];
+      // gather the measurements; masked lanes get a dummy point at their pivot
+      for (int n = 0; n < W; ++n) {
+        const bool  use = k < nMeasurements[n];
+        const auto& m   = use ? tracks[m_lanes[n]].measurements[k] : dummy;
+        m_active[n]     = use ? 1. : 0.;
+        m_isWire[n]     = m.type == KalmanFit::Measurement::Wire ? 1. : 0.;
+        for (int i = 0; i < 3; ++i) {
+          m_position[i][n]  = use ? m.position[i] : m_state.pivot[i][n];
+          m_direction[i][n] = m.direction[i];
+        }
+        m_drift[n] = m.driftDistance;
+        for (int i = 0; i < 6; ++i)
+          m_hitCov[i][n] = use ? m.covariance[i] : (i == 0 || i == 2 || i == 5 ? 1. : 0.);
+        m_forcedSide[n] = use && forcedSides ? step.smoothedSide[n] : 0.;
+      }
+      // pivot: the hit, or the point of the wire at the z of the track
+      transport<W, false>(m_state, m_position, m_trial);
+      for (int n = 0; n < W; ++n) {
+        const double uz   = m_direction[2][n];
+        const bool   wire = m_isWire[n] != 0.;
+        m_valid[n]        = wire & (std::fabs(uz) < 1.e-3) ? 0. : 1.;
+        const double tau  = wire ? m_trial.params[Z0][n] / (m_valid[n] != 0. ? uz : 1.) : 0.;
+        m_tau[n]          = tau;
+        m_newPivot[0][n]  = wire ? m_position[0][n] + tau * m_direction[0][n] : m_position[0][n];
+        m_newPivot[1][n]  = wire ? m_position[1][n] + tau * m_direction[1][n] : m_position[1][n];
+        m_newPivot[2][n]  = wire ? m_position[2][n] + tau * uz : m_position[2][n];
+      }
+      transport<W, true>(m_state, m_newPivot, m_predicted);
+      measurementModel();
+      update();
+      for (int n = 0; n < W; ++n)
+        m_lastStep[n] = m_accepted[n] != 0. ? k : m_lastStep[n];
+      // the lane loops only use members, the history is copied
+      copy(m_newPivot, step.pivot);
+      copy(m_direction, step.direction);
+      copy(m_hitCov[0], step.driftVariance);
+      copy(m_isWire, step.isWire);
+      copy(m_accepted, step.accepted);
+      copy(m_side, step.side);
+    }
+
+    bool any = false;
+    for (int n = 0; n < W; ++n) {
+      m_fitted[n] = active[n] != 0. && m_nHits[n] >= m_config.minHits && 2. * m_nHits[n] - N > 0. ? 1. : 0.;
+      any |= m_fitted[n] != 0.;
+    }
+    if (!any)
+      return false;
+
+    // smoother: transport the last filtered state back, hit by hit
+    m_lastHit = m_state;
+    for (int n = 0; n < W; ++n)
+      m_refit[n] = 0.;
+    for (uint32_t k = nSteps; k-- > 0;) {
+      Step& step = m_steps[k];
+      copy(step.pivot, m_newPivot);
+      copy(step.direction, m_direction);
+      copy(step.driftVariance, m_hitCov[0]);
+      copy(step.isWire, m_isWire);
+      copy(step.accepted, m_accepted);
+      copy(step.side, m_side);
+      transport<W, true>(m_state, m_newPivot, m_predicted);
+      alignas(64) double move[W];
+      for (int n = 0; n < W; ++n)
+        move[n] = (m_accepted[n] != 0.) & (k < m_lastStep[n]) ? 1. : 0.;
+      select(move, m_predicted, m_state);
+      smoothedSides();
+      copy(m_smoothedSide, step.smoothedSide);
+    }
+    m_firstHit = m_state;
+    transport<W, true>(m_firstHit, m_seedPivot, m_reference);
+    return true;
+  }
+
+  /// Measurement of each lane, linear in (d0, z0) of the predicted state: m = h0 + g (d0, z0) + noise(v)
+  void measurementModel() {
+    const double ambiguous2 = m_config.ambiguousSigmas * m_config.ambiguousSigmas;
+    for (int n = 0; n < W; ++n) {
+      const double d0   = m_predicted.params[D0][n];
+      const double z0   = m_predicted.params[Z0][n];
+      const double tanL = m_predicted.params[TANLAMBDA][n];
+      double       sinPhi, cosPhi;
+      SimdMath::sinCos(m_predicted.params[PHI0][n], sinPhi, cosPhi);
+      // point
+      const double nn = sinPhi * sinPhi * m_hitCov[0][n] - 2. * sinPhi * cosPhi * m_hitCov[1][n] +
+                        cosPhi * cosPhi * m_hitCov[2][n];
+      const double nt = -sinPhi * cosPhi * m_hitCov[0][n] + (cosPhi * cosPhi - sinPhi * sinPhi) * m_hitCov[1][n] +
+                        sinPhi * cosPhi * m_hitCov[2][n];
+      const double tt = cosPhi * cosPhi * m_hitCov[0][n] + 2. * sinPhi * cosPhi * m_hitCov[1][n] +
+                        sinPhi * sinPhi * m_hitCov[2][n];
+      const double nz  = -sinPhi * m_hitCov[3][n] + cosPhi * m_hitCov[4][n];
+      const double tz  = cosPhi * m_hitCov[3][n] + sinPhi * m_hitCov[4][n];
+      const double vdd = nn;
+      const double vdz = -tanL * nt + nz;
+      const double vzz = tanL * tanL * tt - 2. * tanL * tz + m_hitCov[5][n];
+      // wire, as KalmanFit::wireProjection
+      const double u0        = m_direction[0][n];
+      const double u1        = m_direction[1][n];
+      const double u2        = m_direction[2][n];
+      const double cosLambda = 1. / std::sqrt(1. + tanL * tanL);
+      const double t0        = cosPhi * cosLambda;
+      const double t1        = sinPhi * cosLambda;
+      const double t2        = tanL * cosLambda;
+      const double tu        = t0 * u0 + t1 * u1 + t2 * u2;
+      const double sin2      = 1. - tu * tu;
+      const bool   parallel  = sin2 < 1.e-6;
+      const double norm      = 1. / std::sqrt(parallel ? 1. : sin2);
+      const double nrm0      = (t1 * u2 - t2 * u1) * norm;
+      const double nrm1      = (t2 * u0 - t0 * u2) * norm;
+      const double nrm2      = (t0 * u1 - t1 * u0) * norm;
+      const double along0    = (u0 - tu * t0) * norm * norm;
+      const double along1    = (u1 - tu * t1) * norm * norm;
+      const double along2    = (u2 - tu * t2) * norm * norm;
+      const double g00       = -sinPhi * nrm0 + cosPhi * nrm1;
+      const double g01       = nrm2;
+      const double g10       = -sinPhi * along0 + cosPhi * along1;
+      const double g11       = along2;
+      const auto&  c         = m_predicted.cov;
+      const double distance  = g00 * d0 + g01 * z0;
+      const double variance  = g00 * g00 * c[sym(D0, D0)][n] + 2. * g00 * g01 * c[sym(D0, Z0)][n] +
+                              g01 * g01 * c[sym(Z0, Z0)][n];
+      const double drift     = m_drift[n];
+      const bool   forced    = m_forcedSide[n] != 0.;
+      const bool   ambiguous = !forced & (drift * drift < ambiguous2 * variance);
+      const double side      = forced ? m_forcedSide[n] : (ambiguous ? 0. : (distance < 0. ? -1. : 1.));
+      const double vWire     = ambiguous ? m_hitCov[0][n] + drift * drift : m_hitCov[0][n];
+
+      const bool wire = m_isWire[n] != 0.;
+      m_valid[n]      = wire & parallel ? 0. : m_valid[n];
+      m_g[0][0][n]   = wire ? g00 : 1.;
+      m_g[0][1][n]   = wire ? g01 : 0.;
+      m_g[1][0][n]   = wire ? g10 : 0.;
+      m_g[1][1][n]   = wire ? g11 : 1.;
+      m_h0[1][n]     = wire ? m_tau[n] : 0.;
+      m_m[0][n]      = wire ? side * drift : 0.;
+      m_v[0][0][n]   = wire ? vWire : vdd;
+      m_v[0][1][n]   = wire ? 0. : vdz;
+      m_v[1][1][n]   = wire ? m_hitCov[1][n] : vzz;
+      m_side[n]      = wire ? side : 0.;
+    }
+  }
+
+  /// KalmanFit::update of each lane, the lanes whose measurement is rejected keep their previous state
+  void update() {
+    const double maxChi2 = m_config.maxChi2PerHit;
+    const auto& c = m_predicted.cov;
+    // c h^T
+    alignas(64) double cht[N][2][W];
+#pragma GCC unroll 5
+    for (int i = 0; i < N; ++i)
+#pragma GCC unroll 2
+      for (int j = 0; j < 2; ++j)
+        for (int n = 0; n < W; ++n)
+          cht[i][j][n] = c[sym(i, D0)][n] * m_g[j][0][n] + c[sym(i, Z0)][n] * m_g[j][1][n];
+    alignas(64) double k[N][2][W], r[2][W], accept[W];
+    alignas(64) double si[2][2][W];
+    for (int n = 0; n < W; ++n) {
+      const double s00 = m_g[0][0][n] * cht[D0][0][n] + m_g[0][1][n] * cht[Z0][0][n] + m_v[0][0][n];
+      const double s01 = m_g[0][0][n] * cht[D0][1][n] + m_g[0][1][n] * cht[Z0][1][n] + m_v[0][1][n];
+      const double s10 = m_g[1][0][n] * cht[D0][0][n] + m_g[1][1][n] * cht[Z0][0][n] + m_v[0][1][n];
+      const double s11 = m_g[1][0][n] * cht[D0][1][n] + m_g[1][1][n] * cht[Z0][1][n] + m_v[1][1][n];
+      const double determinant = s00 * s11 - s01 * s10;
+      const double inverse     = 1. / determinant;
+      si[0][0][n]              = s11 * inverse;
+      si[0][1][n]              = -s01 * inverse;
+      si[1][0][n]              = -s10 * inverse;
+      si[1][1][n]              = s00 * inverse;
+      const double x0          = m_predicted.params[D0][n];
+      const double x3          = m_predicted.params[Z0][n];
+      r[0][n]                  = m_m[0][n] - 0. - m_g[0][0][n] * x0 - m_g[0][1][n] * x3;
+      r[1][n]                  = 0. - m_h0[1][n] - m_g[1][0][n] * x0 - m_g[1][1][n] * x3;
+      const double chi2 = r[0][n] * (si[0][0][n] * r[0][n] + si[0][1][n] * r[1][n]) +
+                          r[1][n] * (si[1][0][n] * r[0][n] + si[1][1][n] * r[1][n]);
+      accept[n] = (m_active[n] != 0.) & (m_valid[n] != 0.) & (determinant > 0.) & !(chi2 > maxChi2) ? 1. : 0.;
+      m_chi2[n] += accept[n] != 0. ? chi2 : 0.;
+      m_nHits[n] += accept[n];
+      m_accepted[n] = accept[n];
+    }
+    // gain, state and covariance
+#pragma GCC unroll 5
+    for (int i = 0; i < N; ++i)
+#pragma GCC unroll 2
+      for (int j = 0; j < 2; ++j)
+        for (int n = 0; n < W; ++n)
+          k[i][j][n] = cht[i][0][n] * si[0][j][n] + cht[i][1][n] * si[1][j][n];
+    for (int i = 0; i < 3; ++i)
+      for (int n = 0; n < W; ++n)
+        m_state.pivot[i][n] = accept[n] != 0. ? m_predicted.pivot[i][n] : m_state.pivot[i][n];
+    for (int i = 0; i < N; ++i)
+      for (int n = 0; n < W; ++n) {
+        const double value   = m_predicted.params[i][n] + (k[i][0][n] * r[0][n] + k[i][1][n] * r[1][n]);
+        m_state.params[i][n] = accept[n] != 0. ? value : m_state.params[i][n];
+      }
+#pragma GCC unroll 5
+    for (int i = 0; i < N; ++i)
+#pragma GCC unroll 5
+      for (int j = 0; j <= i; ++j)
+        for (int n = 0; n < W; ++n) {
+          const double value = c[sym(i, j)][n] - (k[i][0][n] * cht[j][0][n] + k[i][1][n] * cht[j][1][n]);
+          m_state.cov[sym(i, j)][n] = accept[n] != 0. ? value : m_state.cov[sym(i, j)][n];
+        }
+  }
+
+  /// Sides of the wires for the smoothed state of the accepted lanes, and whether the lane should be refitted
+  void smoothedSides() {
+    const double refitSigmas = m_config.refitSideSigmas;
+    for (int n = 0; n < W; ++n) {
+      const double tanL = m_state.params[TANLAMBDA][n];
+      double       sinPhi, cosPhi;
+      SimdMath::sinCos(m_state.params[PHI0][n], sinPhi, cosPhi);
+      const double u0        = m_direction[0][n];
+      const double u1        = m_direction[1][n];
+      const double u2        = m_direction[2][n];
+      const double cosLambda = 1. / std::sqrt(1. + tanL * tanL);
+      const double t0        = cosPhi * cosLambda;
+      const double t1        = sinPhi * cosLambda;
+      const double t2        = tanL * cosLambda;
+      const double tu        = t0 * u0 + t1 * u1 + t2 * u2;
+      const double sin2      = 1. - tu * tu;
+      const bool   parallel  = sin2 < 1.e-6;
+      const double norm      = 1. / std::sqrt(parallel ? 1. : sin2);
+      const double nrm0      = (t1 * u2 - t2 * u1) * norm;
+      const double nrm1      = (t2 * u0 - t0 * u2) * norm;
+      const double nrm2      = (t0 * u1 - t1 * u0) * norm;
+      const double distance  = (-sinPhi * nrm0 + cosPhi * nrm1) * m_state.params[D0][n] + nrm2 * m_state.params[Z0][n];
+      const bool   use       = (m_accepted[n] != 0.) & (m_isWire[n] != 0.) & !parallel;
+      const double side      = distance < 0. ? -1. : 1.;
+      m_smoothedSide[n]      = use ? side : 0.;
+      const bool flip = use & (side != m_side[n]) & (distance * distance > refitSigmas * refitSigmas * m_hitCov[0][n]);
+      m_refit[n] = flip & (refitSigmas > 0.) ? 1. : m_refit[n];
+    }
+  }
+
+  KalmanFit::Config m_config;
+
+  std::vector<uint32_t> m_order;
+  uint32_t              m_lanes[W];
+  std::vector<Step>     m_steps;
+
+  States<W> m_state, m_trial, m_predicted, m_firstHit, m_lastHit, m_reference;
+  alignas(64) double m_seedPivot[3][W];
+  alignas(64) double m_position[3][W];
+  alignas(64) double m_newPivot[3][W];
+  alignas(64) double m_hitCov[6][W];
+  alignas(64) double m_direction[3][W];
+  alignas(64) double m_isWire[W];
+  alignas(64) double m_drift[W];
+  alignas(64) double m_tau[W];
+  alignas(64) double m_forcedSide[W];
+  alignas(64) double m_active[W];
+  alignas(64) double m_valid[W];
+  alignas(64) double m_accepted[W];
+  alignas(64) double m_side[W];
+  alignas(64) double m_smoothedSide[W];
+  alignas(64) double m_g[2][2][W];
+  alignas(64) double m_h0[2][W];
+  alignas(64) double m_m[2][W];
+  alignas(64) double m_v[2][2][W];
+  alignas(64) double m_chi2[W];
+  alignas(64) double m_nHits[W];
+  alignas(64) double m_lastStep[W];
+  alignas(64) double m_fitted[W];
+  alignas(64) double m_refit[W];
+};
+
+} // namespace KalmanMatriplex
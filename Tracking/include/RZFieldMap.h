@@ -0,0 +1,77 @@
+#pragma once
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/** @class RZFieldMap
+ *
+ *  Axially symmetric magnetic field map, sampled on a regular (r, z) grid and bilinearly interpolated.
+ *  Positions are in mm and fields in Tesla. Outside of the grid, the field of the closest grid edge is returned.
+ *
+ */
+
+class RZFieldMap {
+public:
+  /// Allocate a grid of nR x nZ points covering r in [0, rMax] and z in [-zMax, zMax]
+  void resize(double rMax, double zMax, int nR, int nZ) {
+    m_rMax  = rMax;
+    m_zMax  = zMax;
+    m_nR    = nR;
+    m_nZ    = nZ;
+    m_invDr = (nR - 1) / rMax;
+    m_invDz = (nZ - 1) / (2. * zMax);
+    m_br.assign(std::size_t(nR) * nZ, 0.f);
+    m_bz.assign(std::size_t(nR) * nZ, 0.f);
+  }
+
+  int    nR() const { return m_nR; }
+  int    nZ() const { return m_nZ; }
+  double r(int ir) const { return ir / m_invDr; }
+  double z(int iz) const { return -m_zMax + iz / m_invDz; }
+
+  /// Set the radial and longitudinal field at a grid point
+  void set(int ir, int iz, double br, double bz) {
+    m_br[index(ir, iz)] = br;
+    m_bz[index(ir, iz)] = bz;
+  }
+
+  /// Field (Bx, By, Bz) at a position
+  void field(const double pos[3], double b[3]) const {
+    const double r = std::sqrt(pos[0] * pos[0] + pos[1] * pos[1]);
+    double       br, bz;
+    interpolate(r, pos[2], br, bz);
+    const double invR = r > 0. ? 1. / r : 0.;
+    b[0]              = br * pos[0] * invR;
+    b[1]              = br * pos[1] * invR;
+    b[2]              = bz;
+  }
+
+  /// Longitudinal field at a position
+  double bz(const double pos[3]) const {
+    double br, bz;
+    interpolate(std::sqrt(pos[0] * pos[0] + pos[1] * pos[1]), pos[2], br, bz);
+    return bz;
+  }
+
+private:
+  std::size_t index(int ir, int iz) const { return std::size_t(iz) * m_nR + ir; }
+
+  void interpolate(double r, double z, double& br, double& bz) const {
+    const double u  = std::clamp(r * m_invDr, 0., double(m_nR - 1));
+    const double v  = std::clamp((z + m_zMax) * m_invDz, 0., double(m_nZ - 1));
+    const int    ir = std::min(int(u), m_nR - 2);
+    const int    iz = std::min(int(v), m_nZ - 2);
+    const double fu = u - ir;
+    const double fv = v - iz;
+    const double w00 = (1. - fu) * (1. - fv), w10 = fu * (1. - fv), w01 = (1. - fu) * fv, w11 = fu * fv;
+    const std::size_t i00 = index(ir, iz), i10 = i00 + 1, i01 = i00 + m_nR, i11 = i01 + 1;
+    br = w00 * m_br[i00] + w10 * m_br[i10] + w01 * m_br[i01] + w11 * m_br[i11];
+    bz = w00 * m_bz[i00] + w10 * m_bz[i10] + w01 * m_bz[i01] + w11 * m_bz[i11];
+  }
+
+  double             m_rMax = 0, m_zMax = 0, m_invDr = 0, m_invDz = 0;
+  int                m_nR = 0, m_nZ = 0;
+  std::vector<float> m_br, m_bz;
+};
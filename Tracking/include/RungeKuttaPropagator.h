@@ -0,0 +1,156 @@
+#pragma once
+
+#include "HelixMath.h"
+#include "RZFieldMap.h"
+
+// C++
+#include <algorithm>
+#include <cmath>
+
+/** @class RungeKuttaPropagator
+ *
+ *  Propagation of a charged particle through an RZFieldMap with the embedded Runge-Kutta (Cash-Karp) method, with
+ *  adaptive steps: the step is shrunk when the estimated position error is above the tolerance and grown otherwise.
+ *  The propagation stops on a surface, given as a signed distance function of the position (negative before the
+ *  surface), and the last step is shortened so that the final state lies on the surface.
+ *  Positions are in mm, momenta in GeV and fields in Tesla.
+ *
+ */
+
+class RungeKuttaPropagator {
+public:
+  struct State {
+    double pos[3];
+    double mom[3];
+    double charge;
+    /// path length travelled so far [mm]
+    double pathLength = 0.;
+  };
+
+  RungeKuttaPropagator(const RZFieldMap& fieldMap, double tolerance = 1.e-3, double minStep = 0.1,
+                       double maxStep = 200.)
+      : m_fieldMap(fieldMap), m_tolerance(tolerance), m_minStep(minStep), m_maxStep(maxStep) {}
+
+  /// Signed distance to a cylinder around the z axis
+  static auto cylinder(double radius) {
+    return [radius](const double* pos) { return std::sqrt(pos[0] * pos[0] + pos[1] * pos[1]) - radius; };
+  }
+  /// Signed distance to the plane z = zPlane, for a particle starting on the side of the origin
+  static auto zPlane(double zPlane) {
+    return [zPlane](const double* pos) { return zPlane > 0. ? pos[2] - zPlane : zPlane - pos[2]; };
+  }
+
+  /// Propagate the state until the signed distance becomes positive, return false if maxPath is reached before
+  template <typename Surface>
+  bool propagate(State& state, Surface&& signedDistance, double maxPath) const {
+    const double p = std::sqrt(state.mom[0] * state.mom[0] + state.mom[1] * state.mom[1] + state.mom[2] * state.mom[2]);
+    if (p <= 0.)
+      return false;
+    // y = (position, unit direction)
+    double y[6] = {state.pos[0], state.pos[1], state.pos[2], state.mom[0] / p, state.mom[1] / p, state.mom[2] / p};
+    const double lambda = HelixMath::FCT * state.charge / p;
+    double       distance = signedDistance(y);
+    if (distance >= 0.)
+      return true;
+
+    double step = m_maxStep;
+    double path = 0.;
+    while (path < maxPath) {
+      step = std::min(step, maxPath - path);
+      double yNext[6], error;
+      this->step(y, step, lambda, yNext, error);
+      if (error > m_tolerance && step > m_minStep) {
+        step = std::max(m_minStep, step * std::max(0.1, 0.9 * std::pow(m_tolerance / error, 0.25)));
+        continue;
+      }
+      const double nextDistance = signedDistance(yNext);
+      if (nextDistance >= 0.) {
+        // secant search of the step length reaching the surface
+        double h0 = 0., d0 = distance, h1 = step, d1 = nextDistance;
+        for (int iteration = 0; iteration < 20 && std::fabs(d1) > 1.e-4; ++iteration) {
+          const double h = h1 - d1 * (h1 - h0) / (d1 - d0);
+          h0             = h1;
+          d0             = d1;
+          h1             = h;
+          this->step(y, h1, lambda, yNext, error);
+          d1 = signedDistance(yNext);
+        }
+        store(yNext, p, state);
+        state.pathLength += path + h1;
+        return true;
+      }
+      std::copy(yNext, yNext + 6, y);
+      distance = nextDistance;
+      path += step;
+      step = std::min(m_maxStep, step * std::min(5., 0.9 * std::pow(m_tolerance / std::max(error, 1.e-12), 0.2)));
+    }
+    store(y, p, state);
+    state.pathLength += path;
+    return false;
+  }
+
+private:
+  /// dy/ds = (t, lambda t x B)
+  void derivative(const double* y, double lambda, double* dy) const {
+    double b[3];
+    m_fieldMap.field(y, b);
+    dy[0] = y[3];
+    dy[1] = y[4];
+    dy[2] = y[5];
+    dy[3] = lambda * (y[4] * b[2] - y[5] * b[1]);
+    dy[4] = lambda * (y[5] * b[0] - y[3] * b[2]);
+    dy[5] = lambda * (y[3] * b[1] - y[4] * b[0]);
+  }
+
+  /// One Cash-Karp step of length h, with the 5th order solution and the position error estimate
+  void step(const double* y, double h, double lambda, double* yOut, double& error) const {
+    static constexpr double b21 = 1. / 5.;
+    static constexpr double b31 = 3. / 40., b32 = 9. / 40.;
+    static constexpr double b41 = 3. / 10., b42 = -9. / 10., b43 = 6. / 5.;
+    static constexpr double b51 = -11. / 54., b52 = 5. / 2., b53 = -70. / 27., b54 = 35. / 27.;
+    static constexpr double b61 = 1631. / 55296., b62 = 175. / 512., b63 = 575. / 13824., b64 = 44275. / 110592.,
+                            b65 = 253. / 4096.;
+    static constexpr double c1 = 37. / 378., c3 = 250. / 621., c4 = 125. / 594., c6 = 512. / 1771.;
+    static constexpr double dc1 = c1 - 2825. / 27648., dc3 = c3 - 18575. / 48384., dc4 = c4 - 13525. / 55296.,
+                            dc5 = -277. / 14336., dc6 = c6 - 1. / 4.;
+    double k1[6], k2[6], k3[6], k4[6], k5[6], k6[6], tmp[6];
+    derivative(y, lambda, k1);
+    for (int i = 0; i < 6; ++i)
+      tmp[i] = y[i] + h * b21 * k1[i];
+    derivative(tmp, lambda, k2);
+    for (int i = 0; i < 6; ++i)
+      tmp[i] = y[i] + h * (b31 * k1[i] + b32 * k2[i]);
+    derivative(tmp, lambda, k3);
+    for (int i = 0; i < 6; ++i)
+      tmp[i] = y[i] + h * (b41 * k1[i] + b42 * k2[i] + b43 * k3[i]);
+    derivative(tmp, lambda, k4);
+    for (int i = 0; i < 6; ++i)
+      tmp[i] = y[i] + h * (b51 * k1[i] + b52 * k2[i] + b53 * k3[i] + b54 * k4[i]);
+    derivative(tmp, lambda, k5);
+    for (int i = 0; i < 6; ++i)
+      tmp[i] = y[i] + h * (b61 * k1[i] + b62 * k2[i] + b63 * k3[i] + b64 * k4[i] + b65 * k5[i]);
+    derivative(tmp, lambda, k6);
+    error = 0.;
+    for (int i = 0; i < 6; ++i) {
+      yOut[i] = y[i] + h * (c1 * k1[i] + c3 * k3[i] + c4 * k4[i] + c6 * k6[i]);
+      if (i < 3)
+        error = std::max(error, std::fabs(h * (dc1 * k1[i] + dc3 * k3[i] + dc4 * k4[i] + dc5 * k5[i] + dc6 * k6[i])));
+    }
+    // keep the direction normalized
+    const double norm = 1. / std::sqrt(yOut[3] * yOut[3] + yOut[4] * yOut[4] + yOut[5] * yOut[5]);
+    for (int i = 3; i < 6; ++i)
+      yOut[i] *= norm;
+  }
+
+  static void store(const double* y, double p, State& state) {
+    for (int i = 0; i < 3; ++i) {
+      state.pos[i] = y[i];
+      state.mom[i] = p * y[i + 3];
+    }
+  }
+
+  const RZFieldMap& m_fieldMap;
+  double            m_tolerance;
+  double            m_minStep;
+  double            m_maxStep;
+};
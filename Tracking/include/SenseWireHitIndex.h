@@ -0,0 +1,143 @@
+#pragma once
+
+// EDM4HEP extension
+#include "extension/SenseWireHitCollection.h"
+
+// C++
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/** @class SenseWireHitIndex
+ *
+ *  Per event index of the drift chamber hits of a SenseWireHitCollection by layer and azimuth, for the queries "hits of
+ *  layer L within dphi of phi" of track following, hit to track association or residual monitoring.
+ *  It is built in one pass over the hits plus a sort per layer: the hits of all the layers are stored contiguously
+ *  (CSR layout), and within a layer by increasing azimuth in [-pi, pi), then by index in the collection, so that
+ *  results do not depend on the input order of equal azimuths. A window is found with two binary searches, and is split
+ *  in two ranges when it wraps around at +-pi.
+ *  The azimuth of a hit is the one of its position, the point of the wire at the measured position along the wire:
+ *  for stereo wires it differs from wireAzimuthalAngle, the azimuth of the wire at z = 0.
+ *  The layer of a hit is given by the caller, usually from its cellID, e.g. for DCHdigi_v01 hits:
+ *
+ *    index.build(hits, nLayers, [&](const auto& hit) {
+ *      return decoder->get(hit.getCellID(), "superlayer") * layersPerSuperlayer + decoder->get(hit.getCellID(), "layer");
+ *    });
+ *
+ */
+
+class SenseWireHitIndex {
+public:
+  /// Range of indexed hits, by increasing azimuth
+  struct HitRange {
+    const uint32_t* first = nullptr;
+    const uint32_t* last  = nullptr;
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    std::size_t     size() const { return last - first; }
+    bool            empty() const { return first == last; }
+  };
+
+  /// Index the hits in nLayers layers, layerOf(hit) giving the layer of a hit; hits of other layers are ignored
+  template <typename LayerOf>
+  void build(const extension::SenseWireHitCollection& hits, uint32_t nLayers, LayerOf&& layerOf) {
+    m_offsets.assign(nLayers + 1, 0);
+    m_layers.resize(hits.size());
+
+    // first pass: layer and azimuth of each hit, and number of hits per layer
+    m_azimuths.resize(hits.size());
+    for (uint32_t i = 0; i < hits.size(); ++i) {
+      const auto&    hit      = hits[i];
+      const uint32_t layer    = layerOf(hit);
+      const auto&    position = hit.getPosition();
+      m_layers[i]             = layer;
+      m_azimuths[i]           = wrap(std::atan2(position.y, position.x));
+      if (layer < nLayers)
+        ++m_offsets[layer + 1];
+    }
+    // prefix sum, then second pass to fill the hits of each layer, and sort of each layer by azimuth
+    for (std::size_t layer = 1; layer < m_offsets.size(); ++layer)
+      m_offsets[layer] += m_offsets[layer - 1];
+    m_entries.resize(m_offsets.back());
+    std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+    for (uint32_t i = 0; i < hits.size(); ++i)
+      if (m_layers[i] < nLayers)
+        m_entries[fill[m_layers[i]]++] = Entry{m_azimuths[i], i};
+    for (uint32_t layer = 0; layer < nLayers; ++layer)
+      std::sort(m_entries.begin() + m_offsets[layer], m_entries.begin() + m_offsets[layer + 1],
+                [](const Entry& a, const Entry& b) {
+                  return a.azimuth < b.azimuth || (a.azimuth == b.azimuth && a.hit < b.hit);
+                });
+
+    // the queries search the azimuths and return the hits: two contiguous arrays
+    m_azimuths.resize(m_entries.size());
+    m_hits.resize(m_entries.size());
+    for (std::size_t k = 0; k < m_entries.size(); ++k) {
+      m_azimuths[k] = m_entries[k].azimuth;
+      m_hits[k]     = m_entries[k].hit;
+    }
+  }
+
+  /// Number of layers and of indexed hits
+  uint32_t    nLayers() const { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+  std::size_t size() const { return m_hits.size(); }
+
+  /// Indices in the collection of the hits of a layer
+  HitRange layer(uint32_t layer) const {
+    if (layer >= nLayers())
+      return {};
+    return {m_hits.data() + m_offsets[layer], m_hits.data() + m_offsets[layer + 1]};
+  }
+
+  /// Azimuth of an indexed hit, for a pointer into one of the ranges
+  float azimuth(const uint32_t* hit) const { return m_azimuths[hit - m_hits.data()]; }
+
+  /// Hits of a layer with an azimuth within halfWidth of phi: the second range is not empty when the window wraps
+  /// around at +-pi, it then holds the hits from -pi on
+  std::array<HitRange, 2> window(uint32_t layer, double phi, double halfWidth) const {
+    if (layer >= nLayers() || !(halfWidth >= 0.))
+      return {};
+    const uint32_t begin = m_offsets[layer];
+    const uint32_t end   = m_offsets[layer + 1];
+    if (halfWidth >= M_PI)
+      return {HitRange{m_hits.data() + begin, m_hits.data() + end}, HitRange{}};
+    const double centre = wrap(phi);
+    const double low    = centre - halfWidth;
+    const double high   = centre + halfWidth;
+    if (low < -M_PI)
+      return {range(begin, end, low + 2. * M_PI, M_PI), range(begin, end, -M_PI, high)};
+    if (high >= M_PI)
+      return {range(begin, end, low, M_PI), range(begin, end, -M_PI, high - 2. * M_PI)};
+    return {range(begin, end, low, high), HitRange{}};
+  }
+
+private:
+  struct Entry {
+    float    azimuth;
+    uint32_t hit;
+  };
+
+  /// Azimuth in [-pi, pi)
+  static double wrap(double phi) {
+    const double wrapped = std::remainder(phi, 2. * M_PI);
+    return wrapped < M_PI ? wrapped : -M_PI;
+  }
+
+  /// Hits of [begin, end) with an azimuth in [low, high]
+  HitRange range(uint32_t begin, uint32_t end, double low, double high) const {
+    const float* azimuths = m_azimuths.data();
+    const float* first    = std::lower_bound(azimuths + begin, azimuths + end, float(low));
+    const float* last     = std::upper_bound(first, azimuths + end, float(high));
+    return {m_hits.data() + (first - azimuths), m_hits.data() + (last - azimuths)};
+  }
+
+  /// Layer of each hit of the collection, used while building
+  std::vector<uint32_t> m_layers;
+  std::vector<Entry>    m_entries;
+  /// Hits of layer l: [m_offsets[l], m_offsets[l + 1]) in m_azimuths and m_hits
+  std::vector<uint32_t> m_offsets;
+  std::vector<float>    m_azimuths;
+  std::vector<uint32_t> m_hits;
+};
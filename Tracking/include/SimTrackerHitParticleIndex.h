@@ -0,0 +1,109 @@
+#pragma once
+
+// edm4hep
+#include "edm4hep/SimTrackerHitCollection.h"
+
+// podio
+#include "podio/ObjectID.h"
+
+// C++
+#include <cstdint>
+#include <vector>
+
+#include "DenseKeyIndex.h"
+
+/** @class SimTrackerHitParticleIndex
+ *
+ *  Per event index of the SimTrackerHits of several collections, grouped by the object ID of their MCParticle.
+ *  It is built in one pass over the hits: a DenseKeyIndex maps the MCParticle object ID to a bucket, and the hit
+ *  references of all the buckets are stored contiguously (CSR layout).
+ *  Within a bucket, hits keep the order of the input collections, so that results do not depend on the hash.
+ *
+ */
+
+class SimTrackerHitParticleIndex {
+public:
+  /// Position of a hit: index of its collection in the input vector and index in the collection
+  struct HitRef {
+    uint32_t collection;
+    uint32_t index;
+  };
+
+  /// Range of the hits of one particle
+  struct HitRange {
+    const HitRef* first = nullptr;
+    const HitRef* last  = nullptr;
+    const HitRef* begin() const { return first; }
+    const HitRef* end() const { return last; }
+    std::size_t   size() const { return last - first; }
+    bool          empty() const { return first == last; }
+  };
+
+  /// Index the hits of the collections, hits without MCParticle are ignored
+  void build(const std::vector<const edm4hep::SimTrackerHitCollection*>& collections) {
+    std::size_t nHits = 0;
+    for (const auto* coll : collections)
+      nHits += coll->size();
+    m_particles.reset(nHits);
+    m_offsets.assign(1, 0);
+
+    // first pass: find the bucket of each hit and count the hits per bucket
+    std::vector<uint32_t> hitBuckets;
+    hitBuckets.reserve(nHits);
+    for (const auto* coll : collections) {
+      for (const auto& hit : *coll) {
+        const auto particle = hit.getParticle();
+        uint32_t   bucket   = npos;
+        if (particle.isAvailable()) {
+          const auto [index, inserted] = m_particles.insert(key(particle.getObjectID()));
+          if (inserted)
+            m_offsets.push_back(0);
+          bucket = index;
+        }
+        hitBuckets.push_back(bucket);
+        if (bucket != npos)
+          ++m_offsets[bucket + 1];
+      }
+    }
+    // prefix sum, then second pass to fill the hit references of each bucket
+    for (std::size_t i = 1; i < m_offsets.size(); ++i)
+      m_offsets[i] += m_offsets[i - 1];
+    m_hits.resize(m_offsets.back());
+    std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+    std::size_t           iHit = 0;
+    for (uint32_t iColl = 0; iColl < collections.size(); ++iColl) {
+      for (uint32_t ih = 0; ih < collections[iColl]->size(); ++ih) {
+        uint32_t bucket = hitBuckets[iHit++];
+        if (bucket != npos)
+          m_hits[fill[bucket]++] = HitRef{iColl, ih};
+      }
+    }
+  }
+
+  /// Hits belonging to the MCParticle with the given object ID
+  HitRange hits(const podio::ObjectID& particleID) const {
+    const uint32_t bucket = m_particles.find(key(particleID));
+    if (bucket == npos)
+      return {};
+    return {m_hits.data() + m_offsets[bucket], m_hits.data() + m_offsets[bucket + 1]};
+  }
+
+  /// Number of distinct particles with hits
+  std::size_t nParticles() const { return m_particles.size(); }
+
+  /// Allocated memory in bytes
+  std::size_t memory() const {
+    return m_particles.memory() + m_offsets.capacity() * sizeof(uint32_t) + m_hits.capacity() * sizeof(HitRef);
+  }
+
+private:
+  static constexpr uint32_t npos = DenseKeyIndex<uint64_t>::npos;
+
+  static uint64_t key(const podio::ObjectID& id) {
+    return (static_cast<uint64_t>(id.collectionID) << 32) | static_cast<uint32_t>(id.index);
+  }
+
+  DenseKeyIndex<uint64_t> m_particles;
+  std::vector<uint32_t>   m_offsets;
+  std::vector<HitRef>     m_hits;
+};
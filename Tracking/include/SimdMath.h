@@ -0,0 +1,89 @@
+#pragma once
+
+// C++
+#include <cmath>
+
+/** @namespace SimdMath
+ *
+ *  Branch free sine, cosine and arc tangent (Cephes polynomials, accurate to about one ulp), written with selects
+ *  only so that the compiler vectorizes the loops calling them. The libm functions are calls that block the
+ *  vectorization, and they differ from their vector counterparts: these give the same bits whether they are
+ *  evaluated in scalar or vector registers.
+ *
+ */
+
+namespace SimdMath {
+
+constexpr double PI      = 3.14159265358979323846;
+constexpr double PI_2    = 1.57079632679489661923;
+constexpr double PI_4    = 0.78539816339744830962;
+constexpr double TWO_PI  = 6.28318530717958647692;
+constexpr double INV_PI2 = 0.63661977236758134308; // 2 / pi
+
+/// Nearest integer (ties to even), for |x| < 2^51
+inline double nearest(double x) {
+  constexpr double shift = 6755399441055744.; // 1.5 * 2^52
+  return (x + shift) - shift;
+}
+
+/// Angle in [-pi, pi]
+inline double wrapPi(double phi) { return phi - TWO_PI * nearest(phi * (1. / TWO_PI)); }
+
+/// Sine and cosine, for |x| < 1e6
+inline void sinCos(double x, double& sin, double& cos) {
+  // x = q pi / 2 + r, with |r| <= pi / 4 and pi / 2 split in three parts so that q pi / 2 is exact
+  constexpr double pio2_1 = 1.57079632673412561417e+00;
+  constexpr double pio2_2 = 6.07710050630396597660e-11;
+  constexpr double pio2_3 = 2.02226624879595063154e-21;
+  const double     q      = nearest(x * INV_PI2);
+  // quadrant = q modulo 4, (q - 1.5) / 4 is never half way between two integers
+  const double quadrant = q - 4. * nearest((q - 1.5) * 0.25);
+  const double r        = ((x - q * pio2_1) - q * pio2_2) - q * pio2_3;
+  const double z        = r * r;
+  const double s        = r + r * z *
+                         (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z +
+                             2.75573136213857245213e-6) * z - 1.98412698295895385996e-4) * z +
+                           8.33333333332211858878e-3) * z - 1.66666666666666307295e-1);
+  const double c = 1. - 0.5 * z +
+                   z * z *
+                       (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z -
+                           2.75573141792967388112e-7) * z + 2.48015872888517045348e-5) * z -
+                         1.38888888888730564116e-3) * z + 4.16666666666665929218e-2);
+  const bool   swap   = (quadrant == 1.) | (quadrant == 3.);
+  const bool   negSin = quadrant >= 2.;
+  const bool   negCos = (quadrant == 1.) | (quadrant == 2.);
+  const double sinR   = swap ? c : s;
+  const double cosR   = swap ? s : c;
+  sin                 = negSin ? -sinR : sinR;
+  cos                 = negCos ? -cosR : cosR;
+}
+
+/// Arc tangent of y / x in [-pi, pi]
+inline double atan2(double y, double x) {
+  constexpr double tan3pi8  = 2.41421356237309504880;
+  constexpr double moreBits = 6.123233995736765886130e-17;
+  const double     ax       = std::fabs(x);
+  const double     ay       = std::fabs(y);
+  // reduce t = ay / ax to [0, tan(pi / 8)] with atan(t) = pi / 2 + atan(-1 / t) = pi / 4 + atan((t - 1) / (t + 1)),
+  // with a single division of selected operands: the compiler would move divisions in selects to branches
+  const bool   large       = ay > tan3pi8 * ax;
+  const bool   medium      = (ay > 0.66 * ax) & !large;
+  const double numerator   = large ? -ax : (medium ? ay - ax : ay);
+  const double denominator = large ? ay : (medium ? ay + ax : ax);
+  const double u           = numerator / (denominator > 0. ? denominator : 1.);
+  const double offset      = large ? PI_2 : (medium ? PI_4 : 0.);
+  const double extra       = large ? moreBits : (medium ? 0.5 * moreBits : 0.);
+  const double z           = u * u;
+  const double p           = (((-8.750608600031904122785e-1 * z - 1.615753718733365076637e1) * z -
+                     7.500855792314704667340e1) * z - 1.228866684490136173410e2) * z -
+                   6.485021904942025371773e1;
+  const double q = ((((z + 2.485846490142306297962e1) * z + 1.650270098316988542046e2) * z +
+                    4.328810604912902668951e2) * z + 4.853903996359136964868e2) * z +
+                   1.945506571482613964425e2;
+  const double atanT = offset + ((u * (z * p / q) + u) + extra);
+  // quadrants 2 to 4
+  const double angle = x < 0. ? PI - atanT : atanT;
+  return y < 0. ? -angle : angle;
+}
+
+} // namespace SimdMath
@@ -0,0 +1,228 @@
+#pragma once
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** @namespace TrackSmearing
+ *
+ *  Parametric resolution of the helix parameters (d0, phi0, omega, z0, tanLambda), to smear generator level tracks.
+ *
+ *  The resolution is a lookup table in bins of (pT, |eta|) per particle type (|PDG| code), whose entries are the
+ *  covariance of (d0 [mm], phi0 [rad], omega / |omega|, z0 [mm], tanLambda): the curvature is smeared in relative terms,
+ *  so that an entry holds for the whole bin. The covariances and their Cholesky factors are stored contiguously, one
+ *  block of 15 (lower triangle, row by row: 00, 10, 11, 20, ...) per entry; smearing a track is a lookup, 5 gaussian
+ *  numbers and a triangular product.
+ *
+ *  The table is either read from a text file, e.g. from fits of the residuals of fully simulated tracks:
+ *
+ *    # comments start with #
+ *    ptEdges     0.1 0.5 1 2 5 10 20 50 100
+ *    absEtaEdges 0 0.5 1 1.5 2 2.5
+ *    # pdg ptBin etaBin sigma(d0) sigma(phi0) sigma(omega)/|omega| sigma(z0) sigma(tanLambda) [10 correlations]
+ *    211 0 0 0.045 0.0021 0.0035 0.060 0.0024  0 0.1 0 0 0 0 0 0 0 0.2
+ *
+ *  where the optional correlations follow the order of the covariance (10, 20, 21, 30, 31, 32, 40, 41, 42, 43) and all
+ *  the bins of each type must be given, or computed from a Parametrization at the centres of the bins.
+ *  The particles whose type is not in the table take the entries of pdg 0 if there are some, and are not smeared
+ *  otherwise. pT and |eta| outside of the edges take the first or last bin.
+ *
+ */
+
+namespace TrackSmearing {
+
+constexpr int s_nParameters = 5;
+constexpr int s_nCovariance = 15;
+
+/// Resolutions sigma = a (+) b / (p beta sin(theta)^k), a and b for each parameter:
+///   d0 [mm, mm GeV]: k = 3/2, z0 [mm, mm GeV]: k = 5/2, phi0 [rad, rad GeV]: k = 1/2,
+///   tanLambda: the one of theta [rad, rad GeV] with k = 1/2, divided by sin(theta)^2,
+///   omega: sigma(pT) / pT = a pT (+) b / (beta sin(theta)^1/2), with a [1/GeV], b [1]
+/// The parameters are not correlated.
+struct Parametrization {
+  double d0[2], z0[2], phi0[2], tanLambda[2], pt[2];
+};
+
+class ResolutionTable {
+public:
+  /// Read the table from a text file in the format above; false, with a message, if it is invalid or incomplete
+  bool read(std::istream& input, std::string& message) {
+    clear();
+    std::vector<int>    types;
+    std::vector<double> rows; // type, ptBin, etaBin, 5 sigmas, 10 correlations
+    std::string         line;
+    for (int lineNumber = 1; std::getline(input, line); ++lineNumber) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream fields(line);
+      std::string        first;
+      if (!(fields >> first))
+        continue;
+      if (first == "ptEdges" || first == "absEtaEdges") {
+        auto& edges = first == "ptEdges" ? m_ptEdges : m_etaEdges;
+        for (double edge; fields >> edge;)
+          edges.push_back(edge);
+        continue;
+      }
+      std::vector<double> values;
+      values.push_back(std::atof(first.c_str()));
+      for (double value; fields >> value;)
+        values.push_back(value);
+      if (values.size() != 8 && values.size() != 18) {
+        message = "line " + std::to_string(lineNumber) + ": expected 8 or 18 numbers";
+        return false;
+      }
+      values.resize(18, 0.);
+      values[0] = std::abs(int(values[0]));
+      if (std::find(types.begin(), types.end(), int(values[0])) == types.end())
+        types.push_back(int(values[0]));
+      rows.insert(rows.end(), values.begin(), values.end());
+    }
+    if (!validEdges(m_ptEdges) || !validEdges(m_etaEdges)) {
+      message = "ptEdges and absEtaEdges need at least two increasing values";
+      return false;
+    }
+    m_types = types;
+    allocate();
+    std::vector<uint8_t> filled(nEntries(), 0);
+    for (std::size_t row = 0; row < rows.size(); row += 18) {
+      const double* values = &rows[row];
+      const int     ptBin  = int(values[1]);
+      const int     etaBin = int(values[2]);
+      if (ptBin < 0 || ptBin >= nPtBins() || etaBin < 0 || etaBin >= nEtaBins()) {
+        message = "bin (" + std::to_string(ptBin) + ", " + std::to_string(etaBin) + ") outside of the edges";
+        return false;
+      }
+      const int type  = std::find(m_types.begin(), m_types.end(), int(values[0])) - m_types.begin();
+      const int entry = index(type, ptBin, etaBin);
+      if (!setEntry(entry, values + 3, values + 8)) {
+        message = "entry of pdg " + std::to_string(m_types[type]) + " bin (" + std::to_string(ptBin) + ", " +
+                  std::to_string(etaBin) + ") is not a positive definite covariance";
+        return false;
+      }
+      filled[entry] = 1;
+    }
+    if (m_types.empty() || std::count(filled.begin(), filled.end(), 0) > 0) {
+      message = "the table does not have all the (pt, |eta|) bins of each particle type";
+      return false;
+    }
+    return true;
+  }
+
+  /// Table from the parametrization at the centres of the bins, for particle types given by their |PDG| and mass [GeV]
+  void fromParametrization(const Parametrization& parametrization, const std::vector<double>& ptEdges,
+                           const std::vector<double>& absEtaEdges, const std::vector<int>& types,
+                           const std::vector<double>& masses) {
+    clear();
+    m_ptEdges  = ptEdges;
+    m_etaEdges = absEtaEdges;
+    m_types    = types;
+    allocate();
+    const double noCorrelation[10] = {0., 0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    for (int type = 0; type < int(m_types.size()); ++type)
+      for (int ptBin = 0; ptBin < nPtBins(); ++ptBin)
+        for (int etaBin = 0; etaBin < nEtaBins(); ++etaBin) {
+          const double pt       = 0.5 * (m_ptEdges[ptBin] + m_ptEdges[ptBin + 1]);
+          const double eta      = 0.5 * (m_etaEdges[etaBin] + m_etaEdges[etaBin + 1]);
+          const double sinTheta = 1. / std::cosh(eta);
+          const double p        = pt * std::cosh(eta);
+          const double beta     = p / std::sqrt(p * p + masses[type] * masses[type]);
+          const auto   sigma    = [&](const double ab[2], double k) {
+            return std::hypot(ab[0], ab[1] / (p * beta * std::pow(sinTheta, k)));
+          };
+          const double sigmas[s_nParameters] = {
+              sigma(parametrization.d0, 1.5), sigma(parametrization.phi0, 0.5),
+              std::hypot(parametrization.pt[0] * pt, parametrization.pt[1] / (beta * std::sqrt(sinTheta))),
+              sigma(parametrization.z0, 2.5), sigma(parametrization.tanLambda, 0.5) / (sinTheta * sinTheta)};
+          setEntry(index(type, ptBin, etaBin), sigmas, noCorrelation);
+        }
+  }
+
+  /// Entry of a particle, or -1 if its type has no entries
+  int entry(int pdg, double pt, double absEta) const {
+    auto type = std::find(m_types.begin(), m_types.end(), std::abs(pdg));
+    if (type == m_types.end())
+      type = std::find(m_types.begin(), m_types.end(), 0);
+    if (type == m_types.end())
+      return -1;
+    return index(type - m_types.begin(), bin(m_ptEdges, pt), bin(m_etaEdges, absEta));
+  }
+
+  /// Covariance of an entry, (d0, phi0, omega / |omega|, z0, tanLambda) lower triangle
+  const double* covariance(int entry) const { return &m_covariances[entry * s_nCovariance]; }
+
+  /// Helix parameter offsets (d0, phi0, omega / |omega|, z0, tanLambda) of an entry for 5 standard normal numbers
+  void sample(int entry, const double normals[s_nParameters], double offsets[s_nParameters]) const {
+    const double* cholesky = &m_choleskys[entry * s_nCovariance];
+    for (int i = 0, ij = 0; i < s_nParameters; ++i) {
+      offsets[i] = 0.;
+      for (int j = 0; j <= i; ++j, ++ij)
+        offsets[i] += cholesky[ij] * normals[j];
+    }
+  }
+
+  int nPtBins() const { return int(m_ptEdges.size()) - 1; }
+  int nEtaBins() const { return int(m_etaEdges.size()) - 1; }
+  int nEntries() const { return int(m_types.size()) * nPtBins() * nEtaBins(); }
+  const std::vector<int>& types() const { return m_types; }
+
+  /// Whether bin edges are at least two increasing values
+  static bool validEdges(const std::vector<double>& edges) {
+    return edges.size() >= 2 && std::adjacent_find(edges.begin(), edges.end(), std::greater_equal<double>()) ==
+                                    edges.end();
+  }
+
+private:
+  void clear() {
+    m_ptEdges.clear();
+    m_etaEdges.clear();
+    m_types.clear();
+  }
+  void allocate() {
+    m_covariances.assign(nEntries() * s_nCovariance, 0.);
+    m_choleskys.assign(nEntries() * s_nCovariance, 0.);
+  }
+  int index(int type, int ptBin, int etaBin) const { return (type * nPtBins() + ptBin) * nEtaBins() + etaBin; }
+  /// Bin of a value, the first and last bins extend to infinity
+  static int bin(const std::vector<double>& edges, double value) {
+    return std::upper_bound(edges.begin() + 1, edges.end() - 1, value) - (edges.begin() + 1);
+  }
+
+  /// Covariance and Cholesky factor of an entry from the sigmas and the correlations; false if not positive definite
+  bool setEntry(int entry, const double sigmas[s_nParameters], const double correlations[10]) {
+    double* covariance = &m_covariances[entry * s_nCovariance];
+    double* cholesky   = &m_choleskys[entry * s_nCovariance];
+    for (int i = 0, ij = 0; i < s_nParameters; ++i)
+      for (int j = 0; j <= i; ++j, ++ij)
+        covariance[ij] = sigmas[i] * sigmas[j] * (i == j ? 1. : correlations[ij - i]);
+    // L L^T = covariance, row by row
+    for (int i = 0; i < s_nParameters; ++i) {
+      for (int j = 0; j <= i; ++j) {
+        double sum = covariance[i * (i + 1) / 2 + j];
+        for (int k = 0; k < j; ++k)
+          sum -= cholesky[i * (i + 1) / 2 + k] * cholesky[j * (j + 1) / 2 + k];
+        if (i == j) {
+          if (!(sum > 0.))
+            return false;
+          cholesky[i * (i + 1) / 2 + i] = std::sqrt(sum);
+        } else {
+          cholesky[i * (i + 1) / 2 + j] = sum / cholesky[j * (j + 1) / 2 + j];
+        }
+      }
+    }
+    return true;
+  }
+
+  std::vector<double> m_ptEdges, m_etaEdges;
+  std::vector<int>    m_types;
+  /// Blocks of s_nCovariance per entry, entry (type, ptBin, etaBin) at (type * nPtBins + ptBin) * nEtaBins + etaBin
+  std::vector<double> m_covariances, m_choleskys;
+};
+
+} // namespace TrackSmearing
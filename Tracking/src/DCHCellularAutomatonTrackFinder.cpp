@@ -0,0 +1,273 @@
+#include "DCHCellularAutomatonTrackFinder.h"
+
+#include "HelixMath.h"
+
+// DD4hep
+#include "DD4hep/DD4hepUnits.h"
+#include "DD4hep/Detector.h"
+#include "DDRec/DCH_info.h"
+
+// C++
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+DECLARE_COMPONENT(DCHCellularAutomatonTrackFinder)
+
+DCHCellularAutomatonTrackFinder::DCHCellularAutomatonTrackFinder(const std::string& aName, ISvcLocator* aSvcLoc)
+    : Gaudi::Algorithm(aName, aSvcLoc) {
+  declareProperty("inputWireHits", m_input_wire_hits, "Input SenseWireHit collection name");
+  declareProperty("outputTracks", m_output_tracks, "Output track collection name");
+}
+
+DCHCellularAutomatonTrackFinder::~DCHCellularAutomatonTrackFinder() {}
+
+StatusCode DCHCellularAutomatonTrackFinder::initialize() {
+  StatusCode sc = Gaudi::Algorithm::initialize();
+  if (sc.isFailure())
+    return sc;
+
+  if (m_bz <= 0. || m_min_pt <= 0.) {
+    error() << "Bz and minPt must be positive" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_min_hits < 3) {
+    error() << "minHits must be at least 3" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_max_crossing_angle <= 0. || m_max_crossing_angle >= 0.5 * M_PI) {
+    error() << "maxCrossingAngle must be between 0 and pi / 2" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_max_layer_gap < 1 || m_z_slices < 1) {
+    error() << "maxLayerGap and zSlices must be at least 1" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_wire_drift_resolution <= 0. || m_wire_along_resolution <= 0. || m_max_residual <= 0. ||
+      m_max_z_residual <= 0.) {
+    error() << "The resolutions and residuals must be positive" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_recovery_window <= 0. || m_max_recovery_residual <= 0. || m_max_recovery_z_residual <= 0.) {
+    error() << "recoveryWindow and the recovery residuals must be positive" << endmsg;
+    return StatusCode::FAILURE;
+  }
+
+  if (!serviceLocator()->service(m_geoSvcName.value(), true)) {
+    error() << "Unable to locate Geometry Service " << m_geoSvcName.value() << endmsg;
+    return StatusCode::FAILURE;
+  }
+  dd4hep::Detector& detector = dd4hep::Detector::getInstance();
+  if (0 == detector.detectors().count(m_DCH_name.value())) {
+    error() << "Detector <<" << m_DCH_name.value() << ">> does not exist" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  dd4hep::DetElement     DCH_DE   = detector.detectors().at(m_DCH_name.value());
+  dd4hep::rec::DCH_info* dch_data = DCH_DE.extension<dd4hep::rec::DCH_info>();
+  if (not dch_data->IsValid()) {
+    error() << "No valid data extension was found for detector <<" << m_DCH_name.value() << ">>" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  dd4hep::SensitiveDetector dch_sd = detector.sensitiveDetector(m_DCH_name.value());
+  if (not dch_sd.isValid()) {
+    error() << "No valid Sensitive Detector was found for detector <<" << m_DCH_name.value() << ">>" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  m_decoder = dch_sd.readout().idSpec().decoder();
+
+  // layers from the inside out: layer superlayer * nlayersPerSuperlayer + layer in the cellID fields
+  std::vector<CellularAutomaton::Layer> layers;
+  m_layers_per_superlayer = dch_data->nlayersPerSuperlayer;
+  for (int superlayer = 0; superlayer < dch_data->nsuperlayers; ++superlayer) {
+    for (int layer = 0; layer < dch_data->nlayersPerSuperlayer; ++layer) {
+      const int                 ilayer  = dch_data->CalculateILayerFromCellIDFields(layer, superlayer);
+      const auto&               l       = dch_data->database.at(ilayer);
+      CellularAutomaton::Layer& caLayer = layers.emplace_back();
+      caLayer.radius                    = l.radius_sw_z0 / dd4hep::mm;
+      caLayer.phi0                      = dch_data->Get_cell_phi_angle(ilayer, 0);
+      // same sign as SenseWireHit::wireStereoAngle, see DCHdigi_v01
+      caLayer.stereo = -l.StereoSign() * dch_data->stereoangle_z0(0.5 * (l.radius_fdw_z0 + l.radius_fuw_z0));
+      caLayer.nCells = dch_data->Get_ncells(ilayer);
+    }
+  }
+
+  CellularAutomaton::Config config;
+  config.maxLayerGap       = m_max_layer_gap;
+  config.zSlices           = m_z_slices;
+  config.halfLength        = dch_data->Lhalf / dd4hep::mm;
+  config.maxCrossingAngle  = m_max_crossing_angle;
+  config.maxOmega          = HelixMath::FCT * m_bz / m_min_pt;
+  config.maxResidual       = m_max_residual;
+  config.maxZResidual      = m_max_z_residual;
+  config.minHits           = m_min_hits;
+  config.driftResolution   = m_wire_drift_resolution;
+  config.zResolution       = m_wire_along_resolution;
+  config.parallelEvolution = m_parallel_evolution;
+  config.parallelGrainSize = m_parallel_grain_size;
+
+  const auto start = std::chrono::steady_clock::now();
+  m_table.build(layers, config);
+  info() << "Built the neighbour table of " << m_table.nCells() << " cells in " << layers.size() << " layers in "
+         << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+         << endmsg;
+  m_instrumentation.initialize(this);
+  return StatusCode::SUCCESS;
+}
+
+StatusCode DCHCellularAutomatonTrackFinder::execute(const EventContext&) const {
+  const extension::SenseWireHitCollection* wire_hits     = m_input_wire_hits.get();
+  extension::TrackCollection*              output_tracks = m_output_tracks.createAndPut();
+
+  auto probe = m_instrumentation.event();
+  probe.hitsIn(wire_hits->size());
+  probe.enter(HitPreparation);
+  const auto  start  = std::chrono::steady_clock::now();
+  const auto& layers = m_table.layers();
+  m_hits.clear();
+  m_hits.reserve(wire_hits->size());
+  for (const auto& wire_hit : *wire_hits) {
+    const auto     cellID = wire_hit.getCellID();
+    const uint32_t layer =
+        m_decoder->get(cellID, "superlayer") * m_layers_per_superlayer + m_decoder->get(cellID, "layer");
+    const uint32_t cell = m_decoder->get(cellID, "nphi");
+    if (layer >= layers.size() || cell >= layers[layer].nCells) {
+      error() << "Sense wire hit with cellID " << cellID << " outside of the drift chamber geometry" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    const auto&             position = wire_hit.getPosition();
+    CellularAutomaton::Hit& hit      = m_hits.emplace_back();
+    hit.layer                        = layer;
+    hit.cell                         = cell;
+    hit.x                            = position.x;
+    hit.y                            = position.y;
+    hit.z                            = position.z;
+    hit.driftDistance                = wire_hit.getDistanceToWire();
+  }
+  probe.enter(TrackFinding);
+  const auto& candidates = m_finder.find(m_table, m_hits.data(), m_hits.size());
+  m_find_time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  m_doublets_per_event += m_finder.nDoublets();
+  m_triplets_per_event += m_finder.nTriplets();
+  m_tracks_per_event += candidates.size();
+
+  probe.enter(HitRecovery);
+  if (m_recover_hits)
+    m_recovered_per_event += recoverHits(*wire_hits, candidates);
+
+  probe.enter(OutputFill);
+  for (std::size_t t = 0; t < candidates.size(); ++t) {
+    const auto&     candidate = candidates[t];
+    const uint32_t* hits      = m_recover_hits ? m_track_hits.data() + m_track_offsets[t]
+                                               : m_finder.hits().data() + candidate.firstHit;
+    const uint32_t  nHits     = m_recover_hits ? m_track_offsets[t + 1] - m_track_offsets[t] : candidate.nHits;
+
+    auto trackState           = edm4hep::TrackState{};
+    trackState.location       = edm4hep::TrackState::AtFirstHit;
+    trackState.D0             = candidate.d0;
+    trackState.phi            = HelixMath::kernel::wrapTwoPi(candidate.phi0);
+    trackState.omega          = candidate.omega;
+    trackState.Z0             = candidate.z0;
+    trackState.tanLambda      = candidate.tanLambda;
+    trackState.referencePoint = edm4hep::Vector3f(candidate.referencePoint[0], candidate.referencePoint[1], 0.);
+    trackState.covMatrix.setValue(candidate.transverseCov[0], edm4hep::TrackParams::d0, edm4hep::TrackParams::d0);
+    trackState.covMatrix.setValue(candidate.transverseCov[1], edm4hep::TrackParams::phi, edm4hep::TrackParams::d0);
+    trackState.covMatrix.setValue(candidate.transverseCov[2], edm4hep::TrackParams::phi, edm4hep::TrackParams::phi);
+    trackState.covMatrix.setValue(candidate.transverseCov[3], edm4hep::TrackParams::omega, edm4hep::TrackParams::d0);
+    trackState.covMatrix.setValue(candidate.transverseCov[4], edm4hep::TrackParams::omega, edm4hep::TrackParams::phi);
+    trackState.covMatrix.setValue(candidate.transverseCov[5], edm4hep::TrackParams::omega,
+                                  edm4hep::TrackParams::omega);
+    trackState.covMatrix.setValue(candidate.longitudinalCov[0], edm4hep::TrackParams::z0, edm4hep::TrackParams::z0);
+    trackState.covMatrix.setValue(candidate.longitudinalCov[1], edm4hep::TrackParams::tanLambda,
+                                  edm4hep::TrackParams::z0);
+    trackState.covMatrix.setValue(candidate.longitudinalCov[2], edm4hep::TrackParams::tanLambda,
+                                  edm4hep::TrackParams::tanLambda);
+    auto output_track = output_tracks->create();
+    output_track.setChi2(candidate.chi2);
+    output_track.setNdf(candidate.ndf);
+    output_track.addToTrackStates(trackState);
+    for (uint32_t k = 0; k < nHits; ++k)
+      output_track.addToTrackerHits((*wire_hits)[hits[k]]);
+    const auto& first = m_hits[hits[0]];
+    output_track.setRadiusOfInnermostHit(std::hypot(first.x, first.y));
+  }
+  probe.leave();
+  probe.hitsOut(m_recover_hits ? m_track_hits.size() : m_finder.hits().size());
+  if (probe.enabled())
+    probe.workingMemory(m_hits.capacity() * sizeof(CellularAutomaton::Hit) + m_finder.memory() +
+                        (m_track_hits.capacity() + m_track_offsets.capacity()) * sizeof(uint32_t) + m_used.capacity());
+  debug() << "Tracks found: " << output_tracks->size() << " from " << wire_hits->size() << " wire hits, "
+          << m_finder.nDoublets() << " doublets and " << m_finder.nTriplets() << " triplets" << endmsg;
+  return StatusCode::SUCCESS;
+}
+
+unsigned DCHCellularAutomatonTrackFinder::recoverHits(const extension::SenseWireHitCollection&          wire_hits,
+                                                      const std::vector<CellularAutomaton::Candidate>& candidates) const {
+  const auto& layers = m_table.layers();
+  m_hit_index.build(wire_hits, layers.size(), [this](const auto& hit) {
+    return m_decoder->get(hit.getCellID(), "superlayer") * m_layers_per_superlayer +
+           m_decoder->get(hit.getCellID(), "layer");
+  });
+  const auto& candidateHits = m_finder.hits();
+  m_used.assign(wire_hits.size(), 0);
+  for (const uint32_t i : candidateHits)
+    m_used[i] = 1;
+  m_track_hits.clear();
+  m_track_offsets.assign(1, 0);
+  unsigned recovered = 0;
+  for (const auto& candidate : candidates) {
+    const std::size_t begin = m_track_hits.size();
+    m_track_hits.insert(m_track_hits.end(), candidateHits.begin() + candidate.firstHit,
+                        candidateHits.begin() + candidate.firstHit + candidate.nHits);
+    // helix of the candidate from its point of closest approach to the reference point, where z = z0, turning
+    // clockwise for omega > 0
+    const double     sinPhi = std::sin(candidate.phi0);
+    const double     cosPhi = std::cos(candidate.phi0);
+    const double     pcaX   = candidate.referencePoint[0] - candidate.d0 * sinPhi;
+    const double     pcaY   = candidate.referencePoint[1] + candidate.d0 * cosPhi;
+    HelixMath::Helix helix;
+    helix.charge    = candidate.omega > 0. ? 1. : -1.;
+    helix.radius    = 1. / std::fabs(candidate.omega);
+    helix.xCentre   = pcaX + sinPhi / candidate.omega;
+    helix.yCentre   = pcaY - cosPhi / candidate.omega;
+    helix.tanLambda = candidate.tanLambda;
+    helix.refX      = pcaX;
+    helix.refY      = pcaY;
+    helix.refZ      = candidate.z0;
+    helix.phiRef    = std::atan2(pcaY - helix.yCentre, pcaX - helix.xCentre);
+    // the layers outside the first hit, up to the turning point of the track
+    for (uint32_t layer = m_hits[candidateHits[candidate.firstHit]].layer + 1; layer < layers.size(); ++layer) {
+      double crossing[3], s;
+      if (!helix.intersectCylinder(layers[layer].radius, crossing, s))
+        break;
+      const double halfWidth = m_recovery_window * 2. * M_PI / layers[layer].nCells;
+      for (const auto& range : m_hit_index.window(layer, std::atan2(crossing[1], crossing[0]), halfWidth)) {
+        for (const uint32_t i : range) {
+          if (m_used[i])
+            continue;
+          const auto&  hit      = m_hits[i];
+          const double x        = hit.x - pcaX;
+          const double y        = hit.y - pcaY;
+          const double residual = std::fabs(HoughSeeding::distance(x, y, sinPhi, cosPhi, candidate.omega)) -
+                                  hit.driftDistance;
+          const double zResidual =
+              hit.z - candidate.z0 - candidate.tanLambda * HoughSeeding::arcLength(x, y, candidate.omega);
+          if (std::fabs(residual) < m_max_recovery_residual && std::fabs(zResidual) < m_max_recovery_z_residual) {
+            m_used[i] = 1;
+            m_track_hits.push_back(i);
+            ++recovered;
+          }
+        }
+      }
+    }
+    // from the inside out, the hits of the candidate first within a layer
+    std::stable_sort(m_track_hits.begin() + begin, m_track_hits.end(),
+                     [](uint32_t a, uint32_t b) { return m_hits[a].layer < m_hits[b].layer; });
+    m_track_offsets.push_back(m_track_hits.size());
+  }
+  return recovered;
+}
+
+StatusCode DCHCellularAutomatonTrackFinder::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
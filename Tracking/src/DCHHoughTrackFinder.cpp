@@ -0,0 +1,114 @@
+#include "DCHHoughTrackFinder.h"
+
+#include "HelixMath.h"
+
+// C++
+#include <chrono>
+#include <cmath>
+
+DECLARE_COMPONENT(DCHHoughTrackFinder)
+
+DCHHoughTrackFinder::DCHHoughTrackFinder(const std::string& aName, ISvcLocator* aSvcLoc)
+    : Gaudi::Algorithm(aName, aSvcLoc) {
+  declareProperty("inputWireHits", m_input_wire_hits, "Input SenseWireHit collection name");
+  declareProperty("outputTracks", m_output_tracks, "Output track collection name");
+}
+
+DCHHoughTrackFinder::~DCHHoughTrackFinder() {}
+
+StatusCode DCHHoughTrackFinder::initialize() {
+  StatusCode sc = Gaudi::Algorithm::initialize();
+  if (sc.isFailure())
+    return sc;
+
+  if (m_bz <= 0. || m_min_pt <= 0.) {
+    error() << "Bz and minPt must be positive" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_phi_bins < 8 || m_omega_bins < 8) {
+    error() << "phiBins and omegaBins must be at least 8" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_min_hits < 3) {
+    error() << "minHits must be at least 3" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_wire_drift_resolution <= 0. || m_wire_along_resolution <= 0. || m_max_residual <= 0. ||
+      m_max_z_residual <= 0. || m_max_chi2_per_ndf <= 0.) {
+    error() << "The resolutions, residuals and chi2 cut must be positive" << endmsg;
+    return StatusCode::FAILURE;
+  }
+
+  m_config.maxOmega        = HelixMath::FCT * m_bz / m_min_pt;
+  m_config.phiBins         = m_phi_bins;
+  m_config.omegaBins       = m_omega_bins;
+  m_config.coarseFactor    = m_coarse_factor;
+  m_config.minHits         = m_min_hits;
+  m_config.maxResidual     = m_max_residual;
+  m_config.maxZResidual    = m_max_z_residual;
+  m_config.maxChi2PerNdf   = m_max_chi2_per_ndf;
+  m_config.driftResolution = m_wire_drift_resolution;
+  m_config.zResolution     = m_wire_along_resolution;
+  m_instrumentation.initialize(this);
+  return StatusCode::SUCCESS;
+}
+
+StatusCode DCHHoughTrackFinder::execute(const EventContext&) const {
+  const extension::SenseWireHitCollection* wire_hits     = m_input_wire_hits.get();
+  edm4hep::TrackCollection*                output_tracks = m_output_tracks.createAndPut();
+
+  auto probe = m_instrumentation.event();
+  probe.hitsIn(wire_hits->size());
+  probe.enter(HitPreparation);
+  const auto start = std::chrono::steady_clock::now();
+  m_hits.clear();
+  m_hits.reserve(wire_hits->size());
+  for (const auto& wire_hit : *wire_hits) {
+    const auto&        position = wire_hit.getPosition();
+    HoughSeeding::Hit& hit      = m_hits.emplace_back();
+    hit.x                       = position.x;
+    hit.y                       = position.y;
+    hit.z                       = position.z;
+    hit.driftDistance           = wire_hit.getDistanceToWire();
+    hit.vote                    = std::fabs(wire_hit.getWireStereoAngle()) < m_max_voting_stereo_angle;
+  }
+  probe.enter(TrackFinding);
+  m_finder.setConfig(m_config);
+  const auto& seeds = m_finder.find(m_hits.data(), m_hits.size());
+  m_find_time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  m_tracks_per_event += seeds.size();
+
+  probe.enter(OutputFill);
+  for (const auto& seed : seeds) {
+    auto trackState           = edm4hep::TrackState{};
+    trackState.location       = edm4hep::TrackState::AtIP;
+    trackState.D0             = 0.;
+    trackState.phi            = HelixMath::kernel::wrapTwoPi(seed.phi0);
+    trackState.omega          = seed.omega;
+    trackState.Z0             = seed.z0;
+    trackState.tanLambda      = seed.tanLambda;
+    trackState.referencePoint = edm4hep::Vector3f(0., 0., 0.);
+    trackState.covMatrix.setValue(seed.transverseCov[0], edm4hep::TrackParams::phi, edm4hep::TrackParams::phi);
+    trackState.covMatrix.setValue(seed.transverseCov[1], edm4hep::TrackParams::omega, edm4hep::TrackParams::phi);
+    trackState.covMatrix.setValue(seed.transverseCov[2], edm4hep::TrackParams::omega, edm4hep::TrackParams::omega);
+    trackState.covMatrix.setValue(seed.longitudinalCov[0], edm4hep::TrackParams::z0, edm4hep::TrackParams::z0);
+    trackState.covMatrix.setValue(seed.longitudinalCov[1], edm4hep::TrackParams::tanLambda, edm4hep::TrackParams::z0);
+    trackState.covMatrix.setValue(seed.longitudinalCov[2], edm4hep::TrackParams::tanLambda,
+                                  edm4hep::TrackParams::tanLambda);
+    auto output_track = output_tracks->create();
+    output_track.setChi2(seed.chi2);
+    output_track.setNdf(seed.ndf);
+    output_track.addToTrackStates(trackState);
+  }
+  probe.leave();
+  probe.hitsOut(m_finder.hits().size());
+  if (probe.enabled())
+    probe.workingMemory(m_hits.capacity() * sizeof(HoughSeeding::Hit) + m_finder.memory());
+  debug() << "Tracks found: " << output_tracks->size() << " from " << wire_hits->size() << " wire hits" << endmsg;
+  return StatusCode::SUCCESS;
+}
+
+StatusCode DCHHoughTrackFinder::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
@@ -1,32 +1,307 @@
 #include "GenFitter.h"
 
+// EDM4HEP
+#include "edm4hep/Constants.h"
+
+#include "HelixMath.h"
+
+// C++
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <tuple>
+
 DECLARE_COMPONENT(GenFitter)
 
+namespace {
+
+/// Unique key of a podio object in the event
+uint64_t objectKey(const podio::ObjectID& id) {
+  return (uint64_t(uint32_t(id.collectionID)) << 32) | uint32_t(id.index);
+}
+
+edm4hep::TrackState toTrackState(const KalmanFit::State& state, int32_t location) {
+  static constexpr edm4hep::TrackParams params[KalmanMath::N] = {edm4hep::TrackParams::d0, edm4hep::TrackParams::phi,
+                                                                 edm4hep::TrackParams::omega, edm4hep::TrackParams::z0,
+                                                                 edm4hep::TrackParams::tanLambda};
+  auto trackState           = edm4hep::TrackState{};
+  trackState.location       = location;
+  trackState.D0             = state.params[KalmanFit::D0];
+  trackState.phi            = HelixMath::kernel::wrapTwoPi(state.params[KalmanFit::PHI0]);
+  trackState.omega          = state.params[KalmanFit::OMEGA];
+  trackState.Z0             = state.params[KalmanFit::Z0];
+  trackState.tanLambda      = state.params[KalmanFit::TANLAMBDA];
+  trackState.referencePoint = edm4hep::Vector3f(state.pivot[0], state.pivot[1], state.pivot[2]);
+  for (int i = 0; i < KalmanMath::N; ++i)
+    for (int j = 0; j <= i; ++j)
+      trackState.covMatrix.setValue(state.cov[i][j], params[i], params[j]);
+  return trackState;
+}
+
+} // namespace
+
 GenFitter::GenFitter(const std::string& aName, ISvcLocator* aSvcLoc) : Gaudi::Algorithm(aName, aSvcLoc) {
-  declareProperty("inputHits", m_input_hits, "Input tracker hit collection name");
+  declareProperty("inputSeedTracks", m_input_seeds, "Input seed track collection name");
+  declareProperty("inputSeedLinks", m_input_seed_links, "Input seed track to MCParticle link collection name");
   declareProperty("outputTracks", m_output_tracks, "Output track collection name");
 }
 
 GenFitter::~GenFitter() {}
 
-StatusCode GenFitter::initialize() { return StatusCode::SUCCESS; }
+StatusCode GenFitter::initialize() {
+  StatusCode sc = Gaudi::Algorithm::initialize();
+  if (sc.isFailure())
+    return sc;
+
+  if (m_input_hit_names.size() != m_input_hit_link_names.size() ||
+      m_input_wire_hit_names.size() != m_input_wire_hit_link_names.size()) {
+    error() << "Each input hit collection needs its link collection to the sim hits" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_seed_sigmas.size() != KalmanMath::N) {
+    error() << "seedSigmas needs " << KalmanMath::N << " values" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (m_fit_lanes != 0 && m_fit_lanes != 1 && m_fit_lanes != 8) {
+    error() << "fitLanes must be 0, 1 or 8" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  for (std::size_t i = 0; i < m_input_hit_names.size(); ++i) {
+    m_input_hits.push_back(std::make_unique<DataHandle<edm4hep::TrackerHit3DCollection>>(
+        m_input_hit_names[i], Gaudi::DataHandle::Reader, this));
+    m_input_hit_links.push_back(std::make_unique<DataHandle<edm4hep::TrackerHitSimTrackerHitLinkCollection>>(
+        m_input_hit_link_names[i], Gaudi::DataHandle::Reader, this));
+  }
+  for (std::size_t i = 0; i < m_input_wire_hit_names.size(); ++i) {
+    m_input_wire_hits.push_back(std::make_unique<DataHandle<extension::SenseWireHitCollection>>(
+        m_input_wire_hit_names[i], Gaudi::DataHandle::Reader, this));
+    m_input_wire_hit_links.push_back(std::make_unique<DataHandle<extension::SenseWireHitSimTrackerHitLinkCollection>>(
+        m_input_wire_hit_link_names[i], Gaudi::DataHandle::Reader, this));
+  }
+
+  m_config.maxChi2PerHit   = m_max_chi2_per_hit;
+  m_config.minHits         = m_min_hits;
+  m_config.refitSideSigmas = m_refit_side_sigmas;
+  std::copy(m_seed_sigmas.begin(), m_seed_sigmas.end(), m_config.seedSigma);
+  m_instrumentation.initialize(this);
+  return StatusCode::SUCCESS;
+}
 
 StatusCode GenFitter::execute(const EventContext&) const {
-  // Get the input collection with tracker hits
-  const edm4hep::TrackerHit3DCollection* input_hits = m_input_hits.get();
-  verbose() << "Input Hit collection size: " << input_hits->size() << endmsg;
-
-  // Convert edm4hep::TrackerHitCollection to Genfit measurements
-  //for (const auto& input_hit : *input_hits) {
-  //  m_wire_measurements.push_back(genfit::WireMeasurement());
-  //}
-
-  // Produce dummy tracks
-  edm4hep::TrackCollection* output_tracks = m_output_tracks.createAndPut();
-  auto                      output_track  = output_tracks->create();
-  output_track.setChi2(1.);
-  output_track.setNdf(1);
+  const edm4hep::TrackCollection*               seeds         = m_input_seeds.get();
+  const edm4hep::TrackMCParticleLinkCollection* seed_links    = m_input_seed_links.get();
+  edm4hep::TrackCollection*                     output_tracks = m_output_tracks.createAndPut();
+
+  auto probe = m_instrumentation.event();
+  probe.enter(HitAssignment);
+
+  // MCParticle -> seed track
+  m_seed_of_particle.clear();
+  for (const auto& link : *seed_links) {
+    const auto seed_id = link.getFrom().getObjectID();
+    if (seed_id.collectionID == seeds->getID())
+      m_seed_of_particle.emplace_back(objectKey(link.getTo().getObjectID()), seed_id.index);
+  }
+  std::sort(m_seed_of_particle.begin(), m_seed_of_particle.end());
+  const auto seed_of = [](const edm4hep::SimTrackerHit& sim_hit, uint32_t& seed) {
+    const auto particle = sim_hit.getParticle();
+    if (!particle.isAvailable())
+      return false;
+    const uint64_t key = objectKey(particle.getObjectID());
+    const auto     it  = std::lower_bound(m_seed_of_particle.begin(), m_seed_of_particle.end(),
+                                          std::pair<uint64_t, uint32_t>{key, 0});
+    if (it == m_seed_of_particle.end() || it->first != key)
+      return false;
+    seed = it->second;
+    return true;
+  };
+
+  // Convert the hits of the seeded particles to measurements
+  m_candidates.clear();
+  m_point_hits.clear();
+  for (std::size_t i = 0; i < m_input_hits.size(); ++i) {
+    const edm4hep::TrackerHit3DCollection*                hits  = m_input_hits[i]->get();
+    const edm4hep::TrackerHitSimTrackerHitLinkCollection* links = m_input_hit_links[i]->get();
+    for (const auto& link : *links) {
+      const auto hit_id = link.getFrom().getObjectID();
+      uint32_t   seed;
+      if (hit_id.collectionID != hits->getID() || !seed_of(link.getTo(), seed))
+        continue;
+      const auto  hit          = (*hits)[hit_id.index];
+      const auto& position     = hit.getPosition();
+      Candidate&  candidate    = m_candidates.emplace_back();
+      candidate.seed           = seed;
+      candidate.radius2        = position.x * position.x + position.y * position.y;
+      candidate.key            = objectKey(hit_id);
+      auto& measurement        = candidate.measurement;
+      measurement.type         = KalmanFit::Measurement::Point;
+      measurement.position[0]  = position.x;
+      measurement.position[1]  = position.y;
+      measurement.position[2]  = position.z;
+      measurement.index        = m_point_hits.size();
+      m_point_hits.push_back(hit);
+      const auto& cov = hit.getCovMatrix();
+      if (cov.getValue(edm4hep::Cartesian::x, edm4hep::Cartesian::x) > 0.f) {
+        measurement.covariance[0] = cov.getValue(edm4hep::Cartesian::x, edm4hep::Cartesian::x);
+        measurement.covariance[1] = cov.getValue(edm4hep::Cartesian::y, edm4hep::Cartesian::x);
+        measurement.covariance[2] = cov.getValue(edm4hep::Cartesian::y, edm4hep::Cartesian::y);
+        measurement.covariance[3] = cov.getValue(edm4hep::Cartesian::z, edm4hep::Cartesian::x);
+        measurement.covariance[4] = cov.getValue(edm4hep::Cartesian::z, edm4hep::Cartesian::y);
+        measurement.covariance[5] = cov.getValue(edm4hep::Cartesian::z, edm4hep::Cartesian::z);
+      } else {
+        const double rphi2        = m_hit_rphi_resolution * m_hit_rphi_resolution;
+        measurement.covariance[0] = rphi2;
+        measurement.covariance[1] = 0.;
+        measurement.covariance[2] = rphi2;
+        measurement.covariance[3] = 0.;
+        measurement.covariance[4] = 0.;
+        measurement.covariance[5] = m_hit_z_resolution * m_hit_z_resolution;
+      }
+    }
+  }
+  for (std::size_t i = 0; i < m_input_wire_hits.size(); ++i) {
+    const extension::SenseWireHitCollection*                  hits  = m_input_wire_hits[i]->get();
+    const extension::SenseWireHitSimTrackerHitLinkCollection* links = m_input_wire_hit_links[i]->get();
+    for (const auto& link : *links) {
+      const auto hit    = link.getFrom();
+      const auto hit_id = hit.getObjectID();
+      uint32_t   seed;
+      if (hit_id.collectionID != hits->getID() || !seed_of(link.getTo(), seed))
+        continue;
+      const auto&  position     = hit.getPosition();
+      const double sin_stereo   = std::sin(hit.getWireStereoAngle());
+      Candidate&   candidate    = m_candidates.emplace_back();
+      candidate.seed            = seed;
+      candidate.radius2         = position.x * position.x + position.y * position.y;
+      candidate.key             = objectKey(hit_id);
+      auto& measurement         = candidate.measurement;
+      measurement.type          = KalmanFit::Measurement::Wire;
+      measurement.position[0]   = position.x;
+      measurement.position[1]   = position.y;
+      measurement.position[2]   = position.z;
+      // wire direction from its stereo angle and the azimuthal angle of its middle
+      measurement.direction[0]  = sin_stereo * std::sin(hit.getWireAzimuthalAngle());
+      measurement.direction[1]  = -sin_stereo * std::cos(hit.getWireAzimuthalAngle());
+      measurement.direction[2]  = std::cos(hit.getWireStereoAngle());
+      measurement.driftDistance = hit.getDistanceToWire();
+      measurement.covariance[0] = m_wire_drift_resolution * m_wire_drift_resolution;
+      measurement.covariance[1] = m_wire_along_resolution * m_wire_along_resolution;
+      measurement.index         = hit_id.index;
+    }
+  }
+  // group the hits by seed, ordered by radius; a hit linked to several sim hits of the same particle is kept once
+  std::sort(m_candidates.begin(), m_candidates.end(), [](const Candidate& a, const Candidate& b) {
+    return std::tie(a.seed, a.radius2, a.key) < std::tie(b.seed, b.radius2, b.key);
+  });
+  debug() << "Hits assigned to seeds: " << m_candidates.size() << endmsg;
+
+  // Tracks to fit: seed state and measurements of each seed
+  probe.enter(TrackPreparation);
+  m_measurements.clear();
+  m_tracks.clear();
+  m_track_seeds.clear();
+  m_track_offsets.clear();
+  for (std::size_t begin = 0, end = 0; begin < m_candidates.size(); begin = end) {
+    const uint32_t seed_index = m_candidates[begin].seed;
+    const uint32_t offset     = m_measurements.size();
+    for (end = begin; end < m_candidates.size() && m_candidates[end].seed == seed_index; ++end)
+      if (end == begin || m_candidates[end].key != m_candidates[end - 1].key)
+        m_measurements.push_back(m_candidates[end].measurement);
+
+    const auto seed_track = (*seeds)[seed_index];
+    const auto seed_state = std::find_if(seed_track.getTrackStates().begin(), seed_track.getTrackStates().end(),
+                                         [](const auto& state) { return state.location == edm4hep::TrackState::AtIP; });
+    if (seed_state == seed_track.getTrackStates().end() || seed_state->omega == 0.f) {
+      m_measurements.resize(offset);
+      continue;
+    }
+    auto& track                             = m_tracks.emplace_back();
+    track.seed                              = KalmanFit::State{};
+    track.seed.pivot[0]                     = seed_state->referencePoint.x;
+    track.seed.pivot[1]                     = seed_state->referencePoint.y;
+    track.seed.pivot[2]                     = seed_state->referencePoint.z;
+    track.seed.params[KalmanFit::D0]        = seed_state->D0;
+    track.seed.params[KalmanFit::PHI0]      = seed_state->phi;
+    track.seed.params[KalmanFit::OMEGA]     = seed_state->omega;
+    track.seed.params[KalmanFit::Z0]        = seed_state->Z0;
+    track.seed.params[KalmanFit::TANLAMBDA] = seed_state->tanLambda;
+    track.nMeasurements                     = m_measurements.size() - offset;
+    m_track_seeds.push_back(seed_index);
+    m_track_offsets.push_back(offset);
+  }
+  // the measurements do not move anymore
+  m_accepted.assign(m_measurements.size(), 0);
+  for (std::size_t i = 0; i < m_tracks.size(); ++i) {
+    m_tracks[i].measurements = m_measurements.data() + m_track_offsets[i];
+    m_tracks[i].accepted     = m_accepted.data() + m_track_offsets[i];
+  }
+  probe.hitsIn(m_measurements.size());
+
+  // Fit
+  probe.enter(KalmanFilter);
+  m_results.resize(m_tracks.size());
+  m_fitted.assign(m_tracks.size(), 0);
+  const auto start = std::chrono::steady_clock::now();
+  if (m_fit_lanes == 8) {
+    m_vector_fitter.setConfig(m_config);
+    m_vector_fitter.fit(m_tracks.data(), m_tracks.size(), m_results.data(), m_fitted.data());
+  } else if (m_fit_lanes == 1) {
+    m_scalar_fitter.setConfig(m_config);
+    m_scalar_fitter.fit(m_tracks.data(), m_tracks.size(), m_results.data(), m_fitted.data());
+  } else {
+    for (std::size_t i = 0; i < m_tracks.size(); ++i) {
+      const auto& track = m_tracks[i];
+      m_fitted[i] = KalmanFit::fit(track.seed, track.measurements, track.nMeasurements, m_config, m_workspace,
+                                   m_results[i]);
+      for (const auto& step : m_workspace.steps)
+        track.accepted[step.measurement] = 1;
+    }
+  }
+  if (!m_tracks.empty()) {
+    const double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    for (std::size_t i = 0; i < m_tracks.size(); ++i)
+      m_fit_time += time / m_tracks.size();
+  }
+
+  probe.enter(OutputFill);
+  std::size_t n_accepted = 0;
+  for (std::size_t i = 0; i < m_tracks.size(); ++i) {
+    const auto& track = m_tracks[i];
+    if (!m_fitted[i]) {
+      ++m_failed_fits;
+      debug() << "Fit failed for seed " << m_track_seeds[i] << " with " << track.nMeasurements << " hits" << endmsg;
+      continue;
+    }
+    const auto& result       = m_results[i];
+    auto        output_track = output_tracks->create();
+    output_track.setChi2(result.chi2);
+    output_track.setNdf(result.ndf);
+    output_track.addToTrackStates(toTrackState(result.atReference, edm4hep::TrackState::AtIP));
+    output_track.addToTrackStates(toTrackState(result.atFirstHit, edm4hep::TrackState::AtFirstHit));
+    output_track.addToTrackStates(toTrackState(result.atLastHit, edm4hep::TrackState::AtLastHit));
+    for (uint32_t k = 0; k < track.nMeasurements; ++k) {
+      const auto& measurement = track.measurements[k];
+      n_accepted += track.accepted[k];
+      if (track.accepted[k] && measurement.type == KalmanFit::Measurement::Point)
+        output_track.addToTrackerHits(m_point_hits[measurement.index]);
+    }
+  }
+  probe.leave();
+  probe.hitsOut(n_accepted);
+  if (probe.enabled())
+    probe.workingMemory(bufferMemory());
+  debug() << "Fitted tracks: " << output_tracks->size() << " out of " << seeds->size() << " seeds" << endmsg;
   return StatusCode::SUCCESS;
 }
 
-StatusCode GenFitter::finalize() { return StatusCode::SUCCESS; }
+std::size_t GenFitter::bufferMemory() {
+  auto bytes = [](const auto& v) { return v.capacity() * sizeof(v[0]); };
+  return bytes(m_seed_of_particle) + bytes(m_candidates) + bytes(m_point_hits) + bytes(m_measurements) +
+         bytes(m_tracks) + bytes(m_track_seeds) + bytes(m_track_offsets) + bytes(m_accepted) + bytes(m_results) +
+         bytes(m_fitted);
+}
+
+StatusCode GenFitter::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
@@ -0,0 +1,414 @@
+#include "GenParticleTrackBuilder.h"
+
+#include "HelixMath.h"
+#include "RungeKuttaPropagator.h"
+
+// DD4HEP
+#include "DD4hep/DD4hepUnits.h"
+#include "DD4hep/DetType.h"
+#include "DD4hep/Detector.h"
+#include "DD4hep/DetectorSelector.h"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+double GenParticleTrackBuilder::getFieldFromCompact() const {
+  dd4hep::Detector& mainDetector = dd4hep::Detector::getInstance();
+  const double position[3] = {0, 0, 0};  // position to calculate magnetic field at (the origin in this case)
+  double magneticFieldVector[3] = {0, 0, 0};  // initialise object to hold magnetic field
+  mainDetector.field().magneticField(position, magneticFieldVector);  // get the magnetic field vector from DD4hep
+  return magneticFieldVector[2] / dd4hep::tesla;  // z component at (0,0,0)
+}
+
+const dd4hep::rec::LayeredCalorimeterData* GenParticleTrackBuilder::getExtension(const Gaudi::Algorithm& owner,
+                                                                                 unsigned int includeFlag,
+                                                                                 unsigned int excludeFlag) const {
+  dd4hep::Detector& mainDetector = dd4hep::Detector::getInstance();
+  const std::vector<dd4hep::DetElement>& theDetectors =
+      dd4hep::DetectorSelector(mainDetector).detectors(includeFlag, excludeFlag);
+
+  owner.debug() << " getExtension :  includeFlag: " << dd4hep::DetType(includeFlag)
+                << " excludeFlag: " << dd4hep::DetType(excludeFlag) << "  found : " << theDetectors.size()
+                << "  - first det: " << theDetectors.at(0).name() << endmsg;
+
+  if (theDetectors.size() != 1) {
+    std::stringstream es;
+    es << " getExtension: selection is not unique (or empty)  includeFlag: " << dd4hep::DetType(includeFlag)
+       << " excludeFlag: " << dd4hep::DetType(excludeFlag) << " --- found detectors : ";
+    for (unsigned i = 0, N = theDetectors.size(); i < N; ++i) {
+      es << theDetectors.at(i).name() << ", ";
+    }
+    throw std::runtime_error(es.str());
+  }
+
+  return theDetectors.at(0).extension<dd4hep::rec::LayeredCalorimeterData>();
+}
+
+double GenParticleTrackBuilder::bzAt(const double position[3]) const {
+  if (!m_fieldCache)
+    return m_Bz;
+  // out of the coil, the field vanishes and then reverses: keep the field at the origin for the helix parameters
+  const double bz = m_fieldCache->fieldMap().bz(position);
+  return bz * m_Bz >= m_minLocalBzFraction * m_Bz * m_Bz ? bz : m_Bz;
+}
+
+bool GenParticleTrackBuilder::propagateToCalorimeter(const double position[3], const double momentum[3],
+                                                     double charge, double positionAtCalorimeter[3],
+                                                     double momentumAtCalorimeter[3]) const {
+  RungeKuttaPropagator        propagator(m_fieldCache->fieldMap(), m_rungeKuttaTolerance);
+  RungeKuttaPropagator::State state{
+      {position[0], position[1], position[2]}, {momentum[0], momentum[1], momentum[2]}, charge};
+  const auto barrel = RungeKuttaPropagator::cylinder(m_eCalBarrelInnerR);
+  const auto endcap = RungeKuttaPropagator::zPlane(momentum[2] > 0. ? m_eCalEndCapInnerZ : -m_eCalEndCapInnerZ);
+  // the first surface crossed is the first one whose signed distance becomes positive
+  const auto calorimeter = [&](const double* pos) {
+    return std::max(m_eCalBarrelInnerR > 0. ? barrel(pos) : -std::numeric_limits<double>::max(),
+                    m_eCalEndCapInnerR > 0. ? endcap(pos) : -std::numeric_limits<double>::max());
+  };
+  if (!propagator.propagate(state, calorimeter, m_rungeKuttaMaxPath))
+    return false;
+  std::copy(state.pos, state.pos + 3, positionAtCalorimeter);
+  std::copy(state.mom, state.mom + 3, momentumAtCalorimeter);
+  return true;
+}
+
+StatusCode GenParticleTrackBuilder::initialize(const Gaudi::Algorithm& owner) {
+  // retrieve B field, from the cached field map if requested
+  if (!m_fieldCacheSvcName.value().empty()) {
+    m_fieldCache = owner.service<IFieldCacheSvc>(m_fieldCacheSvcName.value(), true);
+    if (!m_fieldCache) {
+      owner.error() << "Unable to locate the field cache service " << m_fieldCacheSvcName.value() << endmsg;
+      return StatusCode::FAILURE;
+    }
+    const double origin[3] = {0., 0., 0.};
+    m_Bz                   = m_fieldCache->fieldMap().bz(origin);
+    if (m_minLocalBzFraction <= 0. || m_minLocalBzFraction > 1.) {
+      owner.error() << "MinLocalBzFraction must be in ]0, 1]" << endmsg;
+      return StatusCode::FAILURE;
+    }
+  } else if (m_useRungeKutta) {
+    owner.error() << "UseRungeKutta requires a FieldCacheSvcName" << endmsg;
+    return StatusCode::FAILURE;
+  } else {
+    m_Bz = getFieldFromCompact();
+  }
+  owner.debug() << "B field (T) is : " << m_Bz << endmsg;
+
+  if (m_minPt < 0. || m_maxAbsCosTheta < 0. || m_maxAbsCosTheta > 1.) {
+    owner.error() << "MinPt must not be negative and MaxAbsCosTheta must be between 0 and 1" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  m_cuts = GenParticleFilter::Cuts{m_generatorStatus, m_minPt, m_maxAbsCosTheta, m_maxVertexRadius,
+                                   m_rejectDecayedInTracker};
+
+  // retrieve ecal dimensions:
+  // - barrel: inner R, zmax
+  // - endcap: inner R, zmin, zmax
+  try {
+    const dd4hep::rec::LayeredCalorimeterData* eCalBarrelExtension =
+        getExtension(owner, (dd4hep::DetType::CALORIMETER | dd4hep::DetType::ELECTROMAGNETIC | dd4hep::DetType::BARREL),
+                     (dd4hep::DetType::AUXILIARY | dd4hep::DetType::FORWARD));
+    m_eCalBarrelInnerR = eCalBarrelExtension->extent[0] / dd4hep::mm;
+    m_eCalBarrelMaxZ   = eCalBarrelExtension->extent[3] / dd4hep::mm;
+    owner.debug() << "ECAL barrel extent: Rmin [mm] = " << m_eCalBarrelInnerR << endmsg;
+    owner.debug() << "ECAL barrel extent: Zmax [mm] = " << m_eCalBarrelMaxZ << endmsg;
+  } catch (...) {
+    owner.warning() << "ECAL barrel extension not found" << endmsg;
+    m_eCalBarrelInnerR = 0.;  // set to 0, will use it later to avoid projecting to the barrel
+  }
+
+  try {
+    const dd4hep::rec::LayeredCalorimeterData* eCalEndCapExtension =
+        getExtension(owner, (dd4hep::DetType::CALORIMETER | dd4hep::DetType::ELECTROMAGNETIC | dd4hep::DetType::ENDCAP),
+                     (dd4hep::DetType::AUXILIARY | dd4hep::DetType::FORWARD));
+    m_eCalEndCapInnerR = eCalEndCapExtension->extent[0] / dd4hep::mm;
+    m_eCalEndCapOuterR = eCalEndCapExtension->extent[1] / dd4hep::mm;
+    m_eCalEndCapInnerZ = eCalEndCapExtension->extent[2] / dd4hep::mm;
+    m_eCalEndCapOuterZ = eCalEndCapExtension->extent[3] / dd4hep::mm;
+    owner.debug() << "ECAL endcap extent: Rmin [mm] = " << m_eCalEndCapInnerR << endmsg;
+    owner.debug() << "ECAL endcap extent: Rmax [mm] = " << m_eCalEndCapOuterR << endmsg;
+    owner.debug() << "ECAL endcap extent: Zmin [mm] = " << m_eCalEndCapInnerZ << endmsg;
+    owner.debug() << "ECAL endcap extent: Zmax [mm] = " << m_eCalEndCapOuterZ << endmsg;
+  } catch (...) {
+    owner.warning() << "ECAL endcap extension not found" << endmsg;
+    m_eCalEndCapInnerR = 0.;  // set to 0, will use it later to avoid projecting to the endcap
+  }
+
+  // retrieve the additional calorimeter surfaces to extrapolate to
+  for (const auto& calorimeterName : m_extrapolationCalorimeters) {
+    const dd4hep::rec::LayeredCalorimeterData* calorimeterData = nullptr;
+    try {
+      calorimeterData =
+          dd4hep::Detector::getInstance().detector(calorimeterName).extension<dd4hep::rec::LayeredCalorimeterData>();
+    } catch (...) {
+      owner.error() << "No LayeredCalorimeterData extension found for calorimeter " << calorimeterName << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (!m_calorimeterSurfaces.addCalorimeter(calorimeterName, *calorimeterData, m_extrapolateToAllLayers)) {
+      owner.error() << "Calorimeter " << calorimeterName << " has a layout which is neither barrel nor endcap"
+                    << endmsg;
+      return StatusCode::FAILURE;
+    }
+    owner.debug() << "Extrapolation surfaces for " << calorimeterName << ": "
+                  << m_calorimeterSurfaces.nSurfaces(m_calorimeterSurfaces.nCalorimeters() - 1) << endmsg;
+  }
+  return StatusCode::SUCCESS;
+}
+
+void GenParticleTrackBuilder::selectParticles(const Gaudi::Algorithm&              owner,
+                                              const edm4hep::MCParticleCollection& genParticles,
+                                              std::vector<std::size_t>&            particleIndices) const {
+  GenParticleFilter::Tally tally;
+  particleIndices.clear();
+  for (std::size_t iParticle = 0; iParticle < genParticles.size(); ++iParticle) {
+    const auto genParticle = genParticles[iParticle];
+    owner.debug() << endmsg;
+    owner.debug() << "Gen. particle: " << genParticle << endmsg;
+    owner.debug() << "  particle " << iParticle << "  PDG: " << genParticle.getPDG()
+                  << " energy: " << genParticle.getEnergy() << " charge: " << genParticle.getCharge() << endmsg;
+    owner.debug() << "Particle decayed in tracker: " << genParticle.isDecayedInTracker() << endmsg;
+
+    if (tally.add(GenParticleFilter::select(m_cuts, genParticle)) == GenParticleFilter::Accepted)
+      particleIndices.push_back(iParticle);
+  }
+  m_acceptedParticles += tally.accepted();
+  m_rejectedParticles += tally.rejected();
+  if (owner.msgLevel(MSG::DEBUG)) {
+    for (int reason = GenParticleFilter::GeneratorStatus; reason < GenParticleFilter::NReasons; ++reason)
+      owner.debug() << "Gen particles rejected by the "
+                    << GenParticleFilter::reasonName(GenParticleFilter::Reason(reason))
+                    << " cut: " << tally.counts[reason] << endmsg;
+  }
+}
+
+bool GenParticleTrackBuilder::buildTrackStates(const edm4hep::MCParticle&             genParticle,
+                                               const SimTrackerHitParticleIndex&      hitIndex,
+                                               const SimTrackerHitColl&               simTrackerHitCollVec,
+                                               MsgStream*                             log,
+                                               std::vector<edm4hep::TrackState>&      trackStates,
+                                               std::vector<TrackHit>&                 trackHits,
+                                               std::vector<CalorimeterSurfaces::Intersection>& intersections) const {
+  trackStates.clear();
+  // Building an helix out of MCParticle properties and B field
+  auto vertex   = genParticle.getVertex();
+  auto endpoint = genParticle.getEndpoint();
+  if (log)
+    *log << "Vertex radius: " << std::sqrt(vertex.x * vertex.x + vertex.y * vertex.y) << endmsg;
+  if (log)
+    *log << "Endpoint radius: " << std::sqrt(endpoint.x * endpoint.x + endpoint.y * endpoint.y) << endmsg;
+  double genParticleVertex[]   = {vertex.x, vertex.y, vertex.z};
+  double genParticleMomentum[] = {genParticle.getMomentum().x, genParticle.getMomentum().y,
+                                  genParticle.getMomentum().z};
+  const double bzAtIP          = bzAt(genParticleVertex);
+  const auto   helixFromGenParticle =
+      HelixMath::Helix::fromPositionMomentum(genParticleVertex, genParticleMomentum, genParticle.getCharge(), bzAtIP);
+  const auto parametersAtIP = helixFromGenParticle.parameters();
+
+  // Setting the track and trackStates at IP properties
+  auto trackState_IP           = edm4hep::TrackState{};
+  trackState_IP.location       = edm4hep::TrackState::AtIP;
+  trackState_IP.D0             = parametersAtIP.d0;
+  trackState_IP.phi            = parametersAtIP.phi0;
+  trackState_IP.omega          = parametersAtIP.omega;
+  trackState_IP.Z0             = parametersAtIP.z0;
+  trackState_IP.tanLambda      = parametersAtIP.tanLambda;
+  trackState_IP.referencePoint = edm4hep::Vector3f((float)genParticleVertex[0], (float)genParticleVertex[1],
+                                                   (float)genParticleVertex[2]);
+  trackStates.push_back(trackState_IP);
+
+  // find SimTrackerHits associated to genParticle, store hit position, momentum and time
+  const auto particleHits = hitIndex.hits(genParticle.getObjectID());
+  trackHits.clear();
+  trackHits.reserve(particleHits.size());
+  for (const auto& hitRef : particleHits) {
+    const auto hit = (*simTrackerHitCollVec[hitRef.collection])[hitRef.index];
+    trackHits.push_back({hit.x(), hit.y(), hit.z(), hit.getMomentum()[0], hit.getMomentum()[1], hit.getMomentum()[2],
+                         hit.getTime()});
+  }
+
+  if (trackHits.empty()) {
+    trackStates.clear();
+    return false;
+  }
+
+  if (log)
+    *log << "Number of SimTrackerHits: " << trackHits.size() << endmsg;
+
+  // sort the hits according to their time
+  std::sort(trackHits.begin(), trackHits.end(), [](const TrackHit& a, const TrackHit& b) { return a[6] < b[6]; });
+
+  // TrackState at First Hit
+  auto   trackState_AtFirstHit = edm4hep::TrackState{};
+  auto   firstHit              = trackHits.front();
+  double posAtFirstHit[]       = {firstHit[0], firstHit[1], firstHit[2]};
+  double momAtFirstHit[]       = {firstHit[3], firstHit[4], firstHit[5]};
+  if (log)
+    *log << "Radius of first hit: " << std::sqrt(firstHit[0] * firstHit[0] + firstHit[1] * firstHit[1]) << endmsg;
+  // get extrapolated momentum from the helix with ref point at IP
+  helixFromGenParticle.momentumAt(posAtFirstHit, momAtFirstHit);
+  // produce new helix at first hit position
+  const auto helixAtFirstHit = HelixMath::Helix::fromPositionMomentum(posAtFirstHit, momAtFirstHit,
+                                                                      genParticle.getCharge(), bzAt(posAtFirstHit));
+  const auto parametersAtFirstHit = helixAtFirstHit.parameters();
+  // fill the TrackState parameters
+  trackState_AtFirstHit.location       = edm4hep::TrackState::AtFirstHit;
+  trackState_AtFirstHit.D0             = parametersAtFirstHit.d0;
+  trackState_AtFirstHit.phi            = parametersAtFirstHit.phi0;
+  trackState_AtFirstHit.omega          = parametersAtFirstHit.omega;
+  trackState_AtFirstHit.Z0             = parametersAtFirstHit.z0;
+  trackState_AtFirstHit.tanLambda      = parametersAtFirstHit.tanLambda;
+  trackState_AtFirstHit.referencePoint =
+      edm4hep::Vector3f((float)posAtFirstHit[0], (float)posAtFirstHit[1], (float)posAtFirstHit[2]);
+  trackStates.push_back(trackState_AtFirstHit);
+
+  // TrackState at Last Hit
+  auto   trackState_AtLastHit = edm4hep::TrackState{};
+  auto   lastHit              = trackHits.back();
+  double posAtLastHit[]       = {lastHit[0], lastHit[1], lastHit[2]};
+  double momAtLastHit[]       = {lastHit[3], lastHit[4], lastHit[5]};
+  if (log)
+    *log << "Radius of last hit: " << std::sqrt(lastHit[0] * lastHit[0] + lastHit[1] * lastHit[1]) << endmsg;
+  // get extrapolated momentum from the helix with ref point at first hit
+  helixAtFirstHit.momentumAt(posAtLastHit, momAtLastHit);
+  // produce new helix at last hit position
+  const auto helixAtLastHit = HelixMath::Helix::fromPositionMomentum(posAtLastHit, momAtLastHit,
+                                                                     genParticle.getCharge(), bzAt(posAtLastHit));
+  const auto parametersAtLastHit = helixAtLastHit.parameters();
+  // fill the TrackState parameters
+  trackState_AtLastHit.location       = edm4hep::TrackState::AtLastHit;
+  trackState_AtLastHit.D0             = parametersAtLastHit.d0;
+  trackState_AtLastHit.phi            = parametersAtLastHit.phi0;
+  trackState_AtLastHit.omega          = parametersAtLastHit.omega;
+  trackState_AtLastHit.Z0             = parametersAtLastHit.z0;
+  trackState_AtLastHit.tanLambda      = parametersAtLastHit.tanLambda;
+  trackState_AtLastHit.referencePoint =
+      edm4hep::Vector3f((float)posAtLastHit[0], (float)posAtLastHit[1], (float)posAtLastHit[2]);
+  // attach the TrackState to the track
+  trackStates.push_back(trackState_AtLastHit);
+
+  // TrackState at Calorimeter
+  if (m_eCalBarrelInnerR > 0. || m_eCalEndCapInnerR > 0.) {
+    auto   trackState_AtCalorimeter = edm4hep::TrackState{};
+    double posAtCalorimeter[]       = {0., 0., 0.};
+    double momAtCalorimeter[]       = {0., 0., 0.};
+
+    // propagate from the last hit through the cached field map, or project the helix
+    if (!m_useRungeKutta || !propagateToCalorimeter(posAtLastHit, momAtLastHit, genParticle.getCharge(),
+                                                    posAtCalorimeter, momAtCalorimeter)) {
+      // create helix to project
+      const auto helix = HelixMath::Helix::fromCanonical(trackState_IP.phi, trackState_IP.D0, trackState_IP.Z0,
+                                                         trackState_IP.omega, trackState_IP.tanLambda, bzAtIP);
+      const int  signPz((helix.tanLambda > 0.) ? 1 : -1);
+
+      // First project to endcap
+      double minPathLength(std::numeric_limits<double>::max());
+      if (m_eCalEndCapInnerR > 0) {
+        double endCapProjection[3];
+        double pathLength;
+        if (helix.intersectZPlane(signPz * m_eCalEndCapInnerZ, endCapProjection, pathLength)) {
+          minPathLength = pathLength;
+          std::copy(endCapProjection, endCapProjection + 3, posAtCalorimeter);
+        }
+        // GM: if the radius of the point on the plane corresponding to the endcap inner face is
+        // lower than the inner radius of the calorimeter, we might want to ignore it
+        // for the moment let's keep it as it might be useful for debugging the reconstruction
+      }
+
+      // Then project to barrel surface(s), and keep projection with shorter path length
+      if (m_eCalBarrelInnerR > 0) {
+        double barrelProjection[3];
+        double pathLength;
+        if (helix.intersectCylinder(m_eCalBarrelInnerR, barrelProjection, pathLength) &&
+            (pathLength < minPathLength)) {
+          minPathLength = pathLength;
+          std::copy(barrelProjection, barrelProjection + 3, posAtCalorimeter);
+        }
+        // GM: again, if the Z of the point on the cylinder of the barrel is beyond the
+        // max/min z of the detector, we might want to ignore it - but let's keep it
+        // for the moment as it might be useful for debugging the reconstruction
+      }
+
+      // get extrapolated momentum from the helix with ref point at last hit
+      helixAtLastHit.momentumAt(posAtCalorimeter, momAtCalorimeter);
+    }
+
+    // get extrapolated position
+    if (log)
+      *log << "Radius at calorimeter: "
+           << std::sqrt(posAtCalorimeter[0] * posAtCalorimeter[0] + posAtCalorimeter[1] * posAtCalorimeter[1])
+           << endmsg;
+
+    // produce new helix at calorimeter position
+    const auto helixAtCalorimeter = HelixMath::Helix::fromPositionMomentum(
+        posAtCalorimeter, momAtCalorimeter, genParticle.getCharge(), bzAt(posAtCalorimeter));
+    const auto parametersAtCalorimeter = helixAtCalorimeter.parameters();
+
+    // fill the TrackState parameters
+    trackState_AtCalorimeter.location       = edm4hep::TrackState::AtCalorimeter;
+    trackState_AtCalorimeter.D0             = parametersAtCalorimeter.d0;
+    trackState_AtCalorimeter.phi            = parametersAtCalorimeter.phi0;
+    trackState_AtCalorimeter.omega          = parametersAtCalorimeter.omega;
+    trackState_AtCalorimeter.Z0             = parametersAtCalorimeter.z0;
+    trackState_AtCalorimeter.tanLambda      = parametersAtCalorimeter.tanLambda;
+    trackState_AtCalorimeter.referencePoint =
+        edm4hep::Vector3f((float)posAtCalorimeter[0], (float)posAtCalorimeter[1], (float)posAtCalorimeter[2]);
+    // attach the TrackState to the track
+    trackStates.push_back(trackState_AtCalorimeter);
+  }
+
+  // TrackStates at the additional calorimeter surfaces, in order of path length
+  if (m_calorimeterSurfaces.nCalorimeters() > 0) {
+    const auto helixAtIP = HelixMath::Helix::fromCanonical(trackState_IP.phi, trackState_IP.D0, trackState_IP.Z0,
+                                                           trackState_IP.omega, trackState_IP.tanLambda, bzAtIP);
+    intersections.clear();
+    m_calorimeterSurfaces.intersect(helixAtIP, intersections);
+    if (log)
+      *log << "Number of crossed calorimeter surfaces: " << intersections.size() << endmsg;
+    for (const auto& intersection : intersections) {
+      // get extrapolated momentum from the helix with ref point at last hit
+      double momAtSurface[] = {0., 0., 0.};
+      helixAtLastHit.momentumAt(intersection.position, momAtSurface);
+      const auto parametersAtSurface =
+          HelixMath::Helix::fromPositionMomentum(intersection.position, momAtSurface, genParticle.getCharge(),
+                                                 bzAt(intersection.position))
+              .parameters();
+      auto trackState_AtSurface           = edm4hep::TrackState{};
+      trackState_AtSurface.location       = edm4hep::TrackState::AtOther;
+      trackState_AtSurface.D0             = parametersAtSurface.d0;
+      trackState_AtSurface.phi            = parametersAtSurface.phi0;
+      trackState_AtSurface.omega          = parametersAtSurface.omega;
+      trackState_AtSurface.Z0             = parametersAtSurface.z0;
+      trackState_AtSurface.tanLambda      = parametersAtSurface.tanLambda;
+      trackState_AtSurface.referencePoint = edm4hep::Vector3f(
+          (float)intersection.position[0], (float)intersection.position[1], (float)intersection.position[2]);
+      trackStates.push_back(trackState_AtSurface);
+    }
+  }
+  return true;
+}
+
+void GenParticleTrackBuilder::fillTracks(const edm4hep::MCParticleCollection&                 genParticles,
+                                         const std::vector<std::size_t>&                      particleIndices,
+                                         const std::vector<std::vector<edm4hep::TrackState>>& trackStates,
+                                         edm4hep::TrackCollection&                            tracks,
+                                         edm4hep::TrackMCParticleLinkCollection&              links) {
+  // the tracks, for the particles with at least one SimTrackerHit, and their links in the original order
+  for (std::size_t i = 0; i < particleIndices.size(); ++i) {
+    if (trackStates[i].empty())
+      continue;
+    auto trackFromGen = edm4hep::MutableTrack();
+    for (const auto& trackState : trackStates[i])
+      trackFromGen.addToTrackStates(trackState);
+    tracks.push_back(trackFromGen);
+
+    // Building the association between tracks and genParticles
+    auto MCRecoTrackParticleAssociation = edm4hep::MutableTrackMCParticleLink();
+    MCRecoTrackParticleAssociation.setFrom(trackFromGen);
+    MCRecoTrackParticleAssociation.setTo(genParticles[particleIndices[i]]);
+    links.push_back(MCRecoTrackParticleAssociation);
+  }
+}
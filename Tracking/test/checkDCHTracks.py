@@ -0,0 +1,42 @@
+# file: checkDCHTracks.py
+# to run: python3 checkDCHTracks.py <file> <collection> [<collection> ...], in DCHdigi/test/test_DCHdigi after the track
+# finder, e.g. python3 checkDCHTracks.py dch_proton_10GeV_ca_tracks.root DCHCellularAutomatonTracks DCHCellularAutomatonTracksParallel
+# goal: check that the drift chamber track finder found the single proton of each event, and that the other collections
+# (e.g. of the parallel instance of the finder) have the same tracks as the first one, and print out a number:
+#  0 : good tracks
+#  1 : an event without track, or with more tracks than MAX_TRACKS_PER_EVENT
+#  2 : the collections differ
+
+import sys
+from podio.root_io import Reader
+
+# one 10 GeV proton per event, plus possibly a track from a secondary
+MAX_TRACKS_PER_EVENT = 2
+
+def trackContent(track):
+    states = [(state.location, state.D0, state.phi, state.omega, state.Z0, state.tanLambda,
+               state.referencePoint.x, state.referencePoint.y, state.referencePoint.z)
+              for state in track.getTrackStates()]
+    hits = [hit.getCellID() for hit in track.getTrackerHits()]
+    return (track.getChi2(), track.getNdf(), states, hits)
+
+def main(filename, collections):
+    events = Reader(filename).get("events")
+    n_tracks = 0
+    for i, event in enumerate(events):
+        tracks = event.get(collections[0])
+        n_tracks += len(tracks)
+        if len(tracks) == 0 or len(tracks) > MAX_TRACKS_PER_EVENT:
+            print(f"event {i}: {len(tracks)} tracks in {collections[0]}")
+            return 1
+        content = [trackContent(track) for track in tracks]
+        for collection in collections[1:]:
+            if [trackContent(track) for track in event.get(collection)] != content:
+                print(f"event {i}: the tracks of {collection} differ from the ones of {collections[0]}")
+                return 2
+    print(f"{collections[0]}: {n_tracks} tracks in {len(events)} events")
+    return 0
+
+if __name__ == "__main__":
+    code = main(sys.argv[1], sys.argv[2:])
+    sys.exit(code)
@@ -0,0 +1,52 @@
+# file: checkGenFitTracks.py
+# to run: python3 test/checkGenFitTracks.py, after runGenFitTrackingOnSimplifiedDriftChamber.py
+# goal: check that GenFitter fitted tracks from the vertex and drift chamber hits, and that the vectorized (fitLanes = 8)
+# and scalar (fitLanes = 1) fits give the same bits, and print out a number:
+#  0 : good fitted tracks
+#  1 : no fitted track
+#  2 : no fitted track reaching the drift chamber
+#  3 : vectorized and scalar fits differ
+
+import math
+import sys
+from podio.root_io import Reader
+
+AT_LAST_HIT = 3
+# inner radius of the IDEA_o1_v03 drift chamber [mm]
+DCH_INNER_RADIUS = 350.
+
+def trackStates(track):
+    return [(state.location, state.D0, state.phi, state.omega, state.Z0, state.tanLambda,
+             state.referencePoint.x, state.referencePoint.y, state.referencePoint.z, tuple(state.covMatrix))
+            for state in track.getTrackStates()]
+
+def main():
+    events = Reader("genfit_tracking_output.root").get("events")
+    n_tracks = 0
+    n_dch_tracks = 0
+    for i, event in enumerate(events):
+        tracks = event.get("genfit_tracks")
+        scalar_tracks = event.get("genfit_tracks_scalar")
+        if len(tracks) != len(scalar_tracks):
+            print(f"event {i}: {len(tracks)} vectorized and {len(scalar_tracks)} scalar fitted tracks")
+            return 3
+        for j, (track, scalar_track) in enumerate(zip(tracks, scalar_tracks)):
+            if (trackStates(track) != trackStates(scalar_track) or track.getChi2() != scalar_track.getChi2()
+                    or track.getNdf() != scalar_track.getNdf()):
+                print(f"event {i}, track {j}: vectorized and scalar fits differ")
+                return 3
+        for track in tracks:
+            n_tracks += 1
+            for state in track.getTrackStates():
+                if state.location == AT_LAST_HIT and math.hypot(state.referencePoint.x, state.referencePoint.y) > DCH_INNER_RADIUS:
+                    n_dch_tracks += 1
+    print(f"genfit_tracks: {n_tracks} fitted tracks, {n_dch_tracks} with their last hit in the drift chamber")
+    if n_tracks == 0:
+        return 1
+    if n_dch_tracks == 0:
+        return 2
+    return 0
+
+if __name__ == "__main__":
+    code = main()
+    sys.exit(code)
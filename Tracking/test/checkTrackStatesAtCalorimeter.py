@@ -0,0 +1,39 @@
+# file: checkTrackStatesAtCalorimeter.py
+# to run: python3 test/checkTrackStatesAtCalorimeter.py, after runTracksFromGenParticlesAlg.py
+# goal: check that the AtCalorimeter track states of the gen particle tracks have a finite, non zero omega of the same
+# sign as at the IP, with the constant field and with the cached field map (where the local Bz at the calorimeter is
+# out of the solenoid), and print out a number:
+#  0 : good AtCalorimeter states
+#  1 : no track with an AtCalorimeter state
+#  2 : bad omega at the calorimeter
+
+import math
+import sys
+from podio.root_io import Reader
+
+AT_IP = 1
+AT_CALORIMETER = 4
+
+def main():
+    events = Reader("tracks_from_genParticle_output.root").get("events")
+    for collection in ["TracksFromGenParticles", "RungeKuttaTracksFromGenParticles"]:
+        n_states = 0
+        for i, event in enumerate(events):
+            for track in event.get(collection):
+                states = {state.location: state for state in track.getTrackStates()}
+                if AT_CALORIMETER not in states:
+                    continue
+                n_states += 1
+                omega_ip = states[AT_IP].omega
+                omega = states[AT_CALORIMETER].omega
+                if not math.isfinite(omega) or omega == 0. or omega * omega_ip < 0.:
+                    print(f"{collection}, event {i}: omega {omega} at the calorimeter, {omega_ip} at the IP")
+                    return 2
+        print(f"{collection}: {n_states} AtCalorimeter track states")
+        if n_states == 0:
+            return 1
+    return 0
+
+if __name__ == "__main__":
+    code = main()
+    sys.exit(code)
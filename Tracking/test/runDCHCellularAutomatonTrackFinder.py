@@ -0,0 +1,59 @@
+#
+# gaudi steering file that runs the cellular automaton track finder on the drift chamber hits made by DCHdigi_v01
+#
+# to execute, in DCHdigi/test/test_DCHdigi after test_DCHdigi.sh:
+# k4run runDCHCellularAutomatonTrackFinder.py
+
+from Gaudi.Configuration import INFO
+from Configurables import EventDataSvc
+from k4FWCore import ApplicationMgr, IOSvc
+
+svc = IOSvc("IOSvc")
+svc.input = ["dch_proton_10GeV_digi.root"]
+svc.output = "dch_proton_10GeV_ca_tracks.root"
+
+from Configurables import GeoSvc
+geoservice = GeoSvc("GeoSvc")
+geoservice.detectors = ['./compact/DCH_standalone_o1_v02.xml']
+
+from Configurables import DCHCellularAutomatonTrackFinder
+trackFinder = DCHCellularAutomatonTrackFinder("DCHCellularAutomatonTrackFinder",
+                                              inputWireHits = "DCH_DigiCollection",
+                                              outputTracks = "DCHCellularAutomatonTracks",
+                                              GeoSvcName = "GeoSvc",
+                                              DCH_name = "DCH_v2",
+                                              Bz = 2.0,
+                                              minPt = 0.3,
+                                              OutputLevel = INFO)
+
+# same finder with the automaton passes spread over TBB tasks, the output must match the serial instance (see
+# checkDCHTracks.py)
+parallelTrackFinder = DCHCellularAutomatonTrackFinder("DCHCellularAutomatonTrackFinderParallel",
+                                                      inputWireHits = "DCH_DigiCollection",
+                                                      outputTracks = "DCHCellularAutomatonTracksParallel",
+                                                      GeoSvcName = "GeoSvc",
+                                                      DCH_name = "DCH_v2",
+                                                      Bz = 2.0,
+                                                      minPt = 0.3,
+                                                      parallelEvolution = True,
+                                                      parallelGrainSize = 64,
+                                                      OutputLevel = INFO)
+
+# same finder adding to the tracks the free hits close to them, found with the (layer, azimuth) index of the hits
+recoveryTrackFinder = DCHCellularAutomatonTrackFinder("DCHCellularAutomatonTrackFinderRecovery",
+                                                      inputWireHits = "DCH_DigiCollection",
+                                                      outputTracks = "DCHCellularAutomatonTracksRecovery",
+                                                      GeoSvcName = "GeoSvc",
+                                                      DCH_name = "DCH_v2",
+                                                      Bz = 2.0,
+                                                      minPt = 0.3,
+                                                      recoverHits = True,
+                                                      OutputLevel = INFO)
+
+mgr = ApplicationMgr(
+    TopAlg=[trackFinder, parallelTrackFinder, recoveryTrackFinder],
+    EvtSel="NONE",
+    EvtMax=-1,
+    ExtSvc=[geoservice, EventDataSvc("EventDataSvc")],
+    OutputLevel=INFO,
+)
@@ -0,0 +1,29 @@
+#
+# gaudi steering file that runs the Hough transform track finder on the drift chamber hits made by DCHdigi_v01
+#
+# to execute, in DCHdigi/test/test_DCHdigi after test_DCHdigi.sh:
+# k4run runDCHHoughTrackFinder.py
+
+from Gaudi.Configuration import INFO
+from Configurables import EventDataSvc
+from k4FWCore import ApplicationMgr, IOSvc
+
+svc = IOSvc("IOSvc")
+svc.input = ["dch_proton_10GeV_digi.root"]
+svc.output = "dch_proton_10GeV_tracks.root"
+
+from Configurables import DCHHoughTrackFinder
+trackFinder = DCHHoughTrackFinder("DCHHoughTrackFinder",
+                                  inputWireHits = "DCH_DigiCollection",
+                                  outputTracks = "DCHHoughTracks",
+                                  Bz = 2.0,
+                                  minPt = 0.3,
+                                  OutputLevel = INFO)
+
+mgr = ApplicationMgr(
+    TopAlg=[trackFinder],
+    EvtSel="NONE",
+    EvtMax=-1,
+    ExtSvc=[EventDataSvc("EventDataSvc")],
+    OutputLevel=INFO,
+)
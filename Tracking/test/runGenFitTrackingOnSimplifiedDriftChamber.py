@@ -1,4 +1,11 @@
-import os
+#
+# simulation of single muons in IDEA_o1_v03 with a constant field, digitization of the vertex and drift chamber hits,
+# and Kalman filter fit of the tracks seeded by TracksFromGenParticles
+#
+# to execute (see checkGenFitTracks.py for the check of the output):
+# k4run runGenFitTrackingOnSimplifiedDriftChamber.py
+
+import os, math
 
 from Gaudi.Configuration import *
 
@@ -14,8 +21,17 @@ thetaMin = 20 # degrees
 thetaMax = 130 # degrees
 pdgCode = 13 # 11 electron, 13 muon, 22 photon, 111 pi0, 211 pi+
 magneticField = True
+fieldZ = -2 # in tesla, the seeds must use the simulated field
 _pi = 3.14159
 
+################## Vertex sensor resolutions
+innerVertexResolution_x = 0.003 # [mm], assume 3 µm resolution for ARCADIA sensor
+innerVertexResolution_y = 0.003 # [mm], assume 3 µm resolution for ARCADIA sensor
+innerVertexResolution_t = 1000 # [ns]
+outerVertexResolution_x = 0.050/math.sqrt(12) # [mm], assume ATLASPix3 sensor with 50 µm pitch
+outerVertexResolution_y = 0.150/math.sqrt(12) # [mm], assume ATLASPix3 sensor with 150 µm pitch
+outerVertexResolution_t = 1000 # [ns]
+
 from Configurables import GenAlg
 genAlg = GenAlg()
 from Configurables import  MomentumRangeParticleGun
@@ -38,6 +54,13 @@ genParticlesOutputName = "genParticles"
 hepmc_converter.GenParticles.Path = genParticlesOutputName
 hepmc_converter.hepmcStatusList = []
 
+# event headers, to seed the drift chamber digitizer
+from Configurables import EventHeaderCreator
+eventHeaderCreator = EventHeaderCreator("eventHeaderCreator",
+    runNumber = 42,
+    eventNumberOffset = 0,
+    eventHeaderCollectionName = "EventHeader")
+
 ################## Simulation setup
 # Detector geometry
 from Configurables import GeoSvc
@@ -46,7 +69,7 @@ geoservice = GeoSvc("GeoSvc")
 path_to_detector = os.environ.get("K4GEO", "")
 print(path_to_detector)
 detectors_to_use=[
-                    'FCCee/IDEA/compact/IDEA_o1_v02/IDEA_o1_v02.xml',
+                    'FCCee/IDEA/compact/IDEA_o1_v03/IDEA_o1_v03.xml',
                   ]
 # prefix all xmls with path_to_detector
 geoservice.detectors = [os.path.join(path_to_detector, _det) for _det in detectors_to_use]
@@ -65,7 +88,7 @@ actions = SimG4FullSimActions()
 
 # Magnetic field
 from Configurables import SimG4ConstantMagneticFieldTool
-field = SimG4ConstantMagneticFieldTool("SimG4ConstantMagneticFieldTool", FieldComponentZ = -2 * tesla, FieldOn = magneticField, IntegratorStepper = "ClassicalRK4")
+field = SimG4ConstantMagneticFieldTool("SimG4ConstantMagneticFieldTool", FieldComponentZ = fieldZ * tesla, FieldOn = magneticField, IntegratorStepper = "ClassicalRK4")
 
 from Configurables import SimG4Svc
 geantservice = SimG4Svc("SimG4Svc", detector = 'SimG4DD4hepDetector', physicslist = "SimG4FtfpBert", actions = actions, magneticField = field)
@@ -88,61 +111,89 @@ particle_converter = SimG4PrimariesFromEdmTool("EdmConverter")
 particle_converter.GenParticles.Path = genParticlesOutputName
 
 from Configurables import SimG4SaveTrackerHits
-saveDCHsimHitTool = SimG4SaveTrackerHits("saveDCHsimHitTool", readoutName="CDCHHits")
+saveDCHsimHitTool = SimG4SaveTrackerHits("saveDCHsimHitTool", readoutName="DCHCollection")
 saveDCHsimHitTool.SimTrackHits.Path = "DC_simTrackerHits"
 
-saveVTXIBsimHitTool = SimG4SaveTrackerHits("saveVTXIBsimHitTool", readoutName="VTXIBCollection")
-saveVTXIBsimHitTool.SimTrackHits.Path = "VTXIB_simTrackerHits"
-
-saveVTXOBsimHitTool = SimG4SaveTrackerHits("saveVTXOBsimHitTool", readoutName="VTXOBCollection")
-saveVTXOBsimHitTool.SimTrackHits.Path = "VTXOB_simTrackerHits"
+saveVTXBsimHitTool = SimG4SaveTrackerHits("saveVTXBsimHitTool", readoutName="VertexBarrelCollection")
+saveVTXBsimHitTool.SimTrackHits.Path = "VTXB_simTrackerHits"
 
-saveVTXDsimHitTool = SimG4SaveTrackerHits("saveVTXDsimHitTool", readoutName="VTXDCollection")
+saveVTXDsimHitTool = SimG4SaveTrackerHits("saveVTXDsimHitTool", readoutName="VertexEndcapCollection")
 saveVTXDsimHitTool.SimTrackHits.Path = "VTXD_simTrackerHits"
 
 from Configurables import SimG4Alg
 geantsim = SimG4Alg("SimG4Alg",
-                       outputs= [saveVTXIBsimHitTool, saveVTXOBsimHitTool, saveVTXDsimHitTool, saveDCHsimHitTool,
+                       outputs= [saveVTXBsimHitTool, saveVTXDsimHitTool, saveDCHsimHitTool,
                                  #saveHistTool
                        ],
                        eventProvider = particle_converter,
                        OutputLevel = INFO)
 
 # Digitize tracker hits (for now digitization is reconstruction)
-vtxib_reco_hit_name = saveVTXIBsimHitTool.SimTrackHits.Path.replace("sim", "reco")
+vtxb_reco_hit_name = saveVTXBsimHitTool.SimTrackHits.Path.replace("sim", "reco")
 from Configurables import VTXdigitizer
-vtxib_digitizer = VTXdigitizer("VTXIBdigitizer",
-    inputSimHits = saveVTXIBsimHitTool.SimTrackHits.Path,
-    readoutName = "VTXIBCollection",
-    outputDigiHits = vtxib_reco_hit_name
-)
-
-vtxob_reco_hit_name = saveVTXOBsimHitTool.SimTrackHits.Path.replace("sim", "reco")
-from Configurables import VTXdigitizer
-vtxob_digitizer = VTXdigitizer("VTXOBdigitizer",
-    inputSimHits = saveVTXOBsimHitTool.SimTrackHits.Path,
-    readoutName = "VTXOBCollection",
-    outputDigiHits = vtxob_reco_hit_name
+vtxb_digitizer = VTXdigitizer("VTXBdigitizer",
+    inputSimHits = saveVTXBsimHitTool.SimTrackHits.Path,
+    outputDigiHits = vtxb_reco_hit_name,
+    outputSimDigiAssociation = "VTXB_simDigiLinks",
+    detectorName = "Vertex",
+    readoutName = "VertexBarrelCollection",
+    xResolution = [innerVertexResolution_x, innerVertexResolution_x, innerVertexResolution_x, outerVertexResolution_x, outerVertexResolution_x], # mm, r-phi direction
+    yResolution = [innerVertexResolution_y, innerVertexResolution_y, innerVertexResolution_y, outerVertexResolution_y, outerVertexResolution_y], # mm, z direction
+    tResolution = [innerVertexResolution_t, innerVertexResolution_t, innerVertexResolution_t, outerVertexResolution_t, outerVertexResolution_t], # ns
+    forceHitsOntoSurface = False
 )
 
 vtxd_reco_hit_name = saveVTXDsimHitTool.SimTrackHits.Path.replace("sim", "reco")
 vtxd_digitizer = VTXdigitizer("VTXDdigitizer",
     inputSimHits = saveVTXDsimHitTool.SimTrackHits.Path,
-    readoutName = "VTXDCollection",
-    outputDigiHits = vtxd_reco_hit_name
+    outputDigiHits = vtxd_reco_hit_name,
+    outputSimDigiAssociation = "VTXD_simDigiLinks",
+    detectorName = "Vertex",
+    readoutName = "VertexEndcapCollection",
+    xResolution = [outerVertexResolution_x, outerVertexResolution_x, outerVertexResolution_x], # mm, r direction
+    yResolution = [outerVertexResolution_y, outerVertexResolution_y, outerVertexResolution_y], # mm, phi direction
+    tResolution = [outerVertexResolution_t, outerVertexResolution_t, outerVertexResolution_t], # ns
+    forceHitsOntoSurface = False
 )
 
-dch_reco_hit_name = saveDCHsimHitTool.SimTrackHits.Path.replace("sim", "reco")
-from Configurables import DCHsimpleDigitizer
-dch_digitizer = DCHsimpleDigitizer("DCHsimpleDigitizer",
-    inputSimHits = saveDCHsimHitTool.SimTrackHits.Path,
-    readoutName = "CDCHHits",
-    outputDigiHits = dch_reco_hit_name
+# drift chamber SenseWireHits, with their links to the sim hits
+from Configurables import DCHdigi_v01, UniqueIDGenSvc
+dch_digitizer = DCHdigi_v01("DCHdigi",
+    DCH_simhits = [saveDCHsimHitTool.SimTrackHits.Path],
+    DCH_name = "DCH_v2",
+    zResolution_mm = 1,
+    xyResolution_mm = 0.1
 )
 
-# run the genfit tracking 
+# seeds for the track fit, from the generated particles
+from Configurables import TracksFromGenParticles
+tracksFromGenParticles = TracksFromGenParticles("TracksFromGenParticles",
+                                               InputGenParticles = [genParticlesOutputName],
+                                               OutputTracks = ["TracksFromGenParticles"],
+                                               OutputMCRecoTrackParticleAssociation = ["TracksFromGenParticlesAssociation"],
+                                               Bz = fieldZ)
+
+# run the Kalman filter track fit on the vertex and drift chamber hits
 from Configurables import GenFitter
-genfitter = GenFitter("GenFitter", inputHits = dch_reco_hit_name, outputTracks = "genfit_tracks") 
+genfitter = GenFitter("GenFitter",
+                      inputSeedTracks = "TracksFromGenParticles",
+                      inputSeedLinks = "TracksFromGenParticlesAssociation",
+                      inputHits = [vtxb_reco_hit_name, vtxd_reco_hit_name],
+                      inputHitLinks = ["VTXB_simDigiLinks", "VTXD_simDigiLinks"],
+                      inputWireHits = ["DCH_DigiCollection"],
+                      inputWireHitLinks = ["DCH_DigiSimAssociationCollection"],
+                      outputTracks = "genfit_tracks")
+
+# same fit with the scalar version of the track parallel Kalman filter, the output tracks must be identical
+genfitter_scalar = GenFitter("GenFitterScalar",
+                             inputSeedTracks = "TracksFromGenParticles",
+                             inputSeedLinks = "TracksFromGenParticlesAssociation",
+                             inputHits = [vtxb_reco_hit_name, vtxd_reco_hit_name],
+                             inputHitLinks = ["VTXB_simDigiLinks", "VTXD_simDigiLinks"],
+                             inputWireHits = ["DCH_DigiCollection"],
+                             inputWireHitLinks = ["DCH_DigiSimAssociationCollection"],
+                             fitLanes = 1,
+                             outputTracks = "genfit_tracks_scalar")
 
 ################ Output
 from Configurables import PodioOutput
@@ -150,8 +201,7 @@ out = PodioOutput("out",
                   OutputLevel=INFO)
 out.outputCommands = ["keep *"]
 
-import uuid
-out.filename = "output_simplifiedDriftChamber_MagneticField_"+str(magneticField)+"_pMin_"+str(momentum*1000)+"_MeV"+"_ThetaMinMax_"+str(thetaMin)+"_"+str(thetaMax)+"_pdgId_"+str(pdgCode)+".root"
+out.filename = "genfit_tracking_output.root"
 
 #CPU information
 from Configurables import AuditorSvc, ChronoAuditor
@@ -168,15 +218,18 @@ ApplicationMgr(
     TopAlg = [
               genAlg,
               hepmc_converter,
+              eventHeaderCreator,
               geantsim,
-              vtxib_digitizer,
+              vtxb_digitizer,
               vtxd_digitizer,
               dch_digitizer,
+              tracksFromGenParticles,
               genfitter,
+              genfitter_scalar,
               out
               ],
     EvtSel = 'NONE',
     EvtMax   = 4,
-    ExtSvc = [geoservice, podioevent, geantservice, audsvc],
+    ExtSvc = [geoservice, podioevent, geantservice, audsvc, UniqueIDGenSvc("uidSvc")],
     StopOnSignal = True,
  )
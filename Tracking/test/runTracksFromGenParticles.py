@@ -20,6 +20,18 @@ tracksFromGenParticles = TracksFromGenParticles("TracksFromGenParticles",
                                                Bz = 2.0,
                                                OutputLevel = INFO)
 
+# Same tracks, with the helix parameters smeared and the covariance filled from the default resolution parametrization
+from Configurables import UniqueIDGenSvc
+smearedTracksFromGenParticles = TracksFromGenParticles("SmearedTracksFromGenParticles",
+                                                      InputGenParticles = ["MCParticles"],
+                                                      InputEventHeader = ["EventHeader"],
+                                                      OutputTracks = ["SmearedTracksFromGenParticles"],
+                                                      OutputMCRecoTrackParticleAssociation = ["SmearedTracksFromGenParticlesAssociation"],
+                                                      Bz = 2.0,
+                                                      Smearing = True,
+                                                      uidSvcName = "uidSvc",
+                                                      OutputLevel = INFO)
+
 # produce a TH1 with distances between tracks and simTrackerHits
 from Configurables import PlotTrackHitDistances, RootHistSvc
 from Configurables import Gaudi__Histograming__Sink__Root as RootHistoSink
@@ -42,9 +54,9 @@ plotTrackHitDistances.AuditExecute = True
 
 from Configurables import EventDataSvc
 ApplicationMgr(
-    TopAlg= [tracksFromGenParticles, plotTrackHitDistances],
+    TopAlg= [tracksFromGenParticles, smearedTracksFromGenParticles, plotTrackHitDistances],
     EvtSel='NONE',
     EvtMax=-1,
-    ExtSvc=[root_hist_svc, EventDataSvc("EventDataSvc"), audsvc],
+    ExtSvc=[root_hist_svc, EventDataSvc("EventDataSvc"), audsvc, UniqueIDGenSvc("uidSvc")],
     StopOnSignal=True,
 )
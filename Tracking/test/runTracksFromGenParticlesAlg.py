@@ -37,6 +37,21 @@ tracksFromGenParticles = TracksFromGenParticlesWithECalExtrapAlg("TracksFromGenP
                                                                  OutputMCRecoTrackParticleAssociation="TracksFromGenParticlesAssociation",
                                                                  OutputLevel=DEBUG)
 
+# Magnetic field cached on an (r, z) grid, used for the local Bz of the helices and the Runge-Kutta extrapolation
+from Configurables import FieldCacheSvc
+fieldcache = FieldCacheSvc("FieldCacheSvc")
+
+rungeKuttaTracksFromGenParticles = TracksFromGenParticlesWithECalExtrapAlg("RungeKuttaTracksFromGenParticles",
+                                                                           InputGenParticles="MCParticles",
+                                                                           InputSimTrackerHits=["DCHCollection",
+                                                                                                "SiWrBCollection",
+                                                                                                "SiWrDCollection"],
+                                                                           OutputTracks="RungeKuttaTracksFromGenParticles",
+                                                                           OutputMCRecoTrackParticleAssociation="RungeKuttaTracksFromGenParticlesAssociation",
+                                                                           FieldCacheSvcName="FieldCacheSvc",
+                                                                           UseRungeKutta=True,
+                                                                           OutputLevel=INFO)
+
 # produce a TH1 with distances between tracks and simTrackerHits
 from Configurables import PlotTrackHitDistances, RootHistSvc
 from Configurables import Gaudi__Histograming__Sink__Root as RootHistoSink
@@ -55,13 +70,14 @@ chra = ChronoAuditor()
 audsvc = AuditorSvc()
 audsvc.Auditors = [chra]
 tracksFromGenParticles.AuditExecute = True
+rungeKuttaTracksFromGenParticles.AuditExecute = True
 plotTrackHitDistances.AuditExecute = True
 
 from Configurables import EventDataSvc
 ApplicationMgr(
-    TopAlg=[tracksFromGenParticles, plotTrackHitDistances],
+    TopAlg=[tracksFromGenParticles, rungeKuttaTracksFromGenParticles, plotTrackHitDistances],
     EvtSel='NONE',
     EvtMax=-1,
-    ExtSvc=[root_hist_svc, EventDataSvc("EventDataSvc"), audsvc, geoservice],
+    ExtSvc=[root_hist_svc, EventDataSvc("EventDataSvc"), audsvc, geoservice, fieldcache],
     StopOnSignal=True,
 )
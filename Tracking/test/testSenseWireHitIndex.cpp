@@ -0,0 +1,85 @@
+// file: testSenseWireHitIndex.cpp
+// goal: check the azimuth windows of SenseWireHitIndex, in particular the ones wrapping around at +-pi, against a
+// brute force selection, and return a number:
+//  0 : good windows
+//  1 : a window misses a hit or returns a hit outside of it
+//  2 : the hits of a window are not ordered by increasing azimuth
+
+#include "SenseWireHitIndex.h"
+
+#include "extension/SenseWireHitCollection.h"
+
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+namespace {
+
+  // Azimuth difference in [-pi, pi]
+  double deltaPhi(double a, double b) { return std::remainder(a - b, 2. * M_PI); }
+
+  int checkWindow(const SenseWireHitIndex& index, const std::vector<double>& azimuths,
+                  const std::vector<uint32_t>& layers, uint32_t layer, double phi, double halfWidth) {
+    // the azimuths are stored as floats: leave a margin around the window edges
+    const double margin = 1e-6;
+
+    std::set<uint32_t> found;
+    for (const auto& range : index.window(layer, phi, halfWidth)) {
+      for (const uint32_t* hit = range.begin(); hit != range.end(); ++hit) {
+        if (hit != range.begin() && index.azimuth(hit) < index.azimuth(hit - 1)) {
+          std::printf("layer %u, window %g +- %g: hits not ordered by azimuth\n", layer, phi, halfWidth);
+          return 2;
+        }
+        found.insert(*hit);
+      }
+    }
+
+    for (uint32_t i = 0; i < azimuths.size(); ++i) {
+      const double distance = std::abs(deltaPhi(azimuths[i], phi));
+      const bool   inside   = layers[i] == layer && distance <= halfWidth - margin;
+      const bool   outside  = layers[i] != layer || distance > halfWidth + margin;
+      if ((inside && !found.count(i)) || (outside && found.count(i))) {
+        std::printf("layer %u, window %g +- %g: hit %u at azimuth %g %s\n", layer, phi, halfWidth, i, azimuths[i],
+                    inside ? "missing" : "returned");
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+}  // namespace
+
+int main() {
+  // hits on both sides of +-pi, exactly at pi (stored as -pi), around 0, and in the other layer
+  const std::vector<double>   azimuths = {M_PI - 0.002, -M_PI + 0.001, M_PI,   M_PI - 0.05, -M_PI + 0.03,
+                                          0.,           0.01,          -0.02,  M_PI - 0.01, -M_PI + 0.01};
+  const std::vector<uint32_t> layers   = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1};
+  const double                radius   = 500.;
+
+  extension::SenseWireHitCollection hits;
+  for (std::size_t i = 0; i < azimuths.size(); ++i) {
+    auto hit = hits.create();
+    hit.setCellID(layers[i]);
+    hit.setPosition({radius * std::cos(azimuths[i]), radius * std::sin(azimuths[i]), 0.});
+  }
+
+  SenseWireHitIndex index;
+  index.build(hits, 2, [](const auto& hit) { return uint32_t(hit.getCellID()); });
+  if (index.size() != hits.size()) {
+    std::printf("%zu indexed hits for %zu hits\n", index.size(), hits.size());
+    return 1;
+  }
+
+  // windows centred on either side of +-pi, on it, and not wrapping
+  const std::vector<double> centres    = {M_PI, -M_PI, M_PI - 0.005, -M_PI + 0.005, 3. * M_PI, 0., 1.};
+  const std::vector<double> halfWidths = {0., 0.0015, 0.004, 0.02, 0.06, 1., M_PI};
+  for (uint32_t layer = 0; layer < 2; ++layer)
+    for (double phi : centres)
+      for (double halfWidth : halfWidths)
+        if (const int code = checkWindow(index, azimuths, layers, layer, phi, halfWidth))
+          return code;
+
+  std::printf("good windows\n");
+  return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DenseKeyIndex.h"
+
+#include <cstdint>
+
+/// (cellID, pixel, readout frame) key of the digitized pixel hits
+struct PixelFrameKey {
+  uint64_t cellID;
+  int32_t  pixelU;
+  int32_t  pixelV;
+  int64_t  frame;
+
+  bool operator==(const PixelFrameKey& other) const {
+    return cellID == other.cellID && pixelU == other.pixelU && pixelV == other.pixelV && frame == other.frame;
+  }
+};
+
+struct PixelFrameKeyHash {
+  uint64_t operator()(const PixelFrameKey& key) const {
+    uint64_t h = key.cellID;
+    h ^= (static_cast<uint64_t>(static_cast<uint32_t>(key.pixelU)) << 32) | static_cast<uint32_t>(key.pixelV);
+    h += 0x9e3779b97f4a7c15ULL * static_cast<uint64_t>(key.frame + 1);
+    return splitmix64(h);
+  }
+};
+
+/** @class PixelFrameIndex
+ *
+ *  Dense index of the (cellID, pixel, readout frame) keys, numbered in order of first insertion (see DenseKeyIndex) so
+ *  that the digitized output order does not depend on the hash.
+ *
+ */
+
+class PixelFrameIndex : public DenseKeyIndex<PixelFrameKey, PixelFrameKeyHash> {
+public:
+  using Key = PixelFrameKey;
+};
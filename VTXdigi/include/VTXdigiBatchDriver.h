@@ -0,0 +1,25 @@
+#pragma once
+
+#include "DigiBatchDriver.h"
+#include "VTXdigitizer.h"
+
+/** @class VTXdigiBatchDriver
+ *
+ *  Runs the batch mode of the VTXdigitizer (VTXdigitizer::digitizeBatch) on a podio file, batchSize events per call,
+ *  see DigiBatchDriver. The digitizer instance is configured in the job options as usual, the collection names are the
+ *  ones of its data handles.
+ *
+ */
+
+class VTXdigiBatchDriver final : public DigiBatchDriver<VTXdigitizer> {
+public:
+  using DigiBatchDriver<VTXdigitizer>::DigiBatchDriver;
+
+protected:
+  StatusCode digitize(const VTXdigitizer& digitizer, std::vector<podio::Frame>& frames) const override;
+
+private:
+  Gaudi::Property<std::string> m_simHitsName{this, "inputSimHits", "VertexBarrelCollection", "Input sim vertex hit collection name"};
+  Gaudi::Property<std::string> m_digiHitsName{this, "outputDigiHits", "VTXDigis", "Output digitized vertex hit collection name"};
+  Gaudi::Property<std::string> m_simDigiLinkName{this, "outputSimDigiAssociation", "VTXSimDigiLinks", "Output link between sim hits and digitized hits collection name"};
+};
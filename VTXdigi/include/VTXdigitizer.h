@@ -22,6 +22,10 @@
 
 #include "DDSegmentation/BitFieldCoder.h"
 
+#include "AlgorithmInstrumentation.h"
+#include "IDigiGeometryCacheSvc.h"
+#include "PixelFrameIndex.h"
+
 #include <vector>
 
 /** @class VTXdigitizer
@@ -49,6 +53,19 @@ public:
    *   @return status code
    */
   virtual StatusCode finalize() final;
+  /**  Batch mode: digitize the sim hits of several events in one call, see VTXdigiBatchDriver. The sim hits go
+   *   straight from the input collections to the pixel hits of their event, the transformation back to the global
+   *   frame runs over the pixel hits of all the events, and the outputs are split back per event into the collections
+   *   given by the caller. The random numbers are drawn event by event in the order of execute(), so that a batch
+   *   gives the same output as its events run one after the other. execute() is a batch of one event.
+   *   The sensor lookup, smearing and pixel integration stay a loop over the hits of each event, through the Gaudi
+   *   random numbers and the cell decoder: no speed up over execute() has been measured, the batch only saves the
+   *   framework calls between the events.
+   *   @return status code
+   */
+  StatusCode digitizeBatch(const std::vector<const edm4hep::SimTrackerHitCollection*>&         input_sim_hits,
+                           const std::vector<edm4hep::TrackerHit3DCollection*>&                output_digi_hits,
+                           const std::vector<edm4hep::TrackerHitSimTrackerHitLinkCollection*>& output_sim_digi_links) const;
 
 private:
   // Input sim vertex hit collection name
@@ -68,6 +85,10 @@ private:
   dd4hep::DDSegmentation::BitFieldCoder* m_decoder;
   // Volume manager to get the physical cell sensitive volume
   dd4hep::VolumeManager m_volman;
+  // Geometry cache service, and its table of the sensor transformations (shared, immutable)
+  Gaudi::Property<std::string> m_geometryCacheSvcName{this, "geometryCacheSvcName", "DigiGeometryCacheSvc", "The name of the DigiGeometryCacheSvc (or DigiGeometrySnapshotSvc) instance (empty := volume manager look-up for each hit, no noise hits)"};
+  SmartIF<IDigiGeometryCacheSvc> m_geometryCacheSvc;
+  const DigiGeometry::CellTable* m_sensor_table = nullptr;
 
   // x resolution in um
   Gaudi::Property<std::vector<float>> m_x_resolution{this, "xResolution", {0.1}, "Spatial resolutions in the x direction per layer [um] (r-phi direction in barrel, z direction in disks)"};
@@ -84,6 +105,75 @@ private:
   // Option to force hits onto sensitive surface
   BooleanProperty m_forceHitsOntoSurface{this, "forceHitsOntoSurface", false, "Project hits onto the surface in case they are not yet on the surface (default: false"};
 
+  // Readout frame length used to integrate hits
+  FloatProperty m_integration_time{this, "integrationTime", -1.0, "Length of the readout frame in which sim hits falling in the same pixel are merged into one digitized hit [ns] (<=0 := disabled, one digitized hit per sim hit)"};
+
+  // Pixel pitches used to integrate hits
+  Gaudi::Property<std::vector<float>> m_pixel_pitch_x{this, "pixelPitchX", {}, "Pixel pitches in the x direction per layer used to integrate hits [mm] (empty := pixels are identified by the cellID only)"};
+  Gaudi::Property<std::vector<float>> m_pixel_pitch_y{this, "pixelPitchY", {}, "Pixel pitches in the y direction per layer used to integrate hits [mm] (empty := pixels are identified by the cellID only)"};
+
+  // Noise hit probability per pixel and readout frame
+  Gaudi::Property<std::vector<float>> m_noise_rate{this, "noiseRate", {}, "Probability for a pixel to produce a noise hit in one event (readout frame) per layer (empty := no noise). Requires pixelPitchX and pixelPitchY"};
+
+  // Per stage timing and throughput counters (one probe per batch, i.e. per event in execute())
+  enum Stages { Geometry, HitIntegration, Smearing, NoiseHits, OutputFill };
+  AlgorithmInstrumentation m_instrumentation{this, {"global frame", "local frame and hit integration", "smearing", "noise hits", "output fill"}};
+
+  // Value of the TrackerHit3D type used to flag noise hits
+  static constexpr int32_t s_noiseHitType = 1;
+
+  // Pixel grid of a sensor, cached at initialize to place noise hits without geometry lookups
+  struct NoiseSensor {
+    dd4hep::DDSegmentation::CellID cellID;
+    dd4hep::rec::Vector3D          corner;  // position of the (u, v) = (0, 0) sensor corner [cm]
+    dd4hep::rec::Vector3D          pitchU;  // u direction scaled by the pixel pitch [cm]
+    dd4hep::rec::Vector3D          pitchV;  // v direction scaled by the pixel pitch [cm]
+    uint32_t                       nPixelsV;
+  };
+  // Sensors of each layer
+  std::vector<std::vector<NoiseSensor>> m_noise_sensors;
+  // For each layer, flat index of the first pixel of each sensor (plus the total number of pixels as last entry)
+  std::vector<std::vector<uint64_t>> m_noise_pixel_offsets;
+  // Build the sensor pixel grids from the surfaces of the detector
+  StatusCode buildNoiseSensorTable();
+  // Noise hit of a pixel center, position in mm
+  struct NoiseHit {
+    dd4hep::DDSegmentation::CellID cellID;
+    edm4hep::Vector3d              position;
+    float                          time;
+  };
+  // Add noise hits to m_noise_hits, with a cost proportional to the number of noise hits
+  void addNoiseHits() const;
+
+  // Check if the sensor box is along y-z (barrel) rather than x-y (disks)
+  bool isBarrelReadout() const { return m_readoutName == "VertexBarrelCollection" || m_readoutName == "SiWrBCollection"; }
+
+  // Hits integrated in the same pixel and readout frame, before smearing
+  struct PixelHit {
+    dd4hep::DDSegmentation::CellID cellID;
+    int                            layer;
+    uint32_t                       sensor;                 // entry in m_sensor_table, npos if not cached
+    const TGeoMatrix*              sensorTransformMatrix;  // only for the sensors not cached
+    double                         localPositionSum[3];  // eDep weighted sum of the local sim hit positions [cm]
+    double                         localPositionSumUnweighted[3];
+    float                          eDep;
+    float                          time;  // earliest contributing sim hit time [ns]
+    unsigned                       nContributions;
+    double                         digiLocalPosition[3];  // smeared local position [cm]
+    edm4hep::Vector3d              digiGlobalPosition;    // smeared global position [mm]
+    float                          digiTime;              // smeared time [ns]
+  };
+  // Per thread buffers reused across events to avoid re-allocating them; the pixel hits and noise hits of all the
+  // events of a batch are stored one event after the other
+  inline static thread_local PixelFrameIndex       m_pixel_index;
+  inline static thread_local std::vector<PixelHit> m_pixel_hits;
+  inline static thread_local std::vector<uint32_t> m_sim_hit_to_pixel_hit;
+  inline static thread_local std::vector<NoiseHit> m_noise_hits;
+  // First sim hit, pixel hit and noise hit of each event of a batch, plus the totals as last entries
+  inline static thread_local std::vector<size_t> m_sim_hit_offsets;
+  inline static thread_local std::vector<size_t> m_pixel_hit_offsets;
+  inline static thread_local std::vector<size_t> m_noise_hit_offsets;
+
   // Random Number Service
   SmartIF<IRndmGenSvc> m_randSvc;
 
@@ -91,4 +181,6 @@ private:
   std::vector<Rndm::Numbers> m_gauss_x_vec;
   std::vector<Rndm::Numbers> m_gauss_y_vec;
   std::vector<Rndm::Numbers> m_gauss_t_vec;
+  // Uniform random number generator used for the noise hits
+  Rndm::Numbers m_uniform;
 };
@@ -0,0 +1,29 @@
+#include "VTXdigiBatchDriver.h"
+
+DECLARE_COMPONENT(VTXdigiBatchDriver)
+
+StatusCode VTXdigiBatchDriver::digitize(const VTXdigitizer& digitizer, std::vector<podio::Frame>& frames) const {
+  const size_t nEvents = frames.size();
+  std::vector<const edm4hep::SimTrackerHitCollection*> input_sim_hits;
+  input_sim_hits.reserve(nEvents);
+  for (const auto& frame : frames)
+    input_sim_hits.push_back(&frame.get<edm4hep::SimTrackerHitCollection>(m_simHitsName));
+
+  std::vector<edm4hep::TrackerHit3DCollection>                digi_hits(nEvents);
+  std::vector<edm4hep::TrackerHitSimTrackerHitLinkCollection> sim_digi_links(nEvents);
+  std::vector<edm4hep::TrackerHit3DCollection*>                output_digi_hits;
+  std::vector<edm4hep::TrackerHitSimTrackerHitLinkCollection*> output_sim_digi_links;
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    output_digi_hits.push_back(&digi_hits[iEvent]);
+    output_sim_digi_links.push_back(&sim_digi_links[iEvent]);
+  }
+  StatusCode sc = digitizer.digitizeBatch(input_sim_hits, output_digi_hits, output_sim_digi_links);
+  if (sc.isFailure())
+    return sc;
+
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    frames[iEvent].put(std::move(digi_hits[iEvent]), m_digiHitsName);
+    frames[iEvent].put(std::move(sim_digi_links[iEvent]), m_simDigiLinkName);
+  }
+  return StatusCode::SUCCESS;
+}
@@ -1,5 +1,10 @@
 #include "VTXdigitizer.h"
 
+// STL
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 DECLARE_COMPONENT(VTXdigitizer)
 
 VTXdigitizer::VTXdigitizer(const std::string& aName, ISvcLocator* aSvcLoc)
@@ -43,15 +48,34 @@ StatusCode VTXdigitizer::initialize() {
     }
   }
 
-  // check if readout exists
-  if (m_geoSvc->getDetector()->readouts().find(m_readoutName) == m_geoSvc->getDetector()->readouts().end()) {
-    error() << "Readout <<" << m_readoutName << ">> does not exist." << endmsg;
-    return StatusCode::FAILURE;
+  // retrieve the geometry: from the geometry cache, which is built on the GeoSvc detector or read from a geometry
+  // snapshot, or directly from the GeoSvc detector
+  dd4hep::Detector* detector = nullptr;
+  if (!m_geometryCacheSvcName.empty()) {
+    m_geometryCacheSvc = service(m_geometryCacheSvcName, true);
+    if (!m_geometryCacheSvc) {
+      error() << "Couldn't get DigiGeometryCacheSvc!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    detector  = m_geometryCacheSvc->detector();
+    m_decoder = m_geometryCacheSvc->decoder(m_readoutName);
+    if (!m_decoder)
+      return StatusCode::FAILURE;
+    // the sensor transformations
+    m_sensor_table = m_geometryCacheSvc->sensorTransforms(m_readoutName);
+    if (!m_sensor_table)
+      return StatusCode::FAILURE;
+  } else {
+    detector = m_geoSvc->getDetector();
+    // check if readout exists
+    if (detector->readouts().find(m_readoutName) == detector->readouts().end()) {
+      error() << "Readout <<" << m_readoutName << ">> does not exist." << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // set the cellID decoder
+    m_decoder = detector->readout(m_readoutName).idSpec().decoder(); // Can be used to access e.g. layer index: m_decoder->get(cellID, "layer"),
   }
 
-  // set the cellID decoder
-  m_decoder = m_geoSvc->getDetector()->readout(m_readoutName).idSpec().decoder(); // Can be used to access e.g. layer index: m_decoder->get(cellID, "layer"),
-
   if (m_decoder->fieldDescription().find("layer") == std::string::npos){
     error() 
       << " Readout " << m_readoutName << " does not contain layer id!"
@@ -59,143 +83,397 @@ StatusCode VTXdigitizer::initialize() {
     return StatusCode::FAILURE;
   }
   
-  // retrieve the volume manager
-  m_volman = m_geoSvc->getDetector()->volumeManager();
+  // retrieve the volume manager, not available with a geometry snapshot
+  if (detector) {
+    m_volman = detector->volumeManager();
+  } else if (m_forceHitsOntoSurface) {
+    error() << "forceHitsOntoSurface needs the full detector geometry, it can't be used with a geometry snapshot!"
+            << endmsg;
+    return StatusCode::FAILURE;
+  }
+
+  // check the pixel pitches used for the hit integration
+  if (m_pixel_pitch_x.size() != m_pixel_pitch_y.size() ||
+      (!m_pixel_pitch_x.empty() && m_pixel_pitch_x.size() != m_x_resolution.size())) {
+    error() << "pixelPitchX and pixelPitchY must either be empty or define the pixel pitch of all detector layers!"
+            << endmsg;
+    return StatusCode::FAILURE;
+  }
+  for (size_t i = 0; i < m_pixel_pitch_x.size(); ++i) {
+    if (m_pixel_pitch_x[i] <= 0 || m_pixel_pitch_y[i] <= 0) {
+      error() << "Pixel pitches must be positive!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+  }
+  if (m_integration_time > 0)
+    info() << "Integrating hits in readout frames of " << m_integration_time.value() << " ns" << endmsg;
+
+  // prepare the noise hit generation
+  if (!m_noise_rate.empty()) {
+    if (m_noise_rate.size() != m_x_resolution.size() || m_pixel_pitch_x.empty()) {
+      error() << "noiseRate must define the noise rate of all detector layers, and requires pixelPitchX and pixelPitchY!"
+              << endmsg;
+      return StatusCode::FAILURE;
+    }
+    for (const auto& rate : m_noise_rate) {
+      if (rate < 0 || rate >= 1) {
+        error() << "Noise rates must be in [0, 1)!" << endmsg;
+        return StatusCode::FAILURE;
+      }
+    }
+    if (m_uniform.initialize(m_randSvc, Rndm::Flat(0., 1.)).isFailure()) {
+      error() << "Couldn't initialize RndmGenSvc!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (buildNoiseSensorTable().isFailure())
+      return StatusCode::FAILURE;
+  }
 
+  m_instrumentation.initialize(this);
   return StatusCode::SUCCESS;
 }
 
 StatusCode VTXdigitizer::execute(const EventContext&) const {
-  // Get the input collection with Geant4 hits
-  const edm4hep::SimTrackerHitCollection* input_sim_hits = m_input_sim_hits.get();
-  verbose() << "Input Sim Hit collection size: " << input_sim_hits->size() << endmsg;
-
-  // Digitize the sim hits
-  edm4hep::TrackerHit3DCollection* output_digi_hits = m_output_digi_hits.createAndPut();
-  edm4hep::TrackerHitSimTrackerHitLinkCollection* output_sim_digi_link_col = m_output_sim_digi_link.createAndPut();
-  for (const auto& input_sim_hit : *input_sim_hits) {
-    auto output_digi_hit = output_digi_hits->create();
-    auto output_sim_digi_link = output_sim_digi_link_col->create();
-
-    // smear the hit position: need to go in the local frame of the silicon sensor to smear in the direction along/perpendicular to the stave
-
-    // retrieve the cell detElement
-    dd4hep::DDSegmentation::CellID cellID = input_sim_hit.getCellID();
-    debug() << "Digitisation of " << m_readoutName << ", cellID: " << cellID << endmsg;
-
-    // Get transformation matrix of sensor
-    const auto& sensorTransformMatrix = m_volman.lookupVolumePlacement(cellID).matrix();
-
-    // Retrieve global position in mm and apply unit transformation (translation matrix is stored in cm)
-    double simHitGlobalPosition[3] = {input_sim_hit.getPosition().x * dd4hep::mm,
-                                      input_sim_hit.getPosition().y * dd4hep::mm,
-                                      input_sim_hit.getPosition().z * dd4hep::mm};
-    dd4hep::rec::Vector3D simHitGlobalPositionVector(simHitGlobalPosition[0], simHitGlobalPosition[1],
-                                                    simHitGlobalPosition[2]);
-    double simHitLocalPosition[3]  = {0, 0, 0};
-
-    if(m_forceHitsOntoSurface){
-      dd4hep::Detector& theDetector = dd4hep::Detector::getInstance();
-      dd4hep::rec::SurfaceManager& surfMan = *theDetector.extension<dd4hep::rec::SurfaceManager>() ;
-      dd4hep::DetElement det = m_geoSvc->getDetector()->detector(m_detectorName) ;
-      _map = surfMan.map( det.name() ) ;
-
-      if( ! _map )
-        error() << " Could not find surface map for detector " << det.name() << " in SurfaceManager " << endmsg;
-
-      dd4hep::rec::SurfaceMap::const_iterator sI = _map->find(cellID) ;
-      if( sI == _map->end() )
-        error() << " VTXdigitizer: no surface found for cellID " << m_decoder->valueString(cellID) << std::endl << endmsg;
-
-      dd4hep::rec::Vector3D newPos ;
-      const dd4hep::rec::ISurface* surf = sI->second ;    
-
-      // Check if Hit is inside sensitive 
-      if ( ! surf->insideBounds( simHitGlobalPositionVector ) ) {
-        
-        info() << "Hit at " << simHitGlobalPositionVector << " is not on surface " << *surf  
-                << ". Distance: " << surf->distance(simHitGlobalPositionVector )
-                << std::endl << endmsg;        
-
-        if( m_forceHitsOntoSurface ){
-          dd4hep::rec::Vector2D lv = surf->globalToLocal(simHitGlobalPositionVector) ;
-          dd4hep::rec::Vector3D oldPosOnSurf = surf->localToGlobal( lv ) ; 
+  // One event is a batch of one
+  return digitizeBatch({m_input_sim_hits.get()}, {m_output_digi_hits.createAndPut()},
+                       {m_output_sim_digi_link.createAndPut()});
+}
+
+StatusCode VTXdigitizer::digitizeBatch(
+    const std::vector<const edm4hep::SimTrackerHitCollection*>&         input_sim_hits,
+    const std::vector<edm4hep::TrackerHit3DCollection*>&                output_digi_hits,
+    const std::vector<edm4hep::TrackerHitSimTrackerHitLinkCollection*>& output_sim_digi_links) const {
+  const size_t nEvents = input_sim_hits.size();
+  if (output_digi_hits.size() != nEvents || output_sim_digi_links.size() != nEvents) {
+    error() << "The batch needs one output collection of each type per event!" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  auto probe = m_instrumentation.event();
+  m_sim_hit_offsets.assign(1, 0);
+  for (const auto* event_sim_hits : input_sim_hits) {
+    verbose() << "Input Sim Hit collection size: " << event_sim_hits->size() << endmsg;
+    m_sim_hit_offsets.push_back(m_sim_hit_offsets.back() + event_sim_hits->size());
+  }
+  const size_t nSimHits = m_sim_hit_offsets.back();
+  probe.hitsIn(nSimHits);
+
+  // Bring the sim hits in the local frame of their sensor and group the ones falling in the same pixel and readout
+  // frame (one group per sim hit if integration is disabled), event by event
+  probe.enter(HitIntegration);
+  const bool integrate       = m_integration_time > 0;
+  uint64_t   nMissingSensors = 0;
+  m_pixel_hits.clear();
+  m_sim_hit_to_pixel_hit.clear();
+  m_pixel_hits.reserve(nSimHits);
+  m_sim_hit_to_pixel_hit.reserve(nSimHits);
+  m_pixel_hit_offsets.assign(1, 0);
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    const uint32_t firstPixelHit = m_pixel_hits.size();
+    m_pixel_index.reset(integrate ? input_sim_hits[iEvent]->size() : 0);
+    for (const auto& input_sim_hit : *input_sim_hits[iEvent]) {
+      // smear the hit position: need to go in the local frame of the silicon sensor to smear in the direction along/perpendicular to the stave
+
+      // retrieve the cell detElement
+      dd4hep::DDSegmentation::CellID cellID = input_sim_hit.getCellID();
+      debug() << "Digitisation of " << m_readoutName << ", cellID: " << cellID << endmsg;
+
+      // Get transformation matrix of sensor, from the geometry cache if possible
+      const uint32_t    sensor = m_sensor_table ? m_sensor_table->find(cellID) : DigiGeometry::CellTable::npos;
+      const TGeoMatrix* sensorTransformMatrix = nullptr;
+      if (sensor == DigiGeometry::CellTable::npos) {
+        if (!m_volman.isValid()) {
+          error() << "Sensor of cellID " << m_decoder->valueString(cellID) << " is not in the geometry snapshot!"
+                  << endmsg;
+          return StatusCode::FAILURE;
+        }
+        sensorTransformMatrix = &m_volman.lookupVolumePlacement(cellID).matrix();
+        ++nMissingSensors;
+      }
+
+      // Retrieve global position in mm and apply unit transformation (translation matrix is stored in cm)
+      double simHitGlobalPosition[3] = {input_sim_hit.getPosition().x * dd4hep::mm,
+                                        input_sim_hit.getPosition().y * dd4hep::mm,
+                                        input_sim_hit.getPosition().z * dd4hep::mm};
+      dd4hep::rec::Vector3D simHitGlobalPositionVector(simHitGlobalPosition[0], simHitGlobalPosition[1],
+                                                      simHitGlobalPosition[2]);
+      double simHitLocalPosition[3]  = {0, 0, 0};
+
+      if(m_forceHitsOntoSurface){
+        dd4hep::Detector& theDetector = dd4hep::Detector::getInstance();
+        dd4hep::rec::SurfaceManager& surfMan = *theDetector.extension<dd4hep::rec::SurfaceManager>() ;
+        dd4hep::DetElement det = m_geoSvc->getDetector()->detector(m_detectorName) ;
+        _map = surfMan.map( det.name() ) ;
+
+        if( ! _map )
+          error() << " Could not find surface map for detector " << det.name() << " in SurfaceManager " << endmsg;
+
+        dd4hep::rec::SurfaceMap::const_iterator sI = _map->find(cellID) ;
+        if( sI == _map->end() )
+          error() << " VTXdigitizer: no surface found for cellID " << m_decoder->valueString(cellID) << std::endl << endmsg;
+
+        dd4hep::rec::Vector3D newPos ;
+        const dd4hep::rec::ISurface* surf = sI->second ;    
+
+        // Check if Hit is inside sensitive 
+        if ( ! surf->insideBounds( simHitGlobalPositionVector ) ) {
           
-          info() << "Moved hit to " << oldPosOnSurf << ", distance " << (oldPosOnSurf-simHitGlobalPositionVector).r()
-                  << std::endl << endmsg;
+          info() << "Hit at " << simHitGlobalPositionVector << " is not on surface " << *surf  
+                  << ". Distance: " << surf->distance(simHitGlobalPositionVector )
+                  << std::endl << endmsg;        
+
+          if( m_forceHitsOntoSurface ){
+            dd4hep::rec::Vector2D lv = surf->globalToLocal(simHitGlobalPositionVector) ;
+            dd4hep::rec::Vector3D oldPosOnSurf = surf->localToGlobal( lv ) ; 
             
-          simHitGlobalPositionVector = oldPosOnSurf ;
-        } 
+            info() << "Moved hit to " << oldPosOnSurf << ", distance " << (oldPosOnSurf-simHitGlobalPositionVector).r()
+                    << std::endl << endmsg;
+              
+            simHitGlobalPositionVector = oldPosOnSurf ;
+          } 
+        }
       }
+
+      // get the simHit coordinate in cm in the sensor reference frame to be able to apply smearing
+      if (sensorTransformMatrix)
+        sensorTransformMatrix->MasterToLocal(simHitGlobalPosition, simHitLocalPosition);
+      else
+        m_sensor_table->toLocal(sensor, simHitGlobalPosition, simHitLocalPosition);
+      debug() << "Cell ID string: " << m_decoder->valueString(cellID) << endmsg;
+      ;
+      debug() << "Global simHit x " << simHitGlobalPosition[0] << " [mm] --> Local simHit x " << simHitLocalPosition[0]
+              << " [cm]" << endmsg;
+      debug() << "Global simHit y " << simHitGlobalPosition[1] << " [mm] --> Local simHit y " << simHitLocalPosition[1]
+              << " [cm]" << endmsg;
+      debug() << "Global simHit z " << simHitGlobalPosition[2] << " [mm] --> Local simHit z " << simHitLocalPosition[2]
+              << " [cm]" << endmsg;
+
+      int iLayer = m_decoder->get(cellID, "layer");
+      debug() << "readout: " << m_readoutName << ", layer id: " << iLayer << endmsg;
+
+      // Find the pixel and readout frame of the hit
+      uint32_t iPixelHit = m_pixel_hits.size();
+      if (integrate) {
+        PixelFrameIndex::Key key{cellID, 0, 0,
+                                 static_cast<int64_t>(std::floor(input_sim_hit.getTime() / m_integration_time.value()))};
+        if (!m_pixel_pitch_x.empty()) {
+          // In barrel, the sensor box is along y-z, in the disks it is already in x-y
+          double localU = isBarrelReadout() ? simHitLocalPosition[1] : simHitLocalPosition[0];
+          double localV = isBarrelReadout() ? simHitLocalPosition[2] : simHitLocalPosition[1];
+          key.pixelU    = static_cast<int32_t>(std::floor(localU / (m_pixel_pitch_x[iLayer] * dd4hep::mm)));
+          key.pixelV    = static_cast<int32_t>(std::floor(localV / (m_pixel_pitch_y[iLayer] * dd4hep::mm)));
+        }
+        iPixelHit = firstPixelHit + m_pixel_index.insert(key).first;
+      }
+      if (iPixelHit == m_pixel_hits.size())
+        m_pixel_hits.push_back(PixelHit{cellID, iLayer, sensor, sensorTransformMatrix, {0, 0, 0}, {0, 0, 0}, 0,
+                                        input_sim_hit.getTime(), 0, {0, 0, 0}, {}, 0});
+
+      // Sum the energy, keep the earliest time and accumulate the position weighted by the deposited energy
+      PixelHit& pixelHit = m_pixel_hits[iPixelHit];
+      float     eDep     = input_sim_hit.getEDep();
+      for (int i = 0; i < 3; ++i) {
+        pixelHit.localPositionSum[i] += eDep * simHitLocalPosition[i];
+        pixelHit.localPositionSumUnweighted[i] += simHitLocalPosition[i];
+      }
+      pixelHit.eDep += eDep;
+      pixelHit.time = std::min(pixelHit.time, input_sim_hit.getTime());
+      pixelHit.nContributions++;
+      m_sim_hit_to_pixel_hit.push_back(iPixelHit);
     }
+    m_pixel_hit_offsets.push_back(m_pixel_hits.size());
+    verbose() << "Number of integrated pixel hits: " << m_pixel_hits.size() - firstPixelHit << endmsg;
+  }
+  if (m_sensor_table)
+    m_sensor_table->countLookups(nSimHits - nMissingSensors, nMissingSensors);
+
+  const bool endcapReadout = m_readoutName == "VertexEndcapCollection" || m_readoutName == "SiWrDCollection";
+  if (!isBarrelReadout() && !endcapReadout && !m_pixel_hits.empty()) {
+    error()
+        << "VTX readout name (m_readoutName) unknown or xResolution/yResolution/tResolution not defining all detector layer resolutions!"
+        << endmsg;
+    return StatusCode::FAILURE;
+  }
 
-    // get the simHit coordinate in cm in the sensor reference frame to be able to apply smearing
-    sensorTransformMatrix.MasterToLocal(simHitGlobalPosition, simHitLocalPosition);
-    debug() << "Cell ID string: " << m_decoder->valueString(cellID) << endmsg;
-    ;
-    debug() << "Global simHit x " << simHitGlobalPosition[0] << " [mm] --> Local simHit x " << simHitLocalPosition[0]
-            << " [cm]" << endmsg;
-    debug() << "Global simHit y " << simHitGlobalPosition[1] << " [mm] --> Local simHit y " << simHitLocalPosition[1]
-            << " [cm]" << endmsg;
-    debug() << "Global simHit z " << simHitGlobalPosition[2] << " [mm] --> Local simHit z " << simHitLocalPosition[2]
-            << " [cm]" << endmsg;
-
-    // build a vector to easily apply smearing of distance to the wire
-    dd4hep::rec::Vector3D simHitLocalPositionVector(simHitLocalPosition[0], simHitLocalPosition[1],
-                                                    simHitLocalPosition[2]);
-
-    // Smear the hit in the local sensor coordinates
-    double digiHitLocalPosition[3];
-    int iLayer = m_decoder->get(cellID, "layer");      
-    debug() << "readout: " << m_readoutName << ", layer id: " << iLayer << endmsg;
-    if (m_readoutName == "VertexBarrelCollection" ||
-        m_readoutName == "SiWrBCollection") {  // In barrel, the sensor box is along y-z
-      digiHitLocalPosition[0] = simHitLocalPositionVector.x();
-      digiHitLocalPosition[1] = simHitLocalPositionVector.y() + m_gauss_x_vec[iLayer].shoot() * dd4hep::mm;
-      digiHitLocalPosition[2] = simHitLocalPositionVector.z() + m_gauss_y_vec[iLayer].shoot() * dd4hep::mm;
-    } else if (m_readoutName == "VertexEndcapCollection" ||
-               m_readoutName == "SiWrDCollection") {  // In the disks, the sensor box is already in x-y
-      digiHitLocalPosition[0] = simHitLocalPositionVector.x() + m_gauss_x_vec[iLayer].shoot() * dd4hep::mm;
-      digiHitLocalPosition[1] = simHitLocalPositionVector.y() + m_gauss_y_vec[iLayer].shoot() * dd4hep::mm;
-      digiHitLocalPosition[2] = simHitLocalPositionVector.z();
-    } else {
-      error()
-          << "VTX readout name (m_readoutName) unknown or xResolution/yResolution/tResolution not defining all detector layer resolutions!"
-          << endmsg;
-      return StatusCode::FAILURE;
+  // Smear the integrated hits in the local sensor coordinates and draw the noise hits, event by event so that the
+  // random numbers are used in the same order as when the events are digitized one by one
+  m_noise_hits.clear();
+  m_noise_hit_offsets.assign(1, 0);
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    probe.enter(Smearing);
+    for (size_t iPixelHit = m_pixel_hit_offsets[iEvent]; iPixelHit < m_pixel_hit_offsets[iEvent + 1]; ++iPixelHit) {
+      PixelHit& pixelHit = m_pixel_hits[iPixelHit];
+
+      // build a vector to easily apply smearing of distance to the wire
+      double simHitLocalPosition[3];
+      for (int i = 0; i < 3; ++i)
+        simHitLocalPosition[i] = pixelHit.eDep > 0 ? pixelHit.localPositionSum[i] / pixelHit.eDep
+                                                   : pixelHit.localPositionSumUnweighted[i] / pixelHit.nContributions;
+
+      double* digiHitLocalPosition = pixelHit.digiLocalPosition;
+      int     iLayer               = pixelHit.layer;
+      if (isBarrelReadout()) {  // In barrel, the sensor box is along y-z
+        digiHitLocalPosition[0] = simHitLocalPosition[0];
+        digiHitLocalPosition[1] = simHitLocalPosition[1] + m_gauss_x_vec[iLayer].shoot() * dd4hep::mm;
+        digiHitLocalPosition[2] = simHitLocalPosition[2] + m_gauss_y_vec[iLayer].shoot() * dd4hep::mm;
+      } else {  // In the disks, the sensor box is already in x-y
+        digiHitLocalPosition[0] = simHitLocalPosition[0] + m_gauss_x_vec[iLayer].shoot() * dd4hep::mm;
+        digiHitLocalPosition[1] = simHitLocalPosition[1] + m_gauss_y_vec[iLayer].shoot() * dd4hep::mm;
+        digiHitLocalPosition[2] = simHitLocalPosition[2];
+      }
+
+      // Apply time smearing
+      pixelHit.digiTime = pixelHit.time + m_gauss_t_vec[iLayer].shoot();
     }
+    // The noise hits of the event, not linked to any sim hit
+    probe.enter(NoiseHits);
+    if (!m_noise_rate.empty())
+      addNoiseHits();
+    m_noise_hit_offsets.push_back(m_noise_hits.size());
+  }
 
-    // go back to the global frame
+  // Go back to the global frame, for the integrated hits of all the events
+  probe.enter(Geometry);
+  for (auto& pixelHit : m_pixel_hits) {
     double digiHitGlobalPosition[3] = {0, 0, 0};
-    sensorTransformMatrix.LocalToMaster(digiHitLocalPosition, digiHitGlobalPosition);
+    if (pixelHit.sensorTransformMatrix)
+      pixelHit.sensorTransformMatrix->LocalToMaster(pixelHit.digiLocalPosition, digiHitGlobalPosition);
+    else
+      m_sensor_table->toGlobal(pixelHit.sensor, pixelHit.digiLocalPosition, digiHitGlobalPosition);
 
     // go back to mm
-    edm4hep::Vector3d digiHitGlobalPositionVector(digiHitGlobalPosition[0] / dd4hep::mm,
-                                                  digiHitGlobalPosition[1] / dd4hep::mm,
-                                                  digiHitGlobalPosition[2] / dd4hep::mm);
-
-    debug() << "Global digiHit x " << digiHitGlobalPositionVector[0] << " [mm] --> Local digiHit x "
-            << digiHitLocalPosition[0] << " [cm]" << endmsg;
-    debug() << "Global digiHit y " << digiHitGlobalPositionVector[1] << " [mm] --> Local digiHit y "
-            << digiHitLocalPosition[1] << " [cm]" << endmsg;
-    debug() << "Global digiHit z " << digiHitGlobalPositionVector[2] << " [mm] --> Local digiHit z "
-            << digiHitLocalPosition[2] << " [cm]" << endmsg;
+    pixelHit.digiGlobalPosition = edm4hep::Vector3d(digiHitGlobalPosition[0] / dd4hep::mm,
+                                                    digiHitGlobalPosition[1] / dd4hep::mm,
+                                                    digiHitGlobalPosition[2] / dd4hep::mm);
+
+    debug() << "Global digiHit x " << pixelHit.digiGlobalPosition[0] << " [mm] --> Local digiHit x "
+            << pixelHit.digiLocalPosition[0] << " [cm]" << endmsg;
+    debug() << "Global digiHit y " << pixelHit.digiGlobalPosition[1] << " [mm] --> Local digiHit y "
+            << pixelHit.digiLocalPosition[1] << " [cm]" << endmsg;
+    debug() << "Global digiHit z " << pixelHit.digiGlobalPosition[2] << " [mm] --> Local digiHit z "
+            << pixelHit.digiLocalPosition[2] << " [cm]" << endmsg;
     debug() << "Moving to next hit... " << std::endl << endmsg;
+  }
+
+  // Write the digitized hits, split back per event
+  probe.enter(OutputFill);
+  for (size_t iEvent = 0; iEvent < nEvents; ++iEvent) {
+    edm4hep::TrackerHit3DCollection*                output_digi_hits_event   = output_digi_hits[iEvent];
+    edm4hep::TrackerHitSimTrackerHitLinkCollection* output_sim_digi_link_col = output_sim_digi_links[iEvent];
+    const size_t firstPixelHit = m_pixel_hit_offsets[iEvent];
+    for (size_t iPixelHit = firstPixelHit; iPixelHit < m_pixel_hit_offsets[iEvent + 1]; ++iPixelHit) {
+      const PixelHit& pixelHit        = m_pixel_hits[iPixelHit];
+      auto            output_digi_hit = output_digi_hits_event->create();
+      output_digi_hit.setEDep(pixelHit.eDep);
+      output_digi_hit.setPosition(pixelHit.digiGlobalPosition);
+      output_digi_hit.setTime(pixelHit.digiTime);
+      output_digi_hit.setCellID(pixelHit.cellID);
+    }
 
-    output_digi_hit.setEDep(input_sim_hit.getEDep());
-    output_digi_hit.setPosition(digiHitGlobalPositionVector);
+    // Set the links between sim and digi hits, weighted by the fraction of deposited energy
+    const auto& event_sim_hits = *input_sim_hits[iEvent];
+    for (size_t iSimHit = 0; iSimHit < event_sim_hits.size(); ++iSimHit) {
+      const auto& input_sim_hit = event_sim_hits[iSimHit];
+      uint32_t    iPixelHit     = m_sim_hit_to_pixel_hit[m_sim_hit_offsets[iEvent] + iSimHit];
+      const auto& pixelHit      = m_pixel_hits[iPixelHit];
+      auto output_sim_digi_link = output_sim_digi_link_col->create();
+      output_sim_digi_link.setFrom((*output_digi_hits_event)[iPixelHit - firstPixelHit]);
+      output_sim_digi_link.setTo(input_sim_hit);
+      output_sim_digi_link.setWeight(pixelHit.eDep > 0 ? input_sim_hit.getEDep() / pixelHit.eDep
+                                                       : 1.f / pixelHit.nContributions);
+    }
 
-    // Apply time smearing
-    output_digi_hit.setTime(input_sim_hit.getTime() + m_gauss_t_vec[iLayer].shoot());
+    // Add the noise hits, not linked to any sim hit
+    for (size_t iNoiseHit = m_noise_hit_offsets[iEvent]; iNoiseHit < m_noise_hit_offsets[iEvent + 1]; ++iNoiseHit) {
+      const NoiseHit& noiseHit        = m_noise_hits[iNoiseHit];
+      auto            output_digi_hit = output_digi_hits_event->create();
+      output_digi_hit.setCellID(noiseHit.cellID);
+      output_digi_hit.setType(s_noiseHitType);
+      output_digi_hit.setEDep(0);
+      output_digi_hit.setTime(noiseHit.time);
+      output_digi_hit.setPosition(noiseHit.position);
+    }
+    verbose() << "Output Digi Hit collection size: " << output_digi_hits_event->size() << endmsg;
+    probe.hitsOut(output_digi_hits_event->size());
+  }
+  probe.leave();
+  if (probe.enabled())
+    probe.workingMemory(m_pixel_index.memory() + m_pixel_hits.capacity() * sizeof(PixelHit) +
+                        m_sim_hit_to_pixel_hit.capacity() * sizeof(uint32_t) +
+                        m_noise_hits.capacity() * sizeof(NoiseHit));
 
-    output_digi_hit.setCellID(cellID);
+  return StatusCode::SUCCESS;
+}
 
-    // Set the link between sim and digi hit
-    output_sim_digi_link.setFrom(output_digi_hit);
-    output_sim_digi_link.setTo(input_sim_hit);
+StatusCode VTXdigitizer::buildNoiseSensorTable() {
+  const std::vector<DigiGeometry::SensorSurface>* surfaces =
+      m_geometryCacheSvc ? m_geometryCacheSvc->sensorSurfaces(m_detectorName) : nullptr;
+  if (!surfaces) {
+    error() << "Could not find the sensor surfaces of detector " << m_detectorName
+            << " (the noise hits need the geometry cache)" << endmsg;
+    return StatusCode::FAILURE;
+  }
 
+  m_noise_sensors.assign(m_noise_rate.size(), {});
+  m_noise_pixel_offsets.assign(m_noise_rate.size(), {0});
+  for (const auto& surf : *surfaces) {
+    dd4hep::DDSegmentation::CellID cellID = surf.cellID;
+    int iLayer = m_decoder->get(cellID, "layer");
+    if (iLayer < 0 || iLayer >= int(m_noise_rate.size())) {
+      error() << "Sensor " << m_decoder->valueString(cellID) << " is in a layer without noise rate!" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // The surface u-v directions are assumed to follow the x-y order used for the resolutions and pixel pitches
+    double   pitchU   = m_pixel_pitch_x[iLayer] * dd4hep::mm;
+    double   pitchV   = m_pixel_pitch_y[iLayer] * dd4hep::mm;
+    uint32_t nPixelsU = std::max(1., std::floor(surf.lengthU / pitchU));
+    uint32_t nPixelsV = std::max(1., std::floor(surf.lengthV / pitchV));
+    dd4hep::rec::Vector3D u(surf.u[0], surf.u[1], surf.u[2]);
+    dd4hep::rec::Vector3D v(surf.v[0], surf.v[1], surf.v[2]);
+    dd4hep::rec::Vector3D origin(surf.origin[0], surf.origin[1], surf.origin[2]);
+    dd4hep::rec::Vector3D corner = origin - (0.5 * nPixelsU * pitchU) * u - (0.5 * nPixelsV * pitchV) * v;
+    m_noise_sensors[iLayer].push_back(NoiseSensor{cellID, corner, pitchU * u, pitchV * v, nPixelsV});
+    m_noise_pixel_offsets[iLayer].push_back(m_noise_pixel_offsets[iLayer].back() + uint64_t(nPixelsU) * nPixelsV);
   }
+
+  for (size_t iLayer = 0; iLayer < m_noise_sensors.size(); ++iLayer)
+    info() << "Noise hits in layer " << iLayer << ": " << m_noise_sensors[iLayer].size() << " sensors, "
+           << m_noise_pixel_offsets[iLayer].back() << " pixels, noise rate " << m_noise_rate[iLayer] << endmsg;
   return StatusCode::SUCCESS;
 }
 
-StatusCode VTXdigitizer::finalize() { return StatusCode::SUCCESS; }
+void VTXdigitizer::addNoiseHits() const {
+  for (size_t iLayer = 0; iLayer < m_noise_sensors.size(); ++iLayer) {
+    const double rate = m_noise_rate[iLayer];
+    if (rate <= 0)
+      continue;
+    const auto&    offsets   = m_noise_pixel_offsets[iLayer];
+    const uint64_t nPixels   = offsets.back();
+    const double   logNoHit  = std::log1p(-rate);
+    // Geometric skip sampling: the distance between two consecutive noisy pixels follows a geometric distribution
+    uint64_t iPixel = 0;
+    while (true) {
+      double skip = std::floor(std::log(std::max(m_uniform.shoot(), std::numeric_limits<double>::min())) / logNoHit);
+      if (skip >= double(nPixels - iPixel))
+        break;
+      iPixel += uint64_t(skip);
+
+      // Find the sensor containing the flat pixel index and place the hit at the pixel center
+      size_t      iSensor = std::upper_bound(offsets.begin(), offsets.end(), iPixel) - offsets.begin() - 1;
+      const auto& sensor  = m_noise_sensors[iLayer][iSensor];
+      uint64_t    iLocal  = iPixel - offsets[iSensor];
+      dd4hep::rec::Vector3D position = sensor.corner + (iLocal / sensor.nPixelsV + 0.5) * sensor.pitchU +
+                                       (iLocal % sensor.nPixelsV + 0.5) * sensor.pitchV;
+
+      float time = m_integration_time > 0 ? m_uniform.shoot() * m_integration_time.value() : 0;
+      m_noise_hits.push_back(NoiseHit{
+          sensor.cellID,
+          edm4hep::Vector3d(position.x() / dd4hep::mm, position.y() / dd4hep::mm, position.z() / dd4hep::mm), time});
+      ++iPixel;
+    }
+  }
+}
+
+StatusCode VTXdigitizer::finalize() {
+  m_instrumentation.summary(info());
+  return StatusCode::SUCCESS;
+}
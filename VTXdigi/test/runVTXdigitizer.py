@@ -22,6 +22,11 @@ innerVertexResolution_t = 1000 # [ns]
 outerVertexResolution_x = 0.050/math.sqrt(12) # [mm], assume ATLASPix3 sensor with 50 µm pitch
 outerVertexResolution_y = 0.150/math.sqrt(12) # [mm], assume ATLASPix3 sensor with 150 µm pitch
 outerVertexResolution_t = 1000 # [ns]
+innerVertexPixelPitch = 0.025 # [mm], ARCADIA sensor pitch
+outerVertexPixelPitch_x = 0.050 # [mm], ATLASPix3 sensor pitch
+outerVertexPixelPitch_y = 0.150 # [mm], ATLASPix3 sensor pitch
+vertexIntegrationTime = 1000 # [ns], hits in the same pixel within one readout frame are merged
+vertexNoiseRate = 1e-6 # probability for a pixel to produce a noise hit in one readout frame
 
 # CLD
 vertexBarrelResolution_x = 0.003 # [mm], assume 3 µm resolution
@@ -197,6 +202,24 @@ idea_vtxb_digitizer = VTXdigitizer("VTXBdigitizer",
     OutputLevel = INFO
 )
 
+# same barrel hits with the readout frame integration and noise hits, in separate output collections
+idea_vtxb_integrating_digitizer = VTXdigitizer("VTXBintegratingDigitizer",
+    inputSimHits = SimG4SaveTrackerHitsB.SimTrackHits.Path,
+    outputDigiHits = SimG4SaveTrackerHitsB.SimTrackHits.Path.replace("sim", "digi") + "_integrated",
+    outputSimDigiAssociation = SimG4SaveTrackerHitsB.SimTrackHits.Path.replace("simTrackerHits", "simDigiAssociation") + "_integrated",
+    detectorName = "Vertex",
+    readoutName = "VertexBarrelCollection",
+    xResolution = [innerVertexResolution_x, innerVertexResolution_x, innerVertexResolution_x, outerVertexResolution_x, outerVertexResolution_x], # mm, r-phi direction
+    yResolution = [innerVertexResolution_y, innerVertexResolution_y, innerVertexResolution_y, outerVertexResolution_y, outerVertexResolution_y], # mm, z direction
+    tResolution = [innerVertexResolution_t, innerVertexResolution_t, innerVertexResolution_t, outerVertexResolution_t, outerVertexResolution_t], # ns
+    integrationTime = vertexIntegrationTime, # ns
+    pixelPitchX = [innerVertexPixelPitch, innerVertexPixelPitch, innerVertexPixelPitch, outerVertexPixelPitch_x, outerVertexPixelPitch_x], # mm, r-phi direction
+    pixelPitchY = [innerVertexPixelPitch, innerVertexPixelPitch, innerVertexPixelPitch, outerVertexPixelPitch_y, outerVertexPixelPitch_y], # mm, z direction
+    noiseRate = [vertexNoiseRate, vertexNoiseRate, vertexNoiseRate, vertexNoiseRate, vertexNoiseRate],
+    forceHitsOntoSurface = False,
+    OutputLevel = INFO
+)
+
 idea_vtxd_digitizer  = VTXdigitizer("VTXDdigitizer",
     inputSimHits = SimG4SaveTrackerHitsD.SimTrackHits.Path,
     outputDigiHits = SimG4SaveTrackerHitsD.SimTrackHits.Path.replace("sim", "digi"),
@@ -283,6 +306,7 @@ ApplicationMgr(
               hepmc_converter,
               geantsim,
               idea_vtxb_digitizer, idea_vtxd_digitizer,
+              idea_vtxb_integrating_digitizer,
               idea_siwrb_digitizer, idea_siwrd_digitizer,
               out
               ],
@@ -9,7 +9,7 @@ from Configurables import k4DataSvc
 dataservice = k4DataSvc("EventDataSvc", input = vars().get("input", "data/arcsim_kaon+_edm4hep.root"))
 
 from Configurables import PodioInput
-podioinput = PodioInput("PodioInput", collections = ["ARC_HITS"], OutputLevel = DEBUG)
+podioinput = PodioInput("PodioInput", collections = ["EventHeader", "ARC_HITS"], OutputLevel = DEBUG)
 
 from Configurables import ARCdigitizer
 arc_digitizer = ARCdigitizer("ARCdigitizer",
@@ -17,6 +17,10 @@ arc_digitizer = ARCdigitizer("ARCdigitizer",
     outputDigiHits = "ARC_DIGI_HITS"
 )
 
+# the random numbers of the digitizer are seeded from the event header
+from Configurables import UniqueIDGenSvc
+uidsvc = UniqueIDGenSvc("uidSvc")
+
 from Configurables import PodioOutput
 podiooutput = PodioOutput("PodioOutput", filename = vars().get("output", "digi.root"), OutputLevel = DEBUG)
 podiooutput.outputCommands = ["keep *"]
@@ -42,5 +46,5 @@ ApplicationMgr(
     ],
     EvtSel = 'NONE',
     EvtMax = 10,
-    ExtSvc = [geoservice, dataservice]
+    ExtSvc = [geoservice, dataservice, uidsvc]
 )